@@ -20,6 +20,9 @@ struct ProcessStats {
     long no_coinc_multiples_events = 0;
     long no_coinc_single_events = 0;
     long no_coinc_events = 0;
+    // The sum of the weights of the coincidences, which is their number
+    // unless the emission was biased.
+    double weighted_coinc_events = 0;
 
     long no_events() const {
         return (no_kept + no_dropped + no_coinc_pair_events +
@@ -31,7 +34,8 @@ struct ProcessStats {
         ss << "coinc events            : " << no_coinc_events << "\n"
             << "events in coinc pair    : " << no_coinc_pair_events << "\n"
             << "events in coinc multiple: " << no_coinc_multiples_events << "\n"
-            << "events in coinc single  : " << no_coinc_single_events << "\n";
+            << "events in coinc single  : " << no_coinc_single_events << "\n"
+            << "weighted coinc events   : " << weighted_coinc_events << "\n";
         return (ss.str());
     }
 
@@ -42,6 +46,7 @@ struct ProcessStats {
         no_coinc_multiples_events += rhs.no_coinc_multiples_events;
         no_coinc_single_events += rhs.no_coinc_single_events;
         no_coinc_events += rhs.no_coinc_events;
+        weighted_coinc_events += rhs.weighted_coinc_events;
         return (*this);
     }
 
@@ -0,0 +1,49 @@
+/*
+ * Gray: A Ray Tracing-based Monte Carlo Simulator for PET
+ *
+ * Copyright (c) 2018, David Freese, Peter Olcott, Sam Buss, Craig Levin
+ *
+ * This software is distributed under the terms of the MIT License unless
+ * otherwise noted.  See LICENSE for further details.
+ *
+ */
+
+#ifndef MESHFILE_H
+#define MESHFILE_H
+
+#include <istream>
+#include <string>
+#include <vector>
+#include "Gray/Graphics/ViewableMesh.h"
+#include "Gray/VrMath/LinearR3.h"
+
+// MeshFile reads triangle meshes from STL (binary or ASCII), OBJ, and PLY
+// (ASCII or binary) files straight into the shared vertices and triangle
+// indices used by ViewableMesh.  Polygons with more than three vertices are
+// split into a fan of triangles.  STL stores the vertices of each triangle
+// separately, so vertices that are exactly equal are merged.
+//
+// Each function returns false and describes the problem in error if the file
+// can't be read.
+class MeshFile {
+public:
+    // Reads the file, choosing the format from its extension.
+    static bool Read(const std::string& filename,
+                     std::vector<VectorR3>& vertices,
+                     std::vector<ViewableMesh::Triangle>& triangles,
+                     std::string& error);
+    static bool ReadSTL(std::istream& input,
+                        std::vector<VectorR3>& vertices,
+                        std::vector<ViewableMesh::Triangle>& triangles,
+                        std::string& error);
+    static bool ReadOBJ(std::istream& input,
+                        std::vector<VectorR3>& vertices,
+                        std::vector<ViewableMesh::Triangle>& triangles,
+                        std::string& error);
+    static bool ReadPLY(std::istream& input,
+                        std::vector<VectorR3>& vertices,
+                        std::vector<ViewableMesh::Triangle>& triangles,
+                        std::string& error);
+};
+
+#endif // MESHFILE_H
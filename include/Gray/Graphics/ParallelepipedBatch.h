@@ -0,0 +1,53 @@
+/*
+ * Gray: A Ray Tracing-based Monte Carlo Simulator for PET
+ *
+ * Copyright (c) 2018, David Freese, Peter Olcott, Sam Buss, Craig Levin
+ *
+ * This software is distributed under the terms of the MIT License unless
+ * otherwise noted.  See LICENSE for further details.
+ *
+ */
+
+#ifndef PARALLELEPIPEDBATCH_H
+#define PARALLELEPIPEDBATCH_H
+
+#include <cstddef>
+#include <vector>
+#include "Gray/VrMath/LinearR3.h"
+
+class ViewableParallelepiped;
+
+// ParallelepipedBatch holds the face planes of groups of parallelepipeds as a
+// structure of arrays, so that the slab test for width of them at once is a
+// set of fixed length loops over contiguous doubles, which the compiler can
+// vectorize.  Each group is padded to a multiple of width by repeating its
+// last parallelepiped.
+class ParallelepipedBatch {
+public:
+    static constexpr size_t width = 4;
+
+    // Adds a group of parallelepipeds, returning the index of the first.
+    size_t AddGroup(const std::vector<const ViewableParallelepiped*>& group);
+    size_t Size() const {
+        return (top[0].size());
+    }
+
+    // For the width entries starting at first, finds the distances along the
+    // ray of the front and back faces, as ViewableParallelepiped would.  hit
+    // is false where the ray misses, or reaches the front beyond maxDistance.
+    void Intersect(size_t first, const VectorR3& viewPos,
+                   const VectorR3& viewDir, double maxDistance,
+                   double front[width], double back[width],
+                   bool hit[width]) const;
+
+private:
+    // The normal, and the top and bottom plane coefficients, of each of the
+    // three pairs of faces.
+    std::vector<double> normal_x[3];
+    std::vector<double> normal_y[3];
+    std::vector<double> normal_z[3];
+    std::vector<double> top[3];
+    std::vector<double> bottom[3];
+};
+
+#endif // PARALLELEPIPEDBATCH_H
@@ -18,6 +18,7 @@
 #include "Gray/Graphics/CameraView.h"
 #include "Gray/Graphics/Light.h"
 #include "Gray/Graphics/Material.h"
+#include "Gray/Graphics/ParallelepipedBatch.h"
 #include "Gray/Graphics/ViewableBase.h"
 #include "Gray/KdTree/KdTree.h"
 
@@ -157,13 +158,25 @@ public:
 
     AABB GetExtents() const;
     double GetMaxDistance() const;
+    // A box around each object with a sensitive material, including those
+    // within placed modules.
+    std::vector<AABB> GetSensitiveExtents() const;
 
     void BuildTree(bool use_double_recurse_split, double object_cost);
 
+    // skip is the surface that pos is on, from the last hit along the path,
+    // which is then not found again.
     long SeekIntersection(const VectorR3& pos, const VectorR3& direction,
-                          double & hitDist, VisiblePoint& returnedPoint) const;
+                          double & hitDist, VisiblePoint& returnedPoint,
+                          const HitSurface& skip = HitSurface()) const;
+    // Same as above, but walks the KdTree from the leaf given by leaf, which
+    // is updated to the leaf the search ended in.  Passing it back in on the
+    // next step of the same photon avoids descending from the root again.
+    long SeekIntersection(const VectorR3& pos, const VectorR3& direction,
+                          double & hitDist, VisiblePoint& returnedPoint,
+                          long & leaf,
+                          const HitSurface& skip = HitSurface()) const;
     bool TestOverlap() const;
-    static constexpr double ray_trace_epsilon = 1e-10;
 
 private:
 
@@ -176,10 +189,29 @@ private:
         }
     }
     bool TestOverlapSingle(VectorR3 & start, const VectorR3 & dir) const;
-    bool intersection_callback(long objectNum, const VectorR3 & start_pos,
-                               const VectorR3 & direction,
-                               double & retStopDistance,
-                               VisiblePoint & visible_point_return_ptr) const;
+
+    // The closest hit found so far in a search.  A hit on a parallelepiped
+    // found through box_batch is pending, and only has its VisiblePoint
+    // filled in once the search is over and it has won.
+    struct ClosestHit {
+        long object = -1;
+        double distance;
+        bool front_face;
+        bool pending = false;
+
+        bool Accept(long hitObject, double hitDistance, bool hitFrontFace,
+                    double & stopDistance);
+    };
+    static bool Uncrossed(long object, bool front_face,
+                          const HitSurface& skip);
+    long IntersectLeaf(long leaf, const VectorR3 & start_pos,
+                       const VectorR3 & direction, double & retStopDistance,
+                       const HitSurface& skip, ClosestHit & closest,
+                       VisiblePoint & returnedPoint) const;
+    void FinishHit(const ClosestHit & closest, const VectorR3 & start_pos,
+                   const VectorR3 & direction,
+                   VisiblePoint & returnedPoint) const;
+
     VectorR3 TheGlobalAmbientLight = VectorR3(0, 0, 0);
     VectorR3 TheBackgroundColor = VectorR3(1.0, 1.0, 1.0);
 
@@ -193,6 +225,16 @@ private:
     std::vector<std::unique_ptr<ViewableBase>> ViewableArray;
     std::map<std::string, int> material_names_map;
     KdTree kd_tree;
+
+    // The objects in each leaf of kd_tree, indexed by node, with the
+    // parallelepipeds split out and stored in box_batch from box_start on.
+    struct LeafObjects {
+        size_t box_start = 0;
+        std::vector<long> boxes;
+        std::vector<long> others;
+    };
+    std::vector<LeafObjects> leaf_objects;
+    ParallelepipedBatch box_batch;
     std::string default_material;
 };
 
@@ -35,9 +35,11 @@ public:
     // Returns an intersection if found with distance maxDistance
     // viewDir must be a unit vector.
     // intersectDistance and visPoint are returned values.
+    // skip is the surface the ray starts on, if any, which is not reported.
     bool FindIntersection (
         const VectorR3& viewPos, const VectorR3& viewDir, double maxDistance,
-        double *intersectDistance, VisiblePoint& returnedPoint ) const;
+        double *intersectDistance, VisiblePoint& returnedPoint,
+        const HitSurface& skip = HitSurface() ) const;
 
     // CalcBoundingPlanes:
     //   Computes the extents of the viewable object with respect to a
@@ -59,6 +61,13 @@ public:
     // Calculate the extent intersected with a bounding box
     virtual bool CalcExtentsInBox( const AABB& aabb, AABB& retAABB ) const;
 
+    // True for closed convex solids, so that a box with all of its corners
+    // inside of the object lies entirely inside of it.
+    virtual bool IsConvex() const
+    {
+        return false;
+    }
+
     int GetDetectorId() const
     {
         return detector_id;
@@ -75,6 +84,16 @@ public:
     {
         return src_id;
     }
+    // The order the object was added to its scene in, which decides between
+    // surfaces found at the same distance.
+    long GetSceneIndex() const
+    {
+        return scene_index;
+    }
+    void SetSceneIndex(long index)
+    {
+        scene_index = index;
+    }
 
     void SetMaterial( const Material* material );
     void SetMaterialFront( const Material* frontmaterial );
@@ -93,13 +112,19 @@ protected:
     //		the intersection point, and computing u,v coordinates.
     //	The "NT" version does not call the texture map: this is left for
     //		the non-NT version to do.
+    //  If skip.IsOn(this), the ray starts on the side of this object given by
+    //      skip.front_face, and that surface must not be reported again.
+    //      Front faces at a distance of zero are reported, as the ray may
+    //      start where the object touches the one it just left.
     virtual bool FindIntersectionNT (
         const VectorR3& viewPos, const VectorR3& viewDir, double maxDistance,
-        double *intersectDistance, VisiblePoint& returnedPoint ) const = 0;
+        double *intersectDistance, VisiblePoint& returnedPoint,
+        const HitSurface& skip ) const = 0;
 
 private:
     int detector_id;
     int src_id;
+    long scene_index;
 
     const Material* FrontMat;
     const Material* BackMat;	// Null point if not visible from back
@@ -108,6 +133,7 @@ private:
 inline ViewableBase::ViewableBase() :
     detector_id(-1),
     src_id(0),
+    scene_index(-1),
     FrontMat(&Material::Default),
     BackMat(&Material::Default)
 {
@@ -131,12 +157,18 @@ inline void ViewableBase::SetMaterialBack( const Material* backmaterial )
 
 inline bool ViewableBase::FindIntersection (
     const VectorR3& viewPos, const VectorR3& viewDir, double maxDistance,
-    double *intersectDistance, VisiblePoint& returnedPoint ) const
+    double *intersectDistance, VisiblePoint& returnedPoint,
+    const HitSurface& skip ) const
 {
+    // Set before the NT call so that viewables made of other viewables can
+    // refine the detector id and the surface of the point they hit.
+    returnedPoint.SetDetectorId(detector_id);
+    returnedPoint.ClearSurface();
     bool found = FindIntersectionNT(viewPos, viewDir, maxDistance,
-                                    intersectDistance, returnedPoint);
+                                    intersectDistance, returnedPoint, skip);
     if (found) {
         returnedPoint.SetObject(this);
+        returnedPoint.AddOuterObject(this);
     }
     return found;
 }
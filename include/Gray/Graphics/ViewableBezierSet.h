@@ -43,7 +43,8 @@ public:
     // intersectDistance and visPoint are returned values.
     virtual bool FindIntersectionNT (
         const VectorR3& viewPos, const VectorR3& viewDir, double maxDistance,
-        double *intersectDistance, VisiblePoint& returnedPoint ) const;
+        double *intersectDistance, VisiblePoint& returnedPoint,
+        const HitSurface& skip ) const;
     void CalcBoundingPlanes( const VectorR3& u, double *minDot, double *maxDot ) const;
     bool CalcPartials( const VisiblePoint& visPoint,
                        VectorR3& retPartialU, VectorR3& retPartialV ) const;
@@ -33,8 +33,13 @@ public:
     // intersectDistance and visPoint are returned values.
     virtual bool FindIntersectionNT (
         const VectorR3& viewPos, const VectorR3& viewDir, double maxDistance,
-        double *intersectDistance, VisiblePoint& returnedPoint ) const;
+        double *intersectDistance, VisiblePoint& returnedPoint,
+        const HitSurface& skip ) const;
     void CalcBoundingPlanes( const VectorR3& u, double *minDot, double *maxDot ) const;
+    bool IsConvex() const
+    {
+        return true;
+    }
 
     // SetCenterAxis should be called before the other set routines, otherwise
     //		strange effects can occur.  SetCenterAxis() chooses radial axes
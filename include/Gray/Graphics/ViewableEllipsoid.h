@@ -33,8 +33,13 @@ public:
     // intersectDistance and visPoint are returned values.
     virtual bool FindIntersectionNT (
         const VectorR3& viewPos, const VectorR3& viewDir, double maxDistance,
-        double *intersectDistance, VisiblePoint& returnedPoint ) const;
+        double *intersectDistance, VisiblePoint& returnedPoint,
+        const HitSurface& skip ) const;
     void CalcBoundingPlanes( const VectorR3& u, double *minDot, double *maxDot ) const;
+    bool IsConvex() const
+    {
+        return true;
+    }
 
     void SetCenter( double x, double y, double z );
     void SetCenter( const double *center );
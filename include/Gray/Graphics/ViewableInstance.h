@@ -0,0 +1,60 @@
+/*
+ * Gray: A Ray Tracing-based Monte Carlo Simulator for PET
+ *
+ * Copyright (c) 2018, David Freese, Peter Olcott, Sam Buss, Craig Levin
+ *
+ * This software is distributed under the terms of the MIT License unless
+ * otherwise noted.  See LICENSE for further details.
+ *
+ */
+
+#ifndef VIEWABLEINSTANCE_H
+#define VIEWABLEINSTANCE_H
+
+#include <memory>
+#include "Gray/Graphics/ViewableBase.h"
+#include "Gray/VrMath/LinearR3.h"
+
+class SceneDescription;
+
+// ViewableInstance places a module, a SceneDescription with its own KdTree
+// defined once in module-local coordinates, into the scene with a rigid
+// transform.  Rays are mapped into the module's space for traversal, so the
+// geometry and the tree of a module are shared between every instance of it.
+// Detector ids found inside of the module are offset by the first detector id
+// assigned to this instance.
+class ViewableInstance : public ViewableBase
+{
+public:
+    ViewableInstance(std::shared_ptr<const SceneDescription> module,
+                     const RigidMapR3& placement, int detector_offset);
+
+    virtual bool FindIntersectionNT (
+        const VectorR3& viewPos, const VectorR3& viewDir, double maxDistance,
+        double *intersectDistance, VisiblePoint& returnedPoint,
+        const HitSurface& skip ) const;
+    void CalcBoundingPlanes( const VectorR3& u, double *minDot, double *maxDot ) const;
+
+    const SceneDescription& GetModule() const
+    {
+        return *module;
+    }
+    const RigidMapR3& GetPlacement() const
+    {
+        return placement;
+    }
+    int GetDetectorOffset() const
+    {
+        return detector_offset;
+    }
+
+private:
+    std::shared_ptr<const SceneDescription> module;
+    RigidMapR3 placement;
+    RigidMapR3 inverse;
+    int detector_offset;
+    // Corners of the module's AABB in world coordinates
+    VectorR3 corners[8];
+};
+
+#endif // VIEWABLEINSTANCE_H
@@ -0,0 +1,89 @@
+/*
+ * Gray: A Ray Tracing-based Monte Carlo Simulator for PET
+ *
+ * Copyright (c) 2018, David Freese, Peter Olcott, Sam Buss, Craig Levin
+ *
+ * This software is distributed under the terms of the MIT License unless
+ * otherwise noted.  See LICENSE for further details.
+ *
+ */
+
+#ifndef VIEWABLEMESH_H
+#define VIEWABLEMESH_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "Gray/Graphics/ViewableBase.h"
+#include "Gray/VrMath/Aabb.h"
+#include "Gray/VrMath/LinearR3.h"
+
+// ViewableMesh is a closed triangle mesh, stored as shared vertices and
+// indices into them, that is added to the scene as a single object.  It
+// carries its own bounding volume hierarchy over its triangles, so the scene's
+// KdTree only needs to know about the mesh as a whole.  Triangles are in
+// counter-clockwise order when seen from outside of the mesh, as with
+// ViewableTriangle and the common mesh file formats.
+//
+// Rays are tested against the triangles with the watertight test of Woop,
+// Benthin and Wald, so a ray through an edge or a vertex shared by triangles
+// always hits at least one of them, and can't slip through the mesh.
+class ViewableMesh : public ViewableBase
+{
+public:
+    typedef std::array<uint32_t, 3> Triangle;
+
+    ViewableMesh(const std::vector<VectorR3>& vertices,
+                 const std::vector<Triangle>& triangles);
+
+    virtual bool FindIntersectionNT (
+        const VectorR3& viewPos, const VectorR3& viewDir, double maxDistance,
+        double *intersectDistance, VisiblePoint& returnedPoint,
+        const HitSurface& skip ) const;
+    void CalcBoundingPlanes( const VectorR3& u, double *minDot, double *maxDot ) const;
+    void CalcAABB( AABB& retAABB ) const;
+    bool CalcExtentsInBox( const AABB& boundingAABB, AABB& retAABB ) const;
+
+    size_t NumVertices() const
+    {
+        return vertices.size();
+    }
+    size_t NumTriangles() const
+    {
+        return triangles.size();
+    }
+    const VectorR3& GetVertex(size_t i) const
+    {
+        return vertices[i];
+    }
+    const Triangle& GetTriangle(size_t i) const
+    {
+        return triangles[i];
+    }
+
+    // The most triangles placed in a leaf of the hierarchy.
+    static constexpr uint32_t max_leaf_size = 4;
+
+private:
+    // A node of the hierarchy covers either count triangles from first in
+    // triangles, as a leaf, or two children, the first of which follows it
+    // in nodes and the second of which is at second_child.
+    struct Node {
+        AABB box;
+        uint32_t first = 0;
+        uint32_t count = 0;
+        uint32_t second_child = 0;
+    };
+    uint32_t Build(uint32_t first, uint32_t count,
+                   std::vector<uint32_t>& order,
+                   const std::vector<VectorR3>& centroids);
+    AABB TriangleBox(const Triangle& tri) const;
+    void ExtentsInBox(uint32_t node, const AABB& boundingAABB,
+                      AABB& retAABB) const;
+
+    std::vector<VectorR3> vertices;
+    std::vector<Triangle> triangles;
+    std::vector<Node> nodes;
+};
+
+#endif // VIEWABLEMESH_H
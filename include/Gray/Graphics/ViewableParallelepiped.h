@@ -47,8 +47,13 @@ public:
     // intersectDistance and visPoint are returned values.
     virtual bool FindIntersectionNT (
         const VectorR3& viewPos, const VectorR3& viewDir, double maxDistance,
-        double *intersectDistance, VisiblePoint& returnedPoint ) const;
+        double *intersectDistance, VisiblePoint& returnedPoint,
+        const HitSurface& skip ) const;
     void CalcBoundingPlanes( const VectorR3& u, double *minDot, double *maxDot ) const;
+    bool IsConvex() const
+    {
+        return true;
+    }
     bool CalcExtentsInBox( const AABB& boundingAABB, AABB& retAABB ) const;
 
     // The next tests are good for bounding parallelepipeds
@@ -116,6 +121,37 @@ public:
     {
         return NormalACD;
     }
+    double GetTopCoefABC() const
+    {
+        return TopCoefABC;
+    }
+    double GetBottomCoefABC() const
+    {
+        return BottomCoefABC;
+    }
+    double GetTopCoefABD() const
+    {
+        return TopCoefABD;
+    }
+    double GetBottomCoefABD() const
+    {
+        return BottomCoefABD;
+    }
+    double GetTopCoefACD() const
+    {
+        return TopCoefACD;
+    }
+    double GetBottomCoefACD() const
+    {
+        return BottomCoefACD;
+    }
+
+    // Fills in the point for a hit at distance alpha along the ray, as
+    // FindIntersection would.  Used by ParallelepipedBatch, which finds the
+    // hits for many parallelepipeds at once.
+    void MakeVisiblePoint(const VectorR3& viewPos, const VectorR3& viewDir,
+                          double alpha, bool frontFace,
+                          VisiblePoint& returnedPoint) const;
 
     enum {
         FrontFaceNum = 0,
@@ -29,8 +29,13 @@ public:
     // intersectDistance and visPoint are returned values.
     virtual bool FindIntersectionNT (
         const VectorR3& viewPos, const VectorR3& viewDir, double maxDistance,
-        double *intersectDistance, VisiblePoint& returnedPoint ) const;
+        double *intersectDistance, VisiblePoint& returnedPoint,
+        const HitSurface& skip ) const;
     void CalcBoundingPlanes( const VectorR3& u, double *minDot, double *maxDot ) const;
+    bool IsConvex() const
+    {
+        return true;
+    }
     bool CalcExtentsInBox( const AABB& boundingAABB, AABB& retAABB ) const;
 
     // QuickIntersectTest returns (a) if hit occurs, and (b) distance.
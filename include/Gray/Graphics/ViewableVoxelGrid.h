@@ -0,0 +1,115 @@
+/*
+ * Gray: A Ray Tracing-based Monte Carlo Simulator for PET
+ *
+ * Copyright (c) 2018, David Freese, Peter Olcott, Sam Buss, Craig Levin
+ *
+ * This software is distributed under the terms of the MIT License unless
+ * otherwise noted.  See LICENSE for further details.
+ *
+ */
+
+#ifndef VIEWABLEVOXELGRID_H
+#define VIEWABLEVOXELGRID_H
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "Gray/Graphics/ViewableBase.h"
+#include "Gray/VrMath/LinearR3.h"
+
+// ViewableVoxelGrid is a box split into voxels, each with a label from a
+// label image, such as a segmented CT, and each label with a material.
+// Voxels with a label that has no material are empty, and rays pass through
+// them as if the grid were not there.  The whole grid is a single object in
+// the scene, however many voxels or materials it holds.
+//
+// Rays walk from voxel to voxel with the algorithm of Amanatides and Woo, and
+// report a hit wherever the material changes.  Passing from one material
+// straight into another is reported as leaving the first, then, starting from
+// that same point, entering the second, so that the material stack used by
+// GammaRayTrace stays the same as for nested objects.  The voxel being
+// entered is carried in HitSurface::element, so that the next search starts
+// in the right voxel without looking it up from the position.
+//
+// A grid can instead be delta tracked, given a material that stands in for
+// all of the materials inside of it, in which case it is traced as a solid
+// box of that material.  Every voxel must then have a material.
+//
+// The grid is centered on the origin of local_to_global, with its voxels
+// stored in [x][y][z] C order as VoxelSource::Load reads them.
+class ViewableVoxelGrid : public ViewableBase
+{
+public:
+    typedef std::array<int, 3> Dims;
+
+    // label_materials holds the material for each label, or nullptr for
+    // labels that are empty.  Labels past the end of it are empty.
+    ViewableVoxelGrid(const Dims& dims, const std::vector<uint8_t>& labels,
+                      const std::vector<const Material*>& label_materials,
+                      const VectorR3& size,
+                      const RigidMapR3& local_to_global);
+
+    virtual bool FindIntersectionNT (
+        const VectorR3& viewPos, const VectorR3& viewDir, double maxDistance,
+        double *intersectDistance, VisiblePoint& returnedPoint,
+        const HitSurface& skip ) const;
+    void CalcBoundingPlanes( const VectorR3& u, double *minDot, double *maxDot ) const;
+    bool IsConvex() const
+    {
+        return (delta_material != nullptr);
+    }
+
+    // Traces the grid as a box of material from here on.
+    void SetDeltaMaterial(std::unique_ptr<Material> material)
+    {
+        delta_material = std::move(material);
+    }
+    const Material* GetDeltaMaterial() const
+    {
+        return delta_material.get();
+    }
+
+    // The material of the voxel containing pos, or nullptr if it is empty or
+    // pos is outside of the grid.
+    const Material* GetMaterialAt(const VectorR3& pos) const;
+
+    // Converts the values of an image read by VoxelSource::Load to labels,
+    // which must be whole numbers from 0 to 255.
+    static bool ValuesToLabels(const std::vector<double>& values,
+                               std::vector<uint8_t>& labels);
+
+    const Dims& GetDims() const
+    {
+        return dims;
+    }
+
+private:
+    const Material* VoxelMaterial(const Dims& voxel) const
+    {
+        return materials[labels[Index(voxel)]];
+    }
+    long Index(const Dims& voxel) const
+    {
+        return (static_cast<long>(voxel[0]) * dims[1] + voxel[1]) * dims[2] +
+               voxel[2];
+    }
+    Dims VoxelAt(const VectorR3& local_pos) const;
+    bool BoxIntersection(const VectorR3& pos, const VectorR3& dir,
+                         double& near, double& far) const;
+    bool Hit(const VectorR3& viewPos, const VectorR3& viewDir, double dist,
+             bool front_face, const Material* material, long element,
+             double *intersectDistance, VisiblePoint& returnedPoint) const;
+
+    Dims dims;
+    std::vector<uint8_t> labels;
+    // Indexed by label, with all 256 labels present.
+    std::vector<const Material*> materials;
+    VectorR3 size;
+    VectorR3 voxel_size;
+    RigidMapR3 local_to_global;
+    RigidMapR3 global_to_local;
+    std::unique_ptr<Material> delta_material;
+};
+
+#endif // VIEWABLEVOXELGRID_H
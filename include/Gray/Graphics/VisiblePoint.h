@@ -15,11 +15,43 @@
 // The class   VisiblePoint   is defined in this file.
 // ****************************************************************************
 
+#include <cassert>
 #include "Gray/VrMath/LinearR2.h"
 #include "Gray/VrMath/LinearR3.h"
 #include "Gray/Graphics/Material.h"
 class ViewableBase;
 
+// HitSurface identifies the surface that a ray hit: the objects from the one
+// in the scene, through any module instances, down to the primitive, and which
+// side of that primitive was hit.  A ray continuing on from the hit passes it
+// back to the intersection tests, which skip that surface, so the ray can
+// start exactly at the hit rather than being nudged off of it.
+struct HitSurface {
+    static constexpr int max_depth = 4;
+    ViewableBase const* objects[max_depth] = {};
+    int depth = 0;
+    bool front_face = true;
+    // The piece of the primitive that the ray is passing into, for primitives
+    // made up of many pieces, such as the voxels of ViewableVoxelGrid.
+    long element = -1;
+
+    // If the surface is on object, or on something placed inside of it.
+    bool IsOn(const ViewableBase* object) const {
+        return ((depth > 0) && (objects[0] == object));
+    }
+    // The surface as seen from inside of the outermost object.
+    HitSurface Inner() const {
+        HitSurface inner;
+        inner.depth = (depth > 0) ? depth - 1 : 0;
+        for (int ii = 0; ii < inner.depth; ++ii) {
+            inner.objects[ii] = objects[ii + 1];
+        }
+        inner.front_face = front_face;
+        inner.element = element;
+        return (inner);
+    }
+};
+
 //  VisiblePoint is a class storing information about a visible point.
 
 class VisiblePoint
@@ -59,12 +91,45 @@ public:
     const ViewableBase& GetObject() const {
         return *TheObject;
     }
+    void SetDetectorId(int id) {
+        DetectorId = id;
+    }
+    int GetDetectorId() const {
+        return DetectorId;
+    }
+    void ClearSurface() {
+        Surface.depth = 0;
+        Surface.element = -1;
+    }
+    void SetSurfaceElement(long element) {
+        Surface.element = element;
+    }
+    // Records that the point was found within object, outside of the objects
+    // recorded so far.
+    void AddOuterObject(const ViewableBase* object) {
+        assert(Surface.depth < HitSurface::max_depth);
+        for (int ii = Surface.depth; ii > 0; --ii) {
+            Surface.objects[ii] = Surface.objects[ii - 1];
+        }
+        Surface.objects[0] = object;
+        Surface.depth++;
+    }
+    HitSurface GetSurface() const {
+        HitSurface surface = Surface;
+        surface.front_face = FrontFace;
+        return (surface);
+    }
 
 private:
     VectorR3 Position;
     Material const* Mat = nullptr;
     // The object from which the visible point came
     ViewableBase const* TheObject = nullptr;
+    // The detector id of the point, which can differ from the object's when
+    // the object is an instance of a module.
+    int DetectorId = -1;
+    // The surface hit, with the objects down to the primitive
+    HitSurface Surface;
     // Is it being viewed from the front side?
     bool FrontFace = true;
 
@@ -9,10 +9,16 @@
 #ifndef Config_h
 #define Config_h
 
+#include <memory>
 #include <vector>
 #include <string>
+#include "Gray/Gray/GammaRayTrace.h"
 #include "Gray/Output/Output.h"
 
+namespace PhaseSpace {
+class Surface;
+}
+
 class Config {
 public:
     Config() = default;
@@ -83,6 +89,27 @@ public:
     bool set_coinc_var_output_write_flags(const std::string & mask);
     void set_coinc_var_output_write_flags(const Output::WriteFlags & mask);
     Output::WriteFlags get_coinc_var_output_write_flags() const;
+    void set_emission_bias(double fraction);
+    double get_emission_bias() const;
+    void set_russian_roulette(double energy, double survival);
+    double get_roulette_energy() const;
+    double get_roulette_survival() const;
+    bool set_decay_filter(const std::string& identifier);
+    GammaRayTrace::DecayFilter get_decay_filter() const;
+    bool set_hit_aggregation(const std::string& identifier);
+    GammaRayTrace::HitAggregation get_hit_aggregation() const;
+    void set_quasi_random(bool val);
+    bool get_quasi_random() const;
+    void set_material_grid(bool val);
+    bool get_material_grid() const;
+    void set_phase_space_out(
+            const std::string& filename,
+            std::shared_ptr<const PhaseSpace::Surface> surface);
+    bool get_log_phase_space() const;
+    std::string get_filename_phase_space() const;
+    std::shared_ptr<const PhaseSpace::Surface> get_phase_space_surface() const;
+    // True if the simulation gives events weights other than one.
+    bool get_weighted() const;
     bool get_verbose() const;
     bool get_run_overlap_test() const;
     bool get_write_pos() const;
@@ -129,6 +156,17 @@ private:
     bool hits_var_output_write_flags_set = false;
     bool singles_var_output_write_flags_set = false;
     bool coinc_var_output_write_flags_set = false;
+    double emission_bias = 0;
+    double roulette_energy = 0;
+    double roulette_survival = 1;
+    GammaRayTrace::DecayFilter decay_filter =
+            GammaRayTrace::DecayFilter::None;
+    GammaRayTrace::HitAggregation hit_aggregation =
+            GammaRayTrace::HitAggregation::None;
+    bool quasi_random = false;
+    bool material_grid = false;
+    std::string filename_phase_space;
+    std::shared_ptr<const PhaseSpace::Surface> phase_space_surface;
     bool verbose = false;
     bool run_overlap_test = false;
     std::string write_pos_filename = "";
@@ -0,0 +1,50 @@
+#ifndef DELTA_MATERIAL_H
+#define DELTA_MATERIAL_H
+
+#include <vector>
+#include "Gray/Gray/GammaMaterial.h"
+
+class ViewableVoxelGrid;
+
+// DeltaMaterial stands in for all of the materials of a voxel phantom that is
+// delta (Woodcock) tracked.  The phantom is then traced as a single box of
+// this material, rather than stopping at every change of material inside of
+// it.  Distances are sampled against a majorant, the largest attenuation of
+// any material in the phantom, and each interaction point is then accepted
+// as a real interaction with the local material with the probability of the
+// local attenuation over the majorant.  Otherwise the photon carries on
+// unchanged.
+//
+// The majorant is tabulated at each of the energies at which the materials'
+// attenuations are tabulated, and at even steps between them, and is
+// interpolated in log-log in between.
+class DeltaMaterial : public GammaMaterial {
+public:
+    DeltaMaterial(const ViewableVoxelGrid& grid,
+                  const std::vector<const GammaMaterial*>& materials);
+    double Distance(double photon_energy,
+                    GammaStats::AttenLengths& len) const override;
+    const GammaMaterial* InteractionMaterial(
+            const Photon& photon, GammaStats::AttenLengths& len) const override;
+    const GammaMaterial& MaterialAt(const VectorR3& pos) const override;
+    double Majorant(double photon_energy) const;
+
+    // Covers the rounding of the interpolation.
+    static constexpr double majorant_margin = 1.01;
+    // The number of pieces each bin of the materials' tables is split into.
+    static constexpr int splits_per_bin = 8;
+
+private:
+    double DirectMajorant(double photon_energy) const;
+
+    const ViewableVoxelGrid& grid;
+    std::vector<const GammaMaterial*> materials;
+    // The log of the majorant at either end of the bin from energies[i] up to
+    // energies[i + 1].
+    std::vector<double> energies;
+    std::vector<double> log_energies;
+    std::vector<double> log_majorant_lo;
+    std::vector<double> log_majorant_hi;
+};
+
+#endif // DELTA_MATERIAL_H
@@ -0,0 +1,150 @@
+/*
+ * Gray: A Ray Tracing-based Monte Carlo Simulator for PET
+ *
+ * Copyright (c) 2018, David Freese, Peter Olcott, Sam Buss, Craig Levin
+ *
+ * This software is distributed under the terms of the MIT License unless
+ * otherwise noted.  See LICENSE for further details.
+ *
+ */
+
+#ifndef DETECTORRESPONSE_H
+#define DETECTORRESPONSE_H
+
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Gray/VrMath/LinearR3.h"
+
+class DetectorArray;
+class GammaMaterial;
+class Material;
+class Photon;
+
+// DetectorResponse replaces tracing photons through box crystals with
+// sampling from histories of photons traced through the crystal's material in
+// a calibration run.
+//
+// Each type of crystal, a material and a size, has a table of histories, in
+// order of energy.  A history is the interactions of one calibration photon,
+// relative to where it started, traced until it was absorbed or further from
+// where it started than the crystal is across.  As the material is the same
+// throughout the crystal, nothing about a history depends on the walls of the
+// crystal until it crosses one.  So a history is turned to the direction the
+// photon entered in, moved to where it entered, and cut short where it leaves
+// the crystal, which gives its response for any entry angle and position.
+// Photons that leave the crystal are handed back to be traced through the
+// rest of the scene, so scatter between crystals is still simulated.
+//
+// The tables are built once, up front, and are then only read, so they can be
+// shared between threads.  Each is written to a file and read back on later
+// runs, as long as the material and crystal still match.
+class DetectorResponse {
+public:
+    // A type of crystal to replace, as given with detector_response.
+    struct CrystalType {
+        std::string filename;
+        const GammaMaterial* material;
+        VectorR3 size;
+    };
+
+    // An interaction, or the photon leaving, in world coordinates.
+    struct Hit {
+        VectorR3 pos;
+        // The direction of the photon after the hit.
+        VectorR3 dir;
+        // The distance the photon has travelled since entering the crystal.
+        double path;
+        // The energy of the photon after the hit.
+        double energy;
+        // An Interaction::Type, or escape.
+        int type;
+    };
+    static constexpr int escape = -100;
+    // Calibration photons that are still going after this many interactions
+    // are absorbed, to bound the length of a history.
+    static constexpr int max_hits = 32;
+    typedef std::array<Hit, max_hits + 1> Hits;
+
+    // Histories are only sampled for photons in this range, in MeV.  Any
+    // others are traced.
+    static constexpr double min_energy = 0.03;
+    static constexpr double max_energy = 1.2;
+    static constexpr int energy_bins = 64;
+    static constexpr int histories_per_bin = 4096;
+    // Photons are given one of the histories this close to them in energy,
+    // as the odds of each interaction change too much across a bin.
+    static constexpr int sample_window = 4096;
+
+    explicit DetectorResponse(const DetectorArray& detectors);
+
+    // Reads the table for type from its file, or builds the table and writes
+    // it to the file if that doesn't exist or is for a different crystal.
+    // built is set if the table was built.  Crystals of the size can have a
+    // table for each material, and adding the same type again replaces its
+    // table.  Returns false if the file can't be written.
+    bool AddCrystalType(const CrystalType& type, bool& built);
+
+    // Samples what happens to photon, which has just entered the crystal
+    // det_id, made of material, filling hits with its interactions in order,
+    // ending with one of type escape if it leaves again.  Returns the number
+    // of hits, or -1 if there is no table for the size and material of the
+    // crystal, or the photon's energy.
+    int Sample(int det_id, const Material* material, const Photon& photon,
+               Hits& hits) const;
+
+    size_t NumTables() const {
+        return (tables.size());
+    }
+    size_t NumCrystals() const;
+
+private:
+    struct FileHeader;
+    struct Step {
+        // Relative to where the photon started, going along z.
+        float pos[3];
+        float dir[3];
+        float path;
+        // The fraction of the energy the photon started with that is left.
+        float energy;
+        int32_t type;
+    };
+
+    struct Table {
+        const GammaMaterial* material = nullptr;
+        VectorR3 size;
+        // The histories of bin b are from history b * histories_per_bin, in
+        // order of energy, and the steps of history h are steps[first_step[h]] through
+        // steps[first_step[h + 1] - 1].
+        std::vector<uint32_t> first_step;
+        std::vector<Step> steps;
+        // The attenuation at the energy each history started with, which
+        // its distances are scaled by for the energy of the photon.
+        std::vector<float> attenuation;
+
+        void Build();
+        bool Read(std::istream& input);
+        bool Write(std::ostream& output) const;
+        void MakeHeader(FileHeader& header) const;
+    };
+
+    // The crystal for a detector id, in world coordinates.
+    struct Crystal {
+        VectorR3 center;
+        VectorR3 axes[3];
+        VectorR3 half_size;
+        // The tables for crystals of this size, one for each material.
+        std::vector<size_t> tables;
+    };
+
+    static double EnergyBinEdge(int bin);
+    static void Calibrate(const GammaMaterial& material, double max_dist,
+                          double energy, std::vector<Step>& steps);
+
+    std::vector<Table> tables;
+    std::vector<Crystal> crystals;
+};
+
+#endif // DETECTORRESPONSE_H
@@ -7,6 +7,7 @@
 #include "Gray/Physics/Interaction.h"
 
 class Photon;
+class VectorR3;
 
 class GammaMaterial : public Material {
 public:
@@ -14,12 +15,44 @@ public:
     GammaMaterial(
         int index, const std::string& name, bool sensitive, bool interactive,
         GammaStats stats);
-    double Distance(double photon_energy) const;
-    Interaction::Type Interact(Photon& photon) const;
+    // Samples the distance to the next interaction, filling len with the
+    // attenuation it was sampled from, so that Interact can reuse it.
+    virtual double Distance(double photon_energy,
+                            GammaStats::AttenLengths& len) const;
+    // Interacts with a photon given the attenuation at its energy.
+    Interaction::Type Interact(Photon& photon,
+                               const GammaStats::AttenLengths& len) const;
     void DisableRayleigh();
+    void CacheEnergy(double photon_energy);
+    // Builds the tables needed to trace photons through the material.
+    void BuildTables();
+    // The total linear attenuation coefficient, or zero if interactions are
+    // disabled.
+    double Attenuation(double photon_energy) const;
+    const GammaStats& GetStats() const {
+        return (properties);
+    }
+    // Photons left with less energy than this after interacting in the
+    // material are absorbed where they are, rather than traced any further.
+    void SetEnergyCutoff(double energy) {
+        energy_cutoff = energy;
+    }
+    double GetEnergyCutoff() const {
+        return (energy_cutoff);
+    }
+
+    // The material that a photon, having reached the distance from Distance,
+    // interacts with, or nullptr if it passes on without interacting.  This
+    // is the material itself, except for regions that are delta tracked,
+    // which also update len for the material returned.
+    virtual const GammaMaterial* InteractionMaterial(
+            const Photon& photon, GammaStats::AttenLengths& len) const;
+    // The material at pos, for a position inside of this material.
+    virtual const GammaMaterial& MaterialAt(const VectorR3& pos) const;
 
 private:
     GammaStats properties;
+    double energy_cutoff = 0;
 };
 
 #endif // GAMMA_MATERIAL_H
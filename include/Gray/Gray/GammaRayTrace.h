@@ -1,13 +1,20 @@
 #ifndef GAMMARAYTRACE_H
 #define GAMMARAYTRACE_H
 
+#include <memory>
 #include <vector>
 #include <ostream>
 #include <stack>
+#include <string>
+#include "Gray/Gray/DetectorResponse.h"
 #include "Gray/Physics/Interaction.h"
 #include "Gray/Physics/Photon.h"
 
 class GammaMaterial;
+namespace PhaseSpace {
+class Writer;
+}
+class MaterialGrid;
 struct GammaRayTraceStats;
 class SceneDescription;
 class Output;
@@ -16,6 +23,28 @@ class VectorR3;
 
 class GammaRayTrace {
 public:
+    // Which decays have their interactions passed on to the DAQ.  Singles
+    // needs at least one deposit in a detector, and Coinc deposits in at
+    // least two different detectors.
+    enum class DecayFilter : int {
+        None,
+        Singles,
+        Coinc
+    };
+    static bool ParseDecayFilter(const std::string& identifier,
+                                 DecayFilter& filter);
+    // How the deposits a photon makes in one detector, one after another,
+    // are combined into one interaction before leaving the tracer.  First
+    // and Max match the merge types of the same name, and Centroid keeps the
+    // first with the energy-weighted position of all of them.
+    enum class HitAggregation : int {
+        None,
+        First,
+        Max,
+        Centroid
+    };
+    static bool ParseHitAggregation(const std::string& identifier,
+                                    HitAggregation& aggregation);
 
     GammaRayTrace(const SceneDescription & scene,
                   const std::vector<VectorR3>& source_positions,
@@ -23,6 +52,31 @@ public:
                   bool log_nuclear_decays_inter,
                   bool log_nonsensitive_inter,
                   bool log_errors_inter);
+    // Everything beyond what is logged is optional, and off by default.
+    struct Options {
+        // Shared between threads.  Used to look up the stack a decay starts
+        // in before falling back to tracing from the source.
+        std::shared_ptr<const MaterialGrid> material_grid;
+        // Photons that scatter below roulette_energy outside of the
+        // detectors are kept with a probability of roulette_survival.
+        double roulette_energy = 0;
+        double roulette_survival = 1;
+        // Photons leaving its surface are written to it, and go no further.
+        // Each thread has its own.
+        PhaseSpace::Writer* phase_space = nullptr;
+        // Shared between threads.  Photons entering a crystal it has a table
+        // for are sampled from that, rather than traced.
+        std::shared_ptr<const DetectorResponse> detector_response;
+        DecayFilter decay_filter = DecayFilter::None;
+        HitAggregation hit_aggregation = HitAggregation::None;
+    };
+    GammaRayTrace(const SceneDescription & scene,
+                  const std::vector<VectorR3>& source_positions,
+                  bool log_nondepositing_inter,
+                  bool log_nuclear_decays_inter,
+                  bool log_nonsensitive_inter,
+                  bool log_errors_inter,
+                  const Options& options);
 
     std::vector<Interaction> TraceDecay(const NuclearDecay& decay,
             GammaRayTraceStats& stats) const;
@@ -42,7 +96,17 @@ private:
     void TracePhoton(Photon photon,
                      std::vector<Interaction> & interactions,
                      std::stack<GammaMaterial const *> MatStack,
-                     GammaRayTraceStats& stats) const;
+                     GammaRayTraceStats& stats,
+                     double decay_time) const;
+    bool PassesFilter(const std::vector<Interaction>& interactions) const;
+    void AggregateHits(std::vector<Interaction>& interactions, size_t first,
+                       GammaRayTraceStats& stats) const;
+    void Aggregate(Interaction& into, Interaction& from) const;
+    bool SampleResponse(Photon& photon,
+                        std::vector<Interaction>& interactions,
+                        GammaRayTraceStats& stats,
+                        const GammaMaterial& material,
+                        const DetectorResponse::Hits& hits, int no_hits) const;
     std::stack<GammaMaterial const *> DecayStack(
             size_t src_id, const VectorR3 & pos) const;
     const GammaMaterial& SourceMaterial(size_t idx) const;
@@ -51,11 +115,22 @@ private:
     const SceneDescription & scene;
     const std::vector<VectorR3> source_positions;
     const std::vector<std::stack<GammaMaterial const *>> source_mats;
+    // Each of the optional parts is described in Options.
+    const std::shared_ptr<const MaterialGrid> material_grid;
     const bool log_nondepositing_inter;
     const bool log_nuclear_decays;
     const bool log_nonsensitive;
     const bool log_errors;
     const int max_trace_depth;
+    // Delta tracking can sample many virtual collisions in a dense phantom,
+    // so they have a limit of their own.
+    const int max_virtual_collisions;
+    const double roulette_energy;
+    const double roulette_survival;
+    PhaseSpace::Writer* const phase_space;
+    const std::shared_ptr<const DetectorResponse> detector_response;
+    const DecayFilter decay_filter;
+    const HitAggregation hit_aggregation;
 };
 
 #endif /*GAMMARAYTRACE_H*/
@@ -13,6 +13,14 @@ struct GammaRayTraceStats {
     long xray_escape_sensitive = 0;
     long compton_sensitive = 0;
     long rayleigh_sensitive = 0;
+    long energy_cutoff = 0;
+    long roulette_killed = 0;
+    long phase_space = 0;
+    long phase_space_outside = 0;
+    long detector_response = 0;
+    long decays_filtered = 0;
+    long interactions_filtered = 0;
+    long hits_aggregated = 0;
     long error = 0;
 
     GammaRayTraceStats& operator+=(const GammaRayTraceStats& rhs) {
@@ -27,6 +35,14 @@ struct GammaRayTraceStats {
         xray_escape_sensitive += rhs.xray_escape_sensitive;
         compton_sensitive += rhs.compton_sensitive;
         rayleigh_sensitive += rhs.rayleigh_sensitive;
+        energy_cutoff += rhs.energy_cutoff;
+        roulette_killed += rhs.roulette_killed;
+        phase_space += rhs.phase_space;
+        phase_space_outside += rhs.phase_space_outside;
+        detector_response += rhs.detector_response;
+        decays_filtered += rhs.decays_filtered;
+        interactions_filtered += rhs.interactions_filtered;
+        hits_aggregated += rhs.hits_aggregated;
         error += rhs.error;
         return (*this);
     }
@@ -51,6 +67,14 @@ struct GammaRayTraceStats {
            << "xray_escape_sensitive: " << s.xray_escape_sensitive << "\n"
            << "compton_sensitive: " << s.compton_sensitive << "\n"
            << "rayleigh_sensitive: " << s.rayleigh_sensitive << "\n"
+           << "energy_cutoff: " << s.energy_cutoff << "\n"
+           << "roulette_killed: " << s.roulette_killed << "\n"
+           << "phase_space: " << s.phase_space << "\n"
+           << "phase_space_outside: " << s.phase_space_outside << "\n"
+           << "detector_response: " << s.detector_response << "\n"
+           << "decays_filtered: " << s.decays_filtered << "\n"
+           << "interactions_filtered: " << s.interactions_filtered << "\n"
+           << "hits_aggregated: " << s.hits_aggregated << "\n"
            << "error: " << s.error << "\n";
         return os;
     }
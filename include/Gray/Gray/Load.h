@@ -9,16 +9,20 @@
  */
 #ifndef LOAD_H
 #define LOAD_H
+#include <map>
 #include <memory>
+#include <set>
 #include <stack>
+#include <string>
 #include <vector>
 #include "Gray/Graphics/SceneDescription.h"
 #include "Gray/Graphics/ViewableTriangle.h"
+#include "Gray/Gray/DetectorResponse.h"
 #include "Gray/Gray/Syntax.h"
+#include "Gray/Output/DetectorArray.h"
 #include "Gray/VrMath/LinearR3.h"
 
 class Config;
-class DetectorArray;
 class SourceList;
 class GammaMaterial;
 
@@ -56,8 +60,42 @@ public:
     static std::vector<ViewableTriangle> MakeAnnulusCylinder(
             double radius_inner, double radius_outer, double width);
     static void DisableRayleigh(SceneDescription& scene);
+    static void CacheEnergies(SceneDescription& scene,
+                              const std::vector<double>& energies);
+    // The materials that the scene's geometry was given, and the default
+    // material, which are the only ones a photon can pass through.
+    std::vector<GammaMaterial*> UsedMaterials() const;
+    // The crystals given with detector_response, which need the physics of
+    // their materials to be built before their tables can be.
+    const std::vector<DetectorResponse::CrystalType>& CrystalTypes() const {
+        return (crystal_types);
+    }
+    // Builds the physics tables of each material, split across threads.
+    static void BuildMaterials(const std::vector<GammaMaterial*>& materials,
+                               int no_threads);
 
 private:
+    // A module is a piece of geometry, and the detectors within it, that is
+    // defined once between start_module and end_module and then placed any
+    // number of times with the module command.  Each placement shares the
+    // module's scene and KdTree.
+    struct Module {
+        std::shared_ptr<SceneDescription> scene;
+        std::shared_ptr<DetectorArray> detectors;
+        int no_blocks = 0;
+        std::string name;
+        // State of the enclosing scene restored with end_module
+        size_t matrix_depth = 0;
+        int outer_block_id = 0;
+        int outer_polygon_det_id = -1;
+    };
+    bool StartModule(Command& cmd);
+    bool EndModule(Command& cmd);
+    bool PlaceModule(Command& cmd, SceneDescription& scene,
+                     DetectorArray& det_array);
+    std::map<std::string, Module> modules;
+    std::vector<Module> module_stack;
+
     VectorR3 up = {0, 1, 0};
     VectorR3 from;
     VectorR3 at = {0, 0, 0};
@@ -75,7 +113,10 @@ private:
     double vector_source_activity = -1;
     std::unique_ptr<SceneDescription> vector_source_scene;
     double activity_scale = 1.0;
+    bool delta_tracking = false;
     GammaMaterial* cur_material = nullptr;
+    std::set<GammaMaterial*> used_materials;
+    std::vector<DetectorResponse::CrystalType> crystal_types;
 };
 
 #endif // LOAD_H
@@ -10,11 +10,14 @@ class SceneDescription;
 namespace LoadMaterials
 {
 std::vector<double> VectorizeArray(const Json::Value & array);
+bool CheckMaterialJson(const std::string & mat_name,
+                       const Json::Value & mat_info);
 bool LoadMaterialJson(SceneDescription& scene,
                       const std::string & mat_name,
                       const Json::Value & mat_info);
 bool LoadPhysicsJson(SceneDescription& scene,
                      const std::string & materials_filename);
+void AddDefaultMaterial(SceneDescription& scene);
 };
 
 #endif
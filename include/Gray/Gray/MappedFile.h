@@ -0,0 +1,37 @@
+/*
+ * Gray: A Ray Tracing-based Monte Carlo Simulator for PET
+ *
+ * Copyright (c) 2018, David Freese, Peter Olcott, Sam Buss, Craig Levin
+ *
+ * This software is distributed under the terms of the MIT License unless
+ * otherwise noted.  See LICENSE for further details.
+ *
+ */
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// MappedFile maps a whole file into memory read-only, so it can be read in
+// place.  Where mmap isn't available, the file is read into a buffer
+// instead.  data is nullptr if the file couldn't be opened or is empty.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& filename);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data = nullptr;
+    size_t size = 0;
+
+private:
+#ifdef _WIN32
+    std::vector<char> buffer;
+#endif
+};
+
+#endif // MAPPED_FILE_H
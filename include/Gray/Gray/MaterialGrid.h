@@ -0,0 +1,78 @@
+#ifndef MATERIALGRID_H
+#define MATERIALGRID_H
+
+#include <stack>
+#include <vector>
+#include "Gray/VrMath/Aabb.h"
+#include "Gray/VrMath/LinearR3.h"
+
+class GammaMaterial;
+class SceneDescription;
+class SourceList;
+
+// MaterialGrid holds the material stack, as built by GammaRayTrace, for every
+// cell of a grid laid over the sources, so the materials a decay starts in
+// can be looked up rather than ray traced from the center of its source.
+//
+// A cell only holds a stack if no surface passes through it.  Cells that do
+// have a surface in them are split into finer cells, and any of those that
+// still have a surface in them are left for the caller to ray trace.  The
+// whole grid is built once, up front, and is then only read, so it can be
+// shared between threads.
+class MaterialGrid {
+public:
+    typedef std::stack<GammaMaterial const *> Stack;
+
+    MaterialGrid(const SceneDescription& scene, const AABB& region,
+                 int no_threads = 1);
+
+    // Returns the stack for pos, or nullptr if pos is outside of the grid, or
+    // in a cell with a surface passing through it.
+    const Stack* Lookup(const VectorR3& pos) const;
+
+    // A box around every position the sources can decay at, padded to allow
+    // for the positron range.
+    static AABB SourceRegion(const SourceList& sources);
+
+    size_t NumCells() const
+    {
+        return (cells.size());
+    }
+    size_t NumRefinedCells() const
+    {
+        return (fine_cells.size() / fine_per_cell);
+    }
+    size_t NumUnresolvedCells() const;
+    size_t NumStacks() const
+    {
+        return (stacks.size());
+    }
+
+    // The most cells along the longest side of the region.
+    static constexpr int max_cells_per_axis = 32;
+    // Cells with a surface are split this many times along each axis.
+    static constexpr int refine = 4;
+    static constexpr int fine_per_cell = refine * refine * refine;
+    // How far the region reaches past the edge of the sources in cm.
+    static constexpr double region_padding = 0.3;
+
+private:
+    // The value of a cell that the caller needs to ray trace.  Cells that
+    // were refined hold refined_base - (the index of their block of fine
+    // cells).  All others hold an index into stacks.
+    static constexpr int unresolved = -1;
+    static constexpr int refined_base = -2;
+
+    struct SlabResult;
+    void BuildSlab(const SceneDescription& scene, int iz,
+                   SlabResult& result) const;
+
+    VectorR3 grid_min;
+    double cell_size;
+    int nx, ny, nz;
+    std::vector<int> cells;
+    std::vector<int> fine_cells;
+    std::vector<Stack> stacks;
+};
+
+#endif // MATERIALGRID_H
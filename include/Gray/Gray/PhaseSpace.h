@@ -0,0 +1,128 @@
+/*
+ * Gray: A Ray Tracing-based Monte Carlo Simulator for PET
+ *
+ * Copyright (c) 2018, David Freese, Peter Olcott, Sam Buss, Craig Levin
+ *
+ * This software is distributed under the terms of the MIT License unless
+ * otherwise noted.  See LICENSE for further details.
+ *
+ */
+
+#ifndef PHASE_SPACE_H
+#define PHASE_SPACE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Gray/VrMath/Aabb.h"
+#include "Gray/VrMath/LinearR3.h"
+
+class Photon;
+
+// A phase space file holds every photon that crossed out of a closed surface
+// around the phantom, as it was at the surface, so that the photons can be
+// traced again through other detectors without simulating the phantom.
+//
+// The file is a Header, followed by one Record per photon, written natively
+// like the compiled physics file.  Records are in order of the time of the
+// decay they came from, and the photons of a decay are next to each other,
+// which is what lets a decay be found by its time.
+namespace PhaseSpace
+{
+constexpr char magic[8] = {'G', 'R', 'A', 'Y', 'P', 'S', 'P', 'C'};
+constexpr uint32_t version = 1;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t record_size;
+    uint32_t reserved;
+    // The extents of the surface
+    double min[3];
+    double max[3];
+};
+
+struct Record {
+    double decay_time;
+    float pos[3];
+    float dir[3];
+    float energy;
+    // Since the decay
+    float time;
+    float weight;
+    float roulette_weight;
+    int32_t decay_id;
+    int32_t src_id;
+    uint8_t color;
+    uint8_t scatter_compton_phantom;
+    uint8_t scatter_compton_detector;
+    uint8_t scatter_rayleigh_phantom;
+    uint8_t scatter_rayleigh_detector;
+    uint8_t xray_flouresence;
+    uint8_t reserved[2];
+};
+
+Record MakeRecord(const Photon& photon, double decay_time);
+Photon MakePhoton(const Record& record, int decay_id);
+
+// Checks the header of a file, and fills extents from it.
+bool ReadHeader(const char* data, size_t size, AABB& extents);
+
+// The closed surface that photons are recorded at, either a box, or a
+// cylinder along an arbitrary axis.
+class Surface {
+public:
+    static std::shared_ptr<Surface> Box(const VectorR3& center,
+                                        const VectorR3& size);
+    static std::shared_ptr<Surface> Cylinder(const VectorR3& center,
+                                             const VectorR3& axis,
+                                             double radius, double height);
+    bool Inside(const VectorR3& pos) const;
+    // The distance along dir at which a photon inside of the surface leaves
+    // it, or a negative value if it's outside.
+    double ExitDistance(const VectorR3& pos, const VectorR3& dir) const;
+    AABB GetExtents() const;
+
+private:
+    enum class Shape {
+        BOX,
+        CYLINDER
+    };
+    Shape shape = Shape::BOX;
+    VectorR3 center;
+    // The half size of the box, or the radius and half height of the
+    // cylinder in x and z.
+    VectorR3 half_size;
+    VectorR3 axis = {0, 0, 1};
+};
+
+// Writer records the photons of one thread.  Records are buffered, and
+// written out as the buffer fills, and on Close.
+class Writer {
+public:
+    explicit Writer(std::shared_ptr<const Surface> surface);
+    bool Open(const std::string& filename, bool write_header);
+    void Write(const Photon& photon, double decay_time);
+    void Close();
+    const Surface& GetSurface() const {
+        return (*surface);
+    }
+    const std::string& GetFilename() const {
+        return (filename);
+    }
+
+private:
+    void Flush();
+
+    std::shared_ptr<const Surface> surface;
+    std::string filename;
+    std::ofstream output;
+    std::vector<Record> buffer;
+};
+}
+
+#endif // PHASE_SPACE_H
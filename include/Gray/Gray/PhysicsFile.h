@@ -0,0 +1,52 @@
+/*
+ * Gray: A Ray Tracing-based Monte Carlo Simulator for PET
+ *
+ * Copyright (c) 2018, David Freese, Peter Olcott, Sam Buss, Craig Levin
+ *
+ * This software is distributed under the terms of the MIT License unless
+ * otherwise noted.  See LICENSE for further details.
+ *
+ */
+
+#ifndef PHYSICS_FILE_H
+#define PHYSICS_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+class SceneDescription;
+class SourceList;
+
+// PhysicsFile handles the compiled form of GrayPhysics.json, which holds the
+// same materials and isotopes in a binary file that is read with a single
+// read and copied out of directly, rather than parsed.  Every value is stored
+// natively, and 8 byte aligned, after a header with the format version, so a
+// file is only valid for the version and byte order that wrote it.  A file
+// that doesn't match is ignored in favor of the json.
+namespace PhysicsFile
+{
+constexpr char magic[8] = {'G', 'R', 'A', 'Y', 'P', 'H', 'Y', 'S'};
+constexpr uint32_t version = 1;
+
+// Compiles a json physics file to the binary format.
+bool Compile(std::istream& json_input, std::ostream& output);
+bool Compile(const std::string& json_filename,
+             const std::string& output_filename);
+// The name of the compiled file that is used in place of a json file.
+std::string CompiledFilename(const std::string& json_filename);
+// Checks the header of a compiled file.
+bool IsCompiled(const char* data, size_t size);
+
+// Loads the materials and isotopes from filename, which can either be json
+// or compiled.  For a json file, the compiled file next to it is used
+// instead, if there is one that is valid and newer than the json file.
+bool Load(const std::string& filename, SceneDescription& scene,
+          SourceList& sources);
+// data must be 8 byte aligned.
+bool LoadCompiled(const char* data, size_t size, SceneDescription& scene,
+                  SourceList& sources);
+};
+
+#endif // PHYSICS_FILE_H
@@ -1,13 +1,17 @@
 #ifndef SIMULATION_H_
 #define SIMULATION_H_
 
+#include <memory>
 #include <vector>
 #include "Gray/Daq/DaqModel.h"
+#include "Gray/Gray/PhaseSpace.h"
 #include "Gray/Gray/SimulationStats.h"
 #include "Gray/Output/Output.h"
 #include "Gray/Sources/SourceList.h"
 
 class Config;
+class DetectorResponse;
+class MaterialGrid;
 class SceneDescription;
 
 class Simulation {
@@ -17,7 +21,10 @@ public:
             const SceneDescription& scene,
             const SourceList& sources,
             const DaqModel& daq_model,
-            size_t thread_idx, size_t no_threads);
+            size_t thread_idx, size_t no_threads,
+            std::shared_ptr<const MaterialGrid> material_grid = nullptr,
+            std::shared_ptr<const DetectorResponse> detector_response =
+                    nullptr);
     Simulation(Simulation&&) = default;
     SimulationStats Run();
     static void CombineOutputs(
@@ -27,13 +34,19 @@ public:
     Output output_hits;
     Output output_singles;
     std::vector<Output> outputs_coinc;
+    std::unique_ptr<PhaseSpace::Writer> output_phase_space;
 
 private:
     SourceList sources;
     DaqModel daq_model;
     size_t thread_idx;
+    // The seed for this thread, from which Run scrambles its quasi-random
+    // sequences, as only the thread running it can.
+    unsigned long seed;
     const SceneDescription& scene;
     const Config& config;
+    std::shared_ptr<const MaterialGrid> material_grid;
+    std::shared_ptr<const DetectorResponse> detector_response;
 
 };
 
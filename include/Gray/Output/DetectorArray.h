@@ -26,6 +26,12 @@ public:
     // returns detector_id
     int AddDetector(const VectorR3 & pos, const VectorR3 &size,
                     const RigidMapR3 & map, int x, int y, int z, int bl);
+    // Adds a copy of every detector in local placed with map, and returns the
+    // detector_id of the first copy.
+    int AddDetectors(const DetectorArray & local, const RigidMapR3 & map,
+                     int block_offset);
+    size_t NumDetectors() const;
+    const Detector& GetDetector(size_t idx) const;
     bool WritePositions(std::ostream& os) const;
     bool WritePositions(const std::string& filename) const;
     Mapping::IdMappingT Mapping() const;
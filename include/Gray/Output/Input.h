@@ -34,9 +34,9 @@ private:
     static bool read_header_binary(std::istream & input, int & version);
     static bool read_header_ascii(std::istream & input, int & version);
     static bool read_write_flags_binary(Output::WriteFlags & flags,
-                                        std::istream & input);
+                                        std::istream & input, int version);
     static bool read_write_flags_ascii(Output::WriteFlags & flags,
-                                       std::istream & input);
+                                       std::istream & input, int version);
     static bool read_variables_binary(std::vector<Interaction> & interactions,
                                       size_t no_interactions,
                                       std::istream & input,
@@ -69,6 +69,9 @@ public:
         bool scatter_rayleigh_detector = true;
         bool xray_flouresence = true;
         bool coinc_id = true;
+        // Only written by default when events are weighted.  Includes the
+        // part of the weight from Russian roulette.
+        bool weight = false;
     };
 
     struct WriteOffsets {
@@ -87,6 +90,7 @@ public:
         int scatter_rayleigh_detector = -1;
         int xray_flouresence = -1;
         int coinc_id = -1;
+        int weight = -1;
     };
 
     static void write_flags_stats(const WriteFlags & flags, int & no_fields,
@@ -12,9 +12,11 @@
 #define COMPTON_H
 
 #include <vector>
+#include "Gray/Physics/ScatterTable.h"
 
 class Compton {
 public:
+    Compton() = default;
     Compton(const std::vector<double>& x,
             const std::vector<double>& scattering_func);
     static double x_val(double cos_theta, double energy_mev);
@@ -36,11 +38,18 @@ public:
             const std::vector<double>& costhetas,
             const std::vector<double>& x,
             const std::vector<double>& scattering_func);
-    double scatter_angle(double energy, double rand_uniform) const;
+    double scatter_angle(double energy, double rand_uniform) const {
+        return (scatter_table.Sample(energy, rand_uniform));
+    }
+    void scatter_angles(const double* energies, const double* rand_uniforms,
+                        double* costhetas, size_t count) const
+    {
+        scatter_table.Sample(energies, rand_uniforms, costhetas, count);
+    }
 private:
     std::vector<double> energy_idx;
     std::vector<double> costheta_idx;
-    std::vector<std::vector<double>> scatter_cdfs;
+    ScatterTable scatter_table;
 };
 
 #endif // COMPTON_H
@@ -0,0 +1,54 @@
+/*
+ * Gray: A Ray Tracing-based Monte Carlo Simulator for PET
+ *
+ * Copyright (c) 2018, David Freese, Peter Olcott, Sam Buss, Craig Levin
+ *
+ * This software is distributed under the terms of the MIT License unless
+ * otherwise noted.  See LICENSE for further details.
+ *
+ */
+
+#ifndef EMISSION_BIAS_H
+#define EMISSION_BIAS_H
+
+#include <vector>
+#include "Gray/VrMath/Aabb.h"
+#include "Gray/VrMath/LinearR3.h"
+
+// EmissionBias samples the direction of an annihilation pair toward the
+// sensitive geometry of the scanner, rather than uniformly over the sphere,
+// and gives the decay a weight that makes up for it.
+//
+// The scanner is taken to be along z, through the center of the sensitive
+// geometry, with nothing sensitive closer to the axis than inner_radius.
+// From a point inside of that radius, a photon that goes further along z than
+// the sensitive geometry by the time it gets out to inner_radius can't hit it
+// without scattering.  That leaves a band of directions, |cos| to the axis of
+// no more than MaxCosine, with at least one photon of the pair that could.
+//
+// A fraction of decays are emitted uniformly within the band, and the rest
+// over the whole sphere, so that photons that only reach the detector after
+// scattering are still simulated, and the weight is the ratio of the
+// uniform density to the mixture at the direction chosen.  With a fraction of
+// one, directions outside of the band are never sampled.
+class EmissionBias {
+public:
+    EmissionBias(const std::vector<AABB>& sensitive, double fraction);
+    // Returns the direction of the first photon of a pair annihilating at
+    // pos, and the weight of the decay.
+    VectorR3 Direction(const VectorR3& pos, double& weight) const;
+    double MaxCosine(const VectorR3& pos) const;
+    double GetInnerRadius() const {
+        return (inner_radius);
+    }
+
+private:
+    double fraction;
+    double axis_x = 0;
+    double axis_y = 0;
+    double z_min = 0;
+    double z_max = 0;
+    double inner_radius = 0;
+};
+
+#endif // EMISSION_BIAS_H
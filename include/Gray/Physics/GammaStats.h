@@ -19,6 +19,11 @@
 #include "Gray/Physics/Physics.h"
 #include "Gray/Physics/Rayleigh.h"
 
+// GammaStats holds the attenuation and scattering of a material.  The tables
+// used to look them up quickly are only built by BuildTables, so that only
+// the materials a scene uses pay for them.  Until then, the attenuation is
+// interpolated from the material's tables, and scattering a photon throws, so
+// anything that traces photons has to build the materials it uses first.
 class GammaStats
 {
 public:
@@ -30,6 +35,11 @@ public:
                std::vector<double> form_factor,
                std::vector<double> scattering_func);
     void DisableRayleigh();
+    // Builds the attenuation and scatter angle tables, if they haven't been.
+    void BuildTables();
+    bool TablesBuilt() const {
+        return (tables_built);
+    }
     void ComptonScatter(Photon& p) const;
     void RayleighScatter(Photon& p) const;
     struct AttenLengths {
@@ -41,9 +51,34 @@ public:
             return (photoelectric + compton + rayleigh);
         }
     };
-    AttenLengths GetAttenLengths(double energy) const;
+    // Looks the attenuation up in a table resampled evenly in log energy,
+    // unless the energy is one that has been cached with CacheEnergy.
+    AttenLengths GetAttenLengths(double energy) const {
+        for (const AttenLengths& cached: cached_lengths) {
+            if (cached.energy == energy) {
+                return (cached);
+            }
+        }
+        return (TableAttenLengths(energy));
+    }
+    // Interpolates the attenuation from the tables given for the material.
+    AttenLengths GetAttenLengthsExact(double energy) const;
+    // Keeps the exact attenuation at an energy that photons are emitted
+    // with, such as 511keV, which is cached by default.
+    void CacheEnergy(double energy);
+    // The energies at which the attenuation is tabulated.
+    const std::vector<double>& GetEnergies() const {
+        return (energy);
+    }
+
+    // The number of entries per decade of energy in the resampled table.
+    static constexpr int table_points_per_decade = 256;
 
 private:
+    AttenLengths TableAttenLengths(double energy) const;
+    void BuildTable();
+    void UpdateCache();
+
     std::string filename;
     std::vector<double> energy;
     std::vector<double> photoelectric;
@@ -57,6 +92,17 @@ private:
     const std::vector<double> form_factor;
     const std::vector<double> scattering_func;
 
+    // The photoelectric, compton, and rayleigh attenuation at each entry,
+    // stepping evenly in log energy from table_log_min.
+    std::vector<float> table;
+    double table_log_min = 0;
+    double table_inv_log_step = 0;
+    double table_min_energy = 0;
+    double table_max_energy = 0;
+    size_t table_size = 0;
+    std::vector<AttenLengths> cached_lengths;
+    bool tables_built = false;
+
     Compton compton_scatter;
     Rayleigh rayleigh_scatter;
 
@@ -51,6 +51,8 @@ public:
     int scatter_rayleigh_detector = 0;
     int xray_flouresence = 0;
     int coinc_id = -1;
+    double weight = 1;
+    double roulette_weight = 1;
     bool dropped = false;
 
     struct MergedEventsInfo {
@@ -13,9 +13,12 @@
 
 #include <limits>
 #include <memory>
+#include <vector>
 #include "Gray/VrMath/LinearR3.h"
 #include "Gray/Physics/NuclearDecay.h"
 
+class EmissionBias;
+
 class Isotope
 {
 public:
@@ -30,6 +33,11 @@ public:
     double FractionRemaining(double time) const;
     double FractionIntegral(double start, double time) const;
     virtual double ExpectedNoPhotons() const = 0;
+    // The energies of the photons that a decay can emit.
+    virtual std::vector<double> EmittedEnergies() const = 0;
+    // Samples the direction of emission with bias rather than uniformly.
+    // Isotopes that emit in a given direction, such as beams, ignore it.
+    virtual void SetEmissionBias(std::shared_ptr<const EmissionBias>) {}
 
 private:
     double half_life = std::numeric_limits<double>::infinity();
@@ -12,6 +12,7 @@
 #define KLEIN_NISHINA_H
 
 #include <vector>
+#include "Gray/Physics/ScatterTable.h"
 
 class KleinNishina {
 public:
@@ -23,11 +24,13 @@ public:
     static std::vector<std::vector<double>> create_scatter_cdfs(
             const std::vector<double>& energies,
             const std::vector<double>& costhetas);
-    double scatter_angle(double energy, double rand_uniform) const;
+    double scatter_angle(double energy, double rand_uniform) const {
+        return (scatter_table.Sample(energy, rand_uniform));
+    }
 private:
     std::vector<double> energy_idx;
     std::vector<double> costheta_idx;
-    std::vector<std::vector<double>> scatter_cdfs;
+    ScatterTable scatter_table;
 };
 
 #endif // KLEIN_NISHINA_H
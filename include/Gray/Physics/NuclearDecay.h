@@ -28,6 +28,10 @@ public:
     int GetSourceId() const;
     VectorR3 GetPosition() const;
     double GetTime() const;
+    double GetWeight() const;
+    // Every photon of the decay has the weight of the decay, including those
+    // added after it is set, times any weight of its own from roulette.
+    void SetWeight(double weight);
     void AddPhoton(Photon && p);
     std::vector<Photon>::const_reverse_iterator begin() const;
     std::vector<Photon>::const_reverse_iterator end() const;
@@ -38,6 +42,7 @@ private:
     int src_id = 0;
     VectorR3 position = {0, 0, 0};
     double time = 0;
+    double weight = 1.0;
     std::vector<Photon> photons;
 };
 
@@ -29,9 +29,16 @@ public:
     void SetScatterCompton();
     void SetScatterRayleigh();
     void SetXrayFlouresence();
+    // Restores the scatter counts of a photon that was recorded.
+    void SetScatters(int compton_phantom, int compton_detector,
+                     int rayleigh_phantom, int rayleigh_detector,
+                     int xray_flouresence);
     const VectorR3 & GetPos() const {
         return (pos);
     }
+    void SetPos(const VectorR3 & pos) {
+        this->pos = pos;
+    }
     void AddPos(const VectorR3 & rhs) {
         pos += rhs;
     }
@@ -83,6 +90,26 @@ public:
     int GetSrc() const {
         return src_id;
     }
+    // The statistical weight of the photon, which is one unless its
+    // emission was biased.
+    double GetWeight() const {
+        return (weight);
+    }
+    void SetWeight(double weight) {
+        this->weight = weight;
+    }
+    // The part of the weight the photon picked up surviving Russian
+    // roulette, which, unlike the weight of the decay, isn't shared with the
+    // other photons of the decay.
+    double GetRouletteWeight() const {
+        return (roulette_weight);
+    }
+    void SetRouletteWeight(double weight) {
+        roulette_weight = weight;
+    }
+    // Keeps the photon with probability survival, scaling its weight to
+    // make up for the ones that are not.  Returns false if it was killed.
+    bool Roulette(double survival);
 private:
     VectorR3 pos;
     VectorR3 dir;
@@ -97,6 +124,8 @@ private:
     int scatter_rayleigh_detector;
     int xray_flouresence;
     int src_id;
+    double weight;
+    double roulette_weight;
 };
 
 #endif
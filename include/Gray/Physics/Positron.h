@@ -11,6 +11,8 @@
 #ifndef GAMMAPOSITRON_H
 #define GAMMAPOSITRON_H
 
+#include <memory>
+#include "Gray/Physics/EmissionBias.h"
 #include "Gray/Physics/Isotope.h"
 
 class Positron: public Isotope
@@ -31,8 +33,10 @@ public:
                        const VectorR3 & position) const override;
     bool operator==(const Positron&) const;
     double ExpectedNoPhotons() const override;
+    std::vector<double> EmittedEnergies() const override;
     void SetPositronRange(double c, double k1, double k2, double max);
     void SetPositronRange(double fwhm_mm, double max_mm);
+    void SetEmissionBias(std::shared_ptr<const EmissionBias> bias) override;
 
 private:
     Model model = Model::None;
@@ -46,6 +50,7 @@ private:
     double gamma_decay_energy = 0;
     double positron_emission_prob = 1.0;
     bool emit_gamma = false;
+    std::shared_ptr<const EmissionBias> emission_bias;
     constexpr static double mm_to_cm = 0.1;
 };
 
@@ -12,9 +12,11 @@
 #define RAYLEIGH_H
 
 #include <vector>
+#include "Gray/Physics/ScatterTable.h"
 
 class Rayleigh {
 public:
+    Rayleigh() = default;
     Rayleigh(const std::vector<double>& x,
             const std::vector<double>& form_factor);
     static std::vector<double> formfactor(
@@ -32,11 +34,18 @@ public:
             const std::vector<double>& costhetas,
             const std::vector<double>& x,
             const std::vector<double>& form_factor);
-    double scatter_angle(double energy, double rand_uniform) const;
+    double scatter_angle(double energy, double rand_uniform) const {
+        return (scatter_table.Sample(energy, rand_uniform));
+    }
+    void scatter_angles(const double* energies, const double* rand_uniforms,
+                        double* costhetas, size_t count) const
+    {
+        scatter_table.Sample(energies, rand_uniforms, costhetas, count);
+    }
 private:
     std::vector<double> energy_idx;
     std::vector<double> costheta_idx;
-    std::vector<std::vector<double>> scatter_cdfs;
+    ScatterTable scatter_table;
 };
 
 #endif // RAYLEIGH_H
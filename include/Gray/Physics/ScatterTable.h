@@ -0,0 +1,50 @@
+/*
+ * Gray: A Ray Tracing-based Monte Carlo Simulator for PET
+ *
+ * Copyright (c) 2018, David Freese, Peter Olcott, Sam Buss, Craig Levin
+ *
+ * This software is distributed under the terms of the MIT License unless
+ * otherwise noted.  See LICENSE for further details.
+ *
+ */
+
+#ifndef SCATTER_TABLE_H
+#define SCATTER_TABLE_H
+
+#include <cstddef>
+#include <vector>
+
+// ScatterTable samples a scatter angle from a set of CDFs over cos(theta),
+// one at each of a set of energies, by inverting each CDF ahead of time at
+// evenly spaced probabilities.  A sample is then an index and an
+// interpolation in both energy and probability, rather than a search through
+// two CDFs.  Between energies the angle is interpolated at the same
+// probability, as Math::interpolate_y_2d does with the CDFs themselves.
+class ScatterTable {
+public:
+    ScatterTable() = default;
+    ScatterTable(const std::vector<double>& energies,
+                 const std::vector<double>& costhetas,
+                 const std::vector<std::vector<double>>& cdfs);
+    double Sample(double energy, double rand_uniform) const;
+    // Samples count angles at once, as a loop that can be vectorized.
+    void Sample(const double* energies, const double* rand_uniforms,
+                double* costhetas, size_t count) const;
+
+    // The number of probabilities at which each CDF is inverted.
+    static constexpr int no_probabilities = 512;
+
+private:
+    // Finds the energy below energy, and how far it is to the next.
+    void EnergyBin(double energy, size_t& idx, float& alpha) const;
+
+    std::vector<double> energies;
+    // For a range of energies evenly spaced by energy_step, the index of
+    // the highest energy at or below the start of the range.
+    std::vector<size_t> energy_lookup;
+    double inv_energy_step = 0;
+    // The cos(theta) at each probability, for each energy in turn.
+    std::vector<float> inverse_cdfs;
+};
+
+#endif // SCATTER_TABLE_H
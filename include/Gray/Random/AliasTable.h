@@ -0,0 +1,54 @@
+/*
+ * Gray: A Ray Tracing-based Monte Carlo Simulator for PET
+ *
+ * Copyright (c) 2018, David Freese, Peter Olcott, Sam Buss, Craig Levin
+ *
+ * This software is distributed under the terms of the MIT License unless
+ * otherwise noted.  See LICENSE for further details.
+ *
+ */
+
+#ifndef ALIAS_TABLE_H
+#define ALIAS_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// AliasTable picks an index with a probability proportional to its weight in
+// constant time, using Walker's alias method as constructed by Vose.  Each
+// index gets an equal slice of [0, 1), which is split between the index and
+// the one it is aliased to.  The split is kept as a float, so that an entry
+// takes eight bytes.
+class AliasTable {
+public:
+    AliasTable() = default;
+    // weights must be non-negative, with at least one greater than zero.
+    explicit AliasTable(const std::vector<double>& weights);
+    size_t Sample(double rand_uniform) const {
+        const double scaled = rand_uniform * entries.size();
+        size_t idx = static_cast<size_t>(scaled);
+        if (idx >= entries.size()) {
+            idx = entries.size() - 1;
+        }
+        const Entry& entry = entries[idx];
+        return ((scaled - idx) < entry.threshold ? idx : entry.alias);
+    }
+    size_t Size() const {
+        return (entries.size());
+    }
+    double TotalWeight() const {
+        return (total_weight);
+    }
+
+private:
+    struct Entry {
+        // The fraction of the slice that belongs to the index itself.
+        float threshold;
+        uint32_t alias;
+    };
+    std::vector<Entry> entries;
+    double total_weight = 0;
+};
+
+#endif // ALIAS_TABLE_H
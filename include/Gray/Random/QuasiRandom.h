@@ -0,0 +1,51 @@
+/*
+ * Gray: A Ray Tracing-based Monte Carlo Simulator for PET
+ *
+ * Copyright (c) 2018, David Freese, Peter Olcott, Sam Buss, Craig Levin
+ *
+ * This software is distributed under the terms of the MIT License unless
+ * otherwise noted.  See LICENSE for further details.
+ *
+ */
+
+#ifndef QUASI_RANDOM_H
+#define QUASI_RANDOM_H
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+// ScrambledHalton generates a Halton sequence, one prime base per dimension,
+// with each digit of each dimension put through its own random permutation.
+// The points cover [0, 1)^n more evenly than independent uniforms do, while
+// the scrambling leaves each point uniformly distributed on its own, so an
+// average over them is still an unbiased estimate.  Scrambling again with a
+// different generator gives an independent randomization of the sequence.
+class ScrambledHalton {
+public:
+    ScrambledHalton() = default;
+    explicit ScrambledHalton(const std::vector<int>& bases);
+    // Draws new digit permutations and starts the sequence over.
+    void Scramble(std::mt19937& generator);
+    // Fills point, which must have one entry per base, with the next point
+    // of the sequence, each in [0, 1).
+    void Next(double* point);
+    size_t Dimensions() const {
+        return (dims.size());
+    }
+
+private:
+    struct Dimension {
+        int base;
+        // The number of digits kept, so that base^digits fits exactly in a
+        // double.
+        int digits;
+        double scale;
+        // The permutation for digit d is at d * base.
+        std::vector<uint8_t> perms;
+    };
+    std::vector<Dimension> dims;
+    uint64_t index = 0;
+};
+
+#endif // QUASI_RANDOM_H
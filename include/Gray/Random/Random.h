@@ -12,6 +12,7 @@
 #define RANDOM_H
 
 #include <random>
+class ScrambledHalton;
 class VectorR3;
 
 class Random
@@ -20,6 +21,15 @@ public:
     static void SeedDefault();
     static void SetSeed(unsigned long seed);
     static unsigned long GetSeed();
+    // Draws decay positions and emission directions from scrambled Halton
+    // sequences instead of the generator.  The scrambling is redrawn with
+    // every SetSeed.
+    static void SetQuasiRandom(bool enable);
+    static bool GetQuasiRandom();
+    // Scrambles the sequences of the calling thread from seed, starting them
+    // over.  Every thread has its own, which SetSeed only scrambles for the
+    // thread that calls it.
+    static void ScrambleSequences(unsigned long seed);
     static unsigned long Int();
     static double Uniform();
     static double Gaussian();
@@ -27,6 +37,8 @@ public:
     static long Poisson(double lambda);
     static VectorR3 UniformSphere();
     static VectorR3 UniformSphereFilled();
+    // UniformSphere, for the direction a decay emits a photon in.
+    static VectorR3 EmissionDirection();
     static VectorR3 Deflection(const VectorR3 & ref, const double costheta);
     static VectorR3 DeflectionUniform(const VectorR3 & ref,
             const double theta);
@@ -49,6 +61,9 @@ private:
     static std::mt19937 & generator();
     static std::normal_distribution<double> & normal_distribution();
     static unsigned long & seed_used();
+    static bool & quasi_random();
+    static ScrambledHalton & position_sequence();
+    static ScrambledHalton & direction_sequence();
 };
 
 #endif /* RANDOM_H */
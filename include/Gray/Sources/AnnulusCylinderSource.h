@@ -24,6 +24,7 @@ public:
             const VectorR3& axis, double activity);
     VectorR3 Decay() const override;
     bool Inside(const VectorR3 & pos) const override;
+    AABB GetExtents() const override;
 
 private:
     double radius = 1.0;
@@ -25,6 +25,7 @@ public:
             const VectorR3& axis, double act);
     VectorR3 Decay() const override;
     bool Inside(const VectorR3 & pos) const override;
+    AABB GetExtents() const override;
     void SetRadius(double r1, double r2);
     void SetAxis(VectorR3 L);
     static double EllipticE(double m);
@@ -27,6 +27,7 @@ public:
             double act);
     VectorR3 Decay() const override;
     bool Inside(const VectorR3 & pos) const override;
+    AABB GetExtents() const override;
 
 private:
     double radius = 1.0;
@@ -0,0 +1,97 @@
+/*
+ * Gray: A Ray Tracing-based Monte Carlo Simulator for PET
+ *
+ * Copyright (c) 2018, David Freese, Peter Olcott, Sam Buss, Craig Levin
+ *
+ * This software is distributed under the terms of the MIT License unless
+ * otherwise noted.  See LICENSE for further details.
+ *
+ */
+
+#ifndef DYNAMICVOXELSOURCE_H
+#define DYNAMICVOXELSOURCE_H
+
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <iosfwd>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Gray/Sources/Source.h"
+#include "Gray/Sources/VoxelSource.h"
+#include "Gray/VrMath/LinearR3.h"
+
+// DynamicVoxelSource is a voxelized source that changes over a series of
+// frames, such as for a dynamic study, each with its own image and activity,
+// which is constant over the frame other than for the decay of the isotope.
+//
+// Only the frames in use are held in memory.  A frame is read from its image
+// the first time a decay falls in it, and the next frame is read in the
+// background as soon as it is, so that it is normally ready by the time it
+// is needed.  Each thread simulates a contiguous span of time, so once every
+// thread has moved past a frame, it is dropped.
+class DynamicVoxelSource : public Source
+{
+public:
+    struct Frame {
+        double start;
+        double duration;
+        std::string filename;
+        // In decays per second
+        double activity;
+    };
+
+    DynamicVoxelSource(const VectorR3& position, const VectorR3& size,
+                       const VectorR3& axis, std::vector<Frame> frames);
+    bool IsDynamic() const override {
+        return (true);
+    }
+    double NextDecayTime(double time, long& index) const override;
+    double GetExpectedDecays(double start, double time) const override;
+    VectorR3 DecayAt(double time, long index) const override;
+    VectorR3 Decay() const override;
+    bool Inside(const VectorR3 & pos) const override;
+    AABB GetExtents() const override;
+
+    // Reads a list of frames, one per line, as:
+    // [start time] [duration] [filename] [activity]
+    // with the activity in microcuries, scaled by activity_scale.  Image
+    // filenames are relative to dir.  Lines starting with # are skipped.
+    static bool LoadFrames(std::istream& input, const std::string& dir,
+                           double activity_scale, std::vector<Frame>& frames);
+    // Checks that the frames are in order without overlapping, and that the
+    // header of each image can be read.
+    static bool CheckFrames(const std::vector<Frame>& frames);
+    // The number of frames currently held in memory, or being read.
+    size_t NumLoadedFrames() const;
+
+private:
+    // The first frame that ends after time, or the number of frames if none.
+    size_t FrameAfter(double time) const;
+    const VoxelSource& GetFrame(size_t idx) const;
+    std::shared_future<std::shared_ptr<const VoxelSource>> RequestFrame(
+            size_t idx,
+            std::vector<std::packaged_task<
+                    std::shared_ptr<const VoxelSource>()>>& reads) const;
+
+    std::vector<Frame> frames;
+    VectorR3 size;
+    VectorR3 axis;
+    const RigidMapR3 local_to_global;
+    // Tells apart the sources that a thread's cached frame could be from,
+    // even if one is at the address of another that is gone.
+    const uint64_t source_id;
+    static std::atomic<uint64_t> last_source_id;
+
+    mutable std::mutex frame_mutex;
+    mutable std::map<size_t, std::shared_future<
+            std::shared_ptr<const VoxelSource>>> loaded_frames;
+    // The frame each thread last moved to.
+    mutable std::map<std::thread::id, size_t> thread_frames;
+};
+
+#endif // DYNAMICVOXELSOURCE_H
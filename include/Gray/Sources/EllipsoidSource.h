@@ -24,6 +24,7 @@ public:
     EllipsoidSource(const VectorR3 &center, const VectorR3 &a1, const VectorR3 &a2, double r1, double r2, double r3, double act);
     VectorR3 Decay() const override;
     bool Inside(const VectorR3 & pos) const override;
+    AABB GetExtents() const override;
     void SetRadius(double r1, double r2, double r3);
     void SetAxis(const VectorR3 &a1,const VectorR3 &a2);
 private:
@@ -25,6 +25,7 @@ public:
             const VectorR3& axis, double act);
     VectorR3 Decay() const override;
     bool Inside(const VectorR3 & pos) const override;
+    AABB GetExtents() const override;
 
 private:
     double radius1 = 1.0;
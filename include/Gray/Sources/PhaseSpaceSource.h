@@ -0,0 +1,67 @@
+/*
+ * Gray: A Ray Tracing-based Monte Carlo Simulator for PET
+ *
+ * Copyright (c) 2018, David Freese, Peter Olcott, Sam Buss, Craig Levin
+ *
+ * This software is distributed under the terms of the MIT License unless
+ * otherwise noted.  See LICENSE for further details.
+ *
+ */
+
+#ifndef PHASESPACESOURCE_H
+#define PHASESPACESOURCE_H
+
+#include <memory>
+#include <string>
+#include "Gray/Gray/MappedFile.h"
+#include "Gray/Gray/PhaseSpace.h"
+#include "Gray/Sources/Source.h"
+
+// PhaseSpaceSource replays the photons recorded in a phase space file,
+// rather than decaying its isotope.  Each decay in the file happens at the
+// time it did when it was recorded, with the photons that left the surface,
+// so only the time span that was recorded can be simulated.
+//
+// The file is mapped into memory and read in place, shared by every thread.
+// As the decays are in order of time, a thread finds where it starts by a
+// binary search, and then steps through the records of one decay after
+// another by index, as several decays can share the same time.
+class PhaseSpaceSource : public Source
+{
+public:
+    PhaseSpaceSource() = default;
+    bool Load(const std::string& filename);
+    bool IsDynamic() const override {
+        return (true);
+    }
+    // index is that of the first record of a decay.
+    double NextDecayTime(double time, long& index) const override;
+    // The number of photons recorded in that time, as there is no activity.
+    double GetExpectedPhotons(double start, double time) const override;
+    VectorR3 DecayAt(double time, long index) const override;
+    NuclearDecay Emit(int decay_number, double time, long index, int src_id,
+                      const VectorR3& position) const override;
+    VectorR3 Decay() const override;
+    bool Inside(const VectorR3 & pos) const override;
+    AABB GetExtents() const override;
+    size_t NumRecords() const {
+        return (records_end - records_begin);
+    }
+
+private:
+    // The first record from a decay at or after time.
+    const PhaseSpace::Record* LowerBound(double time) const;
+    // The first record from a decay after time.
+    const PhaseSpace::Record* UpperBound(double time) const;
+    // The record at index, or nullptr if there isn't one.
+    const PhaseSpace::Record* RecordAt(long index) const;
+    // The record after the last one from the same decay as first.
+    const PhaseSpace::Record* DecayEnd(const PhaseSpace::Record* first) const;
+
+    std::unique_ptr<MappedFile> file;
+    const PhaseSpace::Record* records_begin = nullptr;
+    const PhaseSpace::Record* records_end = nullptr;
+    AABB extents;
+};
+
+#endif // PHASESPACESOURCE_H
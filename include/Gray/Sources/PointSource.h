@@ -19,6 +19,7 @@ public:
     PointSource(const VectorR3 &p, double act);
     VectorR3 Decay() const override;
     bool Inside(const VectorR3 & pos) const override;
+    AABB GetExtents() const override;
 };
 
 #endif // POINTSOURCE_H_
@@ -24,6 +24,7 @@ public:
                const VectorR3 & orientation, double act);
     VectorR3 Decay() const override;
     bool Inside(const VectorR3 & pos) const override;
+    AABB GetExtents() const override;
 private:
     const VectorR3 size;
     const RigidMapR3 local_to_global;
@@ -13,10 +13,12 @@
 
 #include <memory>
 
+#include "Gray/VrMath/Aabb.h"
 #include "Gray/VrMath/MathMisc.h"
 #include "Gray/VrMath/LinearR3.h"
 #include "Gray/Physics/Isotope.h"
 #include "Gray/Physics/Physics.h"
+#include "Gray/Random/Random.h"
 
 class Source
 {
@@ -64,11 +66,11 @@ public:
         return (activity * isotope->FractionRemaining(time));
     }
 
-    double GetExpectedDecays(double start, double time) const {
+    virtual double GetExpectedDecays(double start, double time) const {
         return (activity * isotope->FractionIntegral(start, time));
     }
 
-    double GetExpectedPhotons(double start, double time) const {
+    virtual double GetExpectedPhotons(double start, double time) const {
         return (isotope->ExpectedNoPhotons() * GetExpectedDecays(start, time));
     }
 
@@ -100,10 +102,67 @@ public:
         return *isotope.get();
     }
 
+    /*!
+     * The time of the next decay after time.  A source that replays a list
+     * of decays, several of which can happen at the same time, steps index
+     * from the decay it is at to the next one instead.  index starts at -1,
+     * meaning the first decay after time, and other sources leave it be.
+     */
+    virtual double NextDecayTime(double time, long&) const {
+        return (time + Random::Exponential(GetActivity(time)));
+    }
+
+    // True for a source whose activity changes other than by the decay of
+    // its isotope, which then overrides NextDecayTime, DecayAt, and
+    // GetExpectedDecays.
+    virtual bool IsDynamic() const {
+        return (false);
+    }
+    // The position of a decay at time, or index from NextDecayTime, for a
+    // source whose distribution changes over time.
+    virtual VectorR3 DecayAt(double, long) const {
+        return (Decay());
+    }
+
+    /*!
+     * The decay at time and position, with the photons it emits, which come
+     * from the isotope, unless the source replays photons of its own.  index
+     * is the one NextDecayTime gave for it.
+     */
+    virtual NuclearDecay Emit(int decay_number, double time, long,
+                              int src_id, const VectorR3& position) const
+    {
+        return (isotope->Decay(decay_number, time, src_id, position));
+    }
+
     virtual bool Inside(const VectorR3 &pos) const = 0;
     virtual VectorR3 Decay() const = 0;
+    // A box enclosing every position Decay can return.
+    virtual AABB GetExtents() const = 0;
 
 protected:
+    /*!
+     * The extents of the box from -half_size to half_size in the source's
+     * local coordinates, once it has been placed with local_to_global.
+     */
+    static AABB LocalBoxExtents(const RigidMapR3& local_to_global,
+                                const VectorR3& half_size)
+    {
+        AABB extents;
+        for (int ii = 0; ii < 8; ++ii) {
+            VectorR3 corner((ii & 1) ? half_size.x : -half_size.x,
+                            (ii & 2) ? half_size.y : -half_size.y,
+                            (ii & 4) ? half_size.z : -half_size.z);
+            corner = local_to_global * corner;
+            if (ii == 0) {
+                extents.Set(corner, corner);
+            } else {
+                extents.EnlargeToEnclose(AABB(corner, corner));
+            }
+        }
+        return (extents);
+    }
+
     std::shared_ptr<const Isotope> isotope;
     double activity;
     bool negative;
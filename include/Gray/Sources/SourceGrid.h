@@ -0,0 +1,57 @@
+/*
+ * Gray: A Ray Tracing-based Monte Carlo Simulator for PET
+ *
+ * Copyright (c) 2018, David Freese, Peter Olcott, Sam Buss, Craig Levin
+ *
+ * This software is distributed under the terms of the MIT License unless
+ * otherwise noted.  See LICENSE for further details.
+ *
+ */
+
+#ifndef SOURCEGRID_H
+#define SOURCEGRID_H
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "Gray/VrMath/Aabb.h"
+#include "Gray/VrMath/LinearR3.h"
+
+class Source;
+
+// SourceGrid is a uniform grid over the extents of a list of sources, with
+// each cell listing the sources whose extents overlap it, so that finding
+// the sources that could contain a point only looks at a few of them.  The
+// sources of a cell are listed in the same order as they were given, so
+// that testing them in turn gives the same result as testing the whole list.
+class SourceGrid
+{
+public:
+    SourceGrid() = default;
+    explicit SourceGrid(
+            const std::vector<std::shared_ptr<const Source>>& sources);
+    // Sets begin and end to the indices of the sources whose extents could
+    // contain pos.
+    void Candidates(const VectorR3& pos, const uint32_t*& begin,
+                    const uint32_t*& end) const;
+
+    // Cells per axis are scaled so that there are around this many per
+    // source, up to max_cells_per_axis.
+    static constexpr int cells_per_source = 8;
+    static constexpr int max_cells_per_axis = 32;
+
+private:
+    // The cell containing pos, or -1 if it's outside of the grid.
+    long CellAt(const VectorR3& pos) const;
+    int AxisCell(const VectorR3& pos, int axis) const;
+
+    AABB extents;
+    std::array<int, 3> no_cells = {{0, 0, 0}};
+    std::array<double, 3> inv_cell_size = {{0, 0, 0}};
+    // The sources in cell i are indices[offsets[i]] to indices[offsets[i+1]].
+    std::vector<size_t> offsets;
+    std::vector<uint32_t> indices;
+};
+
+#endif // SOURCEGRID_H
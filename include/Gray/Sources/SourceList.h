@@ -18,9 +18,12 @@
 #include <string>
 #include <vector>
 #include "Gray/Physics/Positron.h"
+#include "Gray/Random/AliasTable.h"
 #include "Gray/Sources/Source.h"
+#include "Gray/Sources/SourceGrid.h"
 #include "Gray/json/json.h"
 
+class EmissionBias;
 class Isotope;
 class VectorR3;
 class RigidMapR3;
@@ -32,6 +35,7 @@ public:
     NuclearDecay Decay();
     void AddSource(std::unique_ptr<Source> s);
     void AddIsotope(const std::string& name, std::unique_ptr<Isotope> s);
+    bool AddIsotope(const std::string& name, const Json::Value& isotope);
     bool SetCurIsotope(const std::string& iso, const RigidMapR3& cur_matrix);
     void SetSimulationTime(double time);
     double GetTime() const;
@@ -41,8 +45,14 @@ public:
     bool SimulationIncomplete() const;
     std::vector<VectorR3> GetSourcePositions() const;
     void DisableHalfLife();
+    // Has every isotope sample the direction of its emissions from bias.
+    void SetEmissionBias(std::shared_ptr<const EmissionBias> bias);
     void SetStartTime(double val);
     void InitSources();
+    // True if InitSources found that the sources could be sampled as one.
+    bool SuperposedDecays() const {
+        return (superposed);
+    }
     bool LoadIsotopes(const std::string& physics_filename);
     void AdjustTimeForSplit(int idx, int n);
     bool PrintSplits(int n) const;
@@ -54,6 +64,8 @@ public:
     double SearchSplitTime(double start_time, double full_sim_time,
                            double split_start, double no_photons) const;
     size_t NumSources() const;
+    // The energies of photons emitted by any of the isotopes.
+    std::vector<double> EmittedEnergies() const;
     std::shared_ptr<const Source> GetSource(size_t idx) const;
     static std::unique_ptr<Isotope> IsotopeFactory(
             Json::Value isotope, bool simulate_isotope_half_life);
@@ -70,6 +82,8 @@ private:
         double time;
         int source_idx;
         VectorR3 position;
+        // Where a source replaying a list of decays is in it.
+        long index = -1;
         bool operator<(const DecayInfo & rhs) const {
             return (time < rhs.time);
         }
@@ -78,6 +92,8 @@ private:
         }
     };
     DecayInfo NextDecay(DecayInfo base_info) const;
+    DecayInfo NextSuperposedDecay(DecayInfo base_info) const;
+    bool CanSuperpose() const;
     DecayInfo GetNextDecay();
 
     // We keep these as shared_ptrs as we assume this SourceList can be copied
@@ -87,6 +103,9 @@ private:
     // it stays that way.
     std::vector<std::shared_ptr<const Source>> list;
     std::vector<std::shared_ptr<const Source>> neg_list;
+    // Finds the negative sources that could contain a decay, built by
+    // InitSources.
+    SourceGrid neg_grid;
     std::map<std::string, std::shared_ptr<const Isotope>> valid_isotopes;
     int decay_number = 0;
     std::string current_isotope;
@@ -96,6 +115,12 @@ private:
     // queue, so the earliest time event is in front.
     std::priority_queue<DecayInfo, std::vector<DecayInfo>,
             std::greater<DecayInfo>> decay_list;
+    // When every source decays with the same half-life, the sources are
+    // sampled as one with their total activity, and each decay is given to a
+    // source picked from source_table by its share of that activity.
+    // decay_list then only holds the next decay of the whole list.
+    bool superposed = false;
+    AliasTable source_table;
     bool simulate_isotope_half_life = true;
     double start_time = 0;
     double end_time = 0;
@@ -20,6 +20,7 @@ public:
     SphereSource(const VectorR3 &pos, double radius, double act);
     VectorR3 Decay() const override;
     bool Inside(const VectorR3 & pos) const override;
+    AABB GetExtents() const override;
 private:
     double radius;
 };
@@ -11,24 +11,51 @@
 #ifndef VECTORSOURCE_H_
 #define VECTORSOURCE_H_
 
+#include <array>
+#include <cstdint>
 #include <memory>
+#include <vector>
 #include "Gray/Sources/Source.h"
 #include "Gray/VrMath/LinearR3.h"
 #include "Gray/VrMath/Aabb.h"
 
 class SceneDescription;
 
+// VectorSource is a source filling the inside of a closed surface, such as
+// a mesh.  Its box is split into a grid of cells, each of which is inside,
+// outside, or on the boundary, where a surface passes through it.  A decay
+// picks one of the cells that are inside or on the boundary, and only needs
+// to check that the position is inside, with a ray cast, for the latter.
 class VectorSource : public Source
 {
 public:
     VectorSource(const double act, std::unique_ptr<SceneDescription> scene);
     VectorR3 Decay() const override;
     bool Inside(const VectorR3 & pos) const override;
+    AABB GetExtents() const override;
+
+    size_t NumInsideCells() const;
+    size_t NumBoundaryCells() const;
+
+    // The number of cells along the longest side of the box.
+    static constexpr int max_cells_per_axis = 64;
 
 private:
+    void BuildGrid();
+    VectorR3 CellCenter(size_t index) const;
+
+    struct Cell {
+        uint32_t index;
+        bool boundary;
+    };
+
     const VectorR3 size;
     const VectorR3 center;
+    const AABB extents;
     std::unique_ptr<SceneDescription> scene;
+    std::array<int, 3> no_cells = {{0, 0, 0}};
+    VectorR3 cell_size;
+    std::vector<Cell> cells;
 };
 
 #endif /*VECTORSOURCE_H_*/
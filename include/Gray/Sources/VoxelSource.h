@@ -12,8 +12,10 @@
 #define VOXELSOURCE_H
 
 #include <array>
+#include <cstdint>
 #include <iosfwd>
 #include <vector>
+#include "Gray/Random/AliasTable.h"
 #include "Gray/Sources/Source.h"
 #include "Gray/VrMath/LinearR3.h"
 
@@ -25,17 +27,37 @@ public:
             const VectorR3& axis, double activity);
     VectorR3 Decay() const override;
     bool Inside(const VectorR3 & pos) const override;
+    AABB GetExtents() const override;
     bool Load(const std::string& filename);
+    bool Load(std::istream& input);
     static bool Load(
             std::istream& input,
             std::vector<double>& vox_vals,
             std::array<int,3>& dims);
+    static bool Load(
+            std::istream& input,
+            std::vector<float>& vox_vals,
+            std::array<int,3>& dims);
+    // Reads just the header of an image, leaving input at the values.
+    static bool LoadHeader(std::istream& input, std::array<int,3>& dims);
 private:
+    bool BuildTables(const std::vector<float>& vox_vals);
+    double BuildSliceTable(const std::vector<float>& vox_vals, int slice);
+
     std::array<int,3> dims;
     VectorR3 size;
     const RigidMapR3 local_to_global;
     const RigidMapR3 global_to_local;
-    std::vector <double> prob;
+    // A voxel is picked by first picking the slice along x that it is in,
+    // and then the voxel within the slice, each with an alias table, so that
+    // the slices can be built in parallel, and each only needs to be precise
+    // relative to its own slice.
+    AliasTable slice_table;
+    std::vector<AliasTable> voxel_tables;
+    // For each slice that is mostly empty, its table only covers the voxels
+    // with activity, and this is the index of each within the slice.  For
+    // the other slices it is empty, and the table covers every voxel.
+    std::vector<std::vector<uint32_t>> voxel_indices;
 };
 
 #endif // VOXELSOURCE_H
@@ -30,6 +30,7 @@ class ViewableBezierSet;
 class ViewableCone;
 class ViewableCylinder;
 class ViewableEllipsoid;
+class ViewableInstance;
 class ViewableParallelepiped;
 class ViewableParallelogram;
 class ViewableSphere;
@@ -99,6 +100,7 @@ public:
     void RenderViewableCone( const ViewableCone& object );
     void RenderViewableCylinder( const ViewableCylinder& object );
     void RenderViewableEllipsoid( const ViewableEllipsoid& object );
+    void RenderViewableInstance( const ViewableInstance& object );
     void RenderViewableParallelepiped( const ViewableParallelepiped& object );
     void RenderViewableParallelogram( const ViewableParallelogram& object );
     void RenderViewableSphere( const ViewableSphere& object );
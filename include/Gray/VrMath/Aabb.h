@@ -105,7 +105,7 @@ public:
                       int signDirX, int signDirY, int signDirZ,
                       double t0, double t1, double & tmin,
                       double & tmax) const;
-    bool Inside(const VectorR3 & pos);
+    bool Inside(const VectorR3 & pos) const;
 private:
     VectorR3 bounds[2];
 };
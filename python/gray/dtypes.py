@@ -16,7 +16,8 @@ def interaction_fields():
             ('scatter_rayleigh_phantom', np.int32),
             ('scatter_rayleigh_detector', np.int32),
             ('xray_flouresence', np.int32),
-            ('coinc_id', np.int32),)
+            ('coinc_id', np.int32),
+            ('weight', np.float64, (2,)),)
 
 def interaction_all_dtype():
     return np.dtype(list(interaction_fields()))
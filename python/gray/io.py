@@ -12,7 +12,7 @@ def write_variable_binary(filename, data):
     with open(filename, 'wb') as fid:
         fields = np.array(gray.variable_field_mask(data), dtype=np.int32)
         # Magic number, version number, no_fields, no_active, event size
-        np.array((65531, 1, fields.size, fields.sum(), data.dtype.itemsize,),
+        np.array((65531, 2, fields.size, fields.sum(), data.dtype.itemsize,),
                   dtype=np.int32).tofile(fid)
         fields.tofile(fid)
         data.tofile(fid)
@@ -23,7 +23,7 @@ def load_variable_binary(filename):
         if magic_number != 65531:
             RuntimeError('Invalid binary file start')
         version_number = np.fromfile(fid, dtype=np.int32, count=1)
-        if version_number != 1:
+        if version_number not in (1, 2):
             RuntimeError('Invalid version number')
         no_fields = np.fromfile(fid, dtype=np.int32, count=1)
         no_active = np.fromfile(fid, dtype=np.int32, count=1)
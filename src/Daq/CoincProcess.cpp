@@ -9,7 +9,10 @@
  */
 
 #include "Gray/Daq/CoincProcess.h"
+#include <algorithm>
 #include <iterator>
+#include <utility>
+#include <vector>
 #include "Gray/Daq/ProcessStats.h"
 
 /*!
@@ -136,6 +139,33 @@ CoincProcess::EventIter CoincProcess::process_events_optional_stop(
         } else {
             stats.no_coinc_single_events += no_events;
         }
+        // Each decay in the coincidence was sampled independently, so the
+        // weight of the coincidence is the product of their weights.  The
+        // photons of a decay share its weight, but each one that survived
+        // Russian roulette brings along its own part.  Both are counted once,
+        // whichever event they come from first.
+        std::vector<int> decay_ids;
+        std::vector<std::pair<int, int>> photons;
+        double weight = 1;
+        const auto add_weight = [&decay_ids, &photons, &weight](
+                const EventT& event)
+        {
+            const std::pair<int, int> photon(event.decay_id, event.color);
+            if (std::find(photons.begin(), photons.end(), photon) !=
+                photons.end())
+            {
+                return;
+            }
+            photons.push_back(photon);
+            weight *= event.roulette_weight;
+            if (std::find(decay_ids.begin(), decay_ids.end(),
+                          event.decay_id) == decay_ids.end())
+            {
+                decay_ids.push_back(event.decay_id);
+                weight *= event.weight / event.roulette_weight;
+            }
+        };
+        add_weight(current_event);
         for (auto iter = window_start_iter; iter != window_end_iter; ++iter)  {
             EventT & event = *iter;
             if (event.dropped) {
@@ -143,6 +173,7 @@ CoincProcess::EventIter CoincProcess::process_events_optional_stop(
             }
             if (keep_events) {
                 event.coinc_id = stats.no_coinc_events;
+                add_weight(event);
             } else {
                 event.coinc_id = -2;
             }
@@ -150,6 +181,7 @@ CoincProcess::EventIter CoincProcess::process_events_optional_stop(
         if (keep_events) {
             current_event.coinc_id = stats.no_coinc_events;
             stats.no_coinc_events++;
+            stats.weighted_coinc_events += weight;
             stats.no_kept += no_events;
         } else {
             current_event.coinc_id = -2;
@@ -0,0 +1,497 @@
+/*
+ * Gray: A Ray Tracing-based Monte Carlo Simulator for PET
+ *
+ * Copyright (c) 2018, David Freese, Peter Olcott, Sam Buss, Craig Levin
+ *
+ * This software is distributed under the terms of the MIT License unless
+ * otherwise noted.  See LICENSE for further details.
+ *
+ */
+
+#include "Gray/Graphics/MeshFile.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <unordered_map>
+
+namespace {
+typedef ViewableMesh::Triangle Triangle;
+
+// Merges vertices that are exactly equal, as STL files repeat each vertex for
+// every triangle that uses it.
+class VertexWelder {
+public:
+    explicit VertexWelder(std::vector<VectorR3>& vertices) :
+        vertices(vertices)
+    {
+    }
+
+    uint32_t Add(const VectorR3& vertex) {
+        // Adding zero makes -0.0 into 0.0, so the two hash the same.
+        const Key key = {{vertex.x + 0.0, vertex.y + 0.0, vertex.z + 0.0}};
+        auto iter = indices.find(key);
+        if (iter != indices.end()) {
+            return (iter->second);
+        }
+        uint32_t index = static_cast<uint32_t>(vertices.size());
+        vertices.push_back(vertex);
+        indices.emplace(key, index);
+        return (index);
+    }
+
+private:
+    typedef std::array<double, 3> Key;
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            std::hash<double> hasher;
+            size_t seed = hasher(key[0]);
+            seed ^= hasher(key[1]) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+            seed ^= hasher(key[2]) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+            return (seed);
+        }
+    };
+    std::vector<VectorR3>& vertices;
+    std::unordered_map<Key, uint32_t, KeyHash> indices;
+};
+
+// Values in binary files are converted from their byte order regardless of
+// that of the machine.
+uint64_t FromBytes(const unsigned char* bytes, size_t size, bool big_endian)
+{
+    uint64_t value = 0;
+    for (size_t ii = 0; ii < size; ++ii) {
+        const size_t shift = 8 * (big_endian ? (size - 1 - ii) : ii);
+        value |= static_cast<uint64_t>(bytes[ii]) << shift;
+    }
+    return (value);
+}
+
+float FloatFromBytes(const unsigned char* bytes, bool big_endian) {
+    uint32_t bits = static_cast<uint32_t>(FromBytes(bytes, 4, big_endian));
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return (value);
+}
+
+double DoubleFromBytes(const unsigned char* bytes, bool big_endian) {
+    uint64_t bits = FromBytes(bytes, 8, big_endian);
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return (value);
+}
+
+/*!
+ * Adds the polygon as a fan of triangles around its first vertex, checking
+ * that each index is in range.
+ */
+bool AddPolygon(const std::vector<int64_t>& polygon, size_t no_vertices,
+                std::vector<Triangle>& triangles, std::string& error)
+{
+    if (polygon.size() < 3) {
+        error = "polygon with fewer than three vertices";
+        return (false);
+    }
+    for (int64_t idx: polygon) {
+        if ((idx < 0) || (static_cast<uint64_t>(idx) >= no_vertices)) {
+            error = "vertex index out of range: " + std::to_string(idx);
+            return (false);
+        }
+    }
+    for (size_t ii = 2; ii < polygon.size(); ++ii) {
+        triangles.push_back({{static_cast<uint32_t>(polygon[0]),
+                              static_cast<uint32_t>(polygon[ii - 1]),
+                              static_cast<uint32_t>(polygon[ii])}});
+    }
+    return (true);
+}
+
+bool ReadBinarySTL(std::istream& input, uint32_t no_triangles,
+                   std::vector<VectorR3>& vertices,
+                   std::vector<Triangle>& triangles, std::string& error)
+{
+    VertexWelder welder(vertices);
+    triangles.reserve(triangles.size() + no_triangles);
+    // Each record is a normal, three vertices, and a two byte attribute.
+    unsigned char record[50];
+    for (uint32_t ii = 0; ii < no_triangles; ++ii) {
+        if (!input.read(reinterpret_cast<char*>(record), sizeof(record))) {
+            error = "binary STL ended after " + std::to_string(ii) +
+                    " of " + std::to_string(no_triangles) + " triangles";
+            return (false);
+        }
+        Triangle tri;
+        for (int vv = 0; vv < 3; ++vv) {
+            const unsigned char* data = record + 12 * (vv + 1);
+            VectorR3 vertex(FloatFromBytes(data, false),
+                            FloatFromBytes(data + 4, false),
+                            FloatFromBytes(data + 8, false));
+            tri[vv] = welder.Add(vertex);
+        }
+        triangles.push_back(tri);
+    }
+    return (true);
+}
+
+bool ReadAsciiSTL(std::istream& input, std::vector<VectorR3>& vertices,
+                  std::vector<Triangle>& triangles, std::string& error)
+{
+    VertexWelder welder(vertices);
+    Triangle tri;
+    int no_verts = 0;
+    std::string token;
+    while (input >> token) {
+        if (token == "vertex") {
+            VectorR3 vertex;
+            if (!(input >> vertex.x >> vertex.y >> vertex.z)) {
+                error = "invalid vertex in ASCII STL";
+                return (false);
+            }
+            if (no_verts == 3) {
+                error = "facet with more than three vertices in ASCII STL";
+                return (false);
+            }
+            tri[no_verts++] = welder.Add(vertex);
+        } else if (token == "endloop") {
+            if (no_verts != 3) {
+                error = "facet without three vertices in ASCII STL";
+                return (false);
+            }
+            triangles.push_back(tri);
+            no_verts = 0;
+        }
+    }
+    return (true);
+}
+
+// The scalar types used in PLY files, by either of their names.
+struct PlyType {
+    size_t size;
+    bool is_float;
+    bool is_signed;
+};
+
+bool ParsePlyType(const std::string& name, PlyType& type) {
+    static const std::vector<std::pair<std::vector<std::string>, PlyType>>
+            types = {
+        {{"char", "int8"}, {1, false, true}},
+        {{"uchar", "uint8"}, {1, false, false}},
+        {{"short", "int16"}, {2, false, true}},
+        {{"ushort", "uint16"}, {2, false, false}},
+        {{"int", "int32"}, {4, false, true}},
+        {{"uint", "uint32"}, {4, false, false}},
+        {{"float", "float32"}, {4, true, true}},
+        {{"double", "float64"}, {8, true, true}},
+    };
+    for (const auto& entry: types) {
+        const auto& names = entry.first;
+        if (std::find(names.begin(), names.end(), name) != names.end()) {
+            type = entry.second;
+            return (true);
+        }
+    }
+    return (false);
+}
+
+struct PlyProperty {
+    std::string name;
+    PlyType type;
+    bool is_list = false;
+    PlyType count_type;
+};
+
+struct PlyElement {
+    std::string name;
+    uint64_t count = 0;
+    std::vector<PlyProperty> properties;
+};
+
+// Reads values from the body of a PLY file in any of its formats.
+class PlyReader {
+public:
+    PlyReader(std::istream& input, bool ascii, bool big_endian) :
+        input(input),
+        ascii(ascii),
+        big_endian(big_endian)
+    {
+    }
+
+    bool Read(const PlyType& type, double& value) {
+        if (ascii) {
+            return (static_cast<bool>(input >> value));
+        }
+        unsigned char bytes[8];
+        if (!input.read(reinterpret_cast<char*>(bytes), type.size)) {
+            return (false);
+        }
+        if (type.is_float) {
+            value = (type.size == 4) ? FloatFromBytes(bytes, big_endian) :
+                                       DoubleFromBytes(bytes, big_endian);
+            return (true);
+        }
+        uint64_t bits = FromBytes(bytes, type.size, big_endian);
+        if (type.is_signed) {
+            // Sign extend from the size of the type.
+            const uint64_t sign_bit = uint64_t(1) << (8 * type.size - 1);
+            value = static_cast<double>(
+                    static_cast<int64_t>(bits ^ sign_bit) -
+                    static_cast<int64_t>(sign_bit));
+        } else {
+            value = static_cast<double>(bits);
+        }
+        return (true);
+    }
+
+private:
+    std::istream& input;
+    bool ascii;
+    bool big_endian;
+};
+
+std::string Lower(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    return (text);
+}
+}
+
+bool MeshFile::Read(const std::string& filename,
+                    std::vector<VectorR3>& vertices,
+                    std::vector<ViewableMesh::Triangle>& triangles,
+                    std::string& error)
+{
+    const size_t dot = filename.find_last_of('.');
+    const std::string ext = (dot == std::string::npos) ? "" :
+                            Lower(filename.substr(dot + 1));
+    std::ifstream input(filename, std::ios::binary);
+    if (!input) {
+        error = "unable to open " + filename;
+        return (false);
+    }
+    if (ext == "stl") {
+        return (ReadSTL(input, vertices, triangles, error));
+    } else if (ext == "obj") {
+        return (ReadOBJ(input, vertices, triangles, error));
+    } else if (ext == "ply") {
+        return (ReadPLY(input, vertices, triangles, error));
+    }
+    error = "unknown mesh format \"" + ext + "\", expected stl, obj, or ply";
+    return (false);
+}
+
+/*!
+ * Binary STL files can also start with "solid", so they are told apart from
+ * ASCII by whether the triangle count in the header matches the size of the
+ * file.
+ */
+bool MeshFile::ReadSTL(std::istream& input,
+                       std::vector<VectorR3>& vertices,
+                       std::vector<ViewableMesh::Triangle>& triangles,
+                       std::string& error)
+{
+    const std::streampos start = input.tellg();
+    input.seekg(0, std::ios::end);
+    const std::streamoff size = input.tellg() - start;
+    input.seekg(start);
+
+    unsigned char header[84];
+    if ((size >= 84) &&
+        input.read(reinterpret_cast<char*>(header), sizeof(header)))
+    {
+        uint32_t no_triangles = static_cast<uint32_t>(
+                FromBytes(header + 80, 4, false));
+        if (size == 84 + 50 * static_cast<std::streamoff>(no_triangles)) {
+            return (ReadBinarySTL(input, no_triangles, vertices, triangles,
+                                  error));
+        }
+    }
+    input.clear();
+    input.seekg(start);
+    std::string solid;
+    if (!(input >> solid) || (solid != "solid")) {
+        error = "not a binary or ASCII STL file";
+        return (false);
+    }
+    return (ReadAsciiSTL(input, vertices, triangles, error));
+}
+
+/*!
+ * Only the vertices and faces are read.  Face indices start at one, and
+ * negative ones count back from the latest vertex.  Texture and normal
+ * indices, given as v/vt/vn, are ignored.
+ */
+bool MeshFile::ReadOBJ(std::istream& input,
+                       std::vector<VectorR3>& vertices,
+                       std::vector<ViewableMesh::Triangle>& triangles,
+                       std::string& error)
+{
+    const size_t first_vertex = vertices.size();
+    std::vector<int64_t> polygon;
+    std::string line;
+    size_t line_no = 0;
+    while (std::getline(input, line)) {
+        ++line_no;
+        std::istringstream line_stream(line);
+        std::string type;
+        if (!(line_stream >> type)) {
+            continue;
+        }
+        if (type == "v") {
+            VectorR3 vertex;
+            if (!(line_stream >> vertex.x >> vertex.y >> vertex.z)) {
+                error = "invalid vertex on line " + std::to_string(line_no);
+                return (false);
+            }
+            vertices.push_back(vertex);
+        } else if (type == "f") {
+            polygon.clear();
+            std::string token;
+            while (line_stream >> token) {
+                int64_t idx;
+                try {
+                    idx = std::stoll(token.substr(0, token.find('/')));
+                } catch (std::exception&) {
+                    error = "invalid face on line " + std::to_string(line_no);
+                    return (false);
+                }
+                const int64_t no_file_verts = static_cast<int64_t>(
+                        vertices.size() - first_vertex);
+                idx = (idx < 0) ? (no_file_verts + idx) : (idx - 1);
+                polygon.push_back(static_cast<int64_t>(first_vertex) + idx);
+            }
+            if (!AddPolygon(polygon, vertices.size(), triangles, error)) {
+                error += " on line " + std::to_string(line_no);
+                return (false);
+            }
+        }
+    }
+    return (true);
+}
+
+/*!
+ * Reads the x, y, and z properties of the vertex element and the
+ * vertex_indices list of the face element.  Other elements and properties are
+ * read past.
+ */
+bool MeshFile::ReadPLY(std::istream& input,
+                       std::vector<VectorR3>& vertices,
+                       std::vector<ViewableMesh::Triangle>& triangles,
+                       std::string& error)
+{
+    std::string line;
+    if (!std::getline(input, line) || (line.substr(0, 3) != "ply")) {
+        error = "not a PLY file";
+        return (false);
+    }
+    std::string format;
+    std::vector<PlyElement> elements;
+    while (true) {
+        if (!std::getline(input, line)) {
+            error = "PLY header has no end_header";
+            return (false);
+        }
+        if (!line.empty() && (line.back() == '\r')) {
+            line.pop_back();
+        }
+        std::istringstream line_stream(line);
+        std::string keyword;
+        line_stream >> keyword;
+        if (keyword == "end_header") {
+            break;
+        } else if (keyword == "format") {
+            line_stream >> format;
+        } else if (keyword == "element") {
+            PlyElement element;
+            if (!(line_stream >> element.name >> element.count)) {
+                error = "invalid PLY element: " + line;
+                return (false);
+            }
+            elements.push_back(element);
+        } else if (keyword == "property") {
+            if (elements.empty()) {
+                error = "PLY property before any element";
+                return (false);
+            }
+            PlyProperty property;
+            std::string type;
+            line_stream >> type;
+            bool valid = true;
+            if (type == "list") {
+                std::string count_type;
+                property.is_list = true;
+                line_stream >> count_type >> type;
+                valid = ParsePlyType(count_type, property.count_type);
+            }
+            valid &= ParsePlyType(type, property.type);
+            if (!valid || !(line_stream >> property.name)) {
+                error = "invalid PLY property: " + line;
+                return (false);
+            }
+            elements.back().properties.push_back(property);
+        }
+    }
+    if ((format != "ascii") && (format != "binary_little_endian") &&
+        (format != "binary_big_endian"))
+    {
+        error = "unknown PLY format: " + format;
+        return (false);
+    }
+    PlyReader reader(input, format == "ascii",
+                     format == "binary_big_endian");
+
+    const size_t first_vertex = vertices.size();
+    std::vector<int64_t> polygon;
+    for (const PlyElement& element: elements) {
+        const bool is_vertex = (element.name == "vertex");
+        const bool is_face = (element.name == "face");
+        for (uint64_t item = 0; item < element.count; ++item) {
+            VectorR3 vertex;
+            for (const PlyProperty& property: element.properties) {
+                double value;
+                if (!property.is_list) {
+                    if (!reader.Read(property.type, value)) {
+                        error = "PLY file ended in element " + element.name;
+                        return (false);
+                    }
+                    if (is_vertex && (property.name == "x")) {
+                        vertex.x = value;
+                    } else if (is_vertex && (property.name == "y")) {
+                        vertex.y = value;
+                    } else if (is_vertex && (property.name == "z")) {
+                        vertex.z = value;
+                    }
+                    continue;
+                }
+                double count;
+                if (!reader.Read(property.count_type, count)) {
+                    error = "PLY file ended in element " + element.name;
+                    return (false);
+                }
+                const bool is_indices = (is_face &&
+                        ((property.name == "vertex_indices") ||
+                         (property.name == "vertex_index")));
+                polygon.clear();
+                for (uint64_t ii = 0; ii < static_cast<uint64_t>(count); ++ii) {
+                    if (!reader.Read(property.type, value)) {
+                        error = "PLY file ended in element " + element.name;
+                        return (false);
+                    }
+                    polygon.push_back(static_cast<int64_t>(first_vertex) +
+                                      static_cast<int64_t>(value));
+                }
+                if (is_indices && !AddPolygon(polygon, vertices.size(),
+                                              triangles, error))
+                {
+                    return (false);
+                }
+            }
+            if (is_vertex) {
+                vertices.push_back(vertex);
+            }
+        }
+    }
+    return (true);
+}
@@ -0,0 +1,89 @@
+/*
+ * Gray: A Ray Tracing-based Monte Carlo Simulator for PET
+ *
+ * Copyright (c) 2018, David Freese, Peter Olcott, Sam Buss, Craig Levin
+ *
+ * This software is distributed under the terms of the MIT License unless
+ * otherwise noted.  See LICENSE for further details.
+ *
+ */
+
+#include "Gray/Graphics/ParallelepipedBatch.h"
+#include <algorithm>
+#include <cfloat>
+#include "Gray/Graphics/ViewableParallelepiped.h"
+
+size_t ParallelepipedBatch::AddGroup(
+        const std::vector<const ViewableParallelepiped*>& group)
+{
+    const size_t first = Size();
+    if (group.empty()) {
+        return (first);
+    }
+    const size_t padded = ((group.size() + width - 1) / width) * width;
+    for (size_t ii = 0; ii < padded; ++ii) {
+        const ViewableParallelepiped& p = *group[std::min(ii, group.size() - 1)];
+        const VectorR3 normals[3] = {p.GetNormalABC(), p.GetNormalABD(),
+                                     p.GetNormalACD()};
+        const double tops[3] = {p.GetTopCoefABC(), p.GetTopCoefABD(),
+                                p.GetTopCoefACD()};
+        const double bottoms[3] = {p.GetBottomCoefABC(), p.GetBottomCoefABD(),
+                                   p.GetBottomCoefACD()};
+        for (int plane = 0; plane < 3; ++plane) {
+            normal_x[plane].push_back(normals[plane].x);
+            normal_y[plane].push_back(normals[plane].y);
+            normal_z[plane].push_back(normals[plane].z);
+            top[plane].push_back(tops[plane]);
+            bottom[plane].push_back(bottoms[plane]);
+        }
+    }
+    return (first);
+}
+
+/*!
+ * The same slab test as DoTwoPlanes in ViewableParallelepiped.cpp, written
+ * without early exits.  The front is the furthest entry into the three slabs
+ * and the back is the nearest exit.  Slabs the ray starts inside of give a
+ * negative entry, which only matters when the front is negative, where the
+ * front is not used.  The products and divisions are done in the same order
+ * so that the distances are the same to the bit.
+ */
+void ParallelepipedBatch::Intersect(
+        size_t first, const VectorR3& viewPos, const VectorR3& viewDir,
+        double maxDistance, double front[width], double back[width],
+        bool hit[width]) const
+{
+    bool miss[width];
+    for (size_t ii = 0; ii < width; ++ii) {
+        front[ii] = -DBL_MAX;
+        back[ii] = DBL_MAX;
+        miss[ii] = false;
+    }
+    for (int plane = 0; plane < 3; ++plane) {
+        const double* nx = normal_x[plane].data() + first;
+        const double* ny = normal_y[plane].data() + first;
+        const double* nz = normal_z[plane].data() + first;
+        const double* tp = top[plane].data() + first;
+        const double* bt = bottom[plane].data() + first;
+        for (size_t ii = 0; ii < width; ++ii) {
+            double pdotn = viewPos.x * nx[ii] + viewPos.y * ny[ii] +
+                           viewPos.z * nz[ii];
+            double udotn = viewDir.x * nx[ii] + viewDir.y * ny[ii] +
+                           viewDir.z * nz[ii];
+            double toBottom = (bt[ii] - pdotn) / udotn;
+            double toTop = (tp[ii] - pdotn) / udotn;
+            // Parallel to the planes, the ray is either always between them,
+            // or never.
+            bool parallel = (udotn == 0.0);
+            double entry = parallel ? -DBL_MAX : std::min(toBottom, toTop);
+            double exit = parallel ? DBL_MAX : std::max(toBottom, toTop);
+            miss[ii] |= (parallel && ((pdotn < bt[ii]) || (pdotn > tp[ii])));
+            front[ii] = std::max(front[ii], entry);
+            back[ii] = std::min(back[ii], exit);
+        }
+    }
+    for (size_t ii = 0; ii < width; ++ii) {
+        hit[ii] = (!miss[ii] && (front[ii] <= back[ii]) &&
+                   (front[ii] <= maxDistance));
+    }
+}
@@ -9,6 +9,10 @@
  */
 
 #include "Gray/Graphics/SceneDescription.h"
+#include "Gray/Graphics/ViewableInstance.h"
+#include "Gray/Graphics/ViewableParallelepiped.h"
+#include <algorithm>
+#include <cmath>
 #include <fstream>
 #include <iostream>
 #include <stack>
@@ -25,6 +29,7 @@ void SceneDescription::AddMaterial(std::unique_ptr<Material> newMaterial) {
 }
 
 void SceneDescription::AddViewable(std::unique_ptr<ViewableBase> newViewable) {
+    newViewable->SetSceneIndex(ViewableArray.size());
     ViewableArray.push_back(std::move(newViewable));
 }
 
@@ -64,6 +69,41 @@ AABB SceneDescription::GetExtents() const {
     return(scene_aabb);
 }
 
+std::vector<AABB> SceneDescription::GetSensitiveExtents() const {
+    std::vector<AABB> extents;
+    for (size_t idx = 0; idx < NumViewables(); idx++) {
+        const ViewableBase& viewable = GetViewable(idx);
+        const ViewableInstance* instance =
+                dynamic_cast<const ViewableInstance*>(&viewable);
+        if (instance) {
+            const std::vector<AABB> module_extents =
+                    instance->GetModule().GetSensitiveExtents();
+            for (const AABB& local: module_extents) {
+                AABB aabb;
+                for (int corner = 0; corner < 8; ++corner) {
+                    VectorR3 pos((corner & 1) ? local.GetMaxX():local.GetMinX(),
+                                 (corner & 2) ? local.GetMaxY():local.GetMinY(),
+                                 (corner & 4) ? local.GetMaxZ():local.GetMinZ());
+                    instance->GetPlacement().Transform(&pos);
+                    if (corner == 0) {
+                        aabb.Set(pos, pos);
+                    } else {
+                        aabb.EnlargeToEnclose(AABB(pos, pos));
+                    }
+                }
+                extents.push_back(aabb);
+            }
+        } else if (viewable.GetMaterialFront() &&
+                   viewable.GetMaterialFront()->IsSensitive())
+        {
+            AABB aabb;
+            viewable.CalcAABB(aabb);
+            extents.push_back(aabb);
+        }
+    }
+    return (extents);
+}
+
 double SceneDescription::GetMaxDistance() const {
     AABB extents = GetExtents();
     return((extents.GetBoxMax() - extents.GetBoxMin()).Norm());
@@ -80,41 +120,212 @@ void SceneDescription::BuildTree(bool use_double_recurse_split,
         return (this->GetViewable(obj).CalcExtentsInBox(enc_box, box));
     };
     kd_tree.BuildTree(NumViewables(), ExtentFunc, ExtentInBoxFunc);
+
+    // Sort the objects of each leaf by type, so that the parallelepipeds,
+    // which are most of the detector, can be tested together.
+    leaf_objects.assign(kd_tree.NumNodes(), LeafObjects());
+    box_batch = ParallelepipedBatch();
+    for (long node = 0; node < kd_tree.NumNodes(); ++node) {
+        const KdTreeNode& tree_node = kd_tree.GetNode(node);
+        if (!tree_node.IsLeaf()) {
+            continue;
+        }
+        LeafObjects& leaf = leaf_objects[node];
+        std::vector<const ViewableParallelepiped*> boxes;
+        for (long object : tree_node.Objects()) {
+            auto box = dynamic_cast<const ViewableParallelepiped*>(
+                    &GetViewable(object));
+            if (box) {
+                boxes.push_back(box);
+                leaf.boxes.push_back(object);
+            } else {
+                leaf.others.push_back(object);
+            }
+        }
+        leaf.box_start = box_batch.AddGroup(boxes);
+    }
 }
 
-bool SceneDescription::intersection_callback(
-        long objectNum, const VectorR3 & start_pos, const VectorR3 & direction,
-        double & retStopDistance,VisiblePoint & visible_point_return_ptr) const
+/*!
+ * Where surfaces are at the same distance, as with crystals that touch or
+ * volumes that overlap, they are reported one per search: back faces before
+ * front faces, so that one material is left before the next is entered, and
+ * otherwise in the order the objects were added to the scene.  Each search
+ * then starts on the last of them, and finds the rest at a distance of zero,
+ * where Uncrossed keeps it from taking any that were reported before it.
+ */
+bool SceneDescription::ClosestHit::Accept(
+        long hitObject, double hitDistance, bool hitFrontFace,
+        double & stopDistance)
 {
-    double thisHitDistance;
-    VisiblePoint tempPoint;
-    bool hitFlag = GetViewable(objectNum).FindIntersection(start_pos, direction,
-                                                           retStopDistance,
-                                                           &thisHitDistance,
-                                                           tempPoint);
-    if ( !hitFlag ) {
-        return false;
+    if (hitDistance > stopDistance) {
+        return (false);
     }
-    visible_point_return_ptr = tempPoint;
+    if ((hitDistance == stopDistance) && (object >= 0)) {
+        if (hitFrontFace != front_face) {
+            if (hitFrontFace) {
+                return (false);
+            }
+        } else if (hitObject > object) {
+            return (false);
+        }
+    }
+    object = hitObject;
+    distance = hitDistance;
+    front_face = hitFrontFace;
     // No need to traverse search further than this distance in the future
-    retStopDistance = thisHitDistance;
-    return true;
+    stopDistance = hitDistance;
+    return (true);
+}
+
+/*!
+ * Whether a surface at a distance of zero is one the ray hasn't already
+ * crossed where it starts, following the order that ClosestHit reports
+ * surfaces at the same distance in.  Without this, a ray starting on two
+ * front faces would enter each of them in turn, over and over.
+ */
+bool SceneDescription::Uncrossed(long object, bool front_face,
+                                 const HitSurface& skip)
+{
+    if (skip.depth == 0) {
+        return (front_face);
+    }
+    const bool after = (skip.objects[0]->GetSceneIndex() < object);
+    if (skip.front_face) {
+        return (front_face && after);
+    }
+    return (front_face || after);
+}
+
+/*!
+ * Tests all of the objects in a leaf.  The parallelepipeds are tested width
+ * at a time by box_batch, and the hit is decided the same way as
+ * ViewableParallelepiped::FindIntersectionNT does.  Everything else goes
+ * through FindIntersection.
+ */
+long SceneDescription::IntersectLeaf(
+        long leaf, const VectorR3 & start_pos, const VectorR3 & direction,
+        double & retStopDistance, const HitSurface& skip,
+        ClosestHit & closest, VisiblePoint & returnedPoint) const
+{
+    const LeafObjects& objects = leaf_objects[leaf];
+    const size_t width = ParallelepipedBatch::width;
+    long found = -1;
+    for (size_t first = 0; first < objects.boxes.size(); first += width) {
+        double front[width];
+        double back[width];
+        bool hit[width];
+        box_batch.Intersect(objects.box_start + first, start_pos, direction,
+                            retStopDistance, front, back, hit);
+        const size_t count = std::min(width, objects.boxes.size() - first);
+        for (size_t ii = 0; ii < count; ++ii) {
+            if (!hit[ii]) {
+                continue;
+            }
+            const long object = objects.boxes[first + ii];
+            const ViewableBase* viewable = ViewableArray[object].get();
+            if (skip.IsOn(viewable) && !skip.front_face) {
+                continue;
+            }
+            // A box whose front face the ray has already crossed here is
+            // one the ray is inside of.
+            const bool entering = skip.IsOn(viewable) ||
+                    ((front[ii] == 0.0) && !Uncrossed(object, true, skip));
+            bool accepted = false;
+            if ((front[ii] >= 0.0) && !entering) {
+                accepted = closest.Accept(object, front[ii], true,
+                                          retStopDistance);
+            } else if (((back[ii] > 0.0) ||
+                        ((back[ii] == 0.0) &&
+                         Uncrossed(object, false, skip))) &&
+                       (back[ii] <= retStopDistance))
+            {
+                accepted = closest.Accept(object, back[ii], false,
+                                          retStopDistance);
+            }
+            if (accepted) {
+                closest.pending = true;
+                found = object;
+            }
+        }
+    }
+    for (long object : objects.others) {
+        const ViewableBase& viewable = GetViewable(object);
+        double thisHitDistance;
+        VisiblePoint tempPoint;
+        bool hitFlag = viewable.FindIntersection(
+                start_pos, direction, retStopDistance, &thisHitDistance,
+                tempPoint, skip);
+        if (hitFlag && (thisHitDistance == 0.0) &&
+            tempPoint.IsFrontFacing() &&
+            !Uncrossed(object, true, skip))
+        {
+            // The ray has already entered the object here, so look for the
+            // next surface past the one that was found, through however many
+            // module instances it is inside of.
+            hitFlag = viewable.FindIntersection(
+                    start_pos, direction, retStopDistance, &thisHitDistance,
+                    tempPoint, tempPoint.GetSurface());
+        }
+        if (hitFlag && closest.Accept(object, thisHitDistance,
+                                      tempPoint.IsFrontFacing(),
+                                      retStopDistance))
+        {
+            closest.pending = false;
+            returnedPoint = tempPoint;
+            found = object;
+        }
+    }
+    return (found);
+}
+
+void SceneDescription::FinishHit(
+        const ClosestHit & closest, const VectorR3 & start_pos,
+        const VectorR3 & direction, VisiblePoint & returnedPoint) const
+{
+    if (closest.pending) {
+        const auto& box = static_cast<const ViewableParallelepiped&>(
+                GetViewable(closest.object));
+        box.MakeVisiblePoint(start_pos, direction, closest.distance,
+                             closest.front_face, returnedPoint);
+    }
+}
+
+long SceneDescription::SeekIntersection(const VectorR3& pos,
+                                        const VectorR3& direction,
+                                        double & hitDist,
+                                        VisiblePoint& returnedPoint,
+                                        const HitSurface& skip) const
+{
+    ClosestHit closest;
+    auto leaf_func = [&](long node, const std::vector<long>&,
+                         double & retStopDistance)
+    {
+        return (this->IntersectLeaf(node, pos, direction, retStopDistance,
+                                    skip, closest, returnedPoint));
+    };
+    kd_tree.Traverse(pos, direction, hitDist, leaf_func);
+    FinishHit(closest, pos, direction, returnedPoint);
+    return (closest.object);
 }
 
 long SceneDescription::SeekIntersection(const VectorR3& pos,
                                         const VectorR3& direction,
                                         double & hitDist,
-                                        VisiblePoint& returnedPoint) const
+                                        VisiblePoint& returnedPoint,
+                                        long & leaf,
+                                        const HitSurface& skip) const
 {
-    auto intersect_func = [this, &returnedPoint](long objectNum,
-                                                 const VectorR3 & start_pos,
-                                                 const VectorR3 & direction,
-                                                 double & retStopDistance)
+    ClosestHit closest;
+    auto leaf_func = [&](long node, const std::vector<long>&,
+                         double & retStopDistance)
     {
-        return (this->intersection_callback(objectNum, start_pos, direction,
-                                            retStopDistance, returnedPoint));
+        return (this->IntersectLeaf(node, pos, direction, retStopDistance,
+                                    skip, closest, returnedPoint));
     };
-    return(kd_tree.Traverse(pos, direction, hitDist, intersect_func));
+    kd_tree.TraverseRopes(pos, direction, hitDist, leaf_func, leaf);
+    FinishHit(closest, pos, direction, returnedPoint);
+    return (closest.object);
 }
 
 bool SceneDescription::TestOverlapSingle(VectorR3 & start, const VectorR3 & dir) const {
@@ -124,10 +335,12 @@ bool SceneDescription::TestOverlapSingle(VectorR3 & start, const VectorR3 & dir)
     VisiblePoint point;
     // negative return from Seek Intersection indicates it didn't run into
     // anything.
-    while (SeekIntersection(start, dir, hit_dist, point) >= 0) {
-        // Move the point to where we hit, plus an epsilon to make sure we don't
-        // hit the same place again.
-        start += (hit_dist + ray_trace_epsilon) * dir;
+    while (SeekIntersection(start, dir, hit_dist, point,
+                            point.GetSurface()) >= 0)
+    {
+        // Move the point to where we hit.  The surface hit is skipped in the
+        // next search, so we won't find it again.
+        start += hit_dist * dir;
         if (point.IsFrontFacing()) {
             // Front face means we are entering a material.
             mat_stack.push(point.GetMaterial());
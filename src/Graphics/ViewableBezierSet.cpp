@@ -40,8 +40,13 @@ void BpPushPatchToStack( BezierPatch*, double HitDistIn, double HitDistOut, int
 // intersectDistance and visPoint are returned values.
 bool ViewableBezierSet::FindIntersectionNT (
     const VectorR3& viewPos, const VectorR3& viewDir, double maxDist,
-    double *intersectDistance, VisiblePoint& returnedPoint ) const
+    double *intersectDistance, VisiblePoint& returnedPoint,
+    const HitSurface& skip ) const
 {
+    // Rays starting on the surface of a patch are not traced further.
+    if (skip.IsOn(this)) {
+        return false;
+    }
     // Start by computing bounding sphere if necessary
     if ( !BoundingSphereSet ) {
         (const_cast<ViewableBezierSet*>(this))->CalcBoundingSphere();
@@ -22,8 +22,15 @@ ViewableCone::ViewableCone()
 // intersectDistance and visPoint are returned values.
 bool ViewableCone::FindIntersectionNT (
     const VectorR3& viewPos, const VectorR3& viewDir, double maxDistance,
-    double *intersectDistance, VisiblePoint& returnedPoint ) const
+    double *intersectDistance, VisiblePoint& returnedPoint,
+    const HitSurface& skip ) const
 {
+    // A ray that starts on the back face is leaving, and can't hit this
+    // object again.  One that starts on the front face is inside of it.
+    if (skip.IsOn(this) && !skip.front_face) {
+        return false;
+    }
+    const bool entering = skip.IsOn(this);
 
     double maxFrontDist = -DBL_MAX;
     double minBackDist = DBL_MAX;
@@ -107,7 +114,7 @@ bool ViewableCone::FindIntersectionNT (
     // Put it all together:
 
     double alpha;
-    if ( maxFrontDist>=0.0 ) {
+    if ( maxFrontDist>=0.0 && !entering ) {
         if ( maxFrontDist >= maxDistance ) {
             return false;
         }
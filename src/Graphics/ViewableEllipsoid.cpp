@@ -18,8 +18,15 @@
 // intersectDistance and visPoint are returned values.
 bool ViewableEllipsoid::FindIntersectionNT (
     const VectorR3& viewPos, const VectorR3& viewDir, double maxDistance,
-    double *intersectDistance, VisiblePoint& returnedPoint ) const
+    double *intersectDistance, VisiblePoint& returnedPoint,
+    const HitSurface& skip ) const
 {
+    // A ray that starts on the back face is leaving, and can't hit this
+    // object again.  One that starts on the front face is inside of it.
+    if (skip.IsOn(this) && !skip.front_face) {
+        return false;
+    }
+    const bool entering = skip.IsOn(this);
     VectorR3 v = viewPos;
     v -= Center;
     double pdotuA = v^AxisA;
@@ -43,7 +50,7 @@ bool ViewableEllipsoid::FindIntersectionNT (
     if ( numRoots==0 ) {
         return false;
     }
-    if ( alpha1>0.0 ) {
+    if ( alpha1>=0.0 && !entering ) {
         if ( alpha1>=maxDistance ) {
             return false;				// Too far away
         }
@@ -0,0 +1,80 @@
+/*
+ * Gray: A Ray Tracing-based Monte Carlo Simulator for PET
+ *
+ * Copyright (c) 2018, David Freese, Peter Olcott, Sam Buss, Craig Levin
+ *
+ * This software is distributed under the terms of the MIT License unless
+ * otherwise noted.  See LICENSE for further details.
+ *
+ */
+
+#include "Gray/Graphics/ViewableInstance.h"
+#include "Gray/Graphics/SceneDescription.h"
+
+ViewableInstance::ViewableInstance(
+        std::shared_ptr<const SceneDescription> module,
+        const RigidMapR3& placement, int detector_offset) :
+    module(module),
+    placement(placement),
+    inverse(placement.Inverse()),
+    detector_offset(detector_offset)
+{
+    const AABB local = module->GetExtents();
+    const VectorR3& lo = local.GetBoxMin();
+    const VectorR3& hi = local.GetBoxMax();
+    for (int ii = 0; ii < 8; ++ii) {
+        VectorR3 corner((ii & 1) ? hi.x : lo.x,
+                        (ii & 2) ? hi.y : lo.y,
+                        (ii & 4) ? hi.z : lo.z);
+        placement.Transform(corner, &corners[ii]);
+    }
+}
+
+bool ViewableInstance::FindIntersectionNT (
+    const VectorR3& viewPos, const VectorR3& viewDir, double maxDistance,
+    double *intersectDistance, VisiblePoint& returnedPoint,
+    const HitSurface& skip ) const
+{
+    // The placement is rigid, so distances along the ray are the same in the
+    // module's coordinates as they are in the world's.
+    VectorR3 local_pos;
+    VectorR3 local_dir;
+    inverse.Transform(viewPos, &local_pos);
+    inverse.Transform3x3(viewDir, &local_dir);
+
+    // Only a surface found through this instance is one to skip inside of
+    // it, as the module's objects are shared with every other instance.
+    double hit_dist = maxDistance;
+    if (module->SeekIntersection(local_pos, local_dir, hit_dist, returnedPoint,
+                                 skip.IsOn(this) ? skip.Inner() :
+                                                   HitSurface()) < 0)
+    {
+        return false;
+    }
+    VectorR3 world_pos;
+    placement.Transform(returnedPoint.GetPosition(), &world_pos);
+    returnedPoint.SetPosition(world_pos);
+    if (returnedPoint.GetDetectorId() >= 0) {
+        returnedPoint.SetDetectorId(detector_offset +
+                                    returnedPoint.GetDetectorId());
+    }
+    *intersectDistance = hit_dist;
+    return true;
+}
+
+void ViewableInstance::CalcBoundingPlanes( const VectorR3& u,
+        double *minDot, double *maxDot ) const
+{
+    double mind = (u^corners[0]);
+    double maxd = mind;
+    for (int ii = 1; ii < 8; ++ii) {
+        double t = (u^corners[ii]);
+        if ( t<mind ) {
+            mind = t;
+        } else if ( t>maxd ) {
+            maxd = t;
+        }
+    }
+    *minDot = mind;
+    *maxDot = maxd;
+}
@@ -0,0 +1,367 @@
+/*
+ * Gray: A Ray Tracing-based Monte Carlo Simulator for PET
+ *
+ * Copyright (c) 2018, David Freese, Peter Olcott, Sam Buss, Craig Levin
+ *
+ * This software is distributed under the terms of the MIT License unless
+ * otherwise noted.  See LICENSE for further details.
+ *
+ */
+
+#include "Gray/Graphics/ViewableMesh.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+// The deepest the hierarchy can get while it is walked.  The tree is split at
+// the median, so this would take far more triangles than could be stored.
+constexpr int traverse_stack_size = 64;
+
+// Scales the far side of a box so that rounding in the box test can't lose a
+// triangle that lies on the box's face.  From Ize, "Robust BVH Ray
+// Traversal".
+constexpr double box_far_scale = 1.0 + 4.0 * DBL_EPSILON;
+
+/*!
+ * Finds the distance at which the ray enters the box, if it does so before
+ * maxDistance.  Where a component of the direction is zero, invDir is
+ * infinite, and the NaN from a ray starting on that face is ignored by min
+ * and max, which is conservative.
+ */
+bool BoxEntry(const AABB& box, const VectorR3& pos, const VectorR3& invDir,
+              double maxDistance, double& entry)
+{
+    const VectorR3& lo = box.GetBoxMin();
+    const VectorR3& hi = box.GetBoxMax();
+    double near = 0.0;
+    double far = maxDistance;
+    const double los[3] = {lo.x, lo.y, lo.z};
+    const double his[3] = {hi.x, hi.y, hi.z};
+    const double ps[3] = {pos.x, pos.y, pos.z};
+    const double invs[3] = {invDir.x, invDir.y, invDir.z};
+    for (int axis = 0; axis < 3; ++axis) {
+        double t0 = (los[axis] - ps[axis]) * invs[axis];
+        double t1 = (his[axis] - ps[axis]) * invs[axis];
+        if (t0 > t1) {
+            std::swap(t0, t1);
+        }
+        near = std::max(near, t0);
+        far = std::min(far, t1 * box_far_scale);
+    }
+    entry = near;
+    return (near <= far);
+}
+}
+
+ViewableMesh::ViewableMesh(const std::vector<VectorR3>& vertices,
+                           const std::vector<Triangle>& triangles) :
+    vertices(vertices),
+    triangles(triangles)
+{
+    if (triangles.empty()) {
+        throw std::runtime_error("ViewableMesh requires at least one triangle");
+    }
+    for (const Triangle& tri: triangles) {
+        for (uint32_t idx: tri) {
+            if (idx >= vertices.size()) {
+                throw std::runtime_error(
+                        "ViewableMesh triangle has an invalid vertex index");
+            }
+        }
+    }
+    std::vector<VectorR3> centroids(triangles.size());
+    for (size_t ii = 0; ii < triangles.size(); ++ii) {
+        const Triangle& tri = triangles[ii];
+        centroids[ii] = (vertices[tri[0]] + vertices[tri[1]] +
+                         vertices[tri[2]]) / 3.0;
+    }
+    // Build over an ordering of the triangles, then put the triangles in that
+    // order so that each leaf refers to a contiguous range of them.
+    std::vector<uint32_t> order(triangles.size());
+    std::iota(order.begin(), order.end(), 0);
+    nodes.reserve(2 * (triangles.size() / max_leaf_size + 1));
+    Build(0, static_cast<uint32_t>(triangles.size()), order, centroids);
+    for (size_t ii = 0; ii < order.size(); ++ii) {
+        this->triangles[ii] = triangles[order[ii]];
+    }
+}
+
+AABB ViewableMesh::TriangleBox(const Triangle& tri) const
+{
+    const VectorR3& a = vertices[tri[0]];
+    const VectorR3& b = vertices[tri[1]];
+    const VectorR3& c = vertices[tri[2]];
+    return (AABB(VectorR3(std::min({a.x, b.x, c.x}),
+                          std::min({a.y, b.y, c.y}),
+                          std::min({a.z, b.z, c.z})),
+                 VectorR3(std::max({a.x, b.x, c.x}),
+                          std::max({a.y, b.y, c.y}),
+                          std::max({a.z, b.z, c.z}))));
+}
+
+/*!
+ * Builds the node for order[first, first + count), splitting at the median
+ * centroid along the axis in which the centroids are most spread out.
+ */
+uint32_t ViewableMesh::Build(uint32_t first, uint32_t count,
+                             std::vector<uint32_t>& order,
+                             const std::vector<VectorR3>& centroids)
+{
+    const uint32_t index = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back();
+
+    AABB box = TriangleBox(triangles[order[first]]);
+    VectorR3 cmin = centroids[order[first]];
+    VectorR3 cmax = cmin;
+    for (uint32_t ii = first + 1; ii < first + count; ++ii) {
+        box.EnlargeToEnclose(TriangleBox(triangles[order[ii]]));
+        const VectorR3& c = centroids[order[ii]];
+        cmin.Set(std::min(cmin.x, c.x), std::min(cmin.y, c.y),
+                 std::min(cmin.z, c.z));
+        cmax.Set(std::max(cmax.x, c.x), std::max(cmax.y, c.y),
+                 std::max(cmax.z, c.z));
+    }
+    nodes[index].box = box;
+
+    const VectorR3 spread = cmax - cmin;
+    int axis = 0;
+    if (spread.y > spread.x) {
+        axis = 1;
+    }
+    if (spread.z > std::max(spread.x, spread.y)) {
+        axis = 2;
+    }
+    // If every centroid is at the same point, there's no way to split them.
+    if ((count <= max_leaf_size) || (spread[axis] <= 0.0)) {
+        nodes[index].first = first;
+        nodes[index].count = count;
+        return (index);
+    }
+
+    const uint32_t half = count / 2;
+    std::nth_element(order.begin() + first, order.begin() + first + half,
+                     order.begin() + first + count,
+                     [&centroids, axis](uint32_t a, uint32_t b) {
+                         return (centroids[a][axis] < centroids[b][axis]);
+                     });
+    Build(first, half, order, centroids);
+    const uint32_t second = Build(first + half, count - half, order,
+                                  centroids);
+    nodes[index].second_child = second;
+    return (index);
+}
+
+// Returns an intersection if found with distance maxDistance
+// viewDir must be a unit vector.
+// intersectDistance and visPoint are returned values.
+bool ViewableMesh::FindIntersectionNT (
+    const VectorR3& viewPos, const VectorR3& viewDir, double maxDistance,
+    double *intersectDistance, VisiblePoint& returnedPoint,
+    const HitSurface& skip ) const
+{
+    // The mesh is closed, so a ray that starts on it, having just entered,
+    // next hits a back face of it, and one that has just left next hits a
+    // front face.  Requiring that skips the triangle the ray starts on, and
+    // any that share the edge or vertex through which the ray crossed.
+    const bool on_mesh = skip.IsOn(this);
+
+    // Shear and scale the triangles so that the ray runs along +z from the
+    // origin.  x and y are swapped when z is negative to keep the winding.
+    const double dir[3] = {viewDir.x, viewDir.y, viewDir.z};
+    int kz = 0;
+    if (std::abs(dir[1]) > std::abs(dir[kz])) {
+        kz = 1;
+    }
+    if (std::abs(dir[2]) > std::abs(dir[kz])) {
+        kz = 2;
+    }
+    int kx = (kz + 1) % 3;
+    int ky = (kx + 1) % 3;
+    if (dir[kz] < 0.0) {
+        std::swap(kx, ky);
+    }
+    const double sx = dir[kx] / dir[kz];
+    const double sy = dir[ky] / dir[kz];
+    const double sz = 1.0 / dir[kz];
+    const VectorR3 invDir(1.0 / viewDir.x, 1.0 / viewDir.y, 1.0 / viewDir.z);
+
+    bool found = false;
+    double bestDist = maxDistance;
+    bool bestFront = false;
+
+    auto test_triangle = [&](const Triangle& tri) {
+        const VectorR3 a = vertices[tri[0]] - viewPos;
+        const VectorR3 b = vertices[tri[1]] - viewPos;
+        const VectorR3 c = vertices[tri[2]] - viewPos;
+        const double ax = a[kx] - sx * a[kz];
+        const double ay = a[ky] - sy * a[kz];
+        const double bx = b[kx] - sx * b[kz];
+        const double by = b[ky] - sy * b[kz];
+        const double cx = c[kx] - sx * c[kz];
+        const double cy = c[ky] - sy * c[kz];
+        double u = cx * by - cy * bx;
+        double v = ax * cy - ay * cx;
+        double w = bx * ay - by * ax;
+        // On an edge, recompute with more precision so that the triangles on
+        // either side of the edge agree on where it is.
+        if ((u == 0.0) || (v == 0.0) || (w == 0.0)) {
+            u = static_cast<double>((long double)cx * by - (long double)cy * bx);
+            v = static_cast<double>((long double)ax * cy - (long double)ay * cx);
+            w = static_cast<double>((long double)bx * ay - (long double)by * ax);
+        }
+        if (((u < 0.0) || (v < 0.0) || (w < 0.0)) &&
+            ((u > 0.0) || (v > 0.0) || (w > 0.0)))
+        {
+            return;
+        }
+        const double det = u + v + w;
+        if (det == 0.0) {
+            return;
+        }
+        const double t = (u * sz * a[kz] + v * sz * b[kz] +
+                          w * sz * c[kz]) / det;
+        // Counter-clockwise seen from the ray's start is clockwise in the
+        // sheared x-y plane, which gives a positive determinant.
+        const bool front = (det > 0.0);
+        if (on_mesh) {
+            if ((front == skip.front_face) || !(t > 0.0)) {
+                return;
+            }
+        } else if (front ? (t < 0.0) : (t <= 0.0)) {
+            return;
+        }
+        // Match the other primitives against maxDistance, and prefer a back
+        // face where two are at the same distance.
+        if (!found) {
+            if (front ? (t > bestDist) : (t >= bestDist)) {
+                return;
+            }
+        } else if ((t > bestDist) ||
+                   ((t == bestDist) && !(bestFront && !front)))
+        {
+            return;
+        }
+        found = true;
+        bestDist = t;
+        bestFront = front;
+    };
+
+    uint32_t stack[traverse_stack_size];
+    double stack_entry[traverse_stack_size];
+    int stack_size = 0;
+    double entry;
+    if (BoxEntry(nodes[0].box, viewPos, invDir, bestDist, entry)) {
+        stack[stack_size] = 0;
+        stack_entry[stack_size++] = entry;
+    }
+    while (stack_size > 0) {
+        --stack_size;
+        if (stack_entry[stack_size] > bestDist) {
+            continue;
+        }
+        const Node& node = nodes[stack[stack_size]];
+        if (node.count > 0) {
+            for (uint32_t ii = node.first; ii < node.first + node.count; ++ii) {
+                test_triangle(triangles[ii]);
+            }
+            continue;
+        }
+        // Visit the nearer child first, by pushing it last.
+        const uint32_t first_child = stack[stack_size] + 1;
+        double first_entry, second_entry;
+        bool first_hit = BoxEntry(nodes[first_child].box, viewPos, invDir,
+                                  bestDist, first_entry);
+        bool second_hit = BoxEntry(nodes[node.second_child].box, viewPos,
+                                   invDir, bestDist, second_entry);
+        if (first_hit && second_hit && (first_entry < second_entry)) {
+            stack[stack_size] = node.second_child;
+            stack_entry[stack_size++] = second_entry;
+            second_hit = false;
+        }
+        if (first_hit) {
+            stack[stack_size] = first_child;
+            stack_entry[stack_size++] = first_entry;
+        }
+        if (second_hit) {
+            stack[stack_size] = node.second_child;
+            stack_entry[stack_size++] = second_entry;
+        }
+    }
+    if (!found) {
+        return false;
+    }
+
+    *intersectDistance = bestDist;
+    VectorR3 v = viewDir;
+    v *= bestDist;
+    v += viewPos;
+    returnedPoint.SetPosition(v);
+    if (bestFront) {
+        returnedPoint.SetFrontFace();
+        returnedPoint.SetMaterial(ViewableBase::GetMaterialBack());
+    } else {
+        returnedPoint.SetBackFace();
+        returnedPoint.SetMaterial(ViewableBase::GetMaterialFront());
+    }
+    return true;
+}
+
+void ViewableMesh::CalcBoundingPlanes( const VectorR3& u, double *minDot, double *maxDot ) const
+{
+    double mind = DBL_MAX;
+    double maxd = -DBL_MAX;
+    for (const VectorR3& vertex: vertices) {
+        double t = (u^vertex);
+        mind = std::min(mind, t);
+        maxd = std::max(maxd, t);
+    }
+    *minDot = mind;
+    *maxDot = maxd;
+}
+
+void ViewableMesh::CalcAABB( AABB& retAABB ) const
+{
+    retAABB = nodes[0].box;
+}
+
+bool ViewableMesh::CalcExtentsInBox( const AABB& boundingAABB, AABB& retAABB ) const
+{
+    retAABB.Set(VectorR3(DBL_MAX, DBL_MAX, DBL_MAX),
+                VectorR3(-DBL_MAX, -DBL_MAX, -DBL_MAX));
+    ExtentsInBox(0, boundingAABB, retAABB);
+    return (!retAABB.IsEmpty());
+}
+
+/*!
+ * Encloses the part of each triangle's box that is within boundingAABB, for
+ * the triangles under node.  Triangle boxes are used rather than clipping
+ * each triangle, as a mesh can have far more triangles than there are nodes
+ * in the scene's KdTree.
+ */
+void ViewableMesh::ExtentsInBox(uint32_t node, const AABB& boundingAABB,
+                                AABB& retAABB) const
+{
+    AABB overlap = nodes[node].box;
+    overlap.IntersectAgainst(boundingAABB);
+    if (overlap.IsEmpty()) {
+        return;
+    }
+    if (nodes[node].count == 0) {
+        ExtentsInBox(node + 1, boundingAABB, retAABB);
+        ExtentsInBox(nodes[node].second_child, boundingAABB, retAABB);
+        return;
+    }
+    for (uint32_t ii = nodes[node].first;
+         ii < nodes[node].first + nodes[node].count; ++ii)
+    {
+        AABB box = TriangleBox(triangles[ii]);
+        box.IntersectAgainst(boundingAABB);
+        if (!box.IsEmpty()) {
+            retAABB.EnlargeToEnclose(box);
+        }
+    }
+}
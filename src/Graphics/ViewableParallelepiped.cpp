@@ -146,8 +146,15 @@ bool DoTwoPlanesCheck(
 // intersectDistance and visPoint are returned values.
 bool ViewableParallelepiped::FindIntersectionNT (
     const VectorR3& viewPos, const VectorR3& viewDir, double maxDistance,
-    double *intersectDistance, VisiblePoint& returnedPoint ) const
+    double *intersectDistance, VisiblePoint& returnedPoint,
+    const HitSurface& skip ) const
 {
+    // A ray that starts on the back face is leaving, and can't hit this
+    // object again.  One that starts on the front face is inside of it.
+    if (skip.IsOn(this) && !skip.front_face) {
+        return false;
+    }
+    const bool entering = skip.IsOn(this);
     double maxFrontDist = -DBL_MAX;
     int frontFaceNum;
     double minBackDist = DBL_MAX;
@@ -168,7 +175,7 @@ bool ViewableParallelepiped::FindIntersectionNT (
     }
 
     double alpha;
-    if ( maxFrontDist>0.0 ) {
+    if ( maxFrontDist>=0.0 && !entering ) {
         alpha = maxFrontDist;
         returnedPoint.SetFrontFace();
         returnedPoint.SetMaterial(ViewableBase::GetMaterialBack());
@@ -189,6 +196,27 @@ bool ViewableParallelepiped::FindIntersectionNT (
     return true;
 }
 
+void ViewableParallelepiped::MakeVisiblePoint(
+    const VectorR3& viewPos, const VectorR3& viewDir, double alpha,
+    bool frontFace, VisiblePoint& returnedPoint) const
+{
+    if (frontFace) {
+        returnedPoint.SetFrontFace();
+        returnedPoint.SetMaterial(ViewableBase::GetMaterialBack());
+    } else {
+        returnedPoint.SetBackFace();
+        returnedPoint.SetMaterial(ViewableBase::GetMaterialFront());
+    }
+    VectorR3 v = viewDir;
+    v *= alpha;
+    v += viewPos;
+    returnedPoint.SetPosition(v);
+    returnedPoint.SetDetectorId(GetDetectorId());
+    returnedPoint.SetObject(this);
+    returnedPoint.ClearSurface();
+    returnedPoint.AddOuterObject(this);
+}
+
 void ViewableParallelepiped::CalcBoundingPlanes( const VectorR3& u,
         double *minDot, double *maxDot ) const
 {
@@ -17,8 +17,15 @@
 // intersectDistance and visPoint are returned values.
 bool ViewableSphere::FindIntersectionNT (
     const VectorR3& viewPos, const VectorR3& viewDir, double maxDist,
-    double *intersectDistance, VisiblePoint& returnedPoint ) const
+    double *intersectDistance, VisiblePoint& returnedPoint,
+    const HitSurface& skip ) const
 {
+    // A ray that starts on the back face is leaving, and can't hit this
+    // object again.  One that starts on the front face is inside of it.
+    if (skip.IsOn(this) && !skip.front_face) {
+        return false;
+    }
+    const bool entering = skip.IsOn(this);
     VectorR3 tocenter(Center);
     tocenter -= viewPos;		// Vector view position to the center
 
@@ -37,7 +44,7 @@ bool ViewableSphere::FindIntersectionNT (
     }
 
     double BSq = RadiusSq-ASq;
-    if ( D>0.0 && D*D>BSq &&
+    if ( !entering && D>0.0 && D*D>=BSq &&
             (D<maxDist || BSq>Square(D-maxDist) ) ) {
 
         // Return the point where view intersects with the outside of
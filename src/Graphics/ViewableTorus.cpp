@@ -91,8 +91,12 @@ inline bool ViewableTorus::CollideTwoPlanes(
 bool ViewableTorus::FindIntersectionNT (
     const VectorR3& viewPos, const VectorR3& viewDir,
     double maxDistance, double *intersectDistance,
-    VisiblePoint& returnedPoint ) const
+    VisiblePoint& returnedPoint, const HitSurface& skip ) const
 {
+    // Rays starting on the surface of a torus are not traced further.
+    if (skip.IsOn(this)) {
+        return false;
+    }
 
     // Precheck for collisions by
     //	checking if passes to within a bounding box
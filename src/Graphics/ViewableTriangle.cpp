@@ -48,8 +48,13 @@ void ViewableTriangle::PreCalcInfo()
 // intersectDistance and visPoint are returned values.
 bool ViewableTriangle::FindIntersectionNT (
     const VectorR3& viewPos, const VectorR3& viewDir, double maxDistance,
-    double *intersectDistance, VisiblePoint& returnedPoint ) const
+    double *intersectDistance, VisiblePoint& returnedPoint,
+    const HitSurface& skip ) const
 {
+    // A ray can't cross a plane twice.
+    if (skip.IsOn(this)) {
+        return false;
+    }
     double mdotn = (viewDir^Normal);
     double planarDist = (viewPos^Normal)-PlaneCoef;
 
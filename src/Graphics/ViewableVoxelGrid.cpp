@@ -0,0 +1,268 @@
+/*
+ * Gray: A Ray Tracing-based Monte Carlo Simulator for PET
+ *
+ * Copyright (c) 2018, David Freese, Peter Olcott, Sam Buss, Craig Levin
+ *
+ * This software is distributed under the terms of the MIT License unless
+ * otherwise noted.  See LICENSE for further details.
+ *
+ */
+
+#include "Gray/Graphics/ViewableVoxelGrid.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+ViewableVoxelGrid::ViewableVoxelGrid(
+        const Dims& dims, const std::vector<uint8_t>& labels,
+        const std::vector<const Material*>& label_materials,
+        const VectorR3& size, const RigidMapR3& local_to_global) :
+    dims(dims),
+    labels(labels),
+    materials(256, nullptr),
+    size(size),
+    voxel_size(size.x / dims[0], size.y / dims[1], size.z / dims[2]),
+    local_to_global(local_to_global),
+    global_to_local(local_to_global.Inverse())
+{
+    if ((dims[0] < 1) || (dims[1] < 1) || (dims[2] < 1)) {
+        throw std::runtime_error("ViewableVoxelGrid requires at least one voxel");
+    }
+    if (labels.size() != static_cast<size_t>(dims[0]) * dims[1] * dims[2]) {
+        throw std::runtime_error(
+                "ViewableVoxelGrid labels do not match its dimensions");
+    }
+    std::copy_n(label_materials.begin(),
+                std::min(label_materials.size(), materials.size()),
+                materials.begin());
+}
+
+/*!
+ * Finds the voxel containing a point in local coordinates, putting points
+ * just outside of the grid in the closest voxel.
+ */
+ViewableVoxelGrid::Dims ViewableVoxelGrid::VoxelAt(
+        const VectorR3& local_pos) const
+{
+    Dims voxel;
+    for (int axis = 0; axis < 3; ++axis) {
+        const double u = (local_pos[axis] + size[axis] / 2.0) /
+                         voxel_size[axis];
+        voxel[axis] = std::min(std::max(static_cast<int>(std::floor(u)), 0),
+                               dims[axis] - 1);
+    }
+    return (voxel);
+}
+
+const Material* ViewableVoxelGrid::GetMaterialAt(const VectorR3& pos) const
+{
+    const VectorR3 local_pos = global_to_local * pos;
+    for (int axis = 0; axis < 3; ++axis) {
+        if (std::abs(local_pos[axis]) > size[axis] / 2.0) {
+            return (nullptr);
+        }
+    }
+    return (VoxelMaterial(VoxelAt(local_pos)));
+}
+
+bool ViewableVoxelGrid::Hit(
+        const VectorR3& viewPos, const VectorR3& viewDir, double dist,
+        bool front_face, const Material* material, long element,
+        double *intersectDistance, VisiblePoint& returnedPoint) const
+{
+    *intersectDistance = dist;
+    returnedPoint.SetPosition(viewPos + dist * viewDir);
+    if (front_face) {
+        returnedPoint.SetFrontFace();
+    } else {
+        returnedPoint.SetBackFace();
+    }
+    returnedPoint.SetMaterial(material);
+    returnedPoint.SetSurfaceElement(element);
+    return (true);
+}
+
+// Returns an intersection if found with distance maxDistance
+// viewDir must be a unit vector.
+// intersectDistance and visPoint are returned values.
+bool ViewableVoxelGrid::FindIntersectionNT (
+    const VectorR3& viewPos, const VectorR3& viewDir, double maxDistance,
+    double *intersectDistance, VisiblePoint& returnedPoint,
+    const HitSurface& skip ) const
+{
+    const VectorR3 pos = global_to_local * viewPos;
+    VectorR3 dir = viewDir;
+    global_to_local.Transform3x3(&dir);
+
+    if (delta_material) {
+        // Just a box: in through the front, and out through the back.
+        const bool entered = skip.IsOn(this);
+        if (entered && !skip.front_face) {
+            return (false);
+        }
+        double near;
+        double far;
+        if (!BoxIntersection(pos, dir, near, far)) {
+            return (false);
+        }
+        const bool front_face = (near > 0.0) && !entered;
+        const double dist = front_face ? near : far;
+        if (dist >= maxDistance) {
+            return (false);
+        }
+        return (Hit(viewPos, viewDir, dist, front_face, delta_material.get(),
+                    -1, intersectDistance, returnedPoint));
+    }
+
+    Dims voxel;
+    // The material of the voxel the ray is in, nullptr when it is empty or
+    // the ray is outside of the grid.
+    const Material* current;
+    double dist = 0.0;
+    if (skip.IsOn(this)) {
+        // Having left the grid, the ray can't come back into the box.
+        if (skip.element < 0) {
+            return (false);
+        }
+        voxel = {static_cast<int>(skip.element / (dims[1] * dims[2])),
+                 static_cast<int>((skip.element / dims[2]) % dims[1]),
+                 static_cast<int>(skip.element % dims[2])};
+        const Material* entered = VoxelMaterial(voxel);
+        if (!skip.front_face && entered) {
+            // The ray just left the material of the last voxel, so enter the
+            // next one from the same point.
+            return (Hit(viewPos, viewDir, 0.0, true, entered, skip.element,
+                        intersectDistance, returnedPoint));
+        }
+        current = entered;
+    } else {
+        double near;
+        double far;
+        if (!BoxIntersection(pos, dir, near, far) || (near >= maxDistance)) {
+            return (false);
+        }
+        voxel = VoxelAt(pos + near * dir);
+        current = VoxelMaterial(voxel);
+        if ((near > 0.0) && current) {
+            return (Hit(viewPos, viewDir, near, true, current, Index(voxel),
+                        intersectDistance, returnedPoint));
+        }
+        dist = near;
+    }
+
+    // Walk from voxel to voxel, after Amanatides and Woo, "A Fast Voxel
+    // Traversal Algorithm for Ray Tracing".  next_cross is the distance at
+    // which the ray leaves the current voxel along each axis.
+    int step[3];
+    double next_cross[3];
+    double cross_delta[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        if (dir[axis] == 0.0) {
+            step[axis] = 0;
+            next_cross[axis] = DBL_MAX;
+            cross_delta[axis] = DBL_MAX;
+            continue;
+        }
+        step[axis] = (dir[axis] > 0.0) ? 1 : -1;
+        const int boundary = voxel[axis] + ((step[axis] > 0) ? 1 : 0);
+        const double boundary_pos = boundary * voxel_size[axis] -
+                                    size[axis] / 2.0;
+        next_cross[axis] = (boundary_pos - pos[axis]) / dir[axis];
+        cross_delta[axis] = voxel_size[axis] / std::abs(dir[axis]);
+    }
+    while (true) {
+        int axis = 0;
+        if (next_cross[1] < next_cross[axis]) {
+            axis = 1;
+        }
+        if (next_cross[2] < next_cross[axis]) {
+            axis = 2;
+        }
+        // Rounding can put a crossing just behind where the walk started.
+        dist = std::max(dist, next_cross[axis]);
+        if (dist >= maxDistance) {
+            return (false);
+        }
+        voxel[axis] += step[axis];
+        next_cross[axis] += cross_delta[axis];
+        if ((voxel[axis] < 0) || (voxel[axis] >= dims[axis])) {
+            if (!current) {
+                return (false);
+            }
+            return (Hit(viewPos, viewDir, dist, false, current, -1,
+                        intersectDistance, returnedPoint));
+        }
+        const Material* next = VoxelMaterial(voxel);
+        if (next == current) {
+            continue;
+        }
+        if (current) {
+            return (Hit(viewPos, viewDir, dist, false, current, Index(voxel),
+                        intersectDistance, returnedPoint));
+        }
+        return (Hit(viewPos, viewDir, dist, true, next, Index(voxel),
+                    intersectDistance, returnedPoint));
+    }
+}
+
+/*!
+ * Clips a ray in local coordinates against the box of the grid, returning
+ * false if it misses.  near is zero if the ray starts inside.
+ */
+bool ViewableVoxelGrid::BoxIntersection(const VectorR3& pos,
+                                        const VectorR3& dir,
+                                        double& near, double& far) const
+{
+    near = 0.0;
+    far = DBL_MAX;
+    for (int axis = 0; axis < 3; ++axis) {
+        const double half = size[axis] / 2.0;
+        if (dir[axis] == 0.0) {
+            if (std::abs(pos[axis]) > half) {
+                return (false);
+            }
+            continue;
+        }
+        double t0 = (-half - pos[axis]) / dir[axis];
+        double t1 = (half - pos[axis]) / dir[axis];
+        if (t0 > t1) {
+            std::swap(t0, t1);
+        }
+        near = std::max(near, t0);
+        far = std::min(far, t1);
+    }
+    return (near <= far);
+}
+
+void ViewableVoxelGrid::CalcBoundingPlanes( const VectorR3& u,
+        double *minDot, double *maxDot ) const
+{
+    double mind = DBL_MAX;
+    double maxd = -DBL_MAX;
+    for (int corner = 0; corner < 8; ++corner) {
+        const VectorR3 local((corner & 1) ? size.x / 2.0 : -size.x / 2.0,
+                             (corner & 2) ? size.y / 2.0 : -size.y / 2.0,
+                             (corner & 4) ? size.z / 2.0 : -size.z / 2.0);
+        const double dot = u ^ (local_to_global * local);
+        mind = std::min(mind, dot);
+        maxd = std::max(maxd, dot);
+    }
+    *minDot = mind;
+    *maxDot = maxd;
+}
+
+bool ViewableVoxelGrid::ValuesToLabels(const std::vector<double>& values,
+                                       std::vector<uint8_t>& labels)
+{
+    labels.resize(values.size());
+    for (size_t idx = 0; idx < values.size(); ++idx) {
+        const double val = values[idx];
+        if (!(val >= 0) || (val > 255) || (val != std::floor(val))) {
+            return (false);
+        }
+        labels[idx] = static_cast<uint8_t>(val);
+    }
+    return (true);
+}
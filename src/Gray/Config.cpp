@@ -200,7 +200,8 @@ bool Config::get_log_coinc() const {
 }
 
 bool Config::get_log_any() const {
-    return(get_log_hits() || get_log_singles() || get_log_coinc());
+    return(get_log_hits() || get_log_singles() || get_log_coinc() ||
+           get_log_phase_space());
 }
 
 void Config::usage() {
@@ -504,7 +505,10 @@ void Config::set_hits_var_output_write_flags(const Output::WriteFlags & mask) {
 }
 
 Output::WriteFlags Config::get_hits_var_output_write_flags() const {
-    return(hits_var_output_write_flags);
+    Output::WriteFlags flags = hits_var_output_write_flags;
+    // Weighted events can't be counted without their weight.
+    flags.weight |= get_weighted();
+    return(flags);
 }
 
 bool Config::set_singles_var_output_write_flags(const std::string & mask) {
@@ -524,7 +528,9 @@ void Config::set_singles_var_output_write_flags(const Output::WriteFlags & mask)
 }
 
 Output::WriteFlags Config::get_singles_var_output_write_flags() const {
-    return(singles_var_output_write_flags);
+    Output::WriteFlags flags = singles_var_output_write_flags;
+    flags.weight |= get_weighted();
+    return(flags);
 }
 
 
@@ -545,7 +551,87 @@ void Config::set_coinc_var_output_write_flags(const Output::WriteFlags & mask) {
 }
 
 Output::WriteFlags Config::get_coinc_var_output_write_flags() const {
-    return(coinc_var_output_write_flags);
+    Output::WriteFlags flags = coinc_var_output_write_flags;
+    flags.weight |= get_weighted();
+    return(flags);
+}
+
+void Config::set_emission_bias(double fraction) {
+    emission_bias = fraction;
+}
+
+double Config::get_emission_bias() const {
+    return(emission_bias);
+}
+
+void Config::set_russian_roulette(double energy, double survival) {
+    roulette_energy = energy;
+    roulette_survival = survival;
+}
+
+double Config::get_roulette_energy() const {
+    return(roulette_energy);
+}
+
+double Config::get_roulette_survival() const {
+    return(roulette_survival);
+}
+
+bool Config::set_decay_filter(const std::string& identifier) {
+    return (GammaRayTrace::ParseDecayFilter(identifier, decay_filter));
+}
+
+GammaRayTrace::DecayFilter Config::get_decay_filter() const {
+    return(decay_filter);
+}
+
+bool Config::set_hit_aggregation(const std::string& identifier) {
+    return (GammaRayTrace::ParseHitAggregation(identifier, hit_aggregation));
+}
+
+GammaRayTrace::HitAggregation Config::get_hit_aggregation() const {
+    return(hit_aggregation);
+}
+
+void Config::set_quasi_random(bool val) {
+    quasi_random = val;
+}
+
+bool Config::get_quasi_random() const {
+    return(quasi_random);
+}
+
+void Config::set_material_grid(bool val) {
+    material_grid = val;
+}
+
+bool Config::get_material_grid() const {
+    return(material_grid);
+}
+
+void Config::set_phase_space_out(
+        const std::string& filename,
+        std::shared_ptr<const PhaseSpace::Surface> surface)
+{
+    filename_phase_space = filename;
+    phase_space_surface = surface;
+}
+
+bool Config::get_log_phase_space() const {
+    return(!filename_phase_space.empty());
+}
+
+std::string Config::get_filename_phase_space() const {
+    return(filename_phase_space);
+}
+
+std::shared_ptr<const PhaseSpace::Surface>
+Config::get_phase_space_surface() const {
+    return(phase_space_surface);
+}
+
+bool Config::get_weighted() const {
+    return((emission_bias > 0) || (roulette_energy > 0));
 }
 
 void Config::add_filename_coinc(const std::string & name) {
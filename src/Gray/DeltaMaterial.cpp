@@ -0,0 +1,125 @@
+#include "Gray/Gray/DeltaMaterial.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include "Gray/Graphics/ViewableVoxelGrid.h"
+#include "Gray/Physics/Photon.h"
+#include "Gray/Random/Random.h"
+
+constexpr double DeltaMaterial::majorant_margin;
+constexpr int DeltaMaterial::splits_per_bin;
+
+DeltaMaterial::DeltaMaterial(
+        const ViewableVoxelGrid& grid,
+        const std::vector<const GammaMaterial*>& materials) :
+    GammaMaterial(-1, "delta_tracked", false, true, GammaStats()),
+    grid(grid),
+    materials(materials)
+{
+    for (const GammaMaterial* material: materials) {
+        const std::vector<double>& mat_energies =
+                material->GetStats().GetEnergies();
+        energies.insert(energies.end(), mat_energies.begin(),
+                        mat_energies.end());
+    }
+    std::sort(energies.begin(), energies.end());
+    energies.erase(std::unique(energies.begin(), energies.end()),
+                   energies.end());
+    if (energies.size() < 2) {
+        energies.clear();
+        return;
+    }
+
+    // With no tabulated energies between the ends of a bin, each attenuation
+    // is a sum of terms linear in log-log within it, so the log of the
+    // largest of them is convex in log energy, and the line in log-log
+    // between its values at the ends of the bin is never below it.  Each bin
+    // is split evenly in log energy to keep the line close.  The ends are
+    // also checked from just inside of the bin, so that a jump at an edge is
+    // counted on the side of the bin it belongs to, and the margin covers the
+    // rounding.
+    for (size_t idx = 0; idx < energies.size(); ++idx) {
+        const double log_energy = std::log(energies[idx]);
+        if (idx > 0) {
+            const double step = (log_energy - log_energies.back()) /
+                                splits_per_bin;
+            for (int split = 1; split < splits_per_bin; ++split) {
+                log_energies.push_back(log_energies.back() + step);
+            }
+        }
+        log_energies.push_back(log_energy);
+    }
+    energies.resize(log_energies.size());
+    for (size_t idx = 0; idx < energies.size(); ++idx) {
+        energies[idx] = std::exp(log_energies[idx]);
+    }
+    log_majorant_lo.resize(energies.size() - 1);
+    log_majorant_hi.resize(energies.size() - 1);
+    for (size_t bin = 0; bin < energies.size() - 1; ++bin) {
+        const double inside = 0.001 * (log_energies[bin + 1] -
+                                       log_energies[bin]);
+        log_majorant_lo[bin] = std::log(std::max(
+                DirectMajorant(energies[bin]),
+                DirectMajorant(std::exp(log_energies[bin] + inside))));
+        log_majorant_hi[bin] = std::log(std::max(
+                DirectMajorant(energies[bin + 1]),
+                DirectMajorant(std::exp(log_energies[bin + 1] - inside))));
+    }
+}
+
+double DeltaMaterial::DirectMajorant(double photon_energy) const {
+    double majorant = 0;
+    for (const GammaMaterial* material: materials) {
+        majorant = std::max(majorant, material->Attenuation(photon_energy));
+    }
+    return (majorant * majorant_margin);
+}
+
+double DeltaMaterial::Majorant(double photon_energy) const {
+    // Outside of the tables, just find it directly.
+    if (energies.empty() || (photon_energy < energies.front()) ||
+        (photon_energy >= energies.back()))
+    {
+        return (DirectMajorant(photon_energy));
+    }
+    const size_t bin = std::upper_bound(energies.begin(), energies.end(),
+                                        photon_energy) - energies.begin() - 1;
+    const double frac = (std::log(photon_energy) - log_energies[bin]) /
+                        (log_energies[bin + 1] - log_energies[bin]);
+    return (std::exp(log_majorant_lo[bin] + frac *
+                     (log_majorant_hi[bin] - log_majorant_lo[bin])));
+}
+
+double DeltaMaterial::Distance(double photon_energy,
+                               GammaStats::AttenLengths&) const
+{
+    const double majorant = Majorant(photon_energy);
+    if (majorant <= 0) {
+        return (DBL_MAX);
+    }
+    return (Random::Exponential(majorant));
+}
+
+const GammaMaterial* DeltaMaterial::InteractionMaterial(
+        const Photon& photon, GammaStats::AttenLengths& len) const
+{
+    const GammaMaterial& local = MaterialAt(photon.GetPos());
+    if ((&local == this) || !local.InteractionsEnabled()) {
+        return (nullptr);
+    }
+    const double energy = photon.GetEnergy();
+    len = local.GetStats().GetAttenLengths(energy);
+    if (Random::Uniform() * Majorant(energy) < len.total()) {
+        return (&local);
+    }
+    return (nullptr);
+}
+
+const GammaMaterial& DeltaMaterial::MaterialAt(const VectorR3& pos) const {
+    const Material* local = grid.GetMaterialAt(pos);
+    if (!local) {
+        // Only from rounding, right at the edge of the phantom.
+        return (*this);
+    }
+    return (*static_cast<const GammaMaterial*>(local));
+}
@@ -0,0 +1,370 @@
+/*
+ * Gray: A Ray Tracing-based Monte Carlo Simulator for PET
+ *
+ * Copyright (c) 2018, David Freese, Peter Olcott, Sam Buss, Craig Levin
+ *
+ * This software is distributed under the terms of the MIT License unless
+ * otherwise noted.  See LICENSE for further details.
+ *
+ */
+
+#include "Gray/Gray/DetectorResponse.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include "Gray/Gray/GammaMaterial.h"
+#include "Gray/Output/DetectorArray.h"
+#include "Gray/Physics/Interaction.h"
+#include "Gray/Physics/Photon.h"
+#include "Gray/Random/Random.h"
+#include "Gray/VrMath/MathMisc.h"
+
+namespace {
+constexpr char magic[8] = {'G', 'R', 'A', 'Y', 'D', 'R', 'S', 'P'};
+constexpr uint32_t version = 1;
+constexpr uint32_t byte_order_mark = 0x01020304;
+constexpr int total_histories = (DetectorResponse::energy_bins *
+                                 DetectorResponse::histories_per_bin);
+
+/*!
+ * The distance along dir until pos leaves the box from -half to half.
+ */
+double ExitDistance(const VectorR3& pos, const VectorR3& dir,
+                    const VectorR3& half)
+{
+    double dist = DBL_MAX;
+    for (int axis = 0; axis < 3; ++axis) {
+        if (dir[axis] > 0) {
+            dist = std::min(dist, (half[axis] - pos[axis]) / dir[axis]);
+        } else if (dir[axis] < 0) {
+            dist = std::min(dist, (-half[axis] - pos[axis]) / dir[axis]);
+        }
+    }
+    return (std::max(dist, 0.0));
+}
+
+bool SameSize(const VectorR3& a, const VectorR3& b) {
+    return ((std::abs(a.x - b.x) < 1e-6) && (std::abs(a.y - b.y) < 1e-6) &&
+            (std::abs(a.z - b.z) < 1e-6));
+}
+}
+
+constexpr int DetectorResponse::escape;
+constexpr int DetectorResponse::max_hits;
+constexpr double DetectorResponse::min_energy;
+constexpr double DetectorResponse::max_energy;
+constexpr int DetectorResponse::energy_bins;
+constexpr int DetectorResponse::histories_per_bin;
+constexpr int DetectorResponse::sample_window;
+
+struct DetectorResponse::FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t step_size;
+    uint32_t no_histories;
+    uint32_t no_steps;
+    uint32_t reserved;
+    char material[64];
+    double size[3];
+    double energy_cutoff;
+    // The attenuation at each edge of the energy bins, so that a table built
+    // with different physics isn't used.
+    double attenuation[energy_bins + 1];
+};
+
+DetectorResponse::DetectorResponse(const DetectorArray& detectors) :
+    crystals(detectors.NumDetectors())
+{
+    for (size_t idx = 0; idx < crystals.size(); ++idx) {
+        const Detector& det = detectors.GetDetector(idx);
+        Crystal& crystal = crystals[idx];
+        crystal.center = det.pos;
+        crystal.half_size = det.size / 2.0;
+        const VectorR3 unit[3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+        for (int axis = 0; axis < 3; ++axis) {
+            det.map.Transform3x3(unit[axis], &crystal.axes[axis]);
+        }
+    }
+}
+
+bool DetectorResponse::AddCrystalType(const CrystalType& type, bool& built) {
+    Table table;
+    table.material = type.material;
+    table.size = type.size;
+    built = false;
+    std::ifstream input(type.filename, std::ios::binary);
+    if (!table.Read(input)) {
+        table.Build();
+        built = true;
+        std::ofstream output(type.filename, std::ios::binary);
+        if (!table.Write(output)) {
+            return (false);
+        }
+    }
+    // A table replaces any for the same type, so each crystal has at most one
+    // per material.
+    size_t table_idx = 0;
+    while ((table_idx < tables.size()) &&
+           ((tables[table_idx].material != type.material) ||
+            !SameSize(tables[table_idx].size, type.size)))
+    {
+        ++table_idx;
+    }
+    if (table_idx == tables.size()) {
+        tables.push_back(std::move(table));
+    } else {
+        tables[table_idx] = std::move(table);
+    }
+    for (Crystal& crystal: crystals) {
+        if (SameSize(2.0 * crystal.half_size, type.size) &&
+            (std::find(crystal.tables.begin(), crystal.tables.end(),
+                       table_idx) == crystal.tables.end()))
+        {
+            crystal.tables.push_back(table_idx);
+        }
+    }
+    return (true);
+}
+
+size_t DetectorResponse::NumCrystals() const {
+    return (std::count_if(crystals.begin(), crystals.end(),
+                          [](const Crystal& c) { return (!c.tables.empty()); }));
+}
+
+double DetectorResponse::EnergyBinEdge(int bin) {
+    return (min_energy * std::pow(max_energy / min_energy,
+                                  static_cast<double>(bin) / energy_bins));
+}
+
+/*!
+ * Traces a photon from the origin along z through an unbounded block of
+ * material, appending each of its interactions to steps, until it's absorbed
+ * or further than max_dist from the origin.
+ */
+void DetectorResponse::Calibrate(
+        const GammaMaterial& material, double max_dist, double energy,
+        std::vector<Step>& steps)
+{
+    Photon photon({0, 0, 0}, {0, 0, 1}, energy, 0, 0, Photon::P_BLUE, 0);
+    double path = 0;
+    for (int hit = 0; ; ++hit) {
+        GammaStats::AttenLengths atten;
+        const double dist = material.Distance(photon.GetEnergy(), atten);
+        photon.AddPos(dist * photon.GetDir());
+        path += dist;
+        int type = escape;
+        if (photon.GetPos().NormSq() <= max_dist * max_dist) {
+            if (hit == max_hits) {
+                photon.SetEnergy(0);
+                type = static_cast<int>(Interaction::Type::PHOTOELECTRIC);
+            } else {
+                type = static_cast<int>(material.Interact(photon, atten));
+                if (photon.GetEnergy() < material.GetEnergyCutoff()) {
+                    photon.SetEnergy(0);
+                }
+            }
+        }
+        Step step;
+        for (int axis = 0; axis < 3; ++axis) {
+            step.pos[axis] = static_cast<float>(photon.GetPos()[axis]);
+            step.dir[axis] = static_cast<float>(photon.GetDir()[axis]);
+        }
+        step.path = static_cast<float>(path);
+        step.energy = static_cast<float>(photon.GetEnergy() / energy);
+        step.type = type;
+        steps.push_back(step);
+        if ((type == escape) || (photon.GetEnergy() <= 0)) {
+            return;
+        }
+    }
+}
+
+/*!
+ * Traces histories_per_bin photons for each energy bin, spread evenly in log
+ * energy across the bin.  Histories are followed a little further than the
+ * crystal is across, as their distances are scaled when they are sampled.
+ */
+void DetectorResponse::Table::Build() {
+    first_step.clear();
+    steps.clear();
+    attenuation.clear();
+    const double max_dist = 1.25 * size.Norm();
+    for (int bin = 0; bin < energy_bins; ++bin) {
+        const double log_lo = std::log(EnergyBinEdge(bin));
+        const double log_hi = std::log(EnergyBinEdge(bin + 1));
+        for (int ii = 0; ii < histories_per_bin; ++ii) {
+            const double energy = std::exp(
+                    log_lo + (log_hi - log_lo) * (ii + 0.5) /
+                    histories_per_bin);
+            first_step.push_back(static_cast<uint32_t>(steps.size()));
+            attenuation.push_back(
+                    static_cast<float>(material->Attenuation(energy)));
+            Calibrate(*material, max_dist, energy, steps);
+        }
+    }
+    first_step.push_back(static_cast<uint32_t>(steps.size()));
+}
+
+void DetectorResponse::Table::MakeHeader(FileHeader& header) const {
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.byte_order = byte_order_mark;
+    header.step_size = sizeof(Step);
+    header.no_histories = total_histories;
+    const std::string name = material->GetName();
+    name.copy(header.material, sizeof(header.material) - 1);
+    header.size[0] = size.x;
+    header.size[1] = size.y;
+    header.size[2] = size.z;
+    header.energy_cutoff = material->GetEnergyCutoff();
+    for (int bin = 0; bin <= energy_bins; ++bin) {
+        header.attenuation[bin] = material->Attenuation(EnergyBinEdge(bin));
+    }
+}
+
+bool DetectorResponse::Table::Read(std::istream& input) {
+    FileHeader expected;
+    MakeHeader(expected);
+    FileHeader header;
+    if (!input.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        return (false);
+    }
+    const size_t no_steps = header.no_steps;
+    header.no_steps = 0;
+    if (std::memcmp(&header, &expected, sizeof(header)) != 0) {
+        return (false);
+    }
+    first_step.resize(total_histories + 1);
+    attenuation.resize(total_histories);
+    steps.resize(no_steps);
+    input.read(reinterpret_cast<char*>(first_step.data()),
+               first_step.size() * sizeof(uint32_t));
+    input.read(reinterpret_cast<char*>(attenuation.data()),
+               attenuation.size() * sizeof(float));
+    input.read(reinterpret_cast<char*>(steps.data()),
+               steps.size() * sizeof(Step));
+    if (!input || (first_step.back() != no_steps)) {
+        first_step.clear();
+        attenuation.clear();
+        steps.clear();
+        return (false);
+    }
+    return (true);
+}
+
+bool DetectorResponse::Table::Write(std::ostream& output) const {
+    FileHeader header;
+    MakeHeader(header);
+    header.no_steps = static_cast<uint32_t>(steps.size());
+    output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    output.write(reinterpret_cast<const char*>(first_step.data()),
+                 first_step.size() * sizeof(uint32_t));
+    output.write(reinterpret_cast<const char*>(attenuation.data()),
+                 attenuation.size() * sizeof(float));
+    output.write(reinterpret_cast<const char*>(steps.data()),
+                 steps.size() * sizeof(Step));
+    return (output.good());
+}
+
+int DetectorResponse::Sample(int det_id, const Material* material,
+                             const Photon& photon, Hits& hits) const
+{
+    if ((det_id < 0) || (det_id >= static_cast<int>(crystals.size()))) {
+        return (-1);
+    }
+    const Crystal& crystal = crystals[det_id];
+    const Table* found = nullptr;
+    for (size_t idx: crystal.tables) {
+        if (tables[idx].material == material) {
+            found = &tables[idx];
+        }
+    }
+    const double energy = photon.GetEnergy();
+    if (!found || (energy < min_energy) || (energy >= max_energy)) {
+        return (-1);
+    }
+    const Table& table = *found;
+    const int nearest = static_cast<int>(
+            std::log(energy / min_energy) /
+            std::log(max_energy / min_energy) * total_histories);
+    const int history = std::min(std::max(
+            nearest + static_cast<int>(
+                    (Random::Uniform() - 0.5) * sample_window), 0),
+            total_histories - 1);
+    // The distances of the history are for the energy it started with.
+    const double scale = (table.attenuation[history] /
+                          table.material->Attenuation(energy));
+
+    // Put the photon in the frame of the crystal.
+    const VectorR3 rel = photon.GetPos() - crystal.center;
+    const VectorR3 entry(rel ^ crystal.axes[0], rel ^ crystal.axes[1],
+                         rel ^ crystal.axes[2]);
+    const VectorR3 entry_dir(photon.GetDir() ^ crystal.axes[0],
+                             photon.GetDir() ^ crystal.axes[1],
+                             photon.GetDir() ^ crystal.axes[2]);
+
+    // Spin the history by a random angle about z, as the same history is
+    // used for many photons, and then turn z onto the photon's direction.
+    const double spin = 2 * PI * Random::Uniform();
+    const double cos_spin = std::cos(spin);
+    const double sin_spin = std::sin(spin);
+    const VectorR3 axis_rot(-entry_dir.y, entry_dir.x, 0);
+    const double cos_rot = entry_dir.z;
+    const auto rotate = [&](const float* vec) {
+        const VectorR3 v(cos_spin * vec[0] - sin_spin * vec[1],
+                         sin_spin * vec[0] + cos_spin * vec[1], vec[2]);
+        if (cos_rot <= -1 + 1e-12) {
+            return (VectorR3(v.x, -v.y, -v.z));
+        }
+        return (VectorR3(v * cos_rot + axis_rot * v +
+                         axis_rot * ((axis_rot ^ v) / (1 + cos_rot))));
+    };
+    const auto to_world = [&crystal](const VectorR3& pos,
+                                     const VectorR3& dir, Hit& hit) {
+        hit.pos = (crystal.center + pos.x * crystal.axes[0] +
+                   pos.y * crystal.axes[1] + pos.z * crystal.axes[2]);
+        hit.dir = (dir.x * crystal.axes[0] + dir.y * crystal.axes[1] +
+                   dir.z * crystal.axes[2]);
+    };
+    const VectorR3& half = crystal.half_size;
+    const auto inside = [&half](const VectorR3& pos) {
+        return ((std::abs(pos.x) <= half.x) && (std::abs(pos.y) <= half.y) &&
+                (std::abs(pos.z) <= half.z));
+    };
+
+    // The photon leaves where the path of the history first crosses the
+    // surface of the crystal.
+    VectorR3 last_pos = entry;
+    VectorR3 last_dir = entry_dir;
+    double last_path = 0;
+    double last_energy = energy;
+    int no_hits = 0;
+    for (uint32_t idx = table.first_step[history];
+         idx < table.first_step[history + 1]; ++idx)
+    {
+        const Step& step = table.steps[idx];
+        Hit& hit = hits[no_hits++];
+        const VectorR3 pos = entry + scale * rotate(step.pos);
+        if ((step.type == escape) || !inside(pos)) {
+            const double dist = ExitDistance(last_pos, last_dir, half);
+            to_world(last_pos + dist * last_dir, last_dir, hit);
+            hit.path = last_path + dist;
+            hit.energy = last_energy;
+            hit.type = escape;
+            break;
+        }
+        last_pos = pos;
+        last_dir = rotate(step.dir);
+        last_path = scale * step.path;
+        last_energy = energy * step.energy;
+        to_world(last_pos, last_dir, hit);
+        hit.path = last_path;
+        hit.energy = last_energy;
+        hit.type = step.type;
+    }
+    return (no_hits);
+}
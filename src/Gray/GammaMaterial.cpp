@@ -13,18 +13,20 @@ GammaMaterial::GammaMaterial(
     properties(std::move(stats))
 {}
 
-double GammaMaterial::Distance(double photon_energy) const {
+double GammaMaterial::Distance(double photon_energy,
+                               GammaStats::AttenLengths& len) const
+{
     if (InteractionsEnabled()) {
-        GammaStats::AttenLengths len = properties.GetAttenLengths(
-                photon_energy);
+        len = properties.GetAttenLengths(photon_energy);
         return (Random::Exponential(len.total()));
     } else {
         return (DBL_MAX);
     }
 }
 
-Interaction::Type GammaMaterial::Interact(Photon& photon) const {
-    GammaStats::AttenLengths len = properties.GetAttenLengths(photon.GetEnergy());
+Interaction::Type GammaMaterial::Interact(
+        Photon& photon, const GammaStats::AttenLengths& len) const
+{
     double rand = len.total() * Random::Uniform();
     if (rand <= len.photoelectric) {
         photon.SetEnergy(0);
@@ -40,7 +42,32 @@ Interaction::Type GammaMaterial::Interact(Photon& photon) const {
     }
 }
 
+double GammaMaterial::Attenuation(double photon_energy) const {
+    if (!InteractionsEnabled()) {
+        return (0);
+    }
+    return (properties.GetAttenLengths(photon_energy).total());
+}
+
+const GammaMaterial* GammaMaterial::InteractionMaterial(
+        const Photon&, GammaStats::AttenLengths&) const
+{
+    return (this);
+}
+
+const GammaMaterial& GammaMaterial::MaterialAt(const VectorR3&) const {
+    return (*this);
+}
+
 void GammaMaterial::DisableRayleigh() {
     properties.DisableRayleigh();
 }
 
+void GammaMaterial::CacheEnergy(double photon_energy) {
+    properties.CacheEnergy(photon_energy);
+}
+
+void GammaMaterial::BuildTables() {
+    properties.BuildTables();
+}
+
@@ -5,12 +5,16 @@
 #include "Gray/Graphics/SceneDescription.h"
 #include "Gray/Gray/GammaMaterial.h"
 #include "Gray/Gray/GammaRayTraceStats.h"
+#include "Gray/Gray/MaterialGrid.h"
+#include "Gray/Gray/PhaseSpace.h"
 #include "Gray/Physics/Interaction.h"
 #include "Gray/Physics/Positron.h"
 #include "Gray/Physics/Photon.h"
 #include "Gray/Physics/Physics.h"
 #include "Gray/Sources/Source.h"
+#include <cfloat>
 #include <stack>
+#include <utility>
 
 GammaRayTrace::GammaRayTrace(const SceneDescription & scene,
                              const std::vector<VectorR3>& source_positions,
@@ -18,14 +22,36 @@ GammaRayTrace::GammaRayTrace(const SceneDescription & scene,
                              bool log_nuclear_decays_inter,
                              bool log_nonsensitive_inter,
                              bool log_errors_inter) :
+    GammaRayTrace(scene, source_positions, log_nondepositing_inter,
+                  log_nuclear_decays_inter, log_nonsensitive_inter,
+                  log_errors_inter, Options())
+{
+
+}
+
+GammaRayTrace::GammaRayTrace(const SceneDescription & scene,
+                             const std::vector<VectorR3>& source_positions,
+                             bool log_nondepositing_inter,
+                             bool log_nuclear_decays_inter,
+                             bool log_nonsensitive_inter,
+                             bool log_errors_inter,
+                             const Options& options) :
     scene(scene),
     source_positions(source_positions),
     source_mats(BuildStacks(scene, source_positions)),
+    material_grid(options.material_grid),
     log_nondepositing_inter(log_nondepositing_inter),
     log_nuclear_decays(log_nuclear_decays_inter),
     log_nonsensitive(log_nonsensitive_inter),
     log_errors(log_errors_inter),
-    max_trace_depth(500)
+    max_trace_depth(500),
+    max_virtual_collisions(100000),
+    roulette_energy(options.roulette_energy),
+    roulette_survival(options.roulette_survival),
+    phase_space(options.phase_space),
+    detector_response(options.detector_response),
+    decay_filter(options.decay_filter),
+    hit_aggregation(options.hit_aggregation)
 {
 
 }
@@ -34,9 +60,19 @@ void GammaRayTrace::TracePhoton(
         Photon photon,
         std::vector<Interaction> & interactions,
         std::stack<GammaMaterial const *> MatStack,
-        GammaRayTraceStats& stats) const
+        GammaRayTraceStats& stats,
+        double decay_time) const
 {
-    for (int trace_depth = 0; trace_depth < max_trace_depth; ++trace_depth) {
+    // The KdTree leaf the photon is currently in.  Each step starts walking
+    // the tree from here rather than from the root.
+    long leaf = -1;
+    // The surface the photon is sitting on after crossing a boundary, which
+    // is skipped when looking for the next one.
+    HitSurface surface;
+    int virtual_collisions = 0;
+    for (int trace_depth = 0; (trace_depth < max_trace_depth) &&
+         (virtual_collisions < max_virtual_collisions); ++trace_depth)
+    {
         if (MatStack.empty()) {
             // Should always have the default material at the bottom of the
             // stack.  If we somehow pop that out, it means we somehow detected
@@ -59,13 +95,35 @@ void GammaRayTrace::TracePhoton(
         // don't intersect with a material, then an interaction happened at the
         // distance we calculated, we just need to figure out what type of
         // interaction it was.
-        double hitDist = mat_gamma_prop.Distance(photon.GetEnergy());
+        GammaStats::AttenLengths atten;
+        double hitDist = mat_gamma_prop.Distance(photon.GetEnergy(), atten);
 
         VisiblePoint visPoint;
         // Seek intersection will modify hitDist to a smaller distance if the
         // ray interacts with an object.
         long intersectNum = scene.SeekIntersection(
-                photon.GetPos(), photon.GetDir(), hitDist, visPoint);
+                photon.GetPos(), photon.GetDir(), hitDist, visPoint, leaf,
+                surface);
+
+        if (phase_space) {
+            // Record the photon where it leaves the surface, if it gets there
+            // before anything else happens to it.
+            const double exit_dist = phase_space->GetSurface().ExitDistance(
+                    photon.GetPos(), photon.GetDir());
+            if (exit_dist < 0) {
+                // It started outside of the surface, so it can't be recorded,
+                // and nothing outside of the surface is simulated.
+                stats.phase_space_outside++;
+                return;
+            }
+            if (exit_dist <= hitDist) {
+                photon.AddPos(exit_dist * photon.GetDir());
+                photon.AddTime(exit_dist * Physics::inverse_speed_of_light);
+                phase_space->Write(photon, decay_time);
+                stats.phase_space++;
+                return;
+            }
+        }
 
         if (intersectNum >= 0) {
             // If we hit something, then we no we didn't interact.  Move the
@@ -73,7 +131,36 @@ void GammaRayTrace::TracePhoton(
             if (visPoint.IsFrontFacing()) {
                 // This detector id will be used to determine if we scatter
                 // in a detector or inside a phantom
-                photon.SetDetId(visPoint.GetObject().GetDetectorId());
+                photon.SetDetId(visPoint.GetDetectorId());
+                if (detector_response) {
+                    // Sample the crystal's response from where the photon
+                    // enters it.
+                    Photon entering(photon);
+                    entering.AddPos(hitDist * photon.GetDir());
+                    entering.AddTime(
+                            hitDist * Physics::inverse_speed_of_light);
+                    DetectorResponse::Hits hits;
+                    const int no_hits = detector_response->Sample(
+                            entering.GetDetId(), visPoint.GetMaterial(),
+                            entering, hits);
+                    if (no_hits >= 0) {
+                        photon = entering;
+                        if (!SampleResponse(photon, interactions, stats,
+                                *static_cast<GammaMaterial const *>(
+                                        visPoint.GetMaterial()),
+                                hits, no_hits))
+                        {
+                            return;
+                        }
+                        // The photon leaves through the crystal's surface
+                        // into the material it came from.
+                        photon.SetDetId(-1);
+                        surface = visPoint.GetSurface();
+                        surface.front_face = false;
+                        leaf = -1;
+                        continue;
+                    }
+                }
                 MatStack.emplace(static_cast<GammaMaterial const * const>(
                             visPoint.GetMaterial()));
             } else {
@@ -90,11 +177,9 @@ void GammaRayTrace::TracePhoton(
                 photon.SetDetId(-1);
                 MatStack.pop();
             }
-            // Make sure not to hit same place in kdtree, by adding an offset
-            // of a small delta.  This is very much a hack, and a better way
-            // would be to make sure the KdTree doesn't just avoids this
-            // object.
-            hitDist += SceneDescription::ray_trace_epsilon;
+            // Move the photon exactly onto the surface, and skip that surface
+            // when searching from here.
+            surface = visPoint.GetSurface();
             photon.AddPos(hitDist * photon.GetDir());
             photon.AddTime(hitDist * Physics::inverse_speed_of_light);
             continue;
@@ -117,10 +202,32 @@ void GammaRayTrace::TracePhoton(
         // to advance the photon to the interaction point.
         photon.AddPos(hitDist * photon.GetDir());
         photon.AddTime(hitDist * Physics::inverse_speed_of_light);
+        surface = HitSurface();
 
-        double deposit = photon.GetEnergy();
-        Interaction::Type type = mat_gamma_prop.Interact(photon);
-        deposit -= photon.GetEnergy();
+        // A delta tracked material may turn this into a virtual interaction,
+        // which leaves the photon going on as it was, or hand it off to the
+        // material actually at this point.
+        const GammaMaterial* interact_mat =
+                mat_gamma_prop.InteractionMaterial(photon, atten);
+        if (!interact_mat) {
+            // Nothing happened to the photon, so this only counts towards the
+            // limit on virtual collisions, not the depth of the trace.
+            --trace_depth;
+            ++virtual_collisions;
+            continue;
+        }
+
+        const double energy = photon.GetEnergy();
+        Interaction::Type type = interact_mat->Interact(photon, atten);
+        // A photon that falls below the cutoff of the material deposits what
+        // it has left along with the interaction.
+        const bool cutoff = (photon.GetEnergy() > 0) &&
+                (photon.GetEnergy() < interact_mat->GetEnergyCutoff());
+        if (cutoff) {
+            photon.SetEnergy(0);
+            stats.energy_cutoff++;
+        }
+        const double deposit = energy - photon.GetEnergy();
 
         bool is_sensitive = (photon.GetDetId() >= 0);
         bool log_interact = (log_nonsensitive || is_sensitive);
@@ -142,7 +249,7 @@ void GammaRayTrace::TracePhoton(
                 break;
             }
             case Interaction::Type::RAYLEIGH: {
-                log_interact &= log_nondepositing_inter;
+                log_interact &= (log_nondepositing_inter || cutoff);
                 stats.rayleigh++;
                 if (is_sensitive) {
                     stats.rayleigh_sensitive++;
@@ -155,11 +262,22 @@ void GammaRayTrace::TracePhoton(
         }
         if (log_interact) {
             interactions.emplace_back(
-                    Interaction(type, photon, mat_gamma_prop, deposit));
+                    Interaction(type, photon, *interact_mat, deposit));
         }
         if (photon.GetEnergy() <= 0) {
             return;
         }
+        // Russian roulette is only played once, as the photon first scatters
+        // below the energy, and never in a detector, where the rest of its
+        // energy still counts towards the deposit.
+        if (!is_sensitive && (energy >= roulette_energy) &&
+            (photon.GetEnergy() < roulette_energy))
+        {
+            if (!photon.Roulette(roulette_survival)) {
+                stats.roulette_killed++;
+                return;
+            }
+        }
     }
 
     if (log_errors){
@@ -170,6 +288,181 @@ void GammaRayTrace::TracePhoton(
     return;
 }
 
+/*!
+ * Applies the hits sampled for a photon entering a crystal to it, logging
+ * them as they would have been if it had been traced.  Returns true if the
+ * photon left the crystal.
+ */
+bool GammaRayTrace::SampleResponse(
+        Photon& photon, std::vector<Interaction>& interactions,
+        GammaRayTraceStats& stats, const GammaMaterial& material,
+        const DetectorResponse::Hits& hits, int no_hits) const
+{
+    stats.detector_response++;
+    double path = 0;
+    for (int idx = 0; idx < no_hits; ++idx) {
+        const DetectorResponse::Hit& hit = hits[idx];
+        const double deposit = photon.GetEnergy() - hit.energy;
+        photon.SetPos(hit.pos);
+        photon.SetDir(hit.dir);
+        photon.SetEnergy(hit.energy);
+        photon.AddTime((hit.path - path) * Physics::inverse_speed_of_light);
+        path = hit.path;
+        if (hit.type == DetectorResponse::escape) {
+            return (true);
+        }
+        const Interaction::Type type = static_cast<Interaction::Type>(
+                hit.type);
+        bool log_interact = true;
+        switch (type) {
+            case Interaction::Type::PHOTOELECTRIC: {
+                stats.photoelectric++;
+                stats.photoelectric_sensitive++;
+                break;
+            }
+            case Interaction::Type::COMPTON: {
+                stats.compton++;
+                stats.compton_sensitive++;
+                photon.SetScatterCompton();
+                break;
+            }
+            default: {
+                log_interact = (log_nondepositing_inter || (deposit > 0));
+                stats.rayleigh++;
+                stats.rayleigh_sensitive++;
+                photon.SetScatterRayleigh();
+                break;
+            }
+        }
+        if (log_interact) {
+            interactions.emplace_back(
+                    Interaction(type, photon, material, deposit));
+        }
+    }
+    return (false);
+}
+
+bool GammaRayTrace::ParseDecayFilter(const std::string& identifier,
+                                     DecayFilter& filter)
+{
+    if (identifier == "none") {
+        filter = DecayFilter::None;
+    } else if (identifier == "singles") {
+        filter = DecayFilter::Singles;
+    } else if (identifier == "coinc") {
+        filter = DecayFilter::Coinc;
+    } else {
+        return (false);
+    }
+    return (true);
+}
+
+bool GammaRayTrace::ParseHitAggregation(const std::string& identifier,
+                                        HitAggregation& aggregation)
+{
+    if (identifier == "none") {
+        aggregation = HitAggregation::None;
+    } else if (identifier == "first") {
+        aggregation = HitAggregation::First;
+    } else if (identifier == "max") {
+        aggregation = HitAggregation::Max;
+    } else if (identifier == "centroid") {
+        aggregation = HitAggregation::Centroid;
+    } else {
+        return (false);
+    }
+    return (true);
+}
+
+/*!
+ * Merges the deposit from into into, leaving from to be thrown away.  The
+ * pairwise rules are those of MergeFunctors, so a run of deposits ends up
+ * the same as it would going through a merge process in order of time.
+ */
+void GammaRayTrace::Aggregate(Interaction& into, Interaction& from) const {
+    const double energy = into.energy + from.energy;
+    if ((hit_aggregation == HitAggregation::Max) &&
+        (into.energy < from.energy))
+    {
+        Interaction::MergeStats(from, into);
+        from.energy = energy;
+        std::swap(into, from);
+        return;
+    }
+    Interaction::MergeStats(into, from);
+    if ((hit_aggregation == HitAggregation::Centroid) && (energy > 0)) {
+        into.pos = (into.energy * into.pos + from.energy * from.pos) / energy;
+    }
+    into.energy = energy;
+}
+
+/*!
+ * Combines each run of deposits in one detector, in the interactions of one
+ * photon from first on.  Interactions that are dropped, such as Rayleigh
+ * scatters, stay where they are, and only end a run if they are outside of
+ * the detector.
+ */
+void GammaRayTrace::AggregateHits(std::vector<Interaction>& interactions,
+                                  size_t first,
+                                  GammaRayTraceStats& stats) const
+{
+    size_t out = first;
+    // Where the run being aggregated into is, if there is one.
+    size_t run = interactions.size();
+    for (size_t idx = first; idx < interactions.size(); ++idx) {
+        Interaction& interact = interactions[idx];
+        if ((run < out) && (interact.det_id == interactions[run].det_id)) {
+            if (!interact.dropped) {
+                Aggregate(interactions[run], interact);
+                stats.hits_aggregated++;
+                continue;
+            }
+        } else {
+            run = interactions.size();
+        }
+        if (!interact.dropped) {
+            run = out;
+        }
+        if (out != idx) {
+            interactions[out] = std::move(interact);
+        }
+        ++out;
+    }
+    interactions.resize(out);
+}
+
+/*!
+ * Checks if the interactions of a decay could make it through the DAQ, based
+ * on which detectors they deposited energy in.  Interactions that are dropped
+ * never become singles, so they don't count.  A coincidence needs singles in
+ * two different detectors, regardless of which photons they came from, as a
+ * single photon can scatter from one detector into another.
+ */
+bool GammaRayTrace::PassesFilter(
+        const std::vector<Interaction>& interactions) const
+{
+    if (decay_filter == DecayFilter::None) {
+        return (true);
+    }
+    int first_det_id = -1;
+    for (const Interaction& interact: interactions) {
+        if (interact.dropped || (interact.energy <= 0) ||
+            (interact.det_id < 0))
+        {
+            continue;
+        }
+        if (decay_filter == DecayFilter::Singles) {
+            return (true);
+        }
+        if (first_det_id < 0) {
+            first_det_id = interact.det_id;
+        } else if (interact.det_id != first_det_id) {
+            return (true);
+        }
+    }
+    return (false);
+}
+
 std::vector<Interaction> GammaRayTrace::TraceDecay(
         const NuclearDecay& decay,
         GammaRayTraceStats& stats) const
@@ -183,8 +476,17 @@ std::vector<Interaction> GammaRayTrace::TraceDecay(
     }
     for (const Photon& photon: decay) {
         stats.photons++;
+        const size_t first = interactions.size();
         TracePhoton(photon, interactions, DecayStack(src_id, photon.GetPos()),
-                stats);
+                stats, decay.GetTime());
+        if (hit_aggregation != HitAggregation::None) {
+            AggregateHits(interactions, first, stats);
+        }
+    }
+    if (!PassesFilter(interactions)) {
+        stats.decays_filtered++;
+        stats.interactions_filtered += interactions.size();
+        interactions.clear();
     }
     return (interactions);
 }
@@ -198,12 +500,10 @@ std::stack<GammaMaterial const *> GammaRayTrace::BuildStack(
     std::stack<GammaMaterial const *> materials;
     std::stack<bool> front_face;
     VisiblePoint point;
-    point.SetPosition(src_pos);
+    VectorR3 start(src_pos);
 
     double hit_dist = DBL_MAX;
-    long obj_num = scene.SeekIntersection(
-            point.GetPosition() + dir * SceneDescription::ray_trace_epsilon,
-            dir, hit_dist, point);
+    long obj_num = scene.SeekIntersection(start, dir, hit_dist, point);
 
     while (obj_num >= 0) {
         materials.push(static_cast<GammaMaterial const *>(point.GetMaterial()));
@@ -212,10 +512,11 @@ std::stack<GammaMaterial const *> GammaRayTrace::BuildStack(
         } else {
             front_face.push(false);
         }
+        // Continue from exactly where we hit, skipping that surface.
+        start = point.GetPosition();
         hit_dist = DBL_MAX;
-        obj_num = scene.SeekIntersection(
-                point.GetPosition() + dir * SceneDescription::ray_trace_epsilon,
-                dir, hit_dist, point);
+        obj_num = scene.SeekIntersection(start, dir, hit_dist, point,
+                                         point.GetSurface());
     }
 
     std::stack<GammaMaterial const *> true_materials;
@@ -279,12 +580,13 @@ std::stack<GammaMaterial const *> GammaRayTrace::UpdateStack(
     double remaining_dist = dist;
     dir.Normalize();
     VisiblePoint point;
-    point.SetPosition(src_pos);
-    while (scene.SeekIntersection(
-            point.GetPosition() + SceneDescription::ray_trace_epsilon * dir,
-            dir, dist, point) >= 0)
+    VectorR3 start(src_pos);
+    while (scene.SeekIntersection(start, dir, dist, point,
+                                  point.GetSurface()) >= 0)
     {
-        remaining_dist -= dist + SceneDescription::ray_trace_epsilon;
+        // Continue from exactly where we hit, skipping that surface.
+        start = point.GetPosition();
+        remaining_dist -= dist;
         dist = remaining_dist;
         if (point.IsFrontFacing()) {
             // Front face means we are entering a material.
@@ -312,11 +614,17 @@ std::stack<GammaMaterial const *> GammaRayTrace::UpdateStack(
 std::stack<GammaMaterial const *> GammaRayTrace::DecayStack(
         size_t src_id, const VectorR3 & pos) const
 {
+    if (material_grid) {
+        const MaterialGrid::Stack* stack = material_grid->Lookup(pos);
+        if (stack) {
+            return (*stack);
+        }
+    }
     return (UpdateStack(source_positions[src_id], pos, scene,
                         source_mats[src_id]));
 }
 
 const GammaMaterial& GammaRayTrace::SourceMaterial(size_t idx) const {
-    return (*source_mats[idx].top());
+    return (source_mats[idx].top()->MaterialAt(source_positions[idx]));
 }
 
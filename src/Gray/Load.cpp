@@ -9,27 +9,41 @@
  */
 
 #include "Gray/Gray/Load.h"
+#include <algorithm>
 #include <array>
+#include <cfloat>
+#include <fstream>
+#include <future>
 #include <memory>
 #include <vector>
+#include "Gray/Graphics/MeshFile.h"
 #include "Gray/Graphics/SceneDescription.h"
 #include "Gray/Graphics/TransformViewable.h"
 #include "Gray/Graphics/ViewableCylinder.h"
 #include "Gray/Graphics/ViewableEllipsoid.h"
+#include "Gray/Graphics/ViewableInstance.h"
+#include "Gray/Graphics/ViewableMesh.h"
 #include "Gray/Graphics/ViewableParallelepiped.h"
 #include "Gray/Graphics/ViewableSphere.h"
 #include "Gray/Graphics/ViewableTriangle.h"
+#include "Gray/Graphics/ViewableVoxelGrid.h"
+#include "Gray/Graphics/VisiblePoint.h"
 #include "Gray/Gray/Config.h"
+#include "Gray/Gray/DeltaMaterial.h"
 #include "Gray/Gray/File.h"
 #include "Gray/Gray/GammaMaterial.h"
+#include "Gray/Gray/PhaseSpace.h"
 #include "Gray/Gray/String.h"
 #include "Gray/Gray/Syntax.h"
 #include "Gray/Output/DetectorArray.h"
+#include "Gray/Physics/EmissionBias.h"
 #include "Gray/Sources/AnnulusCylinderSource.h"
 #include "Gray/Sources/AnnulusEllipticCylinderSource.h"
 #include "Gray/Sources/CylinderSource.h"
+#include "Gray/Sources/DynamicVoxelSource.h"
 #include "Gray/Sources/EllipsoidSource.h"
 #include "Gray/Sources/EllipticCylinderSource.h"
+#include "Gray/Sources/PhaseSpaceSource.h"
 #include "Gray/Sources/PointSource.h"
 #include "Gray/Sources/SourceList.h"
 #include "Gray/Sources/SphereSource.h"
@@ -38,6 +52,17 @@
 #include "Gray/Sources/VoxelSource.h"
 #include "Gray/VrMath/LinearR3.h"
 
+namespace {
+bool IsSourceCommand(const Command& cmd) {
+    const std::string suffix = "_src";
+    const std::string& name = cmd.tokens.front();
+    bool is_src = ((name.size() > suffix.size()) &&
+                   (name.compare(name.size() - suffix.size(), suffix.size(),
+                                 suffix) == 0));
+    return (is_src || (cmd == "start_vecsrc") || (cmd == "isotope"));
+}
+}
+
 Load::Load() :
     matrix_stack({RigidMapR3::Identity()})
 {
@@ -231,6 +256,59 @@ bool Load::ConfigCommand(Command& cmd, Config & config, bool reject_unknown) {
         }
         config.set_log_all(true);
         return (true);
+    } else if (cmd == "emission_bias") {
+        double fraction;
+        if (!cmd.parse(fraction) || (fraction < 0) || (fraction > 1)) {
+            cmd.MarkError("emission_bias format: [fraction from 0 to 1]");
+            return (false);
+        }
+        config.set_emission_bias(fraction);
+        return (true);
+    } else if (cmd == "russian_roulette") {
+        double energy, survival;
+        if (!cmd.parse(energy, survival) || (energy < 0) ||
+            (survival <= 0) || (survival > 1))
+        {
+            cmd.MarkError("russian_roulette format: [energy (MeV)] "
+                          "[survival probability from 0 to 1]");
+            return (false);
+        }
+        config.set_russian_roulette(energy, survival);
+        return (true);
+    } else if (cmd == "decay_filter") {
+        if (cmd.tokens.size() != 2) {
+            cmd.MarkError("format: decay_filter [none/singles/coinc]");
+            return (false);
+        } else if (!config.set_decay_filter(cmd.Join())) {
+            cmd.MarkError("Invalid decay filter: " + cmd.Join());
+            return (false);
+        }
+        return (true);
+    } else if (cmd == "aggregate_hits") {
+        if (cmd.tokens.size() != 2) {
+            cmd.MarkError("format: aggregate_hits [none/first/max/centroid]");
+            return (false);
+        } else if (!config.set_hit_aggregation(cmd.Join())) {
+            cmd.MarkError("Invalid hit aggregation: " + cmd.Join());
+            return (false);
+        }
+        return (true);
+    } else if (cmd == "quasi_random") {
+        if (cmd.tokens.size() > 1) {
+            cmd.MarkError("Unrecognized options after quasi_random: " +
+                    cmd.Join());
+            return (false);
+        }
+        config.set_quasi_random(true);
+        return (true);
+    } else if (cmd == "material_grid") {
+        if (cmd.tokens.size() > 1) {
+            cmd.MarkError("Unrecognized options after material_grid: " +
+                    cmd.Join());
+            return (false);
+        }
+        config.set_material_grid(true);
+        return (true);
     } else {
         // Ignore other commands.
         return (!reject_unknown);
@@ -253,6 +331,7 @@ bool Load::SceneCommands(
         Config& config)
 {
     cur_material = static_cast<GammaMaterial*>(&scene.GetDefaultMaterial());
+    used_materials.insert(cur_material);
     bool result = true;
     for (Command& cmd : cmds) {
         result &= Load::SceneCommand(cmd, sources, scene, det_array, config);
@@ -265,6 +344,11 @@ bool Load::SceneCommands(
                 << cmd.line << ": " << cmd.WarningMsg() << "\n";
         }
     }
+    if (!module_stack.empty()) {
+        std::cerr << "Error: start_module for \"" << module_stack.back().name
+            << "\" left unpaired\n";
+        result = false;
+    }
     return (result);
 }
 
@@ -283,6 +367,17 @@ bool Load::File(
     auto cmds = Syntax::ParseCommands(filename);
     if (SceneCommands(cmds, sources, scene, det_array, config)) {
         SetCameraView(scene);
+        if (config.get_emission_bias() > 0) {
+            // The bias needs all of the sensitive geometry, so it can only be
+            // set up once the whole scene is loaded.
+            auto bias = std::make_shared<const EmissionBias>(
+                    scene.GetSensitiveExtents(), config.get_emission_bias());
+            if (bias->GetInnerRadius() <= 0) {
+                std::cout << "Warning: emission_bias has no effect, as the "
+                          << "sensitive geometry reaches the scanner axis\n";
+            }
+            sources.SetEmissionBias(bias);
+        }
         return (true);
     } else {
         return (false);
@@ -299,8 +394,15 @@ bool Load::SceneCommand(
     if (!cur_material) {
         cur_material = static_cast<GammaMaterial*>(
                 &scene.GetDefaultMaterial());
+        used_materials.insert(cur_material);
     }
     const RigidMapR3& cur_matrix = matrix_stack.top();
+    // Anything defined between start_module and end_module is added to that
+    // module instead of to the scene and detector array.
+    SceneDescription& geometry = (module_stack.empty() ?
+            scene:*module_stack.back().scene);
+    DetectorArray& detectors = (module_stack.empty() ?
+            det_array:*module_stack.back().detectors);
     if (load_polygon_lines) {
         VectorR3 point;
         bool status = cmd.parseAll(point.x, point.y, point.z);
@@ -315,10 +417,19 @@ bool Load::SceneCommand(
             // Choose if we're adding this to the vector source's scene or
             // the geometric scene.
             SceneDescription & local_scene = (load_vector_source ?
-                    (*vector_source_scene.get()):scene);
+                    (*vector_source_scene.get()):geometry);
             ProcessPolygonVerts(local_scene);
         }
         return (true);
+    } else if (cmd == "start_module") {
+        return (StartModule(cmd));
+    } else if (cmd == "end_module") {
+        return (EndModule(cmd));
+    } else if (cmd == "module") {
+        return (PlaceModule(cmd, geometry, detectors));
+    } else if (!module_stack.empty() && IsSourceCommand(cmd)) {
+        cmd.MarkError("sources cannot be defined inside of a module");
+        return (false);
     } else if (cmd == "disable_half_life") {
         if (!cmd.parse()) {
             cmd.MarkError("disable_half_life takes no options");
@@ -345,7 +456,7 @@ bool Load::SceneCommand(
             std::unique_ptr<ViewableTriangle> vc(
                     new ViewableTriangle(triangle));
             TransformWithRigid(vc.get(), cur_matrix);
-            scene.AddViewable(std::move(vc));
+            geometry.AddViewable(std::move(vc));
         }
         return (true);
     } else if (cmd == "elliptic_cyl") {
@@ -366,7 +477,7 @@ bool Load::SceneCommand(
         vc->SetHeight(height);
         vc->SetMaterial(cur_material);
         TransformWithRigid(vc.get(), cur_matrix);
-        scene.AddViewable(std::move(vc));
+        geometry.AddViewable(std::move(vc));
         return (true);
     } else if (cmd == "isotope") {
         // The isotope command can create new isotopes, currently only a beam
@@ -459,6 +570,79 @@ bool Load::SceneCommand(
         }
         sources.AddSource(std::move(s));
         return (true);
+    } else if (cmd == "phase_space_src") {
+        std::string filename;
+        if (!cmd.parse(filename)) {
+            cmd.MarkError("format: phase_space_src [filename]");
+            return (false);
+        }
+        filename = File::Join(File::Dir(cmd.filename), filename);
+        std::unique_ptr<PhaseSpaceSource> s(new PhaseSpaceSource());
+        if (!s->Load(filename)) {
+            cmd.MarkError("Unable to load phase space file: " + filename);
+            return (false);
+        }
+        sources.AddSource(std::move(s));
+        return (true);
+    } else if (cmd == "phase_space_out") {
+        std::string filename, shape;
+        VectorR3 center, axis, size;
+        double radius, height;
+        std::shared_ptr<PhaseSpace::Surface> surface;
+        if (cmd.parse(filename, shape, center.x, center.y, center.z,
+                      axis.x, axis.y, axis.z, radius, height) &&
+            (shape == "cyl") && (radius > 0) && (height > 0))
+        {
+            cur_matrix.Transform(&center);
+            cur_matrix.Transform3x3(&axis);
+            surface = PhaseSpace::Surface::Cylinder(center, axis, radius,
+                                                    height);
+        } else if (cmd.parse(filename, shape, center.x, center.y, center.z,
+                             size.x, size.y, size.z) &&
+                   (shape == "box") && (size.x > 0) && (size.y > 0) &&
+                   (size.z > 0))
+        {
+            cur_matrix.Transform(&center);
+            surface = PhaseSpace::Surface::Box(center, size);
+        } else {
+            cmd.MarkError("format: phase_space_out [filename] cyl [center xyz]"
+                          " [axis xyz] [radius] [height], or [filename] box"
+                          " [center xyz] [size xyz]");
+            return (false);
+        }
+        config.set_phase_space_out(filename, surface);
+        return (true);
+    } else if (cmd == "dyn_voxel_src") {
+        std::string filename;
+        VectorR3 center;
+        VectorR3 size;
+        // Assume z aligns with z for right now, as with voxel_src.
+        VectorR3 axis(0, 0, 1);
+        if (!cmd.parse(center.x, center.y, center.z,
+                       size.x, size.y, size.z, filename))
+        {
+            cmd.MarkError("format: dyn_voxel_src [center xyz] [size xyz]"
+                          " [frame list]");
+            return (false);
+        }
+        filename = File::Join(File::Dir(cmd.filename), filename);
+        std::ifstream input(filename);
+        std::vector<DynamicVoxelSource::Frame> frames;
+        if (!DynamicVoxelSource::LoadFrames(input, File::Dir(filename),
+                                            activity_scale, frames))
+        {
+            cmd.MarkError("Unable to load frame list: " + filename);
+            return (false);
+        }
+        if (!DynamicVoxelSource::CheckFrames(frames)) {
+            cmd.MarkError("Frames must be in order, not overlap, and have"
+                          " readable images: " + filename);
+            return (false);
+        }
+        std::unique_ptr<DynamicVoxelSource> s(new DynamicVoxelSource(
+                    center, size, axis, std::move(frames)));
+        sources.AddSource(std::move(s));
+        return (true);
     } else if (cmd == "ellipsoid_src") {
         VectorR3 center, axis1, axis2;
         double radius1, radius2, radius3, activity;
@@ -557,6 +741,31 @@ bool Load::SceneCommand(
         }
         cur_material = static_cast<GammaMaterial*>(
                 &scene.GetMaterial(mat_name));
+        used_materials.insert(cur_material);
+        return (true);
+    } else if (cmd == "energy_cutoff") {
+        double energy;
+        if (!cmd.parse(energy) || (energy < 0)) {
+            cmd.MarkError("format: energy_cutoff [energy (MeV)]");
+            return (false);
+        }
+        cur_material->SetEnergyCutoff(energy);
+        return (true);
+    } else if (cmd == "detector_response") {
+        std::string filename;
+        VectorR3 size;
+        if (!cmd.parse(filename, size.x, size.y, size.z) || (size.x <= 0) ||
+            (size.y <= 0) || (size.z <= 0))
+        {
+            cmd.MarkError("format: detector_response [filename] [size xyz]");
+            return (false);
+        }
+        if (!cur_material->IsSensitive()) {
+            cmd.MarkError("detector_response requires a sensitive material");
+            return (false);
+        }
+        crystal_types.push_back({File::Join(File::Dir(cmd.filename), filename),
+                                 cur_material, size});
         return (true);
     } else if (cmd == "disable_rayleigh") {
         if (!cmd.parse()) {
@@ -617,7 +826,7 @@ bool Load::SceneCommand(
         std::unique_ptr<ViewableSphere> s(new ViewableSphere(center, radius));
         s->SetMaterial(cur_material);
         TransformWithRigid(s.get(), cur_matrix);
-        scene.AddViewable(std::move(s));
+        geometry.AddViewable(std::move(s));
         return (true);
     } else if (cmd == "cyl") {
         VectorR3 center, axis;
@@ -636,7 +845,7 @@ bool Load::SceneCommand(
         vc->SetHeight(height);
         vc->SetMaterial(cur_material);
         TransformWithRigid(vc.get(), cur_matrix);
-        scene.AddViewable(std::move(vc));
+        geometry.AddViewable(std::move(vc));
         return (true);
     } else if (cmd == "ellipsoid") {
         VectorR3 center, axis1, axis2;
@@ -655,7 +864,7 @@ bool Load::SceneCommand(
         ve->SetRadii(radius3, radius2, radius1);
         ve->SetMaterial(cur_material);
         TransformWithRigid(ve.get(), cur_matrix);
-        scene.AddViewable(std::move(ve));
+        geometry.AddViewable(std::move(ve));
         return (true);
     } else if (cmd == "k") {
         VectorR3 center, size;
@@ -666,7 +875,7 @@ bool Load::SceneCommand(
 
         int det_id = -1;
         if (cur_material->IsSensitive()) {
-            det_id = det_array.AddDetector(
+            det_id = detectors.AddDetector(
                     center, size, cur_matrix, 0, 0, 0, block_id);
             ++block_id;
         }
@@ -675,7 +884,7 @@ bool Load::SceneCommand(
         vp->SetMaterial(cur_material);
         vp->SetDetectorId(det_id);
         TransformWithRigid(vp.get(), cur_matrix);
-        scene.AddViewable(std::move(vp));
+        geometry.AddViewable(std::move(vp));
         return (true);
     } else if (cmd == "array") {
         VectorR3 center, size, step;
@@ -703,7 +912,7 @@ bool Load::SceneCommand(
                     local_center.z += k * step.z;
 
                     if (cur_material->IsSensitive()) {
-                        det_id = det_array.AddDetector(
+                        det_id = detectors.AddDetector(
                                 local_center, size, cur_matrix,
                                 i, j, k, block_id);
                     }
@@ -713,7 +922,7 @@ bool Load::SceneCommand(
                     vp->SetMaterial(cur_material);
                     vp->SetDetectorId(det_id);
                     TransformWithRigid(vp.get(), cur_matrix);
-                    scene.AddViewable(std::move(vp));
+                    geometry.AddViewable(std::move(vp));
                 }
             }
         }
@@ -739,6 +948,147 @@ bool Load::SceneCommand(
         no_polygon_verts = num_verts;
         polygon_verts.clear();
         return (true);
+    } else if (cmd == "mesh") {
+        std::string filename;
+        if (!cmd.parse(filename)) {
+            cmd.MarkError("format: mesh [filename]");
+            return (false);
+        }
+        // Make the file relative to whichever file in which the command was
+        // placed
+        filename = File::Join(File::Dir(cmd.filename), filename);
+        std::vector<VectorR3> vertices;
+        std::vector<ViewableMesh::Triangle> triangles;
+        std::string error;
+        if (!MeshFile::Read(filename, vertices, triangles, error)) {
+            cmd.MarkError("Unable to load mesh: " + error);
+            return (false);
+        }
+        if (triangles.empty()) {
+            cmd.MarkError("Mesh has no triangles: " + filename);
+            return (false);
+        }
+        VectorR3 lower(DBL_MAX, DBL_MAX, DBL_MAX);
+        VectorR3 upper(-DBL_MAX, -DBL_MAX, -DBL_MAX);
+        for (auto & vertex: vertices) {
+            vertex *= polygon_scale;
+            lower.Set(std::min(lower.x, vertex.x), std::min(lower.y, vertex.y),
+                      std::min(lower.z, vertex.z));
+            upper.Set(std::max(upper.x, vertex.x), std::max(upper.y, vertex.y),
+                      std::max(upper.z, vertex.z));
+        }
+        // The whole mesh is one detector, the size of its bounding box.
+        int det_id = -1;
+        if (!load_vector_source && cur_material->IsSensitive()) {
+            det_id = detectors.AddDetector(
+                    (lower + upper) / 2.0, upper - lower, cur_matrix, 0, 0, 0,
+                    block_id);
+            ++block_id;
+        }
+        for (auto & vertex: vertices) {
+            cur_matrix.Transform(&vertex);
+        }
+        std::unique_ptr<ViewableMesh> vm(new ViewableMesh(vertices, triangles));
+        vm->SetMaterial(cur_material);
+        vm->SetDetectorId(det_id);
+        vm->SetSrcId(load_vector_source ? 1:0);
+        SceneDescription & local_scene = (load_vector_source ?
+                (*vector_source_scene.get()):geometry);
+        local_scene.AddViewable(std::move(vm));
+        return (true);
+    } else if (cmd == "voxel_phantom") {
+        std::string filename;
+        VectorR3 center;
+        VectorR3 size;
+        // The fixed options are followed by pairs of labels and materials.
+        if ((cmd.tokens.size() < 8) || (cmd.tokens.size() % 2 != 0) ||
+            !String::Parse(cmd.tokens.cbegin() + 1, cmd.tokens.cbegin() + 8,
+                           center.x, center.y, center.z,
+                           size.x, size.y, size.z, filename))
+        {
+            cmd.MarkError("format: voxel_phantom [center xyz] [size xyz]"
+                    " [filename] [label material]...");
+            return (false);
+        }
+        std::vector<const Material*> label_materials(256, nullptr);
+        for (auto iter = cmd.tokens.cbegin() + 8; iter != cmd.tokens.cend();
+             iter += 2)
+        {
+            int label;
+            std::string mat_name;
+            if (!String::Parse(iter, iter + 2, label, mat_name) ||
+                (label < 0) || (label > 255))
+            {
+                cmd.MarkError("voxel_phantom labels must be from 0 to 255");
+                return (false);
+            }
+            if (!scene.HasMaterial(mat_name)) {
+                cmd.MarkError("Invalid material: " + mat_name);
+                return (false);
+            }
+            GammaMaterial& material = static_cast<GammaMaterial&>(
+                    scene.GetMaterial(mat_name));
+            if (material.IsSensitive()) {
+                cmd.MarkError("voxel_phantom materials can not be sensitive");
+                return (false);
+            }
+            label_materials[label] = &material;
+            used_materials.insert(&material);
+        }
+        // Make the file relative to whichever file in which the command was
+        // placed
+        filename = File::Join(File::Dir(cmd.filename), filename);
+        std::ifstream input(filename);
+        std::vector<double> values;
+        std::array<int, 3> dims;
+        std::vector<uint8_t> labels;
+        if (!VoxelSource::Load(input, values, dims)) {
+            cmd.MarkError("Unable to load image: " + filename);
+            return (false);
+        }
+        if (!ViewableVoxelGrid::ValuesToLabels(values, labels)) {
+            cmd.MarkError("Labels must be whole numbers from 0 to 255: " +
+                          filename);
+            return (false);
+        }
+        RigidMapR3 local_to_global(cur_matrix);
+        cur_matrix.Transform(&center);
+        local_to_global.SetColumn4(center);
+        std::unique_ptr<ViewableVoxelGrid> vg(new ViewableVoxelGrid(
+                dims, labels, label_materials, size, local_to_global));
+        if (delta_tracking) {
+            std::vector<const GammaMaterial*> materials;
+            for (uint8_t label: labels) {
+                const auto material = static_cast<const GammaMaterial*>(
+                        label_materials[label]);
+                if (!material) {
+                    cmd.MarkError("delta tracked voxel_phantom requires a "
+                                  "material for every label, missing: " +
+                                  std::to_string(label));
+                    return (false);
+                }
+                if (std::find(materials.begin(), materials.end(),
+                              material) == materials.end())
+                {
+                    materials.push_back(material);
+                }
+            }
+            vg->SetDeltaMaterial(std::unique_ptr<Material>(
+                    new DeltaMaterial(*vg, materials)));
+        }
+        vg->SetSrcId(load_vector_source ? 1:0);
+        SceneDescription & local_scene = (load_vector_source ?
+                (*vector_source_scene.get()):geometry);
+        local_scene.AddViewable(std::move(vg));
+        return (true);
+    } else if (cmd == "delta_tracking") {
+        std::string state;
+        if (!cmd.parse(state) || ((state != "on") && (state != "off"))) {
+            cmd.MarkError("format: delta_tracking [on|off]");
+            return (false);
+        }
+        delta_tracking = (state == "on");
+        return (true);
     } else if (cmd == "scale") {
         if (!cmd.parse(polygon_scale)) {
             cmd.MarkError("invalid scale value");
@@ -748,7 +1098,7 @@ bool Load::SceneCommand(
         if (!cmd.parse()) {
             cmd.MarkError("increment takes no options");
         }
-        polygon_det_id = det_array.AddDetector(
+        polygon_det_id = detectors.AddDetector(
                 {0, 0, 0}, {1, 1, 1}, cur_matrix, 0, 0, 0, block_id++);
         return (true);
     } else if (cmd == "start_vecsrc") {
@@ -869,6 +1219,93 @@ bool Load::SceneCommand(
     }
 }
 
+bool Load::StartModule(Command& cmd) {
+    std::string name;
+    if (!cmd.parse(name)) {
+        cmd.MarkError("format: start_module [name]");
+        return (false);
+    }
+    if (modules.count(name)) {
+        cmd.MarkError("module already defined: " + name);
+        return (false);
+    }
+    if (load_vector_source) {
+        cmd.MarkError("modules cannot be defined inside of a vector source");
+        return (false);
+    }
+    // A hit records every module it was found through, plus the primitive.
+    if (module_stack.size() + 2 > HitSurface::max_depth) {
+        cmd.MarkError("modules are nested too deeply: " + name);
+        return (false);
+    }
+    Module module;
+    module.scene = std::make_shared<SceneDescription>();
+    module.detectors = std::make_shared<DetectorArray>();
+    module.name = name;
+    module.outer_block_id = block_id;
+    module.outer_polygon_det_id = polygon_det_id;
+    // Modules are defined in their own coordinate system, and the transforms
+    // are applied when they are placed.
+    matrix_stack.emplace(RigidMapR3::Identity());
+    module.matrix_depth = matrix_stack.size();
+    block_id = 0;
+    polygon_det_id = -1;
+    module_stack.push_back(std::move(module));
+    return (true);
+}
+
+bool Load::EndModule(Command& cmd) {
+    if (!cmd.parse()) {
+        cmd.MarkError("end_module takes no options");
+        return (false);
+    }
+    if (module_stack.empty()) {
+        cmd.MarkError("unpaired end_module found");
+        return (false);
+    }
+    Module module = std::move(module_stack.back());
+    module_stack.pop_back();
+    if (matrix_stack.size() != module.matrix_depth) {
+        cmd.MarkError("unpaired push or pop inside of module: " + module.name);
+        return (false);
+    }
+    matrix_stack.pop();
+    module.no_blocks = block_id;
+    block_id = module.outer_block_id;
+    polygon_det_id = module.outer_polygon_det_id;
+    if (module.scene->NumViewables() == 0) {
+        cmd.MarkError("module has no geometry: " + module.name);
+        return (false);
+    }
+    // Same parameters as the scene's tree in gray.
+    module.scene->BuildTree(true, 8.0);
+    modules.emplace(module.name, std::move(module));
+    return (true);
+}
+
+bool Load::PlaceModule(Command& cmd, SceneDescription& scene,
+                       DetectorArray& det_array)
+{
+    std::string name;
+    if (!cmd.parse(name)) {
+        cmd.MarkError("format: module [name]");
+        return (false);
+    }
+    auto iter = modules.find(name);
+    if (iter == modules.end()) {
+        cmd.MarkError("Unknown module: " + name);
+        return (false);
+    }
+    const Module& module = (*iter).second;
+    const RigidMapR3& cur_matrix = matrix_stack.top();
+    int det_offset = det_array.AddDetectors(*module.detectors, cur_matrix,
+                                            block_id);
+    block_id += module.no_blocks;
+    scene.AddViewable(std::unique_ptr<ViewableInstance>(new ViewableInstance(
+            module.scene, cur_matrix, det_offset)));
+    return (true);
+}
+
 void Load::SetCameraView(SceneDescription& scene) {
     constexpr double deg_to_rad = M_PI / 180.0;
     double fov_angle = fov_angle_deg * deg_to_rad;
@@ -1025,3 +1462,45 @@ void Load::DisableRayleigh(SceneDescription& scene) {
         stats.DisableRayleigh();
     }
 }
+
+std::vector<GammaMaterial*> Load::UsedMaterials() const {
+    return (std::vector<GammaMaterial*>(used_materials.begin(),
+                                        used_materials.end()));
+}
+
+void Load::BuildMaterials(const std::vector<GammaMaterial*>& materials,
+                          int no_threads)
+{
+    // Each material is built independently, so hand them out in turn to a
+    // task per thread.
+    const int no_tasks = std::max(
+            1, std::min(no_threads, static_cast<int>(materials.size())));
+    std::vector<std::future<void>> tasks;
+    for (int task = 0; task < no_tasks; ++task) {
+        tasks.push_back(std::async(std::launch::async,
+                                   [&materials, task, no_tasks]() {
+            for (size_t idx = task; idx < materials.size(); idx += no_tasks) {
+                materials[idx]->BuildTables();
+            }
+        }));
+    }
+    for (auto& task: tasks) {
+        task.get();
+    }
+}
+
+/*!
+ * Keeps the exact attenuation of every material at each of the energies, such
+ * as those emitted by the isotopes, rather than looking it up in the table.
+ */
+void Load::CacheEnergies(SceneDescription& scene,
+                         const std::vector<double>& energies)
+{
+    for (size_t idx = 0; idx < scene.NumMaterials(); ++idx) {
+        GammaMaterial& material = static_cast<GammaMaterial&>(
+                scene.GetMaterial(idx));
+        for (double energy: energies) {
+            material.CacheEnergy(energy);
+        }
+    }
+}
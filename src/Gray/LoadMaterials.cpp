@@ -21,9 +21,8 @@ std::vector<double> LoadMaterials::VectorizeArray(const Json::Value & array) {
     return (values);
 }
 
-bool LoadMaterials::LoadMaterialJson(SceneDescription& scene,
-                                     const std::string & mat_name,
-                                     const Json::Value & mat_info)
+bool LoadMaterials::CheckMaterialJson(const std::string & mat_name,
+                                      const Json::Value & mat_info)
 {
     auto required_vals = {
         "density",
@@ -43,6 +42,16 @@ bool LoadMaterials::LoadMaterialJson(SceneDescription& scene,
             return (false);
         }
     }
+    return (true);
+}
+
+bool LoadMaterials::LoadMaterialJson(SceneDescription& scene,
+                                     const std::string & mat_name,
+                                     const Json::Value & mat_info)
+{
+    if (!CheckMaterialJson(mat_name, mat_info)) {
+        return (false);
+    }
     double density = mat_info["density"].asDouble();
     int index = mat_info["index"].asInt();
     bool sensitive = mat_info["sensitive"].asBool();
@@ -98,7 +107,11 @@ bool LoadMaterials::LoadPhysicsJson(SceneDescription& scene,
             return (false);
         }
     }
+    AddDefaultMaterial(scene);
+    return (true);
+}
 
+void LoadMaterials::AddDefaultMaterial(SceneDescription& scene) {
     // Create a dummy material through which the photons can propogate without
     // interacting.  This just makes the logic easier to propogate photons
     // through space where there is no material.  If the user wants a
@@ -120,5 +133,4 @@ bool LoadMaterials::LoadPhysicsJson(SceneDescription& scene,
             std::move(stats)));
     scene.AddMaterial(std::move(default_mat));
     scene.SetDefaultMaterial(def_mat_name);
-    return (true);
 }
@@ -0,0 +1,53 @@
+/*
+ * Gray: A Ray Tracing-based Monte Carlo Simulator for PET
+ *
+ * Copyright (c) 2018, David Freese, Peter Olcott, Sam Buss, Craig Levin
+ *
+ * This software is distributed under the terms of the MIT License unless
+ * otherwise noted.  See LICENSE for further details.
+ *
+ */
+
+#include "Gray/Gray/MappedFile.h"
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <fstream>
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& filename) {
+#ifdef _WIN32
+    std::ifstream input(filename, std::ios::binary);
+    buffer.assign(std::istreambuf_iterator<char>(input),
+                  std::istreambuf_iterator<char>());
+    data = buffer.empty() ? nullptr : buffer.data();
+    size = buffer.size();
+#else
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    struct stat info;
+    if ((fstat(fd, &info) == 0) && (info.st_size > 0)) {
+        void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE,
+                            fd, 0);
+        if (mapped != MAP_FAILED) {
+            data = static_cast<const char*>(mapped);
+            size = info.st_size;
+        }
+    }
+    close(fd);
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+    if (data) {
+        munmap(const_cast<char*>(data), size);
+    }
+#endif
+}
@@ -0,0 +1,278 @@
+#include "Gray/Gray/MaterialGrid.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <future>
+#include <map>
+#include <stdexcept>
+#include "Gray/Graphics/SceneDescription.h"
+#include "Gray/Graphics/ViewableBase.h"
+#include "Gray/Graphics/VisiblePoint.h"
+#include "Gray/Gray/GammaRayTrace.h"
+#include "Gray/Sources/Source.h"
+#include "Gray/Sources/SourceList.h"
+
+namespace {
+typedef std::vector<const ViewableBase*> ObjectList;
+
+ObjectList Overlapping(const AABB& box, const ObjectList& objects)
+{
+    ObjectList overlapping;
+    for (const ViewableBase* obj: objects) {
+        AABB obj_box = obj->GetAABB();
+        obj_box.IntersectAgainst(box);
+        if (!obj_box.IsEmpty()) {
+            overlapping.push_back(obj);
+        }
+    }
+    return (overlapping);
+}
+
+/*!
+ * Checks if point is inside of a closed object by whether the first surface
+ * of it that a ray from the point hits is a back face.
+ */
+bool Inside(const ViewableBase& obj, const VectorR3& point)
+{
+    VisiblePoint vis_point;
+    double dist;
+    if (!obj.FindIntersection(point, VectorR3(1, 0, 0), DBL_MAX, &dist,
+                              vis_point))
+    {
+        return (false);
+    }
+    return (vis_point.IsBackFacing());
+}
+
+/*!
+ * Returns true if none of the objects have a surface passing through the box.
+ * This is conservative, as only convex objects are checked for the box being
+ * inside of them, by having all eight corners inside.  Any other object that
+ * reaches into the box is counted as having a surface in it.
+ */
+bool NoSurfaceIn(const AABB& box, const ObjectList& objects)
+{
+    const VectorR3& lo = box.GetBoxMin();
+    const VectorR3& hi = box.GetBoxMax();
+    for (const ViewableBase* obj: objects) {
+        AABB extents;
+        if (!obj->CalcExtentsInBox(box, extents)) {
+            continue;
+        }
+        if (!obj->IsConvex()) {
+            return (false);
+        }
+        for (int corner = 0; corner < 8; ++corner) {
+            const VectorR3 point((corner & 1) ? hi.x : lo.x,
+                                 (corner & 2) ? hi.y : lo.y,
+                                 (corner & 4) ? hi.z : lo.z);
+            if (!Inside(*obj, point)) {
+                return (false);
+            }
+        }
+    }
+    return (true);
+}
+}
+
+constexpr int MaterialGrid::max_cells_per_axis;
+constexpr int MaterialGrid::refine;
+constexpr int MaterialGrid::fine_per_cell;
+constexpr double MaterialGrid::region_padding;
+constexpr int MaterialGrid::unresolved;
+constexpr int MaterialGrid::refined_base;
+
+// The cells of one z slab of the grid, with stacks indexed locally to the
+// slab so that slabs can be built in parallel.
+struct MaterialGrid::SlabResult {
+    std::vector<int> cells;
+    std::vector<int> fine_cells;
+    std::vector<Stack> stacks;
+    std::map<Stack, int> stack_index;
+
+    int CellValue(const SceneDescription& scene, const AABB& box)
+    {
+        const VectorR3 center = (box.GetBoxMin() + box.GetBoxMax()) / 2.0;
+        Stack stack;
+        try {
+            stack = GammaRayTrace::BuildStack(scene, center);
+        } catch (const std::runtime_error&) {
+            // Leave overlaps for the ray tracing to report.
+            return (unresolved);
+        }
+        auto iter = stack_index.find(stack);
+        if (iter != stack_index.end()) {
+            return (iter->second);
+        }
+        const int idx = static_cast<int>(stacks.size());
+        stack_index.emplace(stack, idx);
+        stacks.push_back(stack);
+        return (idx);
+    }
+};
+
+MaterialGrid::MaterialGrid(const SceneDescription& scene, const AABB& region,
+                           int no_threads) :
+    grid_min(region.GetBoxMin()),
+    cell_size(1.0),
+    nx(0),
+    ny(0),
+    nz(0)
+{
+    const VectorR3 size = region.GetBoxMax() - region.GetBoxMin();
+    const double longest = std::max({size.x, size.y, size.z});
+    if (region.IsEmpty() || !(longest > 0)) {
+        return;
+    }
+    cell_size = longest / max_cells_per_axis;
+    nx = std::max(1, static_cast<int>(std::ceil(size.x / cell_size)));
+    ny = std::max(1, static_cast<int>(std::ceil(size.y / cell_size)));
+    nz = std::max(1, static_cast<int>(std::ceil(size.z / cell_size)));
+
+    std::vector<SlabResult> slabs(nz);
+    const int no_tasks = std::max(1, std::min(no_threads, nz));
+    std::vector<std::future<void>> tasks;
+    for (int task = 0; task < no_tasks; ++task) {
+        tasks.push_back(std::async(std::launch::async,
+                                   [this, &scene, &slabs, task, no_tasks]() {
+            for (int iz = task; iz < nz; iz += no_tasks) {
+                BuildSlab(scene, iz, slabs[iz]);
+            }
+        }));
+    }
+    for (auto& task: tasks) {
+        task.get();
+    }
+
+    // Merge the slabs, giving each distinct stack a single index.
+    std::map<Stack, int> stack_index;
+    cells.reserve(static_cast<size_t>(nx) * ny * nz);
+    for (const SlabResult& slab: slabs) {
+        std::vector<int> remap(slab.stacks.size());
+        for (size_t ii = 0; ii < slab.stacks.size(); ++ii) {
+            auto iter = stack_index.find(slab.stacks[ii]);
+            if (iter == stack_index.end()) {
+                iter = stack_index.emplace(slab.stacks[ii],
+                                           static_cast<int>(stacks.size())).first;
+                stacks.push_back(slab.stacks[ii]);
+            }
+            remap[ii] = iter->second;
+        }
+        const int block_offset = static_cast<int>(NumRefinedCells());
+        for (int value: slab.cells) {
+            if (value >= 0) {
+                value = remap[value];
+            } else if (value <= refined_base) {
+                value -= block_offset;
+            }
+            cells.push_back(value);
+        }
+        for (int value: slab.fine_cells) {
+            fine_cells.push_back(value >= 0 ? remap[value] : value);
+        }
+    }
+}
+
+void MaterialGrid::BuildSlab(const SceneDescription& scene, int iz,
+                             SlabResult& result) const
+{
+    ObjectList all(scene.NumViewables());
+    for (size_t ii = 0; ii < all.size(); ++ii) {
+        all[ii] = &scene.GetViewable(ii);
+    }
+    const double z0 = grid_min.z + iz * cell_size;
+    const double y_end = grid_min.y + ny * cell_size;
+    const double x_end = grid_min.x + nx * cell_size;
+    const ObjectList slab_objects = Overlapping(
+            AABB(VectorR3(grid_min.x, grid_min.y, z0),
+                 VectorR3(x_end, y_end, z0 + cell_size)), all);
+
+    const double fine_size = cell_size / refine;
+    result.cells.resize(static_cast<size_t>(nx) * ny);
+    for (int iy = 0; iy < ny; ++iy) {
+        const double y0 = grid_min.y + iy * cell_size;
+        const ObjectList row_objects = Overlapping(
+                AABB(VectorR3(grid_min.x, y0, z0),
+                     VectorR3(x_end, y0 + cell_size, z0 + cell_size)),
+                slab_objects);
+        for (int ix = 0; ix < nx; ++ix) {
+            const VectorR3 lo(grid_min.x + ix * cell_size, y0, z0);
+            const AABB box(lo, lo + VectorR3(cell_size, cell_size, cell_size));
+            const ObjectList objects = Overlapping(box, row_objects);
+            int& value = result.cells[iy * nx + ix];
+            if (NoSurfaceIn(box, objects)) {
+                value = result.CellValue(scene, box);
+                continue;
+            }
+            value = refined_base -
+                    static_cast<int>(result.fine_cells.size() / fine_per_cell);
+            for (int jz = 0; jz < refine; ++jz) {
+                for (int jy = 0; jy < refine; ++jy) {
+                    for (int jx = 0; jx < refine; ++jx) {
+                        const VectorR3 fine_lo = lo + VectorR3(jx, jy, jz) *
+                                                 fine_size;
+                        const AABB fine_box(fine_lo, fine_lo +
+                                VectorR3(fine_size, fine_size, fine_size));
+                        if (NoSurfaceIn(fine_box, objects)) {
+                            result.fine_cells.push_back(
+                                    result.CellValue(scene, fine_box));
+                        } else {
+                            result.fine_cells.push_back(unresolved);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+const MaterialGrid::Stack* MaterialGrid::Lookup(const VectorR3& pos) const
+{
+    const double fx = (pos.x - grid_min.x) / cell_size;
+    const double fy = (pos.y - grid_min.y) / cell_size;
+    const double fz = (pos.z - grid_min.z) / cell_size;
+    // Written so that NaN falls outside of the grid.
+    if (!((fx >= 0) && (fx < nx) && (fy >= 0) && (fy < ny) &&
+          (fz >= 0) && (fz < nz)))
+    {
+        return (nullptr);
+    }
+    const int ix = static_cast<int>(fx);
+    const int iy = static_cast<int>(fy);
+    const int iz = static_cast<int>(fz);
+    int value = cells[(static_cast<size_t>(iz) * ny + iy) * nx + ix];
+    if (value <= refined_base) {
+        const int jx = std::min(static_cast<int>((fx - ix) * refine),
+                                refine - 1);
+        const int jy = std::min(static_cast<int>((fy - iy) * refine),
+                                refine - 1);
+        const int jz = std::min(static_cast<int>((fz - iz) * refine),
+                                refine - 1);
+        const size_t block = refined_base - value;
+        value = fine_cells[block * fine_per_cell +
+                           (jz * refine + jy) * refine + jx];
+    }
+    if (value == unresolved) {
+        return (nullptr);
+    }
+    return (&stacks[value]);
+}
+
+size_t MaterialGrid::NumUnresolvedCells() const
+{
+    return (std::count(cells.begin(), cells.end(), unresolved) +
+            std::count(fine_cells.begin(), fine_cells.end(), unresolved));
+}
+
+AABB MaterialGrid::SourceRegion(const SourceList& sources)
+{
+    if (sources.NumSources() == 0) {
+        return (AABB(VectorR3(0, 0, 0), VectorR3(0, 0, 0)));
+    }
+    AABB region = sources.GetSource(0)->GetExtents();
+    for (size_t idx = 1; idx < sources.NumSources(); ++idx) {
+        region.EnlargeToEnclose(sources.GetSource(idx)->GetExtents());
+    }
+    const VectorR3 padding(region_padding, region_padding, region_padding);
+    return (AABB(region.GetBoxMin() - padding, region.GetBoxMax() + padding));
+}
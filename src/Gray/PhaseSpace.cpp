@@ -0,0 +1,234 @@
+/*
+ * Gray: A Ray Tracing-based Monte Carlo Simulator for PET
+ *
+ * Copyright (c) 2018, David Freese, Peter Olcott, Sam Buss, Craig Levin
+ *
+ * This software is distributed under the terms of the MIT License unless
+ * otherwise noted.  See LICENSE for further details.
+ *
+ */
+
+#include "Gray/Gray/PhaseSpace.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include "Gray/Physics/Photon.h"
+
+namespace {
+constexpr uint32_t byte_order_mark = 0x01020304;
+constexpr size_t buffer_size = 1 << 16;
+
+uint8_t Saturate(int count) {
+    return (static_cast<uint8_t>(std::min(std::max(count, 0), 255)));
+}
+
+/*!
+ * The distance along dir until pos leaves the slab from -half to half along
+ * one axis, or DBL_MAX if it's moving parallel to it.
+ */
+double SlabExit(double pos, double dir, double half) {
+    if (dir > 0) {
+        return ((half - pos) / dir);
+    } else if (dir < 0) {
+        return ((-half - pos) / dir);
+    }
+    return (DBL_MAX);
+}
+}
+
+PhaseSpace::Record PhaseSpace::MakeRecord(const Photon& photon,
+                                          double decay_time)
+{
+    static_assert(sizeof(Record) == 64, "Record is expected to be packed");
+    Record record;
+    std::memset(&record, 0, sizeof(record));
+    record.decay_time = decay_time;
+    for (int axis = 0; axis < 3; ++axis) {
+        record.pos[axis] = static_cast<float>(photon.GetPos()[axis]);
+        record.dir[axis] = static_cast<float>(photon.GetDir()[axis]);
+    }
+    record.energy = static_cast<float>(photon.GetEnergy());
+    record.time = static_cast<float>(photon.GetTime() - decay_time);
+    record.weight = static_cast<float>(photon.GetWeight());
+    record.roulette_weight = static_cast<float>(photon.GetRouletteWeight());
+    record.decay_id = photon.GetId();
+    record.src_id = photon.GetSrc();
+    record.color = static_cast<uint8_t>(photon.GetColor());
+    record.scatter_compton_phantom =
+            Saturate(photon.GetScatterComptonPhantom());
+    record.scatter_compton_detector =
+            Saturate(photon.GetScatterComptonDetector());
+    record.scatter_rayleigh_phantom =
+            Saturate(photon.GetScatterRayleighPhantom());
+    record.scatter_rayleigh_detector =
+            Saturate(photon.GetScatterRayleighDetector());
+    record.xray_flouresence = Saturate(photon.GetXrayFlouresence());
+    return (record);
+}
+
+Photon PhaseSpace::MakePhoton(const Record& record, int decay_id) {
+    VectorR3 dir(record.dir[0], record.dir[1], record.dir[2]);
+    dir.Normalize();
+    Photon photon(VectorR3(record.pos[0], record.pos[1], record.pos[2]), dir,
+                  record.energy, record.decay_time + record.time, decay_id,
+                  static_cast<Photon::Color>(record.color), record.src_id);
+    photon.SetScatters(record.scatter_compton_phantom,
+                       record.scatter_compton_detector,
+                       record.scatter_rayleigh_phantom,
+                       record.scatter_rayleigh_detector,
+                       record.xray_flouresence);
+    photon.SetRouletteWeight(record.roulette_weight);
+    photon.SetWeight(record.weight);
+    return (photon);
+}
+
+bool PhaseSpace::ReadHeader(const char* data, size_t size, AABB& extents) {
+    Header header;
+    if (!data || (size < sizeof(header))) {
+        return (false);
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if ((std::memcmp(header.magic, magic, sizeof(magic)) != 0) ||
+        (header.version != version) ||
+        (header.byte_order != byte_order_mark) ||
+        (header.record_size != sizeof(Record)) ||
+        ((size - sizeof(header)) % sizeof(Record) != 0))
+    {
+        return (false);
+    }
+    extents.Set({header.min[0], header.min[1], header.min[2]},
+                {header.max[0], header.max[1], header.max[2]});
+    return (true);
+}
+
+std::shared_ptr<PhaseSpace::Surface> PhaseSpace::Surface::Box(
+        const VectorR3& center, const VectorR3& size)
+{
+    std::shared_ptr<Surface> surface(new Surface());
+    surface->shape = Shape::BOX;
+    surface->center = center;
+    surface->half_size = size / 2.0;
+    return (surface);
+}
+
+std::shared_ptr<PhaseSpace::Surface> PhaseSpace::Surface::Cylinder(
+        const VectorR3& center, const VectorR3& axis, double radius,
+        double height)
+{
+    std::shared_ptr<Surface> surface(new Surface());
+    surface->shape = Shape::CYLINDER;
+    surface->center = center;
+    surface->half_size = VectorR3(radius, 0, height / 2.0);
+    surface->axis = axis;
+    surface->axis.Normalize();
+    return (surface);
+}
+
+bool PhaseSpace::Surface::Inside(const VectorR3& pos) const {
+    const VectorR3 rel = pos - center;
+    if (shape == Shape::BOX) {
+        return ((std::abs(rel.x) <= half_size.x) &&
+                (std::abs(rel.y) <= half_size.y) &&
+                (std::abs(rel.z) <= half_size.z));
+    }
+    const double along = rel ^ axis;
+    const VectorR3 radial = rel - along * axis;
+    return ((std::abs(along) <= half_size.z) &&
+            (radial.NormSq() <= half_size.x * half_size.x));
+}
+
+double PhaseSpace::Surface::ExitDistance(const VectorR3& pos,
+                                         const VectorR3& dir) const
+{
+    if (!Inside(pos)) {
+        return (-1);
+    }
+    const VectorR3 rel = pos - center;
+    if (shape == Shape::BOX) {
+        return (std::min({SlabExit(rel.x, dir.x, half_size.x),
+                          SlabExit(rel.y, dir.y, half_size.y),
+                          SlabExit(rel.z, dir.z, half_size.z)}));
+    }
+    const double along = rel ^ axis;
+    const double dir_along = dir ^ axis;
+    double dist = SlabExit(along, dir_along, half_size.z);
+    // Solve for where the radial part of the path reaches the radius.  pos is
+    // inside, so there is always one root past it.
+    const VectorR3 radial = rel - along * axis;
+    const VectorR3 dir_radial = dir - dir_along * axis;
+    const double a = dir_radial.NormSq();
+    if (a > 0) {
+        const double b = radial ^ dir_radial;
+        const double c = radial.NormSq() - half_size.x * half_size.x;
+        const double disc = std::max(b * b - a * c, 0.0);
+        dist = std::min(dist, (-b + std::sqrt(disc)) / a);
+    }
+    return (std::max(dist, 0.0));
+}
+
+AABB PhaseSpace::Surface::GetExtents() const {
+    if (shape == Shape::BOX) {
+        return (AABB(center - half_size, center + half_size));
+    }
+    // The cylinder reaches furthest along each axis at the rim of one of its
+    // caps.
+    double half[3];
+    for (int idx = 0; idx < 3; ++idx) {
+        const double a = std::abs(axis[idx]);
+        half[idx] = (a * half_size.z +
+                     std::sqrt(std::max(1 - a * a, 0.0)) * half_size.x);
+    }
+    const VectorR3 half_extent(half[0], half[1], half[2]);
+    return (AABB(center - half_extent, center + half_extent));
+}
+
+PhaseSpace::Writer::Writer(std::shared_ptr<const Surface> surface) :
+    surface(surface)
+{
+}
+
+bool PhaseSpace::Writer::Open(const std::string& filename, bool write_header)
+{
+    this->filename = filename;
+    output.open(filename, std::ios::binary);
+    if (!output) {
+        return (false);
+    }
+    buffer.reserve(buffer_size);
+    if (write_header) {
+        Header header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, magic, sizeof(magic));
+        header.version = version;
+        header.byte_order = byte_order_mark;
+        header.record_size = sizeof(Record);
+        const AABB extents = surface->GetExtents();
+        header.min[0] = extents.GetMinX();
+        header.min[1] = extents.GetMinY();
+        header.min[2] = extents.GetMinZ();
+        header.max[0] = extents.GetMaxX();
+        header.max[1] = extents.GetMaxY();
+        header.max[2] = extents.GetMaxZ();
+        output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+    return (static_cast<bool>(output));
+}
+
+void PhaseSpace::Writer::Write(const Photon& photon, double decay_time) {
+    buffer.push_back(MakeRecord(photon, decay_time));
+    if (buffer.size() >= buffer_size) {
+        Flush();
+    }
+}
+
+void PhaseSpace::Writer::Flush() {
+    output.write(reinterpret_cast<const char*>(buffer.data()),
+                 buffer.size() * sizeof(Record));
+    buffer.clear();
+}
+
+void PhaseSpace::Writer::Close() {
+    Flush();
+    output.close();
+}
@@ -0,0 +1,441 @@
+/*
+ * Gray: A Ray Tracing-based Monte Carlo Simulator for PET
+ *
+ * Copyright (c) 2018, David Freese, Peter Olcott, Sam Buss, Craig Levin
+ *
+ * This software is distributed under the terms of the MIT License unless
+ * otherwise noted.  See LICENSE for further details.
+ *
+ */
+
+#include "Gray/Gray/PhysicsFile.h"
+#include <sys/stat.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <vector>
+#include "Gray/Graphics/SceneDescription.h"
+#include "Gray/Gray/GammaMaterial.h"
+#include "Gray/Gray/LoadMaterials.h"
+#include "Gray/Physics/GammaStats.h"
+#include "Gray/Sources/SourceList.h"
+#include "Gray/json/json.h"
+
+namespace {
+// Written to the header so that a file from a machine of the other byte order
+// is rejected.
+constexpr uint32_t byte_order_mark = 0x01020304;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order_mark;
+    uint64_t size;
+    uint64_t no_materials;
+    uint64_t no_isotopes;
+};
+
+// The kinds of isotope values, which are kept as they were in the json so
+// that SourceList::IsotopeFactory can interpret them as usual.
+enum class ValueType : uint64_t {
+    Number = 0,
+    String = 1,
+    Bool = 2,
+};
+
+// The arrays of each material, in the order they are stored.
+const char* const material_arrays[] = {
+    "energy",
+    "matten_comp",
+    "matten_phot",
+    "matten_rayl",
+    "x",
+    "form_factor",
+    "scattering_func",
+};
+constexpr size_t no_material_arrays = 7;
+
+size_t Padding(size_t pos) {
+    return ((8 - (pos % 8)) % 8);
+}
+
+class Writer {
+public:
+    Writer(std::ostream& output) : output(output) {}
+    void Write(const void* data, size_t size) {
+        output.write(static_cast<const char*>(data), size);
+        pos += size;
+        static const char zeros[8] = {};
+        const size_t padding = Padding(pos);
+        output.write(zeros, padding);
+        pos += padding;
+    }
+    void Write(uint64_t val) {
+        Write(&val, sizeof(val));
+    }
+    void Write(double val) {
+        Write(&val, sizeof(val));
+    }
+    void Write(const std::string& val) {
+        Write(static_cast<uint64_t>(val.size()));
+        Write(val.data(), val.size());
+    }
+    void Write(const std::vector<double>& vals) {
+        Write(static_cast<uint64_t>(vals.size()));
+        Write(vals.data(), vals.size() * sizeof(double));
+    }
+    size_t Position() const {
+        return (pos);
+    }
+
+private:
+    std::ostream& output;
+    size_t pos = 0;
+};
+
+class Reader {
+public:
+    Reader(const char* data, size_t size) : data(data), size(size) {}
+    // Returns a pointer to count values in place, or nullptr if the file is
+    // too short.  The values are aligned, as every one starts on a multiple
+    // of 8 bytes from the start of the data, which must itself be aligned.
+    template<typename T>
+    const T* Take(size_t count) {
+        if (count > (size - pos) / sizeof(T)) {
+            return (nullptr);
+        }
+        const T* vals = reinterpret_cast<const T*>(data + pos);
+        pos += count * sizeof(T);
+        pos = std::min(size, pos + Padding(pos));
+        return (vals);
+    }
+    bool Read(uint64_t& val) {
+        const uint64_t* ptr = Take<uint64_t>(1);
+        if (ptr) {
+            val = *ptr;
+        }
+        return (ptr != nullptr);
+    }
+    bool Read(double& val) {
+        const double* ptr = Take<double>(1);
+        if (ptr) {
+            val = *ptr;
+        }
+        return (ptr != nullptr);
+    }
+    bool Read(std::string& val) {
+        uint64_t len;
+        if (!Read(len)) {
+            return (false);
+        }
+        const char* ptr = Take<char>(len);
+        if (ptr) {
+            val.assign(ptr, len);
+        }
+        return (ptr != nullptr);
+    }
+    bool Read(std::vector<double>& vals) {
+        uint64_t len;
+        if (!Read(len)) {
+            return (false);
+        }
+        const double* ptr = Take<double>(len);
+        if (ptr) {
+            vals.assign(ptr, ptr + len);
+        }
+        return (ptr != nullptr);
+    }
+
+private:
+    const char* data;
+    size_t size;
+    size_t pos = 0;
+};
+
+struct MaterialRecord {
+    std::string name;
+    uint64_t index;
+    uint64_t sensitive;
+    double density;
+    std::vector<double> arrays[no_material_arrays];
+};
+
+/*!
+ * Reads the whole of filename into contents, which holds 8 byte values so
+ * that the data is aligned for Reader.
+ */
+bool ReadFile(const std::string& filename, std::vector<uint64_t>& contents,
+              size_t& size)
+{
+    std::ifstream input(filename, std::ios::binary | std::ios::ate);
+    if (!input) {
+        return (false);
+    }
+    size = static_cast<size_t>(input.tellg());
+    contents.resize((size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    input.seekg(0);
+    return (static_cast<bool>(input.read(
+            reinterpret_cast<char*>(contents.data()), size)));
+}
+
+bool ModifiedTime(const std::string& filename, time_t& mtime) {
+    struct stat info;
+    if (stat(filename.c_str(), &info) != 0) {
+        return (false);
+    }
+    mtime = info.st_mtime;
+    return (true);
+}
+}
+
+bool PhysicsFile::Compile(std::istream& json_input, std::ostream& output) {
+    Json::Value root;
+    Json::Reader reader;
+    if (!reader.parse(json_input, root, /*collect_comments=*/false)) {
+        std::cerr << "Reading of physics file failed\n"
+                  << reader.getFormattedErrorMessages() << "\n";
+        return (false);
+    }
+    const Json::Value& materials = root["materials"];
+    const Json::Value& isotopes = root["isotopes"];
+    if (!materials.isObject() || !isotopes.isObject()) {
+        std::cerr << "Physics file requires \"materials\" and \"isotopes\"\n";
+        return (false);
+    }
+
+    Header header;
+    std::memcpy(header.magic, magic, sizeof(header.magic));
+    header.version = version;
+    header.byte_order_mark = byte_order_mark;
+    // The size is filled in at the end.
+    header.size = 0;
+    header.no_materials = materials.size();
+    header.no_isotopes = isotopes.size();
+    const std::ostream::pos_type start = output.tellp();
+    Writer writer(output);
+    writer.Write(&header, sizeof(header));
+
+    for (const std::string& mat_name: materials.getMemberNames()) {
+        const Json::Value& mat_info = materials[mat_name];
+        if (!LoadMaterials::CheckMaterialJson(mat_name, mat_info)) {
+            return (false);
+        }
+        writer.Write(mat_name);
+        writer.Write(static_cast<uint64_t>(mat_info["index"].asInt()));
+        writer.Write(static_cast<uint64_t>(mat_info["sensitive"].asBool()));
+        writer.Write(mat_info["density"].asDouble());
+        for (const char* array: material_arrays) {
+            writer.Write(LoadMaterials::VectorizeArray(mat_info[array]));
+        }
+    }
+
+    for (const std::string& iso_name: isotopes.getMemberNames()) {
+        const Json::Value& isotope = isotopes[iso_name];
+        if (!isotope.isObject()) {
+            std::cerr << "Invalid isotope, \"" << iso_name << "\"\n";
+            return (false);
+        }
+        writer.Write(iso_name);
+        writer.Write(static_cast<uint64_t>(isotope.size()));
+        for (const std::string& key: isotope.getMemberNames()) {
+            const Json::Value& val = isotope[key];
+            writer.Write(key);
+            if (val.isBool()) {
+                writer.Write(static_cast<uint64_t>(ValueType::Bool));
+                writer.Write(static_cast<uint64_t>(val.asBool()));
+            } else if (val.isNumeric()) {
+                writer.Write(static_cast<uint64_t>(ValueType::Number));
+                writer.Write(val.asDouble());
+            } else if (val.isString()) {
+                writer.Write(static_cast<uint64_t>(ValueType::String));
+                writer.Write(val.asString());
+            } else {
+                std::cerr << "Unsupported value for \"" << key
+                          << "\" in isotope \"" << iso_name << "\"\n";
+                return (false);
+            }
+        }
+    }
+
+    header.size = writer.Position();
+    output.seekp(start);
+    output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    output.seekp(0, std::ios::end);
+    return (static_cast<bool>(output));
+}
+
+bool PhysicsFile::Compile(const std::string& json_filename,
+                          const std::string& output_filename)
+{
+    std::ifstream input(json_filename);
+    if (!input) {
+        std::cerr << "Unable to open physics file: " << json_filename << "\n";
+        return (false);
+    }
+    std::ofstream output(output_filename, std::ios::binary);
+    if (!output) {
+        std::cerr << "Unable to open output file: " << output_filename << "\n";
+        return (false);
+    }
+    return (Compile(input, output));
+}
+
+std::string PhysicsFile::CompiledFilename(const std::string& json_filename) {
+    const std::string ext = ".json";
+    if ((json_filename.size() >= ext.size()) &&
+        (json_filename.compare(json_filename.size() - ext.size(), ext.size(),
+                               ext) == 0))
+    {
+        return (json_filename.substr(0, json_filename.size() - ext.size()) +
+                ".bin");
+    }
+    return (json_filename + ".bin");
+}
+
+bool PhysicsFile::IsCompiled(const char* data, size_t size) {
+    if (!data || (size < sizeof(Header))) {
+        return (false);
+    }
+    Header header;
+    std::memcpy(&header, data, sizeof(header));
+    return ((std::memcmp(header.magic, magic, sizeof(magic)) == 0) &&
+            (header.version == version) &&
+            (header.byte_order_mark == byte_order_mark) &&
+            (header.size == size));
+}
+
+bool PhysicsFile::LoadCompiled(const char* data, size_t size,
+                               SceneDescription& scene, SourceList& sources)
+{
+    if (!IsCompiled(data, size)) {
+        return (false);
+    }
+    Header header;
+    std::memcpy(&header, data, sizeof(header));
+    Reader reader(data, size);
+    reader.Take<Header>(1);
+
+    // Read everything before adding any of it, so that a bad file leaves the
+    // scene and sources as they were.
+    std::vector<MaterialRecord> materials(header.no_materials);
+    for (MaterialRecord& mat: materials) {
+        if (!reader.Read(mat.name) || !reader.Read(mat.index) ||
+            !reader.Read(mat.sensitive) || !reader.Read(mat.density))
+        {
+            return (false);
+        }
+        for (std::vector<double>& array: mat.arrays) {
+            if (!reader.Read(array)) {
+                return (false);
+            }
+        }
+    }
+    std::vector<std::pair<std::string, Json::Value>> isotopes(
+            header.no_isotopes);
+    for (auto& iso_pair: isotopes) {
+        uint64_t no_values;
+        if (!reader.Read(iso_pair.first) || !reader.Read(no_values)) {
+            return (false);
+        }
+        for (uint64_t ii = 0; ii < no_values; ++ii) {
+            std::string key;
+            uint64_t type;
+            if (!reader.Read(key) || !reader.Read(type)) {
+                return (false);
+            }
+            Json::Value& val = iso_pair.second[key];
+            switch (static_cast<ValueType>(type)) {
+                case ValueType::Number: {
+                    double number;
+                    if (!reader.Read(number)) {
+                        return (false);
+                    }
+                    val = number;
+                    break;
+                }
+                case ValueType::String: {
+                    std::string str;
+                    if (!reader.Read(str)) {
+                        return (false);
+                    }
+                    val = str;
+                    break;
+                }
+                case ValueType::Bool: {
+                    uint64_t flag;
+                    if (!reader.Read(flag)) {
+                        return (false);
+                    }
+                    val = (flag != 0);
+                    break;
+                }
+                default: {
+                    return (false);
+                }
+            }
+        }
+    }
+
+    for (const auto& iso_pair: isotopes) {
+        if (!sources.AddIsotope(iso_pair.first, iso_pair.second)) {
+            return (false);
+        }
+    }
+    for (MaterialRecord& mat: materials) {
+        GammaStats stats(mat.density, std::move(mat.arrays[0]),
+                         std::move(mat.arrays[1]), std::move(mat.arrays[2]),
+                         std::move(mat.arrays[3]), std::move(mat.arrays[4]),
+                         std::move(mat.arrays[5]), std::move(mat.arrays[6]));
+        scene.AddMaterial(std::unique_ptr<GammaMaterial>(new GammaMaterial(
+                static_cast<int>(mat.index), mat.name, mat.sensitive != 0,
+                true, std::move(stats))));
+    }
+    LoadMaterials::AddDefaultMaterial(scene);
+    return (true);
+}
+
+bool PhysicsFile::Load(const std::string& filename, SceneDescription& scene,
+                       SourceList& sources)
+{
+    std::string compiled;
+    std::vector<uint64_t> contents;
+    size_t size = 0;
+    if (ReadFile(filename, contents, size) &&
+        IsCompiled(reinterpret_cast<const char*>(contents.data()), size))
+    {
+        compiled = filename;
+    } else {
+        contents.clear();
+        const std::string candidate = CompiledFilename(filename);
+        time_t json_time;
+        time_t compiled_time;
+        if (ModifiedTime(candidate, compiled_time)) {
+            if (!ModifiedTime(filename, json_time) ||
+                (compiled_time >= json_time))
+            {
+                compiled = candidate;
+                if (!ReadFile(candidate, contents, size)) {
+                    contents.clear();
+                }
+            } else {
+                std::cerr << "Warning: \"" << candidate << "\" is older than \""
+                          << filename << "\", and is ignored\n";
+            }
+        }
+    }
+    if (!contents.empty()) {
+        if (LoadCompiled(reinterpret_cast<const char*>(contents.data()), size,
+                         scene, sources))
+        {
+            return (true);
+        }
+        std::cerr << "Warning: unable to load compiled physics file \""
+                  << compiled << "\"\n";
+        if (compiled == filename) {
+            return (false);
+        }
+    }
+    return (sources.LoadIsotopes(filename) &&
+            LoadMaterials::LoadPhysicsJson(scene, filename));
+}
@@ -19,18 +19,23 @@ Simulation::Simulation(
         const SceneDescription& scene,
         const SourceList& sources,
         const DaqModel& daq_model,
-        size_t thread_idx, size_t no_threads) :
+        size_t thread_idx, size_t no_threads,
+        std::shared_ptr<const MaterialGrid> material_grid,
+        std::shared_ptr<const DetectorResponse> detector_response) :
     outputs_coinc(daq_model.no_coinc_processes()),
     sources(sources),
     daq_model(daq_model),
     thread_idx(thread_idx),
     scene(scene),
-    config(config)
+    config(config),
+    material_grid(material_grid),
+    detector_response(detector_response)
 {
     if (no_threads > 1) {
         this->sources.AdjustTimeForSplit(thread_idx, no_threads);
         Random::SetSeed(Random::GetSeed() + thread_idx);
     }
+    seed = Random::GetSeed();
     this->sources.InitSources();
 
     string output_append;
@@ -72,6 +77,13 @@ Simulation::Simulation(
                     write_header);
         }
     }
+    if (config.get_log_phase_space()) {
+        output_phase_space.reset(new PhaseSpace::Writer(
+                config.get_phase_space_surface()));
+        success &= output_phase_space->Open(
+                config.get_filename_phase_space() + output_append,
+                write_header);
+    }
 
     if (!success) {
         throw std::runtime_error("Unable to open output files");
@@ -79,16 +91,28 @@ Simulation::Simulation(
 }
 
 SimulationStats Simulation::Run() {
+    if (Random::GetQuasiRandom()) {
+        Random::ScrambleSequences(seed);
+    }
     bool print_prog_bar = (thread_idx == 0);
     const long num_chars = 70;
     double tick_mark = sources.GetSimulationTime() / num_chars;
     int current_tick = 0;
 
+    GammaRayTrace::Options trace_options;
+    trace_options.material_grid = material_grid;
+    trace_options.roulette_energy = config.get_roulette_energy();
+    trace_options.roulette_survival = config.get_roulette_survival();
+    trace_options.phase_space = output_phase_space.get();
+    trace_options.detector_response = detector_response;
+    trace_options.decay_filter = config.get_decay_filter();
+    trace_options.hit_aggregation = config.get_hit_aggregation();
     GammaRayTrace ray_tracer(scene, sources.GetSourcePositions(),
                              config.get_log_nondepositing_inter(),
                              config.get_log_nuclear_decays(),
                              config.get_log_nonsensitive(),
-                             config.get_log_errors());
+                             config.get_log_errors(),
+                             trace_options);
 
     if (print_prog_bar) cout << "[" << flush;
 
@@ -156,6 +180,9 @@ SimulationStats Simulation::Run() {
             }
         }
     }
+    if (output_phase_space) {
+        output_phase_space->Close();
+    }
     if (print_prog_bar) cout << "=] Done." << endl;
     SimulationStats result;
     result.physics = ray_stats;
@@ -185,7 +212,18 @@ void Simulation::CombineOutputs(
             coincs.emplace_back(new std::ofstream(name));
         }
     }
+    std::ofstream phase_space;
+    if (config.get_log_phase_space()) {
+        phase_space.open(config.get_filename_phase_space(), std::ios::binary);
+    }
     for (const auto& sim : sims) {
+        if (config.get_log_phase_space()) {
+            const std::string& name = sim.output_phase_space->GetFilename();
+            std::ifstream phase_space_seg(name, std::ios::binary);
+            phase_space << phase_space_seg.rdbuf();
+            phase_space_seg.close();
+            std::remove(name.c_str());
+        }
         if (config.get_log_hits()) {
             std::ifstream hits_seg(sim.output_hits.GetFilename());
             hits << hits_seg.rdbuf();
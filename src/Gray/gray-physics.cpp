@@ -0,0 +1,50 @@
+/*
+ * Gray: A Ray Tracing-based Monte Carlo Simulator for PET
+ *
+ * Copyright (c) 2018, David Freese, Peter Olcott, Sam Buss, Craig Levin
+ *
+ * This software is distributed under the terms of the MIT License unless
+ * otherwise noted.  See LICENSE for further details.
+ *
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include "Gray/Gray/PhysicsFile.h"
+
+using namespace std;
+
+namespace {
+void usage() {
+    cout << "gray-physics compile [json file] [output file]\n"
+         << "  Compiles a physics file to the binary format gray loads in its\n"
+         << "  place.  The json file defaults to $GRAY_INCLUDE/GrayPhysics.json\n"
+         << "  and the output to the same name with a .bin extension, which\n"
+         << "  is where gray looks for it.\n";
+}
+}
+
+int main(int argc, char ** argv) {
+    if ((argc < 2) || (argc > 4) || (string(argv[1]) != "compile")) {
+        usage();
+        return (1);
+    }
+    string json_filename;
+    if (argc > 2) {
+        json_filename = argv[2];
+    } else {
+        const char * include_cstr = getenv("GRAY_INCLUDE");
+        json_filename = (include_cstr ? string(include_cstr) + "/" : "") +
+                        "GrayPhysics.json";
+    }
+    const string output_filename = (argc > 3) ? string(argv[3]) :
+            PhysicsFile::CompiledFilename(json_filename);
+    if (!PhysicsFile::Compile(json_filename, output_filename)) {
+        cerr << "Compiling \"" << json_filename << "\" failed" << endl;
+        return (2);
+    }
+    cout << "Compiled \"" << json_filename << "\" to \"" << output_filename
+         << "\"\n";
+    return (0);
+}
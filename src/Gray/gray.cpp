@@ -15,9 +15,11 @@
 #include "Gray/Graphics/SceneDescription.h"
 #include "Gray/Gray/GammaMaterial.h"
 #include "Gray/Gray/GammaRayTrace.h"
-#include "Gray/Gray/LoadMaterials.h"
 #include "Gray/Gray/Load.h"
 #include "Gray/Gray/Config.h"
+#include "Gray/Gray/DetectorResponse.h"
+#include "Gray/Gray/MaterialGrid.h"
+#include "Gray/Gray/PhysicsFile.h"
 #include "Gray/Gray/Simulation.h"
 #include "Gray/Output/DetectorArray.h"
 #include "Gray/Output/Output.h"
@@ -41,15 +43,7 @@ int main(int argc, char ** argv) {
     DetectorArray detector_array;
     SceneDescription scene;
     SourceList sources;
-    if (!sources.LoadIsotopes(config.get_physics_filename())) {
-        cerr << "Unable to load physics file: \""
-        << config.get_physics_filename() << "\"\n"
-        << "Check GRAY_INCLUDE env variable or specify name with --phys"
-        << endl;
-        return(1);
-    }
-    if (!LoadMaterials::LoadPhysicsJson(scene, config.get_physics_filename()))
-    {
+    if (!PhysicsFile::Load(config.get_physics_filename(), scene, sources)) {
         cerr << "Unable to load physics file: \""
         << config.get_physics_filename() << "\"\n"
         << "Check GRAY_INCLUDE env variable or specify name with --phys"
@@ -65,6 +59,7 @@ int main(int argc, char ** argv) {
              << "\" failed" << endl;
         return(1);
     }
+    Load::CacheEnergies(scene, sources.EmittedEnergies());
 
     // Setup the singles processor and load a default or specified mapping file
     const double max_req_sort_time = (5 * scene.GetMaxDistance() *
@@ -162,12 +157,46 @@ int main(int argc, char ** argv) {
     // space for each of the threads to index from there in the same manner.
     Random::SetSeed(config.get_seed() +
             (config.get_rank() * config.get_no_threads()));
+    Random::SetQuasiRandom(config.get_quasi_random());
     cout << "Using Seed: " << Random::GetSeed() << endl;
 
     int no_threads = config.get_no_threads();
+    // Only the materials that photons can reach need their physics tables.
+    Load::BuildMaterials(load.UsedMaterials(), no_threads);
+    // Look up the materials each decay starts in from a grid over the sources
+    // rather than tracing from the center of the source for every photon.
+    std::shared_ptr<const MaterialGrid> material_grid;
+    if (config.get_material_grid()) {
+        material_grid = std::make_shared<const MaterialGrid>(
+                scene, MaterialGrid::SourceRegion(sources), no_threads);
+        if (config.get_verbose()) {
+            cout << "Material grid: " << material_grid->NumCells()
+                 << " cells, " << material_grid->NumRefinedCells()
+                 << " refined, " << material_grid->NumUnresolvedCells()
+                 << " traced" << endl;
+        }
+    }
+    std::shared_ptr<DetectorResponse> detector_response;
+    if (!load.CrystalTypes().empty()) {
+        detector_response = std::make_shared<DetectorResponse>(detector_array);
+        for (const auto& type: load.CrystalTypes()) {
+            bool built;
+            if (!detector_response->AddCrystalType(type, built)) {
+                cerr << "Unable to write detector response file: "
+                     << type.filename << endl;
+                return (7);
+            }
+            cout << (built ? "Built" : "Loaded") << " detector response: "
+                 << type.filename << endl;
+        }
+        cout << "Detector response: " << detector_response->NumCrystals()
+             << " crystals" << endl;
+    }
     std::vector<Simulation> sims;
     for (int idx = 0; idx < no_threads; ++idx) {
-        sims.emplace_back(Simulation(config, scene, sources, daq_model, idx, no_threads));
+        sims.emplace_back(Simulation(config, scene, sources, daq_model, idx,
+                                     no_threads, material_grid,
+                                     detector_response));
     }
     clock_t setup_time = clock();
     std::vector<std::future<SimulationStats>> results(no_threads);
@@ -22,176 +22,6 @@ KdTree::~KdTree()
 {
 }
 
-long KdTree::Traverse(const VectorR3& startPos, const VectorR3& dir,
-                      double & stopDistance, CallbackF ObjectCallback) const
-{
-    // Set sign of dir components and inverse values of non-zero entries.
-    VectorR3 dirInv;
-    int sign[3];
-    double entryDist, exitDist;
-    bool intersects = BoundingBox.RayIntersect(startPos, dir, dirInv,
-                                               sign[0], sign[1], sign[2],
-                                               0, DBL_MAX, entryDist, exitDist);
-    if (!intersects) {
-        return(-1);
-    }
-	// Main traversal loop
-
-	long currentNodeIndex = RootIndex(); // The current node in the traversal
-    const KdTreeNode* currentNode = &TreeNodes[currentNodeIndex];
-    double minDistance = std::max(0.0, entryDist);
-    double maxDistance = std::min(stopDistance, exitDist);
-	bool hitParallel = false;
-	double parallelHitMax = -DBL_MAX;
-    long stopping_object = -1;
-
-    // Use array as a stack.  This is a 30% speedup from std::stack.
-    // Bounds checking is done during the tree construction since the stack
-    // can't outgrow the depth of the tree.  Since the size is fixed to 63,
-    // this would be an absolutely massive tree that would probably break other
-    // things.
-    //
-    // Looked at using boost::container::small_vector, but this ended up not
-    // gaining much.
-    //
-    // static thread_local keeps this array from being regenerated each time
-    // the function is called, but makes it thread safe.
-    static thread_local std::array<Kd_TraverseNodeData, traverse_stack_size> traverse_stack;
-    int stack_size = 0;
-
-	while ( true ) {
-		if (currentNode->IsLeaf()) {
-            // Handle leaf nodes by invoking the callback function
-            // Pass the objects back to the user one at a time
-            for (auto object: currentNode->Data.Leaf.Objects) {
-                if (ObjectCallback(object, startPos, dir, stopDistance)) {
-                    stopping_object = object;
-                }
-            }
-		} else {
-            // Handle non-leaf nodes
-            //		These do not contain primitive objects.
-            int thisSign;
-            double thisDir;
-            double thisDirInv;
-            double thisStartPt;
-            switch (currentNode->SplitAxis())
-            {
-                case KdTreeNode::KD_SPLIT_X:
-                    thisSign = sign[0];
-                    thisDir = dir.x;
-                    thisDirInv = dirInv.x;
-                    thisStartPt = startPos.x;
-                    break;
-                case KdTreeNode::KD_SPLIT_Y:
-                    thisSign = sign[1];
-                    thisDir = dir.y;
-                    thisDirInv = dirInv.y;
-                    thisStartPt = startPos.y;
-                    break;
-                case KdTreeNode::KD_SPLIT_Z:
-                    thisSign = sign[2];
-                    thisDir = dir.z;
-                    thisDirInv = dirInv.z;
-                    thisStartPt = startPos.z;
-                    break;
-                default:
-                    throw std::runtime_error("Invalid split type");
-                    break;
-            }
-            long nearNodeIdx;
-            long farNodeIdx;
-            if (thisDir == 0) {
-                // Handle hitting exactly parallel to the splitting plane
-                double thisSplitVal = currentNode->SplitValue();
-                if ( thisSplitVal<thisStartPt ) {
-                    currentNodeIndex = currentNode->RightChildIndex();
-                }
-                else if ( thisSplitVal>thisStartPt ) {
-                    currentNodeIndex = currentNode->LeftChildIndex();
-                }
-                else {
-                    // Exactly hit the splitting plane (not so good!)
-                    long leftIdx = currentNode->LeftChildIndex();
-                    long rightIdx = currentNode->RightChildIndex();
-                    if ( leftIdx == -1 ) {
-                        currentNodeIndex = rightIdx;
-                    }
-                    else if ( rightIdx == -1 ) {
-                        currentNodeIndex = leftIdx;
-                    }
-                    else {
-                        // Advance the current stack size after updating the
-                        // last element.
-                        traverse_stack[stack_size++] = {rightIdx,
-                            minDistance,
-                            maxDistance};
-                        currentNodeIndex = leftIdx;
-                        hitParallel = true;
-                        UpdateMax(maxDistance,parallelHitMax);
-                    }
-                }
-            } else {
-                if (thisSign == 0) {
-                    nearNodeIdx = currentNode->LeftChildIndex();
-                    farNodeIdx = currentNode->RightChildIndex();
-                } else {
-                    nearNodeIdx = currentNode->RightChildIndex();
-                    farNodeIdx = currentNode->LeftChildIndex();
-                }
-                double splitDistance = (currentNode->SplitValue() - thisStartPt) * thisDirInv;
-                if ( splitDistance<minDistance ) {
-                    // Far node is the new current node
-                    currentNodeIndex = farNodeIdx;
-                } else if ( splitDistance>maxDistance ) {
-                    // Near node is the new current node
-                    currentNodeIndex = nearNodeIdx;
-                } else if ( nearNodeIdx == -1 ) {
-                    minDistance = splitDistance;
-                    currentNodeIndex = farNodeIdx;
-                } else {
-                    // Push the far node -- if it exists
-                    if ( farNodeIdx != -1 ) {
-                        // Advance the current stack size after updating the
-                        // last element.
-                        traverse_stack[stack_size++] = {farNodeIdx,
-                            splitDistance,
-                            maxDistance};
-                    }
-                    // Near node is the new current node
-                    maxDistance = splitDistance;
-                    currentNodeIndex = nearNodeIdx;
-                }
-            }
-            if ( currentNodeIndex != -1 ) {
-                currentNode = &TreeNodes[currentNodeIndex];
-                continue;
-            }
-            // If we reach here, we are at an empty leaf and can fall through.
-		}
-
-		// Get to this point if done with a leaf node (possibly empty, possibly not).
-		if (stack_size == 0) {
-			return stopping_object;
-		} else {
-            Kd_TraverseNodeData& topNode = traverse_stack[--stack_size];
-			minDistance = topNode.GetMinDist();
-            if ((stopping_object >= 0) && (minDistance > stopDistance)) {
-                if ( !hitParallel || minDistance>=parallelHitMax ) {
-                    // Exit loop.  Fully done.
-                    return stopping_object;
-                }
-            }
-			currentNodeIndex = topNode.GetNodeNumber();
-			currentNode = &TreeNodes[currentNodeIndex];
-			maxDistance = topNode.GetMaxDist();
-		}
-
-	}
-
-}
-
-
 /***********************************************************************************************
  * Tree building functions.
  ***********************************************************************************************/
@@ -281,16 +111,48 @@ void KdTree::BuildTree(long numObjects,
         throw std::runtime_error(ss.str());
     }
 
-    for (auto node: TreeNodes) {
-        if (node.IsLeaf()) {
-        }
-    }
+    const long outside[6] = {-1, -1, -1, -1, -1, -1};
+    BuildRopes(RootIndex(), BoundingBox, outside);
+
     // Could clear ObjectAABBs if memory was wanted.
 	delete[] ET_Lists;
 	delete[] LeftRightStatus;
     TreeNodes.shrink_to_fit();
 }
 
+// Record the region of each node, and link each face of it to the node on the
+// other side.  A face looking onto an empty child is linked to the parent of
+// that child, and the traversal descends from there into the empty region.
+void KdTree::BuildRopes(long nodeIndex, const AABB& aabb, const long ropes[6])
+{
+    KdTreeNode& node = TreeNodes[nodeIndex];
+    node.Box = aabb;
+    std::copy(ropes, ropes + 6, node.Ropes);
+    if (node.IsLeaf()) {
+        return;
+    }
+    const int axis = node.SplitAxis();
+    const double splitValue = node.SplitValue();
+    const long leftIndex = node.LeftChildIndex();
+    const long rightIndex = node.RightChildIndex();
+    if (leftIndex != -1) {
+        AABB leftAabb = aabb;
+        leftAabb.SetNewAxisMax(axis, splitValue);
+        long leftRopes[6];
+        std::copy(ropes, ropes + 6, leftRopes);
+        leftRopes[2 * axis + 1] = (rightIndex != -1) ? rightIndex : nodeIndex;
+        BuildRopes(leftIndex, leftAabb, leftRopes);
+    }
+    if (rightIndex != -1) {
+        AABB rightAabb = aabb;
+        rightAabb.SetNewAxisMin(axis, splitValue);
+        long rightRopes[6];
+        std::copy(ropes, ropes + 6, rightRopes);
+        rightRopes[2 * axis] = (leftIndex != -1) ? leftIndex : nodeIndex;
+        BuildRopes(rightIndex, rightAabb, rightRopes);
+    }
+}
+
 // Recursively build a subtree.
 // Pick a splitting point on one of the three axes
 // Then call the routine recursively twice, once for each child
@@ -307,7 +169,7 @@ void KdTree::BuildSubTree( long baseIndex, AABB& aabb, double totalObjectCost,
 	// Step 1.
 	// Try all three axes to find the best split decision
     KdTreeNode::KD_SplittingAxis splitAxisID;
-	ExtentTripleArrayInfo* splitExtentList;	// Will point to the split axis extext list
+	ExtentTripleArrayInfo* splitExtentList = nullptr;	// Will point to the split axis extext list
 	double splitValue;				// Point where the split occurs
 	long numTriplesToLeft;			// Number of triples on left side of split
 	long numObjectsToLeft;			// Number of objects on left side of split
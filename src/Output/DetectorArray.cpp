@@ -28,6 +28,31 @@ int DetectorArray::AddDetector(const VectorR3 & pos, const VectorR3 &size,
     return detector_id;
 }
 
+int DetectorArray::AddDetectors(const DetectorArray & local,
+                                const RigidMapR3 & map, int block_offset)
+{
+    int first_id = detectors.size();
+    for (const auto & d: local.detectors) {
+        int detector_id = detectors.size();
+        VectorR3 tpos;
+        map.Transform(d.pos, &tpos);
+        RigidMapR3 tmap = map;
+        tmap *= d.map;
+        detectors.push_back(Detector(detector_id, tpos, d.size, tmap,
+                                     d.idx[0], d.idx[1], d.idx[2],
+                                     block_offset + d.block));
+    }
+    return first_id;
+}
+
+size_t DetectorArray::NumDetectors() const {
+    return (detectors.size());
+}
+
+const Detector& DetectorArray::GetDetector(size_t idx) const {
+    return (detectors[idx]);
+}
+
 bool DetectorArray::WritePositions(std::ostream& os) const {
     if (!os) {
         return (false);
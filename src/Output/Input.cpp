@@ -62,11 +62,13 @@ bool Input::set_logfile(const std::string & name)
     switch (format) {
         case Output::Format::VariableAscii:
             success &= read_header_ascii(log_file, var_format_version);
-            success &= read_write_flags_ascii(var_format_write_flags, log_file);
+            success &= read_write_flags_ascii(var_format_write_flags, log_file,
+                                              var_format_version);
             break;
         case Output::Format::VariableBinary:
             success &= read_header_binary(log_file, var_format_version);
-            success &= read_write_flags_binary(var_format_write_flags, log_file);
+            success &= read_write_flags_binary(var_format_write_flags,
+                                               log_file, var_format_version);
             break;
     }
     return(success);
@@ -103,10 +105,14 @@ bool Input::read_header_ascii(std::istream & input, int & version)
 }
 
 
+/*!
+ * Version 1 of the format doesn't have the weight, which was added as the
+ * last field in version 2.
+ */
 bool Input::read_write_flags_binary(Output::WriteFlags & flags,
-                                    std::istream & input)
+                                    std::istream & input, int version)
 {
-    vector<int> input_vals(18);
+    vector<int> input_vals(version < 2 ? 18 : 19);
     if (!input.read(reinterpret_cast<char*>(input_vals.data()),
                     input_vals.size() * sizeof(int)))
     {
@@ -130,6 +136,7 @@ bool Input::read_write_flags_binary(Output::WriteFlags & flags,
     flags.scatter_rayleigh_detector = static_cast<bool>(input_vals[15]);
     flags.xray_flouresence = static_cast<bool>(input_vals[16]);
     flags.coinc_id = static_cast<bool>(input_vals[17]);
+    flags.weight = (version < 2) ? false : static_cast<bool>(input_vals[18]);
 
     int expected_per_event_size = Output::event_size(flags);
     if (expected_per_event_size != per_event_size) {
@@ -139,6 +146,9 @@ bool Input::read_write_flags_binary(Output::WriteFlags & flags,
     int no_fields;
     int no_active;
     Output::write_flags_stats(flags, no_fields, no_active);
+    if (version < 2) {
+        no_fields--;
+    }
     if ((read_no_fields != no_fields) || (read_no_active != no_active)) {
         return(false);
     }
@@ -146,10 +156,10 @@ bool Input::read_write_flags_binary(Output::WriteFlags & flags,
 }
 
 bool Input::read_write_flags_ascii(Output::WriteFlags & flags,
-                                   std::istream & input)
+                                   std::istream & input, int version)
 {
-    vector<int> input_vals(17);
-    vector<std::string> input_names(17);
+    vector<int> input_vals(version < 2 ? 17 : 18);
+    vector<std::string> input_names(input_vals.size());
 
     for (size_t ii = 0; ii < input_vals.size(); ii++) {
         string line;
@@ -180,10 +190,14 @@ bool Input::read_write_flags_ascii(Output::WriteFlags & flags,
     flags.scatter_rayleigh_detector = static_cast<bool>(input_vals[14]);
     flags.xray_flouresence = static_cast<bool>(input_vals[15]);
     flags.coinc_id = static_cast<bool>(input_vals[16]);
+    flags.weight = (version < 2) ? false : static_cast<bool>(input_vals[17]);
 
     int no_fields;
     int no_active;
     Output::write_flags_stats(flags, no_fields, no_active);
+    if (version < 2) {
+        no_fields--;
+    }
     if ((read_no_fields != no_fields) || (read_no_active != no_active)) {
         return(false);
     }
@@ -282,6 +296,12 @@ bool Input::read_variables_binary(std::vector<Interaction> & interactions,
             inter.coinc_id = *reinterpret_cast<int*>(event_ptr +
                                                      offsets.coinc_id);
         }
+        if (flags.weight) {
+            inter.weight = *reinterpret_cast<double*>(event_ptr +
+                                                      offsets.weight);
+            inter.roulette_weight = *reinterpret_cast<double*>(
+                    event_ptr + offsets.weight + sizeof(inter.weight));
+        }
     }
     return(true);
 }
@@ -291,9 +311,10 @@ bool Input::read_variables_ascii(std::vector<Interaction> & interactions,
                                  std::istream & input,
                                  const Output::WriteFlags & flags)
 {
+    const size_t no_existing = interactions.size();
     interactions.reserve(interactions.size() + no_interactions);
     string line;
-    for (size_t ii = 0; (ii < no_interactions) & (!getline(input, line).fail()); ii++) {
+    for (size_t ii = 0; (ii < no_interactions) && getline(input, line); ii++) {
         Interaction inter;
         stringstream line_ss(line);
         if (flags.time) {
@@ -345,12 +366,16 @@ bool Input::read_variables_ascii(std::vector<Interaction> & interactions,
         if (flags.coinc_id) {
             line_ss >> inter.coinc_id;
         }
+        if (flags.weight) {
+            line_ss >> inter.weight;
+            line_ss >> inter.roulette_weight;
+        }
         if (line_ss.fail()) {
             break;
         }
         interactions.push_back(inter);
     }
-    if (interactions.empty()) {
+    if (interactions.size() == no_existing) {
         return(false);
     } else {
         return(true);
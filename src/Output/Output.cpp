@@ -178,7 +178,7 @@ int Output::ParseFormat(const std::string & identifier, Output::Format & fmt) {
 }
 
 int Output::header_start_magic_number = 0xFFFB;
-int Output::output_version_number = 1;
+int Output::output_version_number = 2;
 bool Output::write_header(std::ostream & output, bool binary) {
     if (binary) {
         output.write(reinterpret_cast<char *>(&header_start_magic_number),
@@ -216,6 +216,7 @@ void Output::write_flags_stats(const WriteFlags & flags, int & no_fields,
     no_fields++; if (flags.scatter_rayleigh_detector) no_active++;
     no_fields++; if (flags.xray_flouresence) no_active++;
     no_fields++; if (flags.coinc_id) no_active++;
+    no_fields++; if (flags.weight) no_active++;
 }
 
 int Output::event_size(const WriteFlags & flags) {
@@ -251,6 +252,10 @@ int Output::event_size(const WriteFlags & flags) {
     if (flags.coinc_id) {
         event_size += sizeof(Interaction::coinc_id);
     }
+    if (flags.weight) {
+        event_size += sizeof(Interaction::weight);
+        event_size += sizeof(Interaction::roulette_weight);
+    }
     return(event_size);
 }
 
@@ -319,6 +324,11 @@ Output::WriteOffsets Output::event_offsets(const WriteFlags & flags) {
         offsets.coinc_id = event_size;
         event_size += sizeof(Interaction::coinc_id);
     }
+    if (flags.weight) {
+        offsets.weight = event_size;
+        event_size += sizeof(Interaction::weight);
+        event_size += sizeof(Interaction::roulette_weight);
+    }
     return(offsets);
 }
 
@@ -386,6 +396,9 @@ bool Output::write_write_flags(const WriteFlags & flags,
 
         int coinc_id = flags.coinc_id;
         output.write(reinterpret_cast<char*>(&coinc_id), sizeof(coinc_id));
+
+        int weight = flags.weight;
+        output.write(reinterpret_cast<char*>(&weight), sizeof(weight));
     } else {
         output << "no_fields " << no_fields << "\n" << "no_active "
         << no_active << "\n";
@@ -409,7 +422,9 @@ bool Output::write_write_flags(const WriteFlags & flags,
         << "xray_flouresence "
         << static_cast<int>(flags.xray_flouresence) << "\n"
         << "coinc_id "
-        << static_cast<int>(flags.coinc_id) << "\n";
+        << static_cast<int>(flags.coinc_id) << "\n"
+        << "weight "
+        << static_cast<int>(flags.weight) << "\n";
     }
 
     if (output.fail()) {
@@ -420,7 +435,9 @@ bool Output::write_write_flags(const WriteFlags & flags,
 }
 
 /*!
- * Turn a string of ones and zeros into write flags
+ * Turn a string of ones and zeros into write flags.  The weight was added
+ * after the rest of the fields, so it is left as it was if the mask doesn't
+ * include it.
  */
 bool Output::parse_write_flags_mask(WriteFlags & flags,
                                     const std::string & mask)
@@ -441,7 +458,14 @@ bool Output::parse_write_flags_mask(WriteFlags & flags,
     line_ss >> flags.scatter_rayleigh_detector;
     line_ss >> flags.xray_flouresence;
     line_ss >> flags.coinc_id;
-    return(!line_ss.fail());
+    if (line_ss.fail()) {
+        return(false);
+    }
+    bool weight;
+    if (line_ss >> weight) {
+        flags.weight = weight;
+    }
+    return(true);
 }
 
 bool Output::write_variable_ascii(const Interaction & inter,
@@ -498,6 +522,12 @@ bool Output::write_variable_ascii(const Interaction & inter,
     if (flags.coinc_id) {
         output << " " << std::setw(9) << inter.coinc_id;
     }
+    if (flags.weight) {
+        output << resetiosflags(ios::floatfield)
+        << " " << scientific << setw(13) << setprecision(6) << inter.weight
+        << " " << scientific << setw(13) << setprecision(6)
+        << inter.roulette_weight;
+    }
     output << "\n";
     if (output.fail()) {
         return(false);
@@ -574,6 +604,12 @@ bool Output::write_variable_binary(const Interaction & inter,
         output.write(reinterpret_cast<const char*>(&inter.coinc_id),
                      sizeof(inter.coinc_id));
     }
+    if (flags.weight) {
+        output.write(reinterpret_cast<const char*>(&inter.weight),
+                     sizeof(inter.weight));
+        output.write(reinterpret_cast<const char*>(&inter.roulette_weight),
+                     sizeof(inter.roulette_weight));
+    }
 
     if (output.fail()) {
         return(false);
@@ -57,6 +57,10 @@ double Beam::ExpectedNoPhotons() const {
     return(2.0);
 }
 
+std::vector<double> Beam::EmittedEnergies() const {
+    return {beam_energy};
+}
+
 bool Beam::operator==(const Beam& rhs) const {
     return (beam_axis == rhs.beam_axis) &&
         (beam_angle_max == rhs.beam_angle_max) &&
@@ -25,15 +25,11 @@ Compton::Compton(
         0.700, 0.900, 1.100, 1.300, 1.500}),
     // Go from -1 to 1 linear in theta
     costheta_idx(Math::cos_space(300)),
-    scatter_cdfs(create_scatter_cdfs(energy_idx, costheta_idx, x, form_factor))
+    scatter_table(energy_idx, costheta_idx,
+                  create_scatter_cdfs(energy_idx, costheta_idx, x, form_factor))
 {
 }
 
-double Compton::scatter_angle(double energy, double rand_uniform) const {
-    return (Math::interpolate_y_2d(energy_idx, costheta_idx, scatter_cdfs,
-                                   energy, rand_uniform));
-}
-
 double Compton::x_val(double cos_theta, double energy_mev) {
     // Planck's contant times the speed of light in MeV*cm
     constexpr double hc_MeV_cm = 1.23984193e-10;
@@ -0,0 +1,73 @@
+/*
+ * Gray: A Ray Tracing-based Monte Carlo Simulator for PET
+ *
+ * Copyright (c) 2018, David Freese, Peter Olcott, Sam Buss, Craig Levin
+ *
+ * This software is distributed under the terms of the MIT License unless
+ * otherwise noted.  See LICENSE for further details.
+ *
+ */
+
+#include "Gray/Physics/EmissionBias.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include "Gray/Random/Random.h"
+#include "Gray/Random/Transform.h"
+
+EmissionBias::EmissionBias(const std::vector<AABB>& sensitive,
+                           double fraction) :
+    fraction(fraction)
+{
+    if (sensitive.empty()) {
+        return;
+    }
+    AABB extents = sensitive.front();
+    for (const AABB& box: sensitive) {
+        extents.EnlargeToEnclose(box);
+    }
+    axis_x = (extents.GetMinX() + extents.GetMaxX()) / 2.0;
+    axis_y = (extents.GetMinY() + extents.GetMaxY()) / 2.0;
+    z_min = extents.GetMinZ();
+    z_max = extents.GetMaxZ();
+
+    inner_radius = DBL_MAX;
+    for (const AABB& box: sensitive) {
+        const double dx = std::max({box.GetMinX() - axis_x, 0.0,
+                                    axis_x - box.GetMaxX()});
+        const double dy = std::max({box.GetMinY() - axis_y, 0.0,
+                                    axis_y - box.GetMaxY()});
+        inner_radius = std::min(inner_radius, std::sqrt(dx * dx + dy * dy));
+    }
+}
+
+double EmissionBias::MaxCosine(const VectorR3& pos) const {
+    const double dx = pos.x - axis_x;
+    const double dy = pos.y - axis_y;
+    const double radial = inner_radius - std::sqrt(dx * dx + dy * dy);
+    if (radial <= 0) {
+        return (1.0);
+    }
+    // The furthest along z that either photon can go and still be next to
+    // the sensitive geometry.
+    const double axial = std::max(z_max - pos.z, pos.z - z_min);
+    if (axial <= 0) {
+        return (1.0);
+    }
+    return (axial / std::sqrt(axial * axial + radial * radial));
+}
+
+VectorR3 EmissionBias::Direction(const VectorR3& pos, double& weight) const {
+    const double max_cos = MaxCosine(pos);
+    VectorR3 dir;
+    if (Random::Uniform() < fraction) {
+        // Scale the uniform cosine of UniformSphere to [-max_cos, max_cos].
+        dir = Transform::UniformSphere(
+                Random::Uniform(), 0.5 + (Random::Uniform() - 0.5) * max_cos);
+    } else {
+        dir = Random::UniformSphere();
+    }
+    const double in_band = (std::abs(dir.z) <= max_cos) ? 1.0 : 0.0;
+    weight = 1.0 / (fraction * in_band / max_cos + (1.0 - fraction));
+    return (dir);
+}
@@ -22,11 +22,15 @@
 
 using namespace std;
 
+constexpr int GammaStats::table_points_per_decade;
+
 GammaStats::GammaStats() :
     // Make the form factor always 1
-    compton_scatter({0.0, 1.0}, {1.0, 1.0}),
-    rayleigh_scatter({0.0, 1.0}, {1.0, 1.0})
+    x({0.0, 1.0}),
+    form_factor({1.0, 1.0}),
+    scattering_func({1.0, 1.0})
 {
+    BuildTables();
 }
 
 GammaStats::GammaStats(
@@ -44,9 +48,7 @@ GammaStats::GammaStats(
         log_rayleigh(matten_rayl.size()),
         x(x),
         form_factor(form_factor),
-        scattering_func(scattering_func),
-        compton_scatter(x, scattering_func),
-        rayleigh_scatter(x, form_factor)
+        scattering_func(scattering_func)
 {
     // Convert the mass attenuation coefficient to a linear attenuation
     // coefficient by multiplying by density.
@@ -70,12 +72,93 @@ GammaStats::GammaStats(
                    log_compton.begin(), log_func);
     std::transform(rayleigh.begin(), rayleigh.end(),
                    log_rayleigh.begin(), log_func);
+    CacheEnergy(Physics::energy_511);
+}
+
+void GammaStats::BuildTables() {
+    if (tables_built) {
+        return;
+    }
+    BuildTable();
+    compton_scatter = Compton(x, scattering_func);
+    rayleigh_scatter = Rayleigh(x, form_factor);
+    tables_built = true;
+}
+
+/*!
+ * Resamples the attenuation evenly in log energy over the range of energies
+ * given, so that a lookup is just an index and a linear interpolation.  The
+ * steps are small enough that the curvature between them is negligible,
+ * except right at an absorption edge, which is smeared over one step.
+ */
+void GammaStats::BuildTable() {
+    table.clear();
+    table_size = 0;
+    if ((energy.size() < 2) || !(energy.front() > 0)) {
+        return;
+    }
+    table_min_energy = energy.front();
+    table_max_energy = energy.back();
+    table_log_min = std::log(table_min_energy);
+    const double log_range = std::log(table_max_energy) - table_log_min;
+    const double decades = log_range / std::log(10.0);
+    table_size = std::max(
+            static_cast<size_t>(2),
+            static_cast<size_t>(std::ceil(decades * table_points_per_decade)) +
+            1);
+    const double log_step = log_range / (table_size - 1);
+    table_inv_log_step = 1.0 / log_step;
+    table.resize(3 * table_size);
+    for (size_t idx = 0; idx < table_size; ++idx) {
+        const double e = std::min(std::exp(table_log_min + idx * log_step),
+                                  table_max_energy);
+        const AttenLengths len = GetAttenLengthsExact(e);
+        table[3 * idx] = static_cast<float>(len.photoelectric);
+        table[3 * idx + 1] = static_cast<float>(len.compton);
+        table[3 * idx + 2] = static_cast<float>(len.rayleigh);
+    }
+}
+
+GammaStats::AttenLengths GammaStats::TableAttenLengths(double e) const {
+    // Outside of the table the values are held at the ends of the material's
+    // tables, which the exact lookup already does.
+    if ((table_size == 0) || !(e >= table_min_energy) ||
+        (e >= table_max_energy))
+    {
+        return (GetAttenLengthsExact(e));
+    }
+    const double u = (std::log(e) - table_log_min) * table_inv_log_step;
+    const size_t idx = std::min(static_cast<size_t>(u), table_size - 2);
+    const float frac = static_cast<float>(u - idx);
+    const float* lo = &table[3 * idx];
+    const float* hi = lo + 3;
+    AttenLengths len;
+    len.energy = e;
+    len.photoelectric = lo[0] + frac * (hi[0] - lo[0]);
+    len.compton = lo[1] + frac * (hi[1] - lo[1]);
+    len.rayleigh = lo[2] + frac * (hi[2] - lo[2]);
+    return (len);
+}
+
+void GammaStats::CacheEnergy(double e) {
+    if (energy.size() < 2) {
+        return;
+    }
+    for (const AttenLengths& cached: cached_lengths) {
+        if (cached.energy == e) {
+            return;
+        }
+    }
+    cached_lengths.push_back(GetAttenLengthsExact(e));
+}
+
+void GammaStats::UpdateCache() {
+    for (AttenLengths& cached: cached_lengths) {
+        cached = GetAttenLengthsExact(cached.energy);
+    }
 }
 
-GammaStats::AttenLengths GammaStats::GetAttenLengths(double e) const {
-    // TODO: This function tends to be called twice with the same e value.  Look
-    // at caching this in a way that both causes a gain in speed, and no thread
-    // contention.
+GammaStats::AttenLengths GammaStats::GetAttenLengthsExact(double e) const {
     AttenLengths cache_len;
     size_t idx = Math::interp_index(energy, e);
     const double log_e = std::log(e);
@@ -92,9 +175,16 @@ GammaStats::AttenLengths GammaStats::GetAttenLengths(double e) const {
 void GammaStats::DisableRayleigh() {
     log_rayleigh = std::vector<double>(rayleigh.size(), std::log(0));
     rayleigh = std::vector<double>(rayleigh.size(), 0);
+    if (tables_built) {
+        BuildTable();
+    }
+    UpdateCache();
 }
 
 void GammaStats::ComptonScatter(Photon& p) const {
+    if (!tables_built) {
+        throw(runtime_error("Compton scatter before BuildTables"));
+    }
     const double costheta = compton_scatter.scatter_angle(p.GetEnergy(), Random::Uniform());
     // After collision the photon loses some energy to the electron
     p.SetEnergy(Physics::KleinNishinaEnergy(p.GetEnergy(), costheta));
@@ -103,6 +193,9 @@ void GammaStats::ComptonScatter(Photon& p) const {
 }
 
 void GammaStats::RayleighScatter(Photon& p) const {
+    if (!tables_built) {
+        throw(runtime_error("Rayleigh scatter before BuildTables"));
+    }
     const double costheta = rayleigh_scatter.scatter_angle(p.GetEnergy(), Random::Uniform());
     p.SetDir(Random::Deflection(p.GetDir(), costheta));
     // If the photon scatters on a non-detector, it is a scatter, checked
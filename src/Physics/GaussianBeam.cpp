@@ -58,6 +58,10 @@ double GaussianBeam::ExpectedNoPhotons() const {
     return(2.0);
 }
 
+std::vector<double> GaussianBeam::EmittedEnergies() const {
+    return {beam_energy};
+}
+
 bool GaussianBeam::operator==(const GaussianBeam& rhs) const {
     return (beam_axis == rhs.beam_axis) &&
         (beam_angle == rhs.beam_angle) &&
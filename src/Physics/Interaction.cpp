@@ -35,6 +35,8 @@ Interaction::Interaction(
     scatter_rayleigh_phantom(p.GetScatterRayleighPhantom()),
     scatter_rayleigh_detector(p.GetScatterRayleighDetector()),
     xray_flouresence(p.GetXrayFlouresence()),
+    weight(p.GetWeight()),
+    roulette_weight(p.GetRouletteWeight()),
     dropped(true)
 {
 }
@@ -58,6 +60,8 @@ Interaction::Interaction(
     scatter_rayleigh_phantom(p.GetScatterRayleighPhantom()),
     scatter_rayleigh_detector(p.GetScatterRayleighDetector()),
     xray_flouresence(p.GetXrayFlouresence()),
+    weight(p.GetWeight()),
+    roulette_weight(p.GetRouletteWeight()),
     dropped(Dropped(type, mat))
 {
 }
@@ -79,6 +83,8 @@ Interaction::Interaction(
     scatter_rayleigh_phantom(0),
     scatter_rayleigh_detector(0),
     xray_flouresence(0),
+    weight(p.GetWeight()),
+    roulette_weight(1),
     dropped(Dropped(type, mat))
 {
 }
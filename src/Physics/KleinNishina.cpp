@@ -23,7 +23,8 @@ KleinNishina::KleinNishina() :
         0.700, 0.900, 1.100, 1.300, 1.500}),
     // Go from -1 to 1 linear in theta
     costheta_idx(Math::cos_space(300)),
-    scatter_cdfs(create_scatter_cdfs(energy_idx, costheta_idx))
+    scatter_table(energy_idx, costheta_idx,
+                  create_scatter_cdfs(energy_idx, costheta_idx))
 {
 }
 
@@ -59,13 +60,6 @@ std::vector<double> KleinNishina::dsigma(
     return (dsigma_dtheta);
 }
 
-double KleinNishina::scatter_angle(
-        double energy, double rand_uniform) const
-{
-    return (Math::interpolate_y_2d(energy_idx, costheta_idx, scatter_cdfs,
-                                   energy, rand_uniform));
-}
-
 std::vector<std::vector<double>> KleinNishina::create_scatter_cdfs(
         const std::vector<double>& energies,
         const std::vector<double>& costhetas)
@@ -32,6 +32,7 @@ std::vector<Photon>::const_reverse_iterator NuclearDecay::end() const {
 
 void NuclearDecay::AddPhoton(Photon && p)
 {
+    p.SetWeight(weight * p.GetRouletteWeight());
     photons.push_back(p);
 }
 
@@ -54,3 +55,14 @@ VectorR3 NuclearDecay::GetPosition() const {
 double NuclearDecay::GetTime() const {
     return(time);
 }
+
+double NuclearDecay::GetWeight() const {
+    return(weight);
+}
+
+void NuclearDecay::SetWeight(double weight) {
+    this->weight = weight;
+    for (Photon& photon: photons) {
+        photon.SetWeight(weight * photon.GetRouletteWeight());
+    }
+}
@@ -9,6 +9,7 @@
  */
 
 #include "Gray/Physics/Photon.h"
+#include "Gray/Random/Random.h"
 
 Photon::Photon() :
     pos(0,0,0),
@@ -23,7 +24,9 @@ Photon::Photon() :
     scatter_rayleigh_phantom(0),
     scatter_rayleigh_detector(0),
     xray_flouresence(0),
-    src_id(-1)
+    src_id(-1),
+    weight(1.0),
+    roulette_weight(1.0)
 {
 }
 
@@ -41,7 +44,9 @@ Photon::Photon(const VectorR3 & pos, const VectorR3 & dir, double energy,
     scatter_rayleigh_phantom(0),
     scatter_rayleigh_detector(0),
     xray_flouresence(0),
-    src_id(src_id)
+    src_id(src_id),
+    weight(1.0),
+    roulette_weight(1.0)
 {
 }
 
@@ -66,3 +71,23 @@ void Photon::SetScatterRayleigh()
 void Photon::SetXrayFlouresence() {
     xray_flouresence++;
 }
+
+void Photon::SetScatters(int compton_phantom, int compton_detector,
+                         int rayleigh_phantom, int rayleigh_detector,
+                         int xray_flouresence)
+{
+    scatter_compton_phantom = compton_phantom;
+    scatter_compton_detector = compton_detector;
+    scatter_rayleigh_phantom = rayleigh_phantom;
+    scatter_rayleigh_detector = rayleigh_detector;
+    this->xray_flouresence = xray_flouresence;
+}
+
+bool Photon::Roulette(double survival) {
+    if (Random::Uniform() >= survival) {
+        return (false);
+    }
+    weight /= survival;
+    roulette_weight /= survival;
+    return (true);
+}
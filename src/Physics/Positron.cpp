@@ -55,14 +55,23 @@ NuclearDecay Positron::Decay(int photon_number, double time, int src_id,
     if (emit_gamma) {
         // TODO: correctly set the time on the gamma decay, based on the
         // lifetime of the intermediate decay state.
-        p.AddPhoton(Photon(position, Random::UniformSphere(),
+        p.AddPhoton(Photon(position, Random::EmissionDirection(),
                            gamma_decay_energy, time, photon_number,
                            Photon::P_YELLOW, src_id));
     }
 
     // Check to see if a Positron was emitted with the gamma or not.
     if (Random::Selection(positron_emission_prob)) {
-        const VectorR3 dir = Random::UniformSphere();
+        VectorR3 dir;
+        if (emission_bias) {
+            // The prompt gamma is still uniform, and so just carries the
+            // weight of the pair.
+            double weight;
+            dir = emission_bias->Direction(anni_position, weight);
+            p.SetWeight(weight);
+        } else {
+            dir = Random::EmissionDirection();
+        }
         p.AddPhoton(Photon(anni_position, dir,
                            Physics::energy_511, time, photon_number,
                            Photon::P_BLUE, src_id));
@@ -92,6 +101,10 @@ void Positron::SetPositronRange(double fwhm, double max) {
     positron_range_max_cm = max * mm_to_cm;
 }
 
+void Positron::SetEmissionBias(std::shared_ptr<const EmissionBias> bias) {
+    emission_bias = bias;
+}
+
 double Positron::ExpectedNoPhotons() const {
     double expected = 2.0 * positron_emission_prob;
     if (emit_gamma) {
@@ -100,6 +113,17 @@ double Positron::ExpectedNoPhotons() const {
     return(expected);
 }
 
+std::vector<double> Positron::EmittedEnergies() const {
+    std::vector<double> energies;
+    if (positron_emission_prob > 0) {
+        energies.push_back(Physics::energy_511);
+    }
+    if (emit_gamma) {
+        energies.push_back(gamma_decay_energy);
+    }
+    return (energies);
+}
+
 bool Positron::operator==(const Positron& rhs) const {
     return ((model == rhs.model) &&
             (positron_range_max_cm  == rhs.positron_range_max_cm) &&
@@ -23,17 +23,11 @@ Rayleigh::Rayleigh(
         0.0, 0.001, 0.002, 0.005, 0.010, 0.020, 0.040, 0.060, 0.080, 0.080,
         0.100, 0.200, 0.300, 0.500, 1.000}),
     costheta_idx(Math::cos_space(300)),
-    scatter_cdfs(create_scatter_cdfs(energy_idx, costheta_idx, x, form_factor))
+    scatter_table(energy_idx, costheta_idx,
+                  create_scatter_cdfs(energy_idx, costheta_idx, x, form_factor))
 {
 }
 
-double Rayleigh::scatter_angle(
-        double energy, double rand_uniform) const
-{
-    return (Math::interpolate_y_2d(energy_idx, costheta_idx, scatter_cdfs,
-                                   energy, rand_uniform));
-}
-
 std::vector<double> Rayleigh::formfactor(
         const std::vector<double>& costhetas,
         const double energy_mev,
@@ -0,0 +1,144 @@
+/*
+ * Gray: A Ray Tracing-based Monte Carlo Simulator for PET
+ *
+ * Copyright (c) 2018, David Freese, Peter Olcott, Sam Buss, Craig Levin
+ *
+ * This software is distributed under the terms of the MIT License unless
+ * otherwise noted.  See LICENSE for further details.
+ *
+ */
+
+#include "Gray/Physics/ScatterTable.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include "Gray/Math/Math.h"
+
+constexpr int ScatterTable::no_probabilities;
+
+ScatterTable::ScatterTable(
+        const std::vector<double>& energies,
+        const std::vector<double>& costhetas,
+        const std::vector<std::vector<double>>& cdfs) :
+    energies(energies),
+    inverse_cdfs(energies.size() * no_probabilities)
+{
+    for (size_t ii = 0; ii < energies.size(); ++ii) {
+        for (int jj = 0; jj < no_probabilities; ++jj) {
+            const double prob = static_cast<double>(jj) /
+                                (no_probabilities - 1);
+            inverse_cdfs[ii * no_probabilities + jj] = static_cast<float>(
+                    Math::interpolate(cdfs[ii], costhetas, prob));
+        }
+    }
+
+    // Step the lookup by the smallest gap between energies, so that each
+    // step has at most one energy inside of it.
+    double min_step = DBL_MAX;
+    for (size_t ii = 1; ii < energies.size(); ++ii) {
+        const double step = energies[ii] - energies[ii - 1];
+        if (step > 0) {
+            min_step = std::min(min_step, step);
+        }
+    }
+    if (min_step == DBL_MAX) {
+        return;
+    }
+    inv_energy_step = 1.0 / min_step;
+    const size_t no_steps = static_cast<size_t>(std::ceil(
+            (energies.back() - energies.front()) * inv_energy_step)) + 1;
+    energy_lookup.resize(no_steps);
+    size_t idx = 0;
+    for (size_t step = 0; step < no_steps; ++step) {
+        const double energy = energies.front() + step * min_step;
+        while ((idx + 2 < energies.size()) && (energies[idx + 1] <= energy)) {
+            ++idx;
+        }
+        energy_lookup[step] = idx;
+    }
+}
+
+void ScatterTable::EnergyBin(double energy, size_t& idx, float& alpha) const
+{
+    // Outside of the energies the nearest CDF is used.
+    if (energy_lookup.empty() || !(energy > energies.front())) {
+        idx = 0;
+        alpha = 0;
+        return;
+    }
+    if (energy >= energies.back()) {
+        idx = energies.size() - 2;
+        alpha = 1;
+        return;
+    }
+    const size_t step = std::min(
+            static_cast<size_t>((energy - energies.front()) * inv_energy_step),
+            energy_lookup.size() - 1);
+    // Rounding of the step, or repeated energies, can leave idx a little off.
+    idx = energy_lookup[step];
+    while ((idx > 0) && (energy < energies[idx])) {
+        --idx;
+    }
+    while ((idx + 2 < energies.size()) && (energy >= energies[idx + 1])) {
+        ++idx;
+    }
+    const double delta = energies[idx + 1] - energies[idx];
+    alpha = (delta > 0) ? static_cast<float>((energy - energies[idx]) / delta)
+                        : 0.0f;
+}
+
+double ScatterTable::Sample(double energy, double rand_uniform) const {
+    if (energies.size() < 2) {
+        return (inverse_cdfs.empty() ? 1.0 : inverse_cdfs.front());
+    }
+    size_t idx;
+    float alpha;
+    EnergyBin(energy, idx, alpha);
+    const float pos = static_cast<float>(rand_uniform) *
+                      (no_probabilities - 1);
+    const int prob_idx = std::min(static_cast<int>(pos), no_probabilities - 2);
+    const float beta = pos - prob_idx;
+    const float* lo = &inverse_cdfs[idx * no_probabilities + prob_idx];
+    const float* hi = lo + no_probabilities;
+    const float val_lo = lo[0] + beta * (lo[1] - lo[0]);
+    const float val_hi = hi[0] + beta * (hi[1] - hi[0]);
+    return (val_lo + alpha * (val_hi - val_lo));
+}
+
+void ScatterTable::Sample(const double* sample_energies,
+                          const double* rand_uniforms, double* costhetas,
+                          size_t count) const
+{
+    if (energies.size() < 2) {
+        for (size_t ii = 0; ii < count; ++ii) {
+            costhetas[ii] = Sample(sample_energies[ii], rand_uniforms[ii]);
+        }
+        return;
+    }
+    // Find the bins first, so that the interpolation is a straight loop of
+    // gathers and arithmetic.
+    std::vector<size_t> offsets(count);
+    std::vector<float> alphas(count);
+    std::vector<float> betas(count);
+    for (size_t ii = 0; ii < count; ++ii) {
+        size_t idx;
+        EnergyBin(sample_energies[ii], idx, alphas[ii]);
+        const float pos = static_cast<float>(rand_uniforms[ii]) *
+                          (no_probabilities - 1);
+        const int prob_idx = std::min(static_cast<int>(pos),
+                                      no_probabilities - 2);
+        betas[ii] = pos - prob_idx;
+        offsets[ii] = idx * no_probabilities + prob_idx;
+    }
+    const float* table = inverse_cdfs.data();
+    for (size_t ii = 0; ii < count; ++ii) {
+        const size_t off = offsets[ii];
+        const float beta = betas[ii];
+        const float val_lo = table[off] + beta *
+                             (table[off + 1] - table[off]);
+        const float val_hi = table[off + no_probabilities] + beta *
+                             (table[off + no_probabilities + 1] -
+                              table[off + no_probabilities]);
+        costhetas[ii] = val_lo + alphas[ii] * (val_hi - val_lo);
+    }
+}
@@ -0,0 +1,72 @@
+/*
+ * Gray: A Ray Tracing-based Monte Carlo Simulator for PET
+ *
+ * Copyright (c) 2018, David Freese, Peter Olcott, Sam Buss, Craig Levin
+ *
+ * This software is distributed under the terms of the MIT License unless
+ * otherwise noted.  See LICENSE for further details.
+ *
+ */
+
+#include "Gray/Random/AliasTable.h"
+#include <limits>
+#include <stdexcept>
+
+AliasTable::AliasTable(const std::vector<double>& weights) :
+    entries(weights.size())
+{
+    if (weights.size() > std::numeric_limits<uint32_t>::max()) {
+        throw std::runtime_error("AliasTable has too many weights");
+    }
+    for (double weight: weights) {
+        if (!(weight >= 0)) {
+            throw std::runtime_error("AliasTable weights can not be negative");
+        }
+        total_weight += weight;
+    }
+    if (!(total_weight > 0)) {
+        throw std::runtime_error("AliasTable requires a positive weight");
+    }
+
+    // Scale the weights so they average one, and then pair each index short
+    // of one with an index that has some to spare.
+    const size_t n = weights.size();
+    std::vector<double> scaled(n);
+    std::vector<uint32_t> small;
+    std::vector<uint32_t> large;
+    for (size_t idx = 0; idx < n; ++idx) {
+        scaled[idx] = weights[idx] * n / total_weight;
+        if (scaled[idx] < 1.0) {
+            small.push_back(static_cast<uint32_t>(idx));
+        } else {
+            large.push_back(static_cast<uint32_t>(idx));
+        }
+    }
+    while (!small.empty() && !large.empty()) {
+        const uint32_t less = small.back();
+        small.pop_back();
+        const uint32_t more = large.back();
+        entries[less] = {static_cast<float>(scaled[less]), more};
+        scaled[more] -= 1.0 - scaled[less];
+        if (scaled[more] < 1.0) {
+            large.pop_back();
+            small.push_back(more);
+        }
+    }
+    // Whatever is left is one, but for rounding, except that an index with
+    // no weight must never be picked.
+    uint32_t any_weight = 0;
+    while (!(weights[any_weight] > 0)) {
+        ++any_weight;
+    }
+    for (uint32_t idx: large) {
+        entries[idx] = {1.0f, idx};
+    }
+    for (uint32_t idx: small) {
+        if (weights[idx] > 0) {
+            entries[idx] = {1.0f, idx};
+        } else {
+            entries[idx] = {0.0f, any_weight};
+        }
+    }
+}
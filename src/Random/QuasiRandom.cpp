@@ -0,0 +1,75 @@
+/*
+ * Gray: A Ray Tracing-based Monte Carlo Simulator for PET
+ *
+ * Copyright (c) 2018, David Freese, Peter Olcott, Sam Buss, Craig Levin
+ *
+ * This software is distributed under the terms of the MIT License unless
+ * otherwise noted.  See LICENSE for further details.
+ *
+ */
+
+#include "Gray/Random/QuasiRandom.h"
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+ScrambledHalton::ScrambledHalton(const std::vector<int>& bases) :
+    dims(bases.size())
+{
+    for (size_t idx = 0; idx < bases.size(); ++idx) {
+        Dimension& dim = dims[idx];
+        dim.base = bases[idx];
+        if (dim.base < 2 || dim.base > 256) {
+            throw std::runtime_error("ScrambledHalton base out of range");
+        }
+        // Keep every digit that still changes the value as a double, so
+        // base^digits <= 2^53 and the numerator below is exact.
+        const uint64_t limit = uint64_t(1) <<
+                std::numeric_limits<double>::digits;
+        uint64_t power = 1;
+        dim.digits = 0;
+        while (power <= limit / dim.base) {
+            power *= dim.base;
+            dim.digits++;
+        }
+        dim.scale = 1.0 / static_cast<double>(power);
+        // Start out unscrambled.
+        dim.perms.resize(dim.digits * dim.base);
+        for (int digit = 0; digit < dim.digits; ++digit) {
+            std::iota(dim.perms.begin() + digit * dim.base,
+                      dim.perms.begin() + (digit + 1) * dim.base, 0);
+        }
+    }
+}
+
+void ScrambledHalton::Scramble(std::mt19937& generator) {
+    for (Dimension& dim: dims) {
+        // Start from the identity each time, so the scrambling only depends
+        // on the state of the generator.
+        for (int digit = 0; digit < dim.digits; ++digit) {
+            const auto begin = dim.perms.begin() + digit * dim.base;
+            std::iota(begin, begin + dim.base, 0);
+            std::shuffle(begin, begin + dim.base, generator);
+        }
+    }
+    index = 0;
+}
+
+void ScrambledHalton::Next(double* point) {
+    for (size_t idx = 0; idx < dims.size(); ++idx) {
+        const Dimension& dim = dims[idx];
+        // Reverse the digits of the index about the radix point, permuting
+        // each, including the leading zeros, which scrambles the bits of
+        // the point below where the index has reached so far.
+        uint64_t remaining = index;
+        uint64_t numerator = 0;
+        for (int digit = 0; digit < dim.digits; ++digit) {
+            const uint8_t* perm = dim.perms.data() + digit * dim.base;
+            numerator = numerator * dim.base + perm[remaining % dim.base];
+            remaining /= dim.base;
+        }
+        point[idx] = numerator * dim.scale;
+    }
+    index++;
+}
@@ -10,6 +10,7 @@
 
 #include "Gray/Random/Random.h"
 #include <cmath>
+#include "Gray/Random/QuasiRandom.h"
 #include "Gray/Random/Transform.h"
 #include "Gray/VrMath/LinearR3.h"
 
@@ -41,6 +42,38 @@ unsigned long & Random::seed_used() {
     return (seed_used);
 }
 
+bool & Random::quasi_random() {
+    static bool quasi_random = false;
+    return (quasi_random);
+}
+
+/*!
+ * Positions and directions are separate sequences, as a decay can draw more
+ * than one direction.  They use different bases so that the two don't line
+ * up with each other.  Each thread steps through its own, scrambled for it.
+ */
+ScrambledHalton & Random::position_sequence() {
+    thread_local ScrambledHalton sequence({2, 3, 5});
+    return (sequence);
+}
+
+ScrambledHalton & Random::direction_sequence() {
+    thread_local ScrambledHalton sequence({7, 11});
+    return (sequence);
+}
+
+/*!
+ * The permutations come from their own generator, rather than the shared one,
+ * so that a thread can scramble its sequences without touching the others.
+ * It is salted so that it doesn't repeat the stream the seed gives Uniform.
+ */
+void Random::ScrambleSequences(unsigned long seed) {
+    std::seed_seq seq{seed, 0x5eedUL};
+    std::mt19937 scramble(seq);
+    position_sequence().Scramble(scramble);
+    direction_sequence().Scramble(scramble);
+}
+
 unsigned long Random::Int() {
     return(generator()());
 }
@@ -73,12 +106,26 @@ void Random::SetSeed(unsigned long seed)
 {
     generator().seed(seed);
     seed_used() = seed;
+    if (quasi_random()) {
+        ScrambleSequences(seed);
+    }
 }
 
 unsigned long Random::GetSeed() {
     return(seed_used());
 }
 
+void Random::SetQuasiRandom(bool enable) {
+    quasi_random() = enable;
+    if (enable) {
+        ScrambleSequences(GetSeed());
+    }
+}
+
+bool Random::GetQuasiRandom() {
+    return (quasi_random());
+}
+
 VectorR3 Random::UniformSphere()
 {
     return (Transform::UniformSphere(Random::Uniform(), Random::Uniform()));
@@ -86,11 +133,26 @@ VectorR3 Random::UniformSphere()
 
 VectorR3 Random::UniformSphereFilled()
 {
+    if (quasi_random()) {
+        double point[3];
+        position_sequence().Next(point);
+        return (Transform::UniformSphereFilled(point[0], point[1], point[2]));
+    }
     return (Transform::UniformSphereFilled(Random::Uniform(),
                                            Random::Uniform(),
                                            Random::Uniform()));
 }
 
+VectorR3 Random::EmissionDirection()
+{
+    if (quasi_random()) {
+        double point[2];
+        direction_sequence().Next(point);
+        return (Transform::UniformSphere(point[0], point[1]));
+    }
+    return (UniformSphere());
+}
+
 /*!
  * Returns a vector deflected from the current direction at an angle of theta
  * in cos units.  The phi angle around the reference vector is uniformly
@@ -120,6 +182,12 @@ VectorR3 Random::Acolinearity(const VectorR3 & ref, double radians)
 }
 
 VectorR3 Random::UniformCylinder(double height, double radius) {
+    if (quasi_random()) {
+        double point[3];
+        position_sequence().Next(point);
+        return (Transform::UniformCylinder(height, radius,
+                                           point[0], point[1], point[2]));
+    }
     return (Transform::UniformCylinder(height, radius,
                                        Random::Uniform(),
                                        Random::Uniform(),
@@ -127,12 +195,24 @@ VectorR3 Random::UniformCylinder(double height, double radius) {
 }
 
 VectorR3 Random::UniformAnnulusCylinder(double height, double radius) {
+    if (quasi_random()) {
+        double point[3];
+        position_sequence().Next(point);
+        return (Transform::UniformAnnulusCylinder(height, radius,
+                                                  point[0], point[1]));
+    }
     return (Transform::UniformAnnulusCylinder(height, radius,
                                               Random::Uniform(),
                                               Random::Uniform()));
 }
 
 VectorR3 Random::UniformRectangle(const VectorR3 & size) {
+    if (quasi_random()) {
+        double point[3];
+        position_sequence().Next(point);
+        return (Transform::UniformRectangle(size,
+                                            point[0], point[1], point[2]));
+    }
     return (Transform::UniformRectangle(size, Random::Uniform(),
                                         Random::Uniform(),
                                         Random::Uniform()));
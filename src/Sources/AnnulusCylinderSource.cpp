@@ -30,3 +30,8 @@ bool AnnulusCylinderSource::Inside(const VectorR3&) const {
     // Nothing can be inside of an Annulus which is infinitely thin.
     return (false);
 }
+
+AABB AnnulusCylinderSource::GetExtents() const
+{
+    return (LocalBoxExtents(local_to_global, VectorR3(radius, radius, height / 2)));
+}
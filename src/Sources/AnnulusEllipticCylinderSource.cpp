@@ -256,3 +256,9 @@ std::vector<double> AnnulusEllipticCylinderSource::GenerateTable(
     }
     return (circ);
 }
+
+AABB AnnulusEllipticCylinderSource::GetExtents() const
+{
+    return (LocalBoxExtents(local_to_global,
+                            VectorR3(radius1, radius2, height / 2)));
+}
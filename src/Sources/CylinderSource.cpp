@@ -40,3 +40,8 @@ bool CylinderSource::Inside(const VectorR3 & pos) const
     }
     return true;
 }
+
+AABB CylinderSource::GetExtents() const
+{
+    return (LocalBoxExtents(local_to_global, VectorR3(radius, radius, height / 2)));
+}
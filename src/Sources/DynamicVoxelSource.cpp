@@ -0,0 +1,253 @@
+/*
+ * Gray: A Ray Tracing-based Monte Carlo Simulator for PET
+ *
+ * Copyright (c) 2018, David Freese, Peter Olcott, Sam Buss, Craig Levin
+ *
+ * This software is distributed under the terms of the MIT License unless
+ * otherwise noted.  See LICENSE for further details.
+ *
+ */
+
+#include "Gray/Sources/DynamicVoxelSource.h"
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include "Gray/Gray/File.h"
+#include "Gray/Random/Random.h"
+
+std::atomic<uint64_t> DynamicVoxelSource::last_source_id(0);
+
+DynamicVoxelSource::DynamicVoxelSource(
+        const VectorR3& position, const VectorR3& size, const VectorR3& axis,
+        std::vector<Frame> frames) :
+    Source(position, 0),
+    frames(std::move(frames)),
+    size(size),
+    axis(axis),
+    local_to_global(RefAxisPlusTransToMap(axis, position)),
+    source_id(++last_source_id)
+{
+    // The activity of the source, as a whole, is that of its busiest frame.
+    for (const Frame& frame: this->frames) {
+        activity = std::max(activity, frame.activity);
+    }
+}
+
+size_t DynamicVoxelSource::FrameAfter(double time) const {
+    return (std::upper_bound(frames.begin(), frames.end(), time,
+                             [](double t, const Frame& frame) {
+                                 return (t < frame.start + frame.duration);
+                             }) - frames.begin());
+}
+
+double DynamicVoxelSource::NextDecayTime(double time, long&) const {
+    // The activity only changes within a frame with the isotope, so sample
+    // as any other source would, but start over from the start of the next
+    // frame if that would fall past the end of this one, as decays are
+    // memoryless.
+    for (size_t idx = FrameAfter(time); idx < frames.size(); ++idx) {
+        const Frame& frame = frames[idx];
+        const double frame_end = frame.start + frame.duration;
+        time = std::max(time, frame.start);
+        const double frame_activity = (frame.activity *
+                                       isotope->FractionRemaining(time));
+        if (frame_activity > 0) {
+            const double next = time + Random::Exponential(frame_activity);
+            if (next < frame_end) {
+                return (next);
+            }
+        }
+        time = frame_end;
+    }
+    return (std::numeric_limits<double>::infinity());
+}
+
+double DynamicVoxelSource::GetExpectedDecays(double start,
+                                             double time) const
+{
+    const double end = start + time;
+    double decays = 0;
+    for (const Frame& frame: frames) {
+        const double overlap_start = std::max(start, frame.start);
+        const double overlap_end = std::min(end, frame.start + frame.duration);
+        if (overlap_end > overlap_start) {
+            decays += frame.activity * isotope->FractionIntegral(
+                    overlap_start, overlap_end - overlap_start);
+        }
+    }
+    return (decays);
+}
+
+VectorR3 DynamicVoxelSource::DecayAt(double time, long) const {
+    // Times past the last frame only come from rounding.
+    const size_t idx = std::min(FrameAfter(time), frames.size() - 1);
+    return (GetFrame(idx).Decay());
+}
+
+VectorR3 DynamicVoxelSource::Decay() const {
+    return (DecayAt(frames.front().start, -1));
+}
+
+/*!
+ * Returns the frame, waiting for it to be read if it isn't ready.  Each
+ * thread keeps the frame it last used, so frame_mutex is only taken when a
+ * thread moves to another frame.  Then the one after it is started, and
+ * frames that every thread has moved past are dropped, once the lock has
+ * been released.
+ */
+const VoxelSource& DynamicVoxelSource::GetFrame(size_t idx) const {
+    struct CachedFrame {
+        uint64_t source_id = 0;
+        size_t idx = 0;
+        std::shared_ptr<const VoxelSource> frame;
+    };
+    static thread_local CachedFrame cached;
+    if ((cached.source_id == source_id) && (cached.idx == idx)) {
+        return (*cached.frame);
+    }
+
+    std::shared_future<std::shared_ptr<const VoxelSource>> frame;
+    std::vector<std::packaged_task<std::shared_ptr<const VoxelSource>()>>
+            reads;
+    std::vector<std::shared_future<std::shared_ptr<const VoxelSource>>>
+            dropped;
+    {
+        std::lock_guard<std::mutex> lock(frame_mutex);
+        thread_frames[std::this_thread::get_id()] = idx;
+        size_t oldest = idx;
+        for (const auto& thread_frame: thread_frames) {
+            oldest = std::min(oldest, thread_frame.second);
+        }
+        const auto keep = loaded_frames.lower_bound(oldest);
+        for (auto iter = loaded_frames.begin(); iter != keep; ++iter) {
+            dropped.push_back(std::move(iter->second));
+        }
+        loaded_frames.erase(loaded_frames.begin(), keep);
+        frame = RequestFrame(idx, reads);
+        if (idx + 1 < frames.size()) {
+            RequestFrame(idx + 1, reads);
+        }
+    }
+    for (auto& read: reads) {
+        std::thread(std::move(read)).detach();
+    }
+    // Let go of this thread's old frame before waiting on the new one.
+    cached = CachedFrame();
+    dropped.clear();
+    cached.frame = frame.get();
+    cached.source_id = source_id;
+    cached.idx = idx;
+    return (*cached.frame);
+}
+
+/*!
+ * Returns the frame if it has been requested already.  Otherwise, adds the
+ * read for it to reads, to be started once frame_mutex, which must be held,
+ * is released.  The read only uses copies of what it needs, so it can
+ * finish after the source is gone.
+ */
+std::shared_future<std::shared_ptr<const VoxelSource>>
+DynamicVoxelSource::RequestFrame(
+        size_t idx,
+        std::vector<std::packaged_task<
+                std::shared_ptr<const VoxelSource>()>>& reads) const
+{
+    auto iter = loaded_frames.find(idx);
+    if (iter != loaded_frames.end()) {
+        return (iter->second);
+    }
+    const VectorR3 frame_pos = position;
+    const VectorR3 frame_size = size;
+    const VectorR3 frame_axis = axis;
+    const Frame& info = frames[idx];
+    std::packaged_task<std::shared_ptr<const VoxelSource>()> read(
+            [frame_pos, frame_size, frame_axis, info]() {
+        std::shared_ptr<VoxelSource> source(new VoxelSource(
+                frame_pos, frame_size, frame_axis, 0));
+        if (!source->Load(info.filename)) {
+            throw std::runtime_error("Unable to load dynamic frame: " +
+                                     info.filename);
+        }
+        return (std::shared_ptr<const VoxelSource>(std::move(source)));
+    });
+    auto frame = read.get_future().share();
+    reads.push_back(std::move(read));
+    loaded_frames.emplace(idx, frame);
+    return (frame);
+}
+
+size_t DynamicVoxelSource::NumLoadedFrames() const {
+    std::lock_guard<std::mutex> lock(frame_mutex);
+    return (loaded_frames.size());
+}
+
+bool DynamicVoxelSource::Inside(const VectorR3&) const {
+    return (false);
+}
+
+AABB DynamicVoxelSource::GetExtents() const {
+    return (LocalBoxExtents(local_to_global, size / 2.0));
+}
+
+bool DynamicVoxelSource::LoadFrames(
+        std::istream& input, const std::string& dir, double activity_scale,
+        std::vector<Frame>& frames)
+{
+    if (!input) {
+        return (false);
+    }
+    frames.clear();
+    std::string line;
+    while (std::getline(input, line)) {
+        std::stringstream line_stream(line);
+        std::string first;
+        if (!(line_stream >> first) || (first.front() == '#')) {
+            continue;
+        }
+        line_stream.str(line);
+        line_stream.clear();
+        Frame frame;
+        double activity_uci;
+        std::string extra;
+        if (!(line_stream >> frame.start >> frame.duration >> frame.filename
+                          >> activity_uci) || (line_stream >> extra))
+        {
+            std::cerr << "Invalid frame: \"" << line << "\"\n"
+                      << "format: [start time] [duration] [filename]"
+                      << " [activity]\n";
+            return (false);
+        }
+        frame.filename = File::Join(dir, frame.filename);
+        frame.activity = (activity_scale * activity_uci *
+                          Physics::decays_per_microcurie);
+        frames.push_back(frame);
+    }
+    return (!frames.empty());
+}
+
+bool DynamicVoxelSource::CheckFrames(const std::vector<Frame>& frames) {
+    if (frames.empty()) {
+        return (false);
+    }
+    for (size_t idx = 0; idx < frames.size(); ++idx) {
+        const Frame& frame = frames[idx];
+        if (!(frame.duration > 0) || !(frame.activity >= 0)) {
+            return (false);
+        }
+        if ((idx > 0) && (frame.start <
+                          frames[idx - 1].start + frames[idx - 1].duration))
+        {
+            return (false);
+        }
+        std::ifstream input(frame.filename, std::ios::binary);
+        std::array<int, 3> dims;
+        if (!VoxelSource::LoadHeader(input, dims)) {
+            return (false);
+        }
+    }
+    return (true);
+}
@@ -77,3 +77,9 @@ bool EllipsoidSource::Inside(const VectorR3 & pos) const
     // ellipsoid test
     return ((r1 + r2 + r3) < 1);
 }
+
+AABB EllipsoidSource::GetExtents() const
+{
+    return (LocalBoxExtents(local_to_global,
+                            VectorR3(radius1, radius2, radius3)));
+}
@@ -47,3 +47,9 @@ bool EllipticCylinderSource::Inside(const VectorR3 & pos) const
     const double r2 = (roted.y * roted.y) / (radius2 * radius2);
     return (((r1 + r2) <= 1.0) && (std::abs(roted.z) <= (height / 2.0)));
 }
+
+AABB EllipticCylinderSource::GetExtents() const
+{
+    return (LocalBoxExtents(local_to_global,
+                            VectorR3(radius1, radius2, height / 2)));
+}
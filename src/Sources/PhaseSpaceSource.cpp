@@ -0,0 +1,115 @@
+/*
+ * Gray: A Ray Tracing-based Monte Carlo Simulator for PET
+ *
+ * Copyright (c) 2018, David Freese, Peter Olcott, Sam Buss, Craig Levin
+ *
+ * This software is distributed under the terms of the MIT License unless
+ * otherwise noted.  See LICENSE for further details.
+ *
+ */
+
+#include "Gray/Sources/PhaseSpaceSource.h"
+#include <algorithm>
+#include <limits>
+#include "Gray/Physics/NuclearDecay.h"
+#include "Gray/Physics/Photon.h"
+
+bool PhaseSpaceSource::Load(const std::string& filename) {
+    file.reset(new MappedFile(filename));
+    if (!PhaseSpace::ReadHeader(file->data, file->size, extents)) {
+        file.reset();
+        return (false);
+    }
+    const char* data = file->data + sizeof(PhaseSpace::Header);
+    records_begin = reinterpret_cast<const PhaseSpace::Record*>(data);
+    records_end = records_begin + ((file->size - sizeof(PhaseSpace::Header)) /
+                                   sizeof(PhaseSpace::Record));
+    position = (extents.GetBoxMin() + extents.GetBoxMax()) / 2.0;
+    return (true);
+}
+
+const PhaseSpace::Record* PhaseSpaceSource::LowerBound(double time) const {
+    return (std::lower_bound(records_begin, records_end, time,
+                             [](const PhaseSpace::Record& r, double t) {
+                                 return (r.decay_time < t);
+                             }));
+}
+
+const PhaseSpace::Record* PhaseSpaceSource::UpperBound(double time) const {
+    return (std::upper_bound(records_begin, records_end, time,
+                             [](double t, const PhaseSpace::Record& r) {
+                                 return (t < r.decay_time);
+                             }));
+}
+
+const PhaseSpace::Record* PhaseSpaceSource::RecordAt(long index) const {
+    if ((index < 0) || (static_cast<size_t>(index) >= NumRecords())) {
+        return (nullptr);
+    }
+    return (records_begin + index);
+}
+
+const PhaseSpace::Record* PhaseSpaceSource::DecayEnd(
+        const PhaseSpace::Record* first) const
+{
+    const PhaseSpace::Record* record = first;
+    while ((record != records_end) &&
+           (record->decay_time == first->decay_time) &&
+           (record->decay_id == first->decay_id))
+    {
+        ++record;
+    }
+    return (record);
+}
+
+double PhaseSpaceSource::NextDecayTime(double time, long& index) const {
+    const PhaseSpace::Record* current = RecordAt(index);
+    const PhaseSpace::Record* next = current ? DecayEnd(current) :
+                                               UpperBound(time);
+    index = next - records_begin;
+    if (next == records_end) {
+        return (std::numeric_limits<double>::infinity());
+    }
+    return (next->decay_time);
+}
+
+double PhaseSpaceSource::GetExpectedPhotons(double start, double time) const {
+    return (LowerBound(start + time) - LowerBound(start));
+}
+
+VectorR3 PhaseSpaceSource::DecayAt(double, long index) const {
+    const PhaseSpace::Record* record = RecordAt(index);
+    if (!record) {
+        return (position);
+    }
+    return (VectorR3(record->pos[0], record->pos[1], record->pos[2]));
+}
+
+NuclearDecay PhaseSpaceSource::Emit(int decay_number, double time, long index,
+                                    int src_id, const VectorR3& position) const
+{
+    NuclearDecay decay(decay_number, time, src_id, position, 0);
+    const PhaseSpace::Record* begin = RecordAt(index);
+    if (!begin) {
+        return (decay);
+    }
+    // The photons share the weight of the decay, apart from roulette.
+    decay.SetWeight(begin->weight / begin->roulette_weight);
+    const PhaseSpace::Record* end = DecayEnd(begin);
+    for (const PhaseSpace::Record* record = begin; record != end; ++record) {
+        decay.AddPhoton(PhaseSpace::MakePhoton(*record, decay_number));
+    }
+    return (decay);
+}
+
+VectorR3 PhaseSpaceSource::Decay() const {
+    return (position);
+}
+
+bool PhaseSpaceSource::Inside(const VectorR3 & pos) const {
+    return (extents.Inside(pos));
+}
+
+AABB PhaseSpaceSource::GetExtents() const {
+    return (extents);
+}
@@ -22,3 +22,8 @@ VectorR3 PointSource::Decay() const {
 bool PointSource::Inside(const VectorR3&) const {
     return false;
 }
+
+AABB PointSource::GetExtents() const
+{
+    return (AABB(position, position));
+}
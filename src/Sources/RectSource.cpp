@@ -42,3 +42,8 @@ bool RectSource::Inside(const VectorR3 & pos) const
             (std::abs(dist.y) <= size.y / 2.0) &&
             (std::abs(dist.z) <= size.z / 2.0));
 }
+
+AABB RectSource::GetExtents() const
+{
+    return (LocalBoxExtents(local_to_global, size / 2.0));
+}
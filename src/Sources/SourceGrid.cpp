@@ -0,0 +1,125 @@
+/*
+ * Gray: A Ray Tracing-based Monte Carlo Simulator for PET
+ *
+ * Copyright (c) 2018, David Freese, Peter Olcott, Sam Buss, Craig Levin
+ *
+ * This software is distributed under the terms of the MIT License unless
+ * otherwise noted.  See LICENSE for further details.
+ *
+ */
+
+#include "Gray/Sources/SourceGrid.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include "Gray/Sources/Source.h"
+
+constexpr int SourceGrid::cells_per_source;
+constexpr int SourceGrid::max_cells_per_axis;
+
+SourceGrid::SourceGrid(
+        const std::vector<std::shared_ptr<const Source>>& sources)
+{
+    if (sources.empty()) {
+        return;
+    }
+    std::vector<AABB> boxes;
+    boxes.reserve(sources.size());
+    for (const auto& source: sources) {
+        boxes.push_back(source->GetExtents());
+        if (boxes.size() == 1) {
+            extents = boxes.back();
+        } else {
+            extents.EnlargeToEnclose(boxes.back());
+        }
+    }
+    // Pad the boxes so that a point a source finds inside of itself through
+    // rounding is still in its box.
+    const double pad_dist = 1e-9 * (1.0 + (extents.GetBoxMax() -
+                                           extents.GetBoxMin()).Norm());
+    const VectorR3 pad(pad_dist, pad_dist, pad_dist);
+    for (AABB& box: boxes) {
+        box.Set(box.GetBoxMin() - pad, box.GetBoxMax() + pad);
+    }
+    extents.Set(extents.GetBoxMin() - pad, extents.GetBoxMax() + pad);
+    const int per_axis = std::min(max_cells_per_axis, static_cast<int>(
+            std::ceil(std::cbrt(static_cast<double>(cells_per_source) *
+                                sources.size()))));
+    const VectorR3 size = extents.GetBoxMax() - extents.GetBoxMin();
+    for (int axis = 0; axis < 3; ++axis) {
+        if (size[axis] > 0) {
+            no_cells[axis] = per_axis;
+            inv_cell_size[axis] = per_axis / size[axis];
+        } else {
+            no_cells[axis] = 1;
+            inv_cell_size[axis] = 0;
+        }
+    }
+
+    // Count the sources in each cell, and then fill them in, in order.
+    const size_t no_total = (static_cast<size_t>(no_cells[0]) * no_cells[1] *
+                             no_cells[2]);
+    offsets.assign(no_total + 1, 0);
+    for (int pass = 0; pass < 2; ++pass) {
+        std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t src = 0; src < boxes.size(); ++src) {
+            std::array<int, 3> lo;
+            std::array<int, 3> hi;
+            for (int axis = 0; axis < 3; ++axis) {
+                lo[axis] = AxisCell(boxes[src].GetBoxMin(), axis);
+                hi[axis] = AxisCell(boxes[src].GetBoxMax(), axis);
+            }
+            for (int ix = lo[0]; ix <= hi[0]; ++ix) {
+                for (int iy = lo[1]; iy <= hi[1]; ++iy) {
+                    for (int iz = lo[2]; iz <= hi[2]; ++iz) {
+                        const size_t cell = (static_cast<size_t>(ix) *
+                                             no_cells[1] + iy) *
+                                            no_cells[2] + iz;
+                        if (pass == 0) {
+                            offsets[cell + 1]++;
+                        } else {
+                            indices[fill[cell]++] = static_cast<uint32_t>(src);
+                        }
+                    }
+                }
+            }
+        }
+        if (pass == 0) {
+            std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+            indices.resize(offsets.back());
+        }
+    }
+}
+
+/*!
+ * The cell along axis for a position, clamped to the grid.  This is the
+ * same calculation for a point as for the corners of a box, so a point in a
+ * box is always in one of its cells.
+ */
+int SourceGrid::AxisCell(const VectorR3& pos, int axis) const {
+    const double u = ((pos[axis] - extents.GetBoxMin()[axis]) *
+                      inv_cell_size[axis]);
+    return (std::min(std::max(static_cast<int>(std::floor(u)), 0),
+                     no_cells[axis] - 1));
+}
+
+long SourceGrid::CellAt(const VectorR3& pos) const {
+    if (offsets.empty() || !extents.Inside(pos)) {
+        return (-1);
+    }
+    return ((static_cast<long>(AxisCell(pos, 0)) * no_cells[1] +
+             AxisCell(pos, 1)) * no_cells[2] + AxisCell(pos, 2));
+}
+
+void SourceGrid::Candidates(const VectorR3& pos, const uint32_t*& begin,
+                            const uint32_t*& end) const
+{
+    const long cell = CellAt(pos);
+    if (cell < 0) {
+        begin = nullptr;
+        end = nullptr;
+        return;
+    }
+    begin = indices.data() + offsets[cell];
+    end = indices.data() + offsets[cell + 1];
+}
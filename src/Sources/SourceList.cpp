@@ -57,6 +57,20 @@ size_t SourceList::NumSources() const {
     return (list.size());
 }
 
+std::vector<double> SourceList::EmittedEnergies() const {
+    std::vector<double> energies;
+    for (const auto& iso_pair: valid_isotopes) {
+        const std::vector<double> iso_energies =
+                iso_pair.second->EmittedEnergies();
+        energies.insert(energies.end(), iso_energies.begin(),
+                        iso_energies.end());
+    }
+    std::sort(energies.begin(), energies.end());
+    energies.erase(std::unique(energies.begin(), energies.end()),
+                   energies.end());
+    return (energies);
+}
+
 std::shared_ptr<const Source> SourceList::GetSource(size_t idx) const {
     return (list[idx]);
 }
@@ -70,8 +84,10 @@ double SourceList::GetTime() const
     }
     // Set the current time to be the next decay that will happen.  This won't
     // be accessed until the next iteration of the main loop, this way we don't
-    // simulate events outside of the simulation time.
-    return(decay_list.top().time);
+    // simulate events outside of the simulation time.  Sources that have run
+    // out of decays, such as a dynamic source past its last frame, give an
+    // infinite time, which is held to the end of the simulation.
+    return(std::min(decay_list.top().time, end_time));
 }
 
 double SourceList::GetElapsedTime() const {
@@ -101,15 +117,36 @@ std::vector<VectorR3> SourceList::GetSourcePositions() const {
 }
 
 SourceList::DecayInfo SourceList::NextDecay(DecayInfo base_info) const {
+    if (superposed) {
+        return (NextSuperposedDecay(base_info));
+    }
     // Calculating the next source decay timesize_t source_idx, double base_time
     auto & source = list[base_info.source_idx];
     do {
-        double source_activity_bq = source->GetActivity(base_info.time);
         // Time advances even if the decay is rejected by the inside negative
         // source test.  This is by design, as we do not know how much activity
         // a negative source inherently removes from the positive sources.
-        base_info.time += Random::Exponential(source_activity_bq);
-        base_info.position = source->Decay();
+        base_info.time = source->NextDecayTime(base_info.time,
+                                               base_info.index);
+        base_info.position = source->DecayAt(base_info.time, base_info.index);
+    } while (InsideNegative(base_info.position));
+    return (base_info);
+}
+
+SourceList::DecayInfo SourceList::NextSuperposedDecay(
+        DecayInfo base_info) const
+{
+    // Every source has the same fraction of its activity remaining, so the
+    // activity of the list is the total of the initial activities scaled by
+    // that fraction.
+    const Isotope& isotope = list.front()->GetIsotope();
+    do {
+        base_info.time += Random::Exponential(
+                source_table.TotalWeight() *
+                isotope.FractionRemaining(base_info.time));
+        base_info.source_idx = static_cast<int>(
+                source_table.Sample(Random::Uniform()));
+        base_info.position = list[base_info.source_idx]->Decay();
     } while (InsideNegative(base_info.position));
     return (base_info);
 }
@@ -129,13 +166,22 @@ NuclearDecay SourceList::Decay() {
 
     DecayInfo decay = GetNextDecay();
 
-    const Isotope& isotope = list[decay.source_idx]->GetIsotope();
-    return (isotope.Decay(
-            decay_number++, decay.time, decay.source_idx, decay.position));
+    return (list[decay.source_idx]->Emit(
+            decay_number++, decay.time, decay.index, decay.source_idx,
+            decay.position));
 }
 
 bool SourceList::InsideNegative(const VectorR3 & pos) const {
-    for (const auto& source : neg_list) {
+    if (neg_list.empty()) {
+        return (false);
+    }
+    // The candidates are in the same order as neg_list, and the rest can't
+    // contain pos, so this is the same as checking every source in turn.
+    const uint32_t* begin;
+    const uint32_t* end;
+    neg_grid.Candidates(pos, begin, end);
+    for (const uint32_t* idx = begin; idx != end; ++idx) {
+        const auto& source = neg_list[*idx];
         if (source->Inside(pos)) {
             double ratio = -1 * source->GetActivity();
             if (Random::Selection(ratio)) {
@@ -240,6 +286,14 @@ void SourceList::DisableHalfLife() {
     }
 }
 
+void SourceList::SetEmissionBias(std::shared_ptr<const EmissionBias> bias) {
+    // Like DisableHalfLife, this is only done while loading.
+    for (auto& iso_pair : valid_isotopes) {
+        Isotope& iso = const_cast<Isotope&>(*iso_pair.second);
+        iso.SetEmissionBias(bias);
+    }
+}
+
 void SourceList::SetStartTime(double val)
 {
     start_time = val;
@@ -330,7 +384,44 @@ bool SourceList::PrintSplits(int n) const {
     return (true);
 }
 
+/*!
+ * The sources can be sampled as one if there is more than one, and all of
+ * their activities fall off with the same half-life, which includes all of
+ * them having the half-life disabled.  Dynamic sources never can.
+ */
+bool SourceList::CanSuperpose() const {
+    if (list.size() < 2) {
+        return (false);
+    }
+    const double half_life = list.front()->GetIsotope().GetHalfLife();
+    double total_activity = 0;
+    for (const auto& source: list) {
+        if (source->IsDynamic() ||
+            (source->GetIsotope().GetHalfLife() != half_life))
+        {
+            return (false);
+        }
+        total_activity += source->GetActivity();
+    }
+    return (total_activity > 0);
+}
+
 void SourceList::InitSources() {
+    neg_grid = SourceGrid(neg_list);
+    superposed = CanSuperpose();
+    if (superposed) {
+        std::vector<double> activities(list.size());
+        std::transform(list.begin(), list.end(), activities.begin(),
+                       [](const std::shared_ptr<const Source>& s) {
+                           return s->GetActivity();
+                       });
+        source_table = AliasTable(activities);
+        DecayInfo info;
+        info.time = start_time;
+        info.source_idx = 0;
+        decay_list.emplace(NextDecay(info));
+        return;
+    }
     for (int sidx = 0; sidx < static_cast<int>(list.size()); ++sidx) {
         DecayInfo info;
         info.time = start_time;
@@ -532,18 +623,30 @@ bool SourceList::LoadIsotopes(std::istream& input) {
     }
 
     for (const std::string & iso_name : isotopes.getMemberNames ()) {
-        Json::Value isotope = isotopes[iso_name];
-        auto iso_ptr = IsotopeFactory(isotope, simulate_isotope_half_life);
-        if (!iso_ptr) {
-            std::cerr << "Unable to load isotope, \"" << iso_name << "\"\n";
+        if (!AddIsotope(iso_name, isotopes[iso_name])) {
             return (false);
         }
-        AddIsotope(iso_name, std::move(iso_ptr));
-        Json::Value is_default = isotope["default"];
-        if (is_default.isBool() && is_default.asBool()) {
-            current_isotope = iso_name;
-        }
     }
 
     return(true);
 }
+
+/*!
+ * Adds an isotope described as it is in the physics file, making it the
+ * current isotope if it is marked as the default.
+ */
+bool SourceList::AddIsotope(const std::string& iso_name,
+                            const Json::Value& isotope)
+{
+    auto iso_ptr = IsotopeFactory(isotope, simulate_isotope_half_life);
+    if (!iso_ptr) {
+        std::cerr << "Unable to load isotope, \"" << iso_name << "\"\n";
+        return (false);
+    }
+    AddIsotope(iso_name, std::move(iso_ptr));
+    Json::Value is_default = isotope["default"];
+    if (is_default.isBool() && is_default.asBool()) {
+        current_isotope = iso_name;
+    }
+    return (true);
+}
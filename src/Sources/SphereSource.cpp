@@ -31,3 +31,9 @@ bool SphereSource::Inside(const VectorR3 & pos) const
 {
     return ((pos - position).Norm() < radius);
 }
+
+AABB SphereSource::GetExtents() const
+{
+    return (AABB(position - VectorR3(radius, radius, radius),
+                 position + VectorR3(radius, radius, radius)));
+}
@@ -9,6 +9,8 @@
  */
 
 #include "Gray/Sources/VectorSource.h"
+#include <algorithm>
+#include <cmath>
 #include <exception>
 #include <memory>
 #include "Gray/Graphics/ViewableTriangle.h"
@@ -17,29 +19,154 @@
 
 using namespace std;
 
+constexpr int VectorSource::max_cells_per_axis;
 
 VectorSource::VectorSource(const double act,
                            std::unique_ptr<SceneDescription> scene) :
     Source({0, 0, 0}, act),
     size(scene->GetExtents().GetBoxMax() - scene->GetExtents().GetBoxMin()),
     center((scene->GetExtents().GetBoxMax() + scene->GetExtents().GetBoxMin()) / 2.0),
+    extents(center - size / 2.0, center + size / 2.0),
     scene(std::move(scene))
 {
     // Build the tree for the source specific scene.
     this->scene->BuildTree(true, 8.0);
+    BuildGrid();
+}
+
+/*!
+ * Splits the box into cells, marking each that a surface passes through as
+ * on the boundary.  The rest are either wholly inside or outside, and a run
+ * of them along z with no boundary between them all are the same, so only
+ * one of each run needs a ray cast.
+ */
+void VectorSource::BuildGrid() {
+    const double longest = std::max(size.x, std::max(size.y, size.z));
+    if (!(longest > 0)) {
+        return;
+    }
+    for (int axis = 0; axis < 3; ++axis) {
+        no_cells[axis] = std::max(1, static_cast<int>(std::ceil(
+                size[axis] / longest * max_cells_per_axis)));
+    }
+    cell_size.Set(size.x / no_cells[0], size.y / no_cells[1],
+                  size.z / no_cells[2]);
+    const size_t no_total = (static_cast<size_t>(no_cells[0]) * no_cells[1] *
+                             no_cells[2]);
+    enum State : uint8_t {UNKNOWN, BOUNDARY, INSIDE, OUTSIDE};
+    std::vector<uint8_t> state(no_total, UNKNOWN);
+
+    // Pad the cells a little, so that a surface lying on the face between
+    // two cells marks both.
+    const VectorR3 pad(1e-6 * longest, 1e-6 * longest, 1e-6 * longest);
+    const VectorR3 box_min = extents.GetBoxMin();
+    for (size_t obj = 0; obj < scene->NumViewables(); ++obj) {
+        const ViewableBase& viewable = scene->GetViewable(obj);
+        const AABB obj_box = viewable.GetAABB();
+        std::array<int, 3> lo;
+        std::array<int, 3> hi;
+        for (int axis = 0; axis < 3; ++axis) {
+            if (cell_size[axis] > 0) {
+                lo[axis] = static_cast<int>(std::floor(
+                        (obj_box.GetBoxMin()[axis] - pad[axis] -
+                         box_min[axis]) / cell_size[axis]));
+                hi[axis] = static_cast<int>(std::floor(
+                        (obj_box.GetBoxMax()[axis] + pad[axis] -
+                         box_min[axis]) / cell_size[axis]));
+            } else {
+                lo[axis] = 0;
+                hi[axis] = 0;
+            }
+            lo[axis] = std::max(lo[axis], 0);
+            hi[axis] = std::min(hi[axis], no_cells[axis] - 1);
+        }
+        for (int ix = lo[0]; ix <= hi[0]; ++ix) {
+            for (int iy = lo[1]; iy <= hi[1]; ++iy) {
+                for (int iz = lo[2]; iz <= hi[2]; ++iz) {
+                    const size_t index = (static_cast<size_t>(ix) *
+                                          no_cells[1] + iy) * no_cells[2] + iz;
+                    if (state[index] == BOUNDARY) {
+                        continue;
+                    }
+                    const VectorR3 cell_min(box_min.x + ix * cell_size.x,
+                                            box_min.y + iy * cell_size.y,
+                                            box_min.z + iz * cell_size.z);
+                    AABB clipped;
+                    if (viewable.CalcExtentsInBox(
+                            AABB(cell_min - pad, cell_min + cell_size + pad),
+                            clipped))
+                    {
+                        state[index] = BOUNDARY;
+                    }
+                }
+            }
+        }
+    }
+
+    for (size_t row = 0; row < no_total; row += no_cells[2]) {
+        uint8_t run_state = UNKNOWN;
+        for (size_t index = row; index < row + no_cells[2]; ++index) {
+            if (state[index] == BOUNDARY) {
+                run_state = UNKNOWN;
+                continue;
+            }
+            if (run_state == UNKNOWN) {
+                run_state = Inside(CellCenter(index)) ? INSIDE : OUTSIDE;
+            }
+            state[index] = run_state;
+        }
+    }
+    for (size_t index = 0; index < no_total; ++index) {
+        if ((state[index] == INSIDE) || (state[index] == BOUNDARY)) {
+            cells.push_back({static_cast<uint32_t>(index),
+                             state[index] == BOUNDARY});
+        }
+    }
+}
+
+VectorR3 VectorSource::CellCenter(size_t index) const {
+    const int iz = index % no_cells[2];
+    const int iy = (index / no_cells[2]) % no_cells[1];
+    const int ix = index / no_cells[2] / no_cells[1];
+    return (extents.GetBoxMin() +
+            VectorR3((ix + 0.5) * cell_size.x, (iy + 0.5) * cell_size.y,
+                     (iz + 0.5) * cell_size.z));
 }
 
 VectorR3 VectorSource::Decay() const {
     VectorR3 pos;
-    do {
-        pos = center + Random::UniformRectangle(size);
-    } while (!Inside(pos));
-    return (pos);
+    if (cells.empty()) {
+        do {
+            pos = center + Random::UniformRectangle(size);
+        } while (!Inside(pos));
+        return (pos);
+    }
+    // Every cell is the same size, so picking one evenly and then a position
+    // evenly within it is even over the cells.
+    while (true) {
+        const size_t pick = std::min(
+                static_cast<size_t>(Random::Uniform() * cells.size()),
+                cells.size() - 1);
+        const Cell& cell = cells[pick];
+        pos = CellCenter(cell.index) + Random::UniformRectangle(cell_size);
+        if (!cell.boundary || Inside(pos)) {
+            return (pos);
+        }
+    }
+}
+
+size_t VectorSource::NumInsideCells() const {
+    return (std::count_if(cells.begin(), cells.end(),
+                          [](const Cell& cell) { return (!cell.boundary); }));
+}
+
+size_t VectorSource::NumBoundaryCells() const {
+    return (cells.size() - NumInsideCells());
 }
 
 bool VectorSource::Inside(const VectorR3 & pos) const
 {
-    if (!scene->GetExtents().Inside(pos)) {
+    if (!extents.Inside(pos)) {
         return (false);
     }
     VectorR3 dir = Random::UniformSphere();
@@ -59,3 +186,8 @@ bool VectorSource::Inside(const VectorR3 & pos) const
     }
     throw(runtime_error("Material has no face"));
 }
+
+AABB VectorSource::GetExtents() const
+{
+    return (extents);
+}
@@ -13,7 +13,9 @@
 #include <array>
 #include <iostream>
 #include <fstream>
-#include <numeric>
+#include <future>
+#include <limits>
+#include <thread>
 #include <vector>
 #include "Gray/Random/Random.h"
 
@@ -28,18 +30,15 @@ VoxelSource::VoxelSource(
 }
 
 VectorR3 VoxelSource::Decay() const {
-    // Since we have created a CDF for the indices, we can do an inversion
-    // selection to randomly choose the voxel with the appropriate value. We
-    // have already created a sorted array, with 1.0 being the last value, so
-    // lower_bound will never select past end() - 1.  So idx ends up being
-    // [0, x*y*z - 1].
-    auto val = std::lower_bound(prob.begin(), prob.end(), Random::Uniform());
-    size_t idx = std::distance(prob.begin(), val);
-    // Now, since this was in [x,y,z], c order, calculate the voxel value in
-    // each of the dimensions.
+    // Pick the slice in x, and then the voxel within it, which is stored in
+    // [y][z] C order.
+    const size_t x = slice_table.Sample(Random::Uniform());
+    size_t idx = voxel_tables[x].Sample(Random::Uniform());
+    if (!voxel_indices[x].empty()) {
+        idx = voxel_indices[x][idx];
+    }
     int z = idx % dims[2];
-    int y = (idx / dims[2]) % dims[1];
-    int x = idx / dims[2] / dims[1];
+    int y = idx / dims[2];
 
     // Each dimension is distributed [0, dim - 1], add a random variable to
     // distribute within voxels so that we have [0, dim] as a float.  divide
@@ -54,16 +53,100 @@ VectorR3 VoxelSource::Decay() const {
 
 bool VoxelSource::Load(const std::string& filename) {
     std::ifstream input(filename);
-    if (!Load(input, prob, dims)) {
+    return (Load(input));
+}
+
+bool VoxelSource::Load(std::istream& input) {
+    std::vector<float> vox_vals;
+    if (!Load(input, vox_vals, dims)) {
+        return (false);
+    }
+    return (BuildTables(vox_vals));
+}
+
+/*!
+ * Builds the tables to pick a voxel from, spreading the slices across
+ * threads.  Returns false if a voxel is negative, or none are positive.
+ */
+bool VoxelSource::BuildTables(const std::vector<float>& vox_vals) {
+    if (static_cast<size_t>(dims[1]) * dims[2] >
+        std::numeric_limits<uint32_t>::max())
+    {
         return (false);
     }
-    std::partial_sum(prob.begin(), prob.end(), prob.begin());
-    for (double& val : prob) {
-        val /= prob.back();
+    voxel_tables.assign(dims[0], AliasTable());
+    voxel_indices.assign(dims[0], std::vector<uint32_t>());
+    std::vector<double> slice_weights(dims[0]);
+    const int no_tasks = std::max(1, std::min(
+            static_cast<int>(std::thread::hardware_concurrency()), dims[0]));
+    std::vector<std::future<void>> tasks;
+    for (int task = 0; task < no_tasks; ++task) {
+        tasks.push_back(std::async(std::launch::async,
+                                   [this, &vox_vals, &slice_weights, task,
+                                    no_tasks]() {
+            for (int slice = task; slice < dims[0]; slice += no_tasks) {
+                slice_weights[slice] = BuildSliceTable(vox_vals, slice);
+            }
+        }));
     }
+    for (auto& task: tasks) {
+        task.get();
+    }
+
+    double total = 0;
+    for (double weight: slice_weights) {
+        if (!(weight >= 0)) {
+            return (false);
+        }
+        total += weight;
+    }
+    if (!(total > 0)) {
+        return (false);
+    }
+    slice_table = AliasTable(slice_weights);
     return (true);
 }
 
+/*!
+ * Builds the table for a slice in x, returning its total activity, or NaN if
+ * any of its voxels are negative.
+ */
+double VoxelSource::BuildSliceTable(const std::vector<float>& vox_vals,
+                                    int slice)
+{
+    const size_t slice_size = static_cast<size_t>(dims[1]) * dims[2];
+    const float* values = vox_vals.data() + slice * slice_size;
+    size_t no_active = 0;
+    for (size_t idx = 0; idx < slice_size; ++idx) {
+        if (!(values[idx] >= 0)) {
+            return (std::numeric_limits<double>::quiet_NaN());
+        }
+        no_active += (values[idx] > 0);
+    }
+    if (no_active == 0) {
+        return (0);
+    }
+    // Listing the voxels with activity costs four bytes for each of them on
+    // top of its entry in the table, so it only saves memory if fewer than
+    // two thirds of them have any.
+    std::vector<double> weights;
+    if (3 * no_active < 2 * slice_size) {
+        std::vector<uint32_t>& indices = voxel_indices[slice];
+        weights.reserve(no_active);
+        indices.reserve(no_active);
+        for (size_t idx = 0; idx < slice_size; ++idx) {
+            if (values[idx] > 0) {
+                weights.push_back(values[idx]);
+                indices.push_back(static_cast<uint32_t>(idx));
+            }
+        }
+    } else {
+        weights.assign(values, values + slice_size);
+    }
+    voxel_tables[slice] = AliasTable(weights);
+    return (voxel_tables[slice].TotalWeight());
+}
+
 /*!
  * Reads a binary image.  Assumes the image has a 20 bytes, 4 int32 header that
  * contains:
@@ -75,27 +158,14 @@ bool VoxelSource::Load(const std::string& filename) {
  */
 bool VoxelSource::Load(
         std::istream& input,
-        std::vector<double>& vox_vals,
+        std::vector<float>& vox_vals,
         std::array<int,3>& dims)
 {
-    if (!input) {
-        return (false);
-    }
-    int magic_number;
-    int version_number;
-
-    input.read(reinterpret_cast<char*>(&magic_number),
-            sizeof(magic_number));
-    input.read(reinterpret_cast<char*>(&version_number),
-            sizeof(version_number));
-    input.read(reinterpret_cast<char*>(dims.data()),
-            sizeof(int) * dims.size());
-
-    if (!input || (magic_number != 65531) || (version_number != 1)) {
+    if (!LoadHeader(input, dims)) {
         return (false);
     }
 
-    int no_vox = dims[0] * dims[1] * dims[2];
+    size_t no_vox = static_cast<size_t>(dims[0]) * dims[1] * dims[2];
     std::vector<float> data(no_vox);
 
     input.read(reinterpret_cast<char*>(data.data()), no_vox * sizeof(float));
@@ -106,12 +176,13 @@ bool VoxelSource::Load(
 
     vox_vals.clear();
     vox_vals.resize(no_vox);
-    int idx = 0;
+    size_t idx = 0;
     for (int x = 0; x < dims[0]; ++x) {
         for (int y = 0; y < dims[1]; ++y) {
             for (int z = 0; z < dims[2]; ++z) {
                 // Calculate the index into the XZY array
-                int data_idx = (x * dims[2] + z) * dims[1] + y;
+                size_t data_idx = (static_cast<size_t>(x) * dims[2] + z) *
+                                  dims[1] + y;
                 vox_vals[idx++] = data[data_idx];
             }
         }
@@ -119,7 +190,48 @@ bool VoxelSource::Load(
     return (true);
 }
 
+bool VoxelSource::LoadHeader(std::istream& input, std::array<int,3>& dims) {
+    if (!input) {
+        return (false);
+    }
+    int magic_number;
+    int version_number;
+
+    input.read(reinterpret_cast<char*>(&magic_number),
+            sizeof(magic_number));
+    input.read(reinterpret_cast<char*>(&version_number),
+            sizeof(version_number));
+    input.read(reinterpret_cast<char*>(dims.data()),
+            sizeof(int) * dims.size());
+
+    if (!input || (magic_number != 65531) || (version_number != 1)) {
+        return (false);
+    }
+    if ((dims[0] < 1) || (dims[1] < 1) || (dims[2] < 1)) {
+        return (false);
+    }
+    return (true);
+}
+
+bool VoxelSource::Load(
+        std::istream& input,
+        std::vector<double>& vox_vals,
+        std::array<int,3>& dims)
+{
+    std::vector<float> values;
+    if (!Load(input, values, dims)) {
+        return (false);
+    }
+    vox_vals.assign(values.begin(), values.end());
+    return (true);
+}
+
 bool VoxelSource::Inside(const VectorR3&) const {
     // TODO: allow for positioning inside of voxelized sources
     return false;
 }
+
+AABB VoxelSource::GetExtents() const
+{
+    return (LocalBoxExtents(local_to_global, size / 2.0));
+}
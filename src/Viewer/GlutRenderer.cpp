@@ -44,6 +44,7 @@
 #include "Gray/Graphics/ViewableCone.h"
 #include "Gray/Graphics/ViewableCylinder.h"
 #include "Gray/Graphics/ViewableEllipsoid.h"
+#include "Gray/Graphics/ViewableInstance.h"
 #include "Gray/Graphics/ViewableParallelepiped.h"
 #include "Gray/Graphics/ViewableParallelogram.h"
 #include "Gray/Graphics/ViewableSphere.h"
@@ -219,6 +220,11 @@ void GlutRenderer::RenderViewable(ViewableBase const * const ptr)
         RenderViewableEllipsoid(*elp_ptr);
         return;
     }
+    ViewableInstance const * const ins_ptr = dynamic_cast<ViewableInstance const * const>(ptr);
+    if (ins_ptr) {
+        RenderViewableInstance(*ins_ptr);
+        return;
+    }
     ViewableParallelepiped const * const plp_ptr = dynamic_cast<ViewableParallelepiped const * const>(ptr);
     if (plp_ptr) {
         RenderViewableParallelepiped(*plp_ptr);
@@ -505,6 +511,23 @@ void GlutRenderer::RenderViewableEllipsoid( const ViewableEllipsoid& object )
 
 }
 
+void GlutRenderer::RenderViewableInstance( const ViewableInstance& object )
+{
+    // Render the module's viewables with the placement applied to the
+    // modelview matrix, which opengl expects in column order.
+    const RigidMapR3& map = object.GetPlacement();
+    const GLdouble matrix[16] = {
+        map.m11, map.m21, map.m31, 0.0,
+        map.m12, map.m22, map.m32, 0.0,
+        map.m13, map.m23, map.m33, 0.0,
+        map.m14, map.m24, map.m34, 1.0};
+    glMatrixMode( GL_MODELVIEW );
+    glPushMatrix();
+    glMultMatrixd( matrix );
+    RenderViewables( object.GetModule() );
+    glPopMatrix();
+}
+
 void GlutRenderer::RenderViewableParallelepiped( const ViewableParallelepiped& object )
 {
     // Set material properties
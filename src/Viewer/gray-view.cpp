@@ -2,7 +2,7 @@
 #include "Gray/Graphics/SceneDescription.h"
 #include "Gray/Gray/Config.h"
 #include "Gray/Gray/Load.h"
-#include "Gray/Gray/LoadMaterials.h"
+#include "Gray/Gray/PhysicsFile.h"
 #include "Gray/Gray/Simulation.h"
 #include "Gray/Output/DetectorArray.h"
 #include "Gray/Sources/SourceList.h"
@@ -22,15 +22,7 @@ int main(int argc, char ** argv)
     DetectorArray detector_array;
     SceneDescription scene;
     SourceList sources;
-    if (!sources.LoadIsotopes(config.get_physics_filename())) {
-        cerr << "Unable to load physics file: \""
-        << config.get_physics_filename() << "\"\n"
-        << "Check GRAY_INCLUDE env variable or specify name with --phys"
-        << endl;
-        return(1);
-    }
-    if (!LoadMaterials::LoadPhysicsJson(scene, config.get_physics_filename()))
-    {
+    if (!PhysicsFile::Load(config.get_physics_filename(), scene, sources)) {
         cerr << "Unable to load physics file: \""
         << config.get_physics_filename() << "\"\n"
         << "Check GRAY_INCLUDE env variable or specify name with --phys"
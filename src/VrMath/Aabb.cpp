@@ -77,7 +77,7 @@ bool AABB::RayIntersect(const VectorR3& startPos, const VectorR3 & dirInv,
     return((tmin < t1) && (tmax > t0));
 }
 
-bool AABB::Inside(const VectorR3 & pos) {
+bool AABB::Inside(const VectorR3 & pos) const {
     return ((pos.x >= GetMinX()) &&
             (pos.x <= GetMaxX()) &&
             (pos.y >= GetMinY()) &&
@@ -9,20 +9,48 @@
  */
 
 #include "gtest/gtest.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <random>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <utility>
+#include "Gray/Daq/DaqModel.h"
+#include "Gray/Daq/Mapping.h"
+#include "Gray/Daq/ProcessStats.h"
 #include "Gray/Graphics/SceneDescription.h"
 #include "Gray/Graphics/ViewableCylinder.h"
 #include "Gray/Graphics/ViewableEllipsoid.h"
 #include "Gray/Graphics/ViewableParallelepiped.h"
 #include "Gray/Graphics/ViewableSphere.h"
 #include "Gray/Graphics/ViewableTriangle.h"
+#include "Gray/Graphics/ViewableVoxelGrid.h"
 #include "Gray/Gray/Config.h"
+#include "Gray/Gray/DeltaMaterial.h"
+#include "Gray/Gray/DetectorResponse.h"
 #include "Gray/Gray/GammaMaterial.h"
+#include "Gray/Gray/GammaRayTrace.h"
+#include "Gray/Gray/GammaRayTraceStats.h"
 #include "Gray/Gray/Load.h"
+#include "Gray/Gray/LoadMaterials.h"
+#include "Gray/Gray/MaterialGrid.h"
+#include "Gray/Gray/PhaseSpace.h"
+#include "Gray/Gray/PhysicsFile.h"
 #include "Gray/Gray/Syntax.h"
 #include "Gray/Output/DetectorArray.h"
+#include "Gray/Output/Input.h"
 #include "Gray/Output/Output.h"
 #include "Gray/Physics/GammaStats.h"
+#include "Gray/Physics/NuclearDecay.h"
+#include "Gray/Physics/Photon.h"
+#include "Gray/Physics/Physics.h"
+#include "Gray/Random/Random.h"
+#include "Gray/Sources/DynamicVoxelSource.h"
 #include "Gray/Sources/SourceList.h"
 #include "Gray/Sources/VectorSource.h"
 
@@ -97,6 +125,46 @@ TEST(LoadTest, HitsOutput) {
     EXPECT_FALSE(Load::ConfigCommand(cmd, config));
 }
 
+TEST(LoadTest, EmissionBias) {
+    Config config;
+    EXPECT_FALSE(config.get_hits_var_output_write_flags().weight);
+
+    Command cmd("emission_bias 0.9");
+    EXPECT_TRUE(Load::ConfigCommand(cmd, config));
+    EXPECT_EQ(config.get_emission_bias(), 0.9);
+    EXPECT_TRUE(config.get_hits_var_output_write_flags().weight);
+    EXPECT_TRUE(config.get_coinc_var_output_write_flags().weight);
+
+    cmd = Command("emission_bias 1.5");
+    EXPECT_FALSE(Load::ConfigCommand(cmd, config));
+    cmd = Command("emission_bias");
+    EXPECT_FALSE(Load::ConfigCommand(cmd, config));
+}
+
+TEST(LoadTest, RussianRoulette) {
+    Config config;
+    Command cmd("russian_roulette 0.2 0.1");
+    EXPECT_TRUE(Load::ConfigCommand(cmd, config));
+    EXPECT_EQ(config.get_roulette_energy(), 0.2);
+    EXPECT_EQ(config.get_roulette_survival(), 0.1);
+    EXPECT_TRUE(config.get_singles_var_output_write_flags().weight);
+
+    cmd = Command("russian_roulette 0.2 0.0");
+    EXPECT_FALSE(Load::ConfigCommand(cmd, config));
+    cmd = Command("russian_roulette 0.2");
+    EXPECT_FALSE(Load::ConfigCommand(cmd, config));
+}
+
+TEST(LoadTest, MaterialGrid) {
+    Config config;
+    EXPECT_FALSE(config.get_material_grid());
+    Command cmd("material_grid");
+    EXPECT_TRUE(Load::ConfigCommand(cmd, config));
+    EXPECT_TRUE(config.get_material_grid());
+    cmd = Command("material_grid on");
+    EXPECT_FALSE(Load::ConfigCommand(cmd, config));
+}
+
 TEST(LoadTest, SinglesOutput) {
     Config config;
     Command cmd("singles_output test.dat");
@@ -358,6 +426,86 @@ TEST(LoadTest, ConfigCommandsUnknown) {
 }
 
 
+TEST(PhysicsFileTest, CompileAndLoad) {
+    const std::string phys_json = R"json({
+        "materials": {
+            "Water": {
+                "density": 1.0, "index": 0, "sensitive": false,
+                "energy": [0.01, 0.1, 1.0],
+                "matten_comp": [0.15, 0.17, 0.07],
+                "matten_phot": [4.9, 0.003, 1e-5],
+                "matten_rayl": [0.2, 0.01, 1e-4],
+                "x": [0.0, 1.0, 10.0], "form_factor": [8.0, 2.0, 0.1],
+                "scattering_func": [0.0, 7.0, 10.0]
+            },
+            "LSO": {
+                "density": 7.4, "index": 1, "sensitive": true,
+                "energy": [0.01, 1.0],
+                "matten_comp": [0.05, 0.05],
+                "matten_phot": [90.0, 0.02],
+                "matten_rayl": [1.0, 1e-3],
+                "x": [0.0, 10.0], "form_factor": [60.0, 1.0],
+                "scattering_func": [0.0, 60.0]
+            }
+        },
+        "isotopes": {
+            "F18": {
+                "acolinearity_deg_fwhm": 0.57, "half_life_s": 6584.04,
+                "model": "gauss", "fwhm_mm": 0.2, "max_range_mm": 3.0,
+                "positron_emiss_prob": 0.9686,
+                "prompt_gamma_energy_mev": 0.0, "default": true
+            },
+            "BackBack": {
+                "acolinearity_deg_fwhm": 0.0, "half_life_s": -1,
+                "model": "none", "positron_emiss_prob": 1.0,
+                "prompt_gamma_energy_mev": 0.0
+            }
+        }})json";
+    std::stringstream input(phys_json);
+    std::stringstream output;
+    ASSERT_TRUE(PhysicsFile::Compile(input, output));
+    const std::string compiled = output.str();
+    ASSERT_TRUE(PhysicsFile::IsCompiled(compiled.data(), compiled.size()));
+    EXPECT_FALSE(PhysicsFile::IsCompiled(compiled.data(),
+                                         compiled.size() - 8));
+    EXPECT_FALSE(PhysicsFile::IsCompiled(phys_json.data(), phys_json.size()));
+    EXPECT_EQ(PhysicsFile::CompiledFilename("dir/GrayPhysics.json"),
+              "dir/GrayPhysics.bin");
+
+    SceneDescription scene;
+    SourceList sources;
+    ASSERT_TRUE(PhysicsFile::LoadCompiled(compiled.data(), compiled.size(),
+                                          scene, sources));
+    std::stringstream json_input(phys_json);
+    Json::Value root;
+    json_input >> root;
+    SceneDescription json_scene;
+    for (const std::string& name: root["materials"].getMemberNames()) {
+        ASSERT_TRUE(LoadMaterials::LoadMaterialJson(
+                json_scene, name, root["materials"][name]));
+    }
+    LoadMaterials::AddDefaultMaterial(json_scene);
+
+    // The same materials, in the same order, as loading the json.
+    ASSERT_EQ(scene.NumMaterials(), json_scene.NumMaterials());
+    for (size_t idx = 0; idx < scene.NumMaterials(); ++idx) {
+        const auto& mat = static_cast<const GammaMaterial&>(
+                scene.GetMaterial(idx));
+        const auto& json_mat = static_cast<const GammaMaterial&>(
+                json_scene.GetMaterial(idx));
+        EXPECT_EQ(mat.GetName(), json_mat.GetName());
+        EXPECT_EQ(mat.GetId(), json_mat.GetId());
+        EXPECT_EQ(mat.IsSensitive(), json_mat.IsSensitive());
+        EXPECT_EQ(mat.Attenuation(0.3), json_mat.Attenuation(0.3));
+    }
+    EXPECT_TRUE(scene.GetMaterial("LSO").IsSensitive());
+    EXPECT_TRUE(sources.SetCurIsotope("BackBack", RigidMapR3::Identity()));
+    EXPECT_TRUE(sources.SetCurIsotope("F18", RigidMapR3::Identity()));
+    EXPECT_FALSE(sources.SetCurIsotope("O15", RigidMapR3::Identity()));
+    EXPECT_EQ(sources.EmittedEnergies(),
+              std::vector<double>({Physics::energy_511}));
+}
+
 class SceneLoadTest : public ::testing::Test {
 public:
     Config config;
@@ -499,6 +647,26 @@ TEST_F(SceneLoadTest, SceneCommandsRectangleSensitive) {
     EXPECT_EQ(v.GetDetectorId(), 0);
 }
 
+TEST_F(SceneLoadTest, UsedMaterials) {
+    std::vector<Command> cmds;
+    cmds.emplace_back("m sensitive");
+    cmds.emplace_back("k 0.0 0.0 0.0 1.0 1.0 1.0");
+
+    Load load;
+    EXPECT_TRUE(load.SceneCommands(cmds, sources, scene, det_array, config));
+    std::vector<GammaMaterial*> used = load.UsedMaterials();
+    std::vector<std::string> names;
+    for (const GammaMaterial* material: used) {
+        names.push_back(material->GetName());
+    }
+    std::sort(names.begin(), names.end());
+    EXPECT_EQ(names, std::vector<std::string>({"default", "sensitive"}));
+    Load::BuildMaterials(used, 4);
+    for (const GammaMaterial* material: used) {
+        EXPECT_TRUE(material->GetStats().TablesBuilt());
+    }
+}
+
 TEST_F(SceneLoadTest, SceneCommandsArray) {
     std::vector<Command> cmds;
     cmds.emplace_back("array 0.0 0.0 0.0 1 3 3 1.1 1.1 1.1 1.0 1.0 1.0");
@@ -564,3 +732,937 @@ TEST_F(SceneLoadTest, SceneCommandsVectorSource) {
     ASSERT_EQ(src->GetActivity(), 20.0 * 37000);
     EXPECT_NE(dynamic_cast<VectorSource const*>(src.get()), nullptr);
 }
+
+TEST_F(SceneLoadTest, SceneCommandsDynVoxelSrc) {
+    const std::vector<std::string> frame_files = {
+        "tmp_dyn_frame_a_test.dat", "tmp_dyn_frame_b_test.dat"};
+    for (size_t idx = 0; idx < frame_files.size(); ++idx) {
+        std::ofstream output(frame_files[idx], std::ios::binary);
+        const int header[5] = {65531, 1, 1, 1, 2};
+        // All of the activity in the low z voxel, and then the high one.
+        const float values[2] = {idx == 0 ? 1.0f : 0.0f,
+                                 idx == 0 ? 0.0f : 1.0f};
+        output.write(reinterpret_cast<const char*>(header), sizeof(header));
+        output.write(reinterpret_cast<const char*>(values), sizeof(values));
+    }
+    const std::string frame_list = "tmp_dyn_frames_test.txt";
+    {
+        std::ofstream output(frame_list);
+        output << "# start duration file activity\n"
+               << "0 0.5 " << frame_files[0] << " 0.1\n"
+               << "0.5 0.5 " << frame_files[1] << " 0.2\n";
+    }
+    std::vector<Command> cmds;
+    cmds.emplace_back("dyn_voxel_src 0 0 0 1 1 2 " + frame_list);
+    cmds.emplace_back("dyn_voxel_src 0 0 0 1 1 2 missing_frames.txt");
+
+    Load load;
+    EXPECT_FALSE(load.SceneCommands(cmds, sources, scene, det_array, config));
+    EXPECT_FALSE(cmds[0].IsError());
+    EXPECT_TRUE(cmds[1].IsError());
+    ASSERT_EQ(sources.NumSources(), 1);
+    auto src = sources.GetSource(0);
+    ASSERT_TRUE(src->IsDynamic());
+    // Files are in uCi, internal is in Bq
+    EXPECT_NEAR(src->GetExpectedDecays(0.0, 1.0), 0.15 * 37000, 10);
+    EXPECT_NEAR(src->GetExpectedDecays(0.25, 0.5), 0.075 * 37000, 10);
+
+    // Run past the last frame, after which there are no more decays.
+    sources.SetSimulationTime(1.5);
+    sources.InitSources();
+    EXPECT_FALSE(sources.SuperposedDecays());
+    int no_decays[2] = {0, 0};
+    while (sources.SimulationIncomplete()) {
+        NuclearDecay decay = sources.Decay();
+        const int frame = decay.GetTime() < 0.5 ? 0 : 1;
+        EXPECT_EQ(decay.GetPosition().z > 0, frame == 1);
+        no_decays[frame]++;
+    }
+    EXPECT_NEAR(no_decays[0], 0.05 * 37000, 200);
+    EXPECT_NEAR(no_decays[1], 0.1 * 37000, 300);
+    EXPECT_EQ(sources.GetElapsedTime(), 1.5);
+    const DynamicVoxelSource& dyn_src =
+            dynamic_cast<const DynamicVoxelSource&>(*src);
+    EXPECT_LE(dyn_src.NumLoadedFrames(), 2);
+
+    // Threads working through their own spans of time, as they do in a
+    // simulation, each move from the first frame to the second.
+    const int no_threads = 4;
+    std::vector<int> no_wrong(no_threads, 0);
+    std::vector<std::thread> threads;
+    for (int thread = 0; thread < no_threads; ++thread) {
+        threads.emplace_back([&dyn_src, &no_wrong, thread]() {
+            for (int ii = 0; ii < 1000; ++ii) {
+                const double time = 0.1 * thread + 0.5 * ii / 1000.0;
+                const bool second = dyn_src.DecayAt(time, -1).z > 0;
+                if (second != (time >= 0.5)) {
+                    no_wrong[thread]++;
+                }
+            }
+        });
+    }
+    for (std::thread& thread: threads) {
+        thread.join();
+    }
+    EXPECT_EQ(no_wrong, std::vector<int>(no_threads, 0));
+
+    for (const std::string& file: frame_files) {
+        std::remove(file.c_str());
+    }
+    std::remove(frame_list.c_str());
+}
+
+TEST_F(SceneLoadTest, SceneCommandsVoxelPhantom) {
+    std::string test_file = "tmp_voxel_phantom_test.dat";
+    {
+        std::ofstream output(test_file, std::ios::binary);
+        const int header[5] = {65531, 1, 3, 1, 1};
+        const float labels[3] = {0, 1, 2};
+        output.write(reinterpret_cast<const char*>(header), sizeof(header));
+        output.write(reinterpret_cast<const char*>(labels), sizeof(labels));
+    }
+    std::vector<Command> cmds;
+    cmds.emplace_back("voxel_phantom 0 0 0 3 1 1 " + test_file +
+                      " 1 world 2 default");
+    cmds.emplace_back("voxel_phantom 0 0 0 3 1 1 " + test_file + " 1");
+    cmds.emplace_back("voxel_phantom 0 0 0 3 1 1 " + test_file + " 1 bone");
+    cmds.emplace_back("voxel_phantom 0 0 0 3 1 1 " + test_file +
+                      " 1 sensitive");
+    cmds.emplace_back("voxel_phantom 0 0 0 3 1 1 " + test_file + " 256 world");
+    cmds.emplace_back("voxel_phantom 0 0 0 3 1 1 missing_file.dat 1 world");
+
+    Load load;
+    EXPECT_FALSE(load.SceneCommands(cmds, sources, scene, det_array, config));
+    std::remove(test_file.c_str());
+    EXPECT_FALSE(cmds[0].IsError());
+    for (size_t ii = 1; ii < cmds.size(); ++ii) {
+        EXPECT_TRUE(cmds[ii].IsError());
+    }
+    ASSERT_EQ(scene.NumViewables(), 1);
+    scene.BuildTree(true, 8.0);
+
+    VisiblePoint point;
+    double hit_dist = DBL_MAX;
+    EXPECT_GE(scene.SeekIntersection({-5.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
+                                     hit_dist, point), 0);
+    EXPECT_NEAR(point.GetPosition().x, -0.5, 1e-12);
+    EXPECT_TRUE(point.IsFrontFacing());
+    EXPECT_EQ(point.GetMaterial(), &scene.GetMaterial("world"));
+
+    // The stack from inside of the second label, as seen from outside.
+    auto stack = GammaRayTrace::BuildStack(scene, {1.0, 0.0, 0.0});
+    ASSERT_EQ(stack.size(), 2);
+    EXPECT_EQ(stack.top(), &scene.GetMaterial("default"));
+}
+
+TEST_F(SceneLoadTest, EnergyCutoff) {
+    std::vector<Command> cmds;
+    cmds.emplace_back("m sensitive");
+    cmds.emplace_back("energy_cutoff 0.05");
+    cmds.emplace_back("energy_cutoff -1.0");
+    Load load;
+    EXPECT_FALSE(load.SceneCommands(cmds, sources, scene, det_array, config));
+    EXPECT_TRUE(cmds[2].IsError());
+    const auto& sensitive =
+            static_cast<const GammaMaterial&>(scene.GetMaterial("sensitive"));
+    EXPECT_EQ(sensitive.GetEnergyCutoff(), 0.05);
+    const auto& other =
+            static_cast<const GammaMaterial&>(scene.GetMaterial("default"));
+    EXPECT_EQ(other.GetEnergyCutoff(), 0.0);
+}
+
+TEST_F(SceneLoadTest, DeltaTrackingDepth) {
+    scene.SetDefaultMaterial("world");
+    // A phantom of something that barely attenuates, next to a row of voxels
+    // of something that attenuates strongly, which sets the majorant.
+    GammaMaterial thin(3, "thin", false, true, GammaStats(
+            1.0, {0.01, 0.1, 1.0}, {1e-8, 1e-8, 1e-8}, {1e-8, 1e-8, 1e-8},
+            {1e-8, 1e-8, 1e-8}, {0.0, 1.0}, {1.0, 1.0}, {1.0, 1.0}));
+    GammaMaterial dense(4, "dense", false, true, GammaStats(
+            1.0, {0.01, 0.1, 1.0}, {1e-8, 1e-8, 1e-8}, {10.0, 10.0, 10.0},
+            {1e-8, 1e-8, 1e-8}, {0.0, 1.0}, {1.0, 1.0}, {1.0, 1.0}));
+    Load::BuildMaterials({&thin, &dense}, 1);
+    std::vector<const Material*> label_materials = {&thin, &dense};
+    std::vector<uint8_t> labels(400);
+    for (size_t idx = 0; idx < labels.size(); ++idx) {
+        labels[idx] = idx % 2;
+    }
+    std::unique_ptr<ViewableVoxelGrid> grid(new ViewableVoxelGrid(
+            {200, 2, 1}, labels, label_materials, {200.0, 2.0, 1.0},
+            RigidMapR3::Identity()));
+    grid->SetDeltaMaterial(std::unique_ptr<Material>(
+            new DeltaMaterial(*grid, {&thin, &dense})));
+    scene.AddViewable(std::move(grid));
+    scene.BuildTree(true, 8.0);
+
+    // Crossing the thin row is thousands of virtual collisions, which don't
+    // count towards the depth of the trace.
+    NuclearDecay decay(0, 0, 0, {-150, -0.5, 0}, 0);
+    decay.AddPhoton(Photon({-150, -0.5, 0}, {1, 0, 0}, 0.511, 0, 0,
+                           Photon::P_BLUE, 0));
+    const std::vector<VectorR3> positions = {{-150, -0.5, 0}};
+    const GammaRayTrace traced(scene, positions, false, false, false, true);
+    GammaRayTraceStats stats;
+    Random::SetSeed(3);
+    EXPECT_TRUE(traced.TraceDecay(decay, stats).empty());
+    Random::SeedDefault();
+    EXPECT_EQ(stats.error, 0);
+    EXPECT_EQ(stats.no_interaction, 1);
+}
+
+TEST_F(SceneLoadTest, DecayFilter) {
+    // Photons go through the world untouched, to the crystals.
+    scene.SetDefaultMaterial("world");
+    // Without scatter, a photon only deposits in the detector it heads into.
+    scene.AddMaterial(std::unique_ptr<GammaMaterial>(new GammaMaterial(
+            3, "lso", true, true, GammaStats(
+                    7.4, {0.01, 0.1, 1.0}, {0.0, 0.0, 0.0},
+                    {90.0, 0.3, 0.02}, {0.0, 0.0, 0.0}, {0.0, 1.0},
+                    {1.0, 1.0}, {1.0, 1.0}))));
+    std::vector<Command> cmds;
+    cmds.emplace_back("decay_filter pairs");
+    cmds.emplace_back("decay_filter");
+    cmds.emplace_back("decay_filter coinc");
+    // Crystals thick enough that anything headed into them is absorbed.
+    cmds.emplace_back("m lso");
+    cmds.emplace_back("k 20.0 0.0 0.0 20.0 20.0 20.0");
+    cmds.emplace_back("k -20.0 0.0 0.0 20.0 20.0 20.0");
+    Load load;
+    EXPECT_FALSE(load.SceneCommands(cmds, sources, scene, det_array, config));
+    EXPECT_TRUE(cmds[0].IsError());
+    EXPECT_TRUE(cmds[1].IsError());
+    EXPECT_FALSE(cmds[2].IsError());
+    EXPECT_EQ(config.get_decay_filter(), GammaRayTrace::DecayFilter::Coinc);
+    scene.BuildTree(true, 8.0);
+    Load::BuildMaterials(load.UsedMaterials(), 1);
+
+    const auto make_decay = [](const VectorR3& blue, const VectorR3& red) {
+        NuclearDecay decay(0, 0, 0, {0, 0, 0}, 0);
+        decay.AddPhoton(Photon({0, 0, 0}, blue, 0.511, 0, 0, Photon::P_BLUE,
+                               0));
+        decay.AddPhoton(Photon({0, 0, 0}, red, 0.511, 0, 0, Photon::P_RED, 0));
+        return (decay);
+    };
+    const NuclearDecay pair = make_decay({1, 0, 0}, {-1, 0, 0});
+    const NuclearDecay single = make_decay({1, 0, 0}, {0, 1, 0});
+    const NuclearDecay missed = make_decay({0, 0, 1}, {0, 1, 0});
+    // Both photons go into the same detector.
+    const NuclearDecay same = make_decay({1, 0, 0}, {1, 0.01, 0});
+    // Only which detectors are hit counts, not which photons hit them.
+    NuclearDecay one_color(0, 0, 0, {0, 0, 0}, 0);
+    one_color.AddPhoton(Photon({0, 0, 0}, {1, 0, 0}, 0.511, 0, 0,
+                               Photon::P_BLUE, 0));
+    one_color.AddPhoton(Photon({0, 0, 0}, {-1, 0, 0}, 0.511, 0, 0,
+                               Photon::P_BLUE, 0));
+
+    const std::vector<VectorR3> positions = {{0, 0, 0}};
+    GammaRayTrace::Options coinc_options;
+    coinc_options.decay_filter = GammaRayTrace::DecayFilter::Coinc;
+    GammaRayTrace::Options singles_options;
+    singles_options.decay_filter = GammaRayTrace::DecayFilter::Singles;
+    const GammaRayTrace coinc(scene, positions, false, false, false, false,
+                              coinc_options);
+    const GammaRayTrace singles(scene, positions, false, false, false, false,
+                                singles_options);
+    GammaRayTraceStats stats;
+    EXPECT_FALSE(coinc.TraceDecay(pair, stats).empty());
+    EXPECT_EQ(stats.decays_filtered, 0);
+    EXPECT_TRUE(coinc.TraceDecay(single, stats).empty());
+    EXPECT_EQ(stats.decays_filtered, 1);
+    EXPECT_GT(stats.interactions_filtered, 0);
+    EXPECT_TRUE(coinc.TraceDecay(same, stats).empty());
+    EXPECT_FALSE(coinc.TraceDecay(one_color, stats).empty());
+    EXPECT_EQ(stats.decays_filtered, 2);
+    EXPECT_FALSE(singles.TraceDecay(single, stats).empty());
+    EXPECT_TRUE(singles.TraceDecay(missed, stats).empty());
+    EXPECT_EQ(stats.decays_filtered, 3);
+    EXPECT_EQ(stats.decays, 6);
+}
+
+TEST_F(SceneLoadTest, RouletteHitsFile) {
+    scene.SetDefaultMaterial("world");
+    scene.AddMaterial(std::unique_ptr<GammaMaterial>(new GammaMaterial(
+            3, "lso", true, true, GammaStats(
+                    7.4, {0.01, 0.1, 1.0}, {0.05, 0.07, 0.05},
+                    {90.0, 0.3, 0.02}, {1.0, 0.01, 0.001}, {0.0, 1.0},
+                    {1.0, 1.0}, {1.0, 1.0}))));
+    scene.AddMaterial(std::unique_ptr<GammaMaterial>(new GammaMaterial(
+            4, "water", false, true, GammaStats(
+                    1.0, {0.01, 0.1, 1.0}, {0.05, 0.17, 0.07},
+                    {1.0, 0.02, 0.001}, {0.1, 0.01, 0.001}, {0.0, 1.0},
+                    {1.0, 1.0}, {1.0, 1.0}))));
+    std::vector<Command> cmds;
+    // Half of the photons that scatter in the phantom are killed, and the
+    // rest are doubled, so only some of the coincidences are weighted.
+    cmds.emplace_back("russian_roulette 0.45 0.5");
+    cmds.emplace_back("m water");
+    cmds.emplace_back("k 0.0 0.0 0.0 16.0 16.0 16.0");
+    cmds.emplace_back("m lso");
+    cmds.emplace_back("k 12.0 0.0 0.0 2.0 8.0 8.0");
+    cmds.emplace_back("k -12.0 0.0 0.0 2.0 8.0 8.0");
+    cmds.emplace_back("k 0.0 12.0 0.0 8.0 2.0 8.0");
+    cmds.emplace_back("k 0.0 -12.0 0.0 8.0 2.0 8.0");
+    Load load;
+    EXPECT_TRUE(load.SceneCommands(cmds, sources, scene, det_array, config));
+    scene.BuildTree(true, 8.0);
+    Load::BuildMaterials(load.UsedMaterials(), 1);
+
+    const std::vector<VectorR3> positions = {{0, 0, 0}};
+    GammaRayTrace::Options options;
+    options.roulette_energy = config.get_roulette_energy();
+    options.roulette_survival = config.get_roulette_survival();
+    const GammaRayTrace traced(scene, positions, false, false, false, false,
+                               options);
+    std::vector<Interaction> hits;
+    GammaRayTraceStats trace_stats;
+    Random::SetSeed(7);
+    for (int ii = 0; ii < 4000; ++ii) {
+        NuclearDecay decay(ii, ii * 1e-6, 0, {0, 0, 0}, 0);
+        const VectorR3 dir = Random::UniformSphere();
+        Photon blue({0, 0, 0}, dir, 0.511, ii * 1e-6, ii,
+                    Photon::P_BLUE, 0);
+        Photon red({0, 0, 0}, -dir, 0.511, ii * 1e-6, ii,
+                   Photon::P_RED, 0);
+        // Which photon is seen first changes from decay to decay.
+        decay.AddPhoton(std::move((ii % 2) ? blue : red));
+        decay.AddPhoton(std::move((ii % 2) ? red : blue));
+        const std::vector<Interaction> inters = traced.TraceDecay(
+                decay, trace_stats);
+        hits.insert(hits.end(), inters.begin(), inters.end());
+    }
+    Random::SeedDefault();
+    ASSERT_GT(trace_stats.roulette_killed, 0);
+
+    const Mapping::IdMappingT mapping;
+    const auto run_daq = [&mapping](const std::vector<Interaction>& input) {
+        DaqModel daq_model;
+        EXPECT_EQ(daq_model.set_processes({"coinc window 10e-9"}, mapping),
+                  0);
+        daq_model.consume(input);
+        daq_model.process_hits();
+        daq_model.process_singles();
+        daq_model.process_coinc(0);
+        daq_model.stop_hits();
+        daq_model.stop_singles();
+        daq_model.stop_coinc(0);
+        return (daq_model.stats().coinc_stats.at(0));
+    };
+    const ProcessStats inline_stats = run_daq(hits);
+    ASSERT_GT(inline_stats.no_coinc_events, 0);
+    EXPECT_NE(inline_stats.weighted_coinc_events,
+              inline_stats.no_coinc_events);
+
+    const std::string test_file = "tmp_roulette_hits_test.dat";
+    for (Output::Format format: {Output::Format::VariableAscii,
+                                 Output::Format::VariableBinary})
+    {
+        {
+            Output output;
+            output.SetFormat(format);
+            output.SetVariableOutputMask(
+                    config.get_hits_var_output_write_flags());
+            ASSERT_TRUE(output.SetLogfile(test_file, true));
+            output.LogHits(hits.begin(), hits.end());
+            output.Close();
+        }
+        Input input;
+        input.set_format(format);
+        ASSERT_TRUE(input.set_logfile(test_file));
+        std::vector<Interaction> read_hits;
+        while (input.read_interactions(read_hits, 1000)) {
+        }
+        ASSERT_EQ(read_hits.size(), hits.size());
+        for (size_t idx = 0; idx < hits.size(); ++idx) {
+            EXPECT_EQ(read_hits[idx].weight, hits[idx].weight);
+            EXPECT_EQ(read_hits[idx].roulette_weight,
+                      hits[idx].roulette_weight);
+        }
+        const ProcessStats offline_stats = run_daq(read_hits);
+        EXPECT_EQ(offline_stats.no_coinc_events,
+                  inline_stats.no_coinc_events);
+        EXPECT_EQ(offline_stats.weighted_coinc_events,
+                  inline_stats.weighted_coinc_events);
+    }
+    std::remove(test_file.c_str());
+}
+
+TEST_F(SceneLoadTest, HitAggregation) {
+    scene.SetDefaultMaterial("world");
+    scene.AddMaterial(std::unique_ptr<GammaMaterial>(new GammaMaterial(
+            3, "lso", true, true, GammaStats(
+                    7.4, {0.01, 0.1, 1.0}, {0.05, 0.07, 0.05},
+                    {90.0, 0.3, 0.02}, {1.0, 0.01, 0.001}, {0.0, 1.0},
+                    {1.0, 1.0}, {1.0, 1.0}))));
+    std::vector<Command> cmds;
+    cmds.emplace_back("aggregate_hits sum");
+    cmds.emplace_back("aggregate_hits centroid");
+    cmds.emplace_back("m lso");
+    cmds.emplace_back("k 20.0 0.0 0.0 20.0 20.0 20.0");
+    cmds.emplace_back("k -20.0 0.0 0.0 20.0 20.0 20.0");
+    Load load;
+    EXPECT_FALSE(load.SceneCommands(cmds, sources, scene, det_array, config));
+    EXPECT_TRUE(cmds[0].IsError());
+    EXPECT_EQ(config.get_hit_aggregation(),
+              GammaRayTrace::HitAggregation::Centroid);
+    scene.BuildTree(true, 8.0);
+    Load::BuildMaterials(load.UsedMaterials(), 1);
+
+    NuclearDecay decay(0, 0, 0, {0, 0, 0}, 0);
+    decay.AddPhoton(Photon({0, 0, 0}, {1, 0, 0}, 0.511, 0, 0, Photon::P_BLUE,
+                           0));
+    decay.AddPhoton(Photon({0, 0, 0}, {-1, 0, 0}, 0.511, 0, 0, Photon::P_RED,
+                           0));
+    const std::vector<VectorR3> positions = {{0, 0, 0}};
+    const GammaRayTrace traced(scene, positions, false, false, false, false);
+    GammaRayTrace::Options options;
+    options.hit_aggregation = GammaRayTrace::HitAggregation::Centroid;
+    const GammaRayTrace aggregated(scene, positions, false, false, false,
+                                   false, options);
+    GammaRayTraceStats stats;
+    long no_traced = 0;
+    long no_aggregated = 0;
+    for (int ii = 0; ii < 200; ++ii) {
+        Random::SetSeed(ii);
+        const std::vector<Interaction> hits = traced.TraceDecay(decay, stats);
+        Random::SetSeed(ii);
+        const std::vector<Interaction> merged = aggregated.TraceDecay(decay,
+                                                                      stats);
+        no_traced += hits.size();
+        no_aggregated += merged.size();
+        // Photons that stay in the first crystal they hit end up as one
+        // deposit, at the center of their energy.
+        for (const int color: {Photon::P_BLUE, Photon::P_RED}) {
+            double energy = 0;
+            VectorR3 weighted(0, 0, 0);
+            std::vector<int> det_ids;
+            for (const Interaction& hit: hits) {
+                if (hit.color == color) {
+                    energy += hit.energy;
+                    weighted += hit.energy * hit.pos;
+                    det_ids.push_back(hit.det_id);
+                }
+            }
+            std::vector<Interaction> photon_merged;
+            std::copy_if(merged.begin(), merged.end(),
+                         std::back_inserter(photon_merged),
+                         [color](const Interaction& hit) {
+                             return (hit.color == color);
+                         });
+            double merged_energy = 0;
+            for (const Interaction& hit: photon_merged) {
+                merged_energy += hit.energy;
+            }
+            EXPECT_NEAR(merged_energy, energy, 1e-9);
+            if (!det_ids.empty() &&
+                std::equal(det_ids.begin() + 1, det_ids.end(),
+                           det_ids.begin()))
+            {
+                ASSERT_EQ(photon_merged.size(), 1);
+                const VectorR3 centroid = weighted / energy;
+                EXPECT_NEAR(photon_merged[0].pos.x, centroid.x, 1e-9);
+                EXPECT_NEAR(photon_merged[0].pos.y, centroid.y, 1e-9);
+                EXPECT_NEAR(photon_merged[0].pos.z, centroid.z, 1e-9);
+                EXPECT_EQ(photon_merged[0].time,
+                          std::find_if(hits.begin(), hits.end(),
+                                       [color](const Interaction& hit) {
+                                           return (hit.color == color);
+                                       })->time);
+            }
+        }
+    }
+    EXPECT_LT(no_aggregated, no_traced);
+    EXPECT_EQ(stats.hits_aggregated, no_traced - no_aggregated);
+}
+
+TEST_F(SceneLoadTest, PhaseSpace) {
+    std::vector<Command> cmds;
+    cmds.emplace_back("t 0.0 0.0 5.0");
+    cmds.emplace_back("phase_space_out ps.dat cyl 0 0 0 0 0 1 2.0 4.0");
+    cmds.emplace_back("phase_space_out ps.dat sphere 0 0 0 2.0");
+    cmds.emplace_back("phase_space_out ps.dat box 0 0 0 1.0 -1.0 1.0");
+    cmds.emplace_back("phase_space_src missing_file.dat");
+    Load load;
+    EXPECT_FALSE(load.SceneCommands(cmds, sources, scene, det_array, config));
+    EXPECT_FALSE(cmds[1].IsError());
+    for (size_t ii = 2; ii < cmds.size(); ++ii) {
+        EXPECT_TRUE(cmds[ii].IsError());
+    }
+    EXPECT_TRUE(config.get_log_phase_space());
+    EXPECT_EQ(config.get_filename_phase_space(), "ps.dat");
+    ASSERT_NE(config.get_phase_space_surface(), nullptr);
+    // The surface is moved along with the current transform.
+    const AABB extents = config.get_phase_space_surface()->GetExtents();
+    EXPECT_DOUBLE_EQ(extents.GetMinZ(), 3.0);
+    EXPECT_DOUBLE_EQ(extents.GetMaxZ(), 7.0);
+    EXPECT_EQ(sources.NumSources(), 0);
+}
+
+TEST_F(SceneLoadTest, PhaseSpaceTrace) {
+    scene.SetDefaultMaterial("world");
+    scene.BuildTree(true, 8.0);
+    const std::string test_file = "tmp_phase_space_trace.dat";
+    PhaseSpace::Writer writer(PhaseSpace::Surface::Box({0, 0, 0}, {2, 2, 2}));
+    ASSERT_TRUE(writer.Open(test_file, true));
+
+    // One photon leaves through the surface, and the other starts outside of
+    // it, so it is counted rather than recorded.
+    NuclearDecay decay(0, 0, 0, {0, 0, 0}, 0);
+    decay.AddPhoton(Photon({0, 0, 0}, {1, 0, 0}, 0.511, 0, 0, Photon::P_BLUE,
+                           0));
+    decay.AddPhoton(Photon({5, 0, 0}, {-1, 0, 0}, 0.511, 0, 0, Photon::P_RED,
+                           0));
+    const std::vector<VectorR3> positions = {{0, 0, 0}};
+    GammaRayTrace::Options options;
+    options.phase_space = &writer;
+    const GammaRayTrace traced(scene, positions, false, false, false, false,
+                               options);
+    GammaRayTraceStats stats;
+    EXPECT_TRUE(traced.TraceDecay(decay, stats).empty());
+    writer.Close();
+    std::remove(test_file.c_str());
+    EXPECT_EQ(stats.phase_space, 1);
+    EXPECT_EQ(stats.phase_space_outside, 1);
+    EXPECT_EQ(stats.no_interaction, 0);
+}
+
+TEST_F(SceneLoadTest, SceneCommandsModule) {
+    std::vector<Command> cmds;
+    cmds.emplace_back("m sensitive");
+    cmds.emplace_back("start_module block");
+    cmds.emplace_back("array 0.0 0.0 0.0 1 3 3 1.1 1.1 1.1 1.0 1.0 1.0");
+    cmds.emplace_back("end_module");
+    cmds.emplace_back("push");
+    cmds.emplace_back("t 10.0 0.0 0.0");
+    cmds.emplace_back("module block");
+    cmds.emplace_back("pop");
+    cmds.emplace_back("push");
+    cmds.emplace_back("t -10.0 0.0 0.0");
+    cmds.emplace_back("module block");
+    cmds.emplace_back("pop");
+
+    Load load;
+    EXPECT_TRUE(load.SceneCommands(cmds, sources, scene, det_array, config));
+    // Each placement is a single viewable, but gets its own detectors.
+    ASSERT_EQ(scene.NumViewables(), 2);
+    EXPECT_EQ(det_array.NumDetectors(), 18);
+
+    scene.BuildTree(true, 8.0);
+    VisiblePoint point;
+    double hit_dist = DBL_MAX;
+    EXPECT_GE(scene.SeekIntersection({20.0, 0.0, 0.0}, {-1.0, 0.0, 0.0},
+                                     hit_dist, point), 0);
+    EXPECT_NEAR(hit_dist, 9.5, 1e-9);
+    EXPECT_NEAR(point.GetPosition().x, 10.5, 1e-9);
+    EXPECT_TRUE(point.IsFrontFacing());
+    EXPECT_EQ(point.GetDetectorId(), 4);
+
+    hit_dist = DBL_MAX;
+    EXPECT_GE(scene.SeekIntersection({-20.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
+                                     hit_dist, point), 0);
+    EXPECT_NEAR(point.GetPosition().x, -10.5, 1e-9);
+    EXPECT_EQ(point.GetDetectorId(), 9 + 4);
+}
+
+TEST_F(SceneLoadTest, SeekIntersectionRopes) {
+    std::vector<Command> cmds;
+    cmds.emplace_back("m sensitive");
+    cmds.emplace_back("array 0.0 0.0 0.0 4 4 4 1.1 1.1 1.1 1.0 1.0 1.0");
+    cmds.emplace_back("sphere 3.0 0.0 0.0 0.7");
+
+    Load load;
+    EXPECT_TRUE(load.SceneCommands(cmds, sources, scene, det_array, config));
+    scene.BuildTree(true, 8.0);
+
+    // Follow paths through the scene, hit to hit, and check that walking the
+    // tree along the ropes from the last leaf finds the same hits as
+    // traversing from the root each time.
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<double> coord(-4.0, 4.0);
+    std::vector<VectorR3> dirs = {{1.0, 0.0, 0.0}, {0.0, -1.0, 0.0},
+                                  {0.0, 0.0, 1.0}, {1.0, 1.0, 0.0}};
+    for (int ii = 0; ii < 200; ++ii) {
+        VectorR3 dir(coord(gen), coord(gen), coord(gen));
+        dirs.push_back(dir);
+    }
+    for (auto dir: dirs) {
+        dir.Normalize();
+        VectorR3 pos(coord(gen), coord(gen), coord(gen));
+        long leaf = -1;
+        HitSurface surface;
+        for (int step = 0; step < 20; ++step) {
+            VisiblePoint expected;
+            double expected_dist = DBL_MAX;
+            long expected_obj = scene.SeekIntersection(pos, dir, expected_dist,
+                                                       expected, surface);
+            VisiblePoint point;
+            double dist = DBL_MAX;
+            long obj = scene.SeekIntersection(pos, dir, dist, point, leaf,
+                                              surface);
+            ASSERT_EQ(obj, expected_obj);
+            if (obj < 0) {
+                break;
+            }
+            EXPECT_DOUBLE_EQ(dist, expected_dist);
+            EXPECT_EQ(point.IsFrontFacing(), expected.IsFrontFacing());
+            surface = point.GetSurface();
+            pos = point.GetPosition();
+        }
+    }
+}
+
+TEST_F(SceneLoadTest, SeekIntersectionSkipSurface) {
+    std::vector<Command> cmds;
+    cmds.emplace_back("m sensitive");
+    // Crystals that touch, so the back of one is the front of the next.
+    cmds.emplace_back("array 0.0 0.0 0.0 3 1 1 1.0 1.0 1.0 1.0 1.0 1.0");
+    cmds.emplace_back("sphere 0.0 5.0 0.0 1.0");
+    cmds.emplace_back("start_module block");
+    cmds.emplace_back("array 0.0 0.0 0.0 1 1 2 1.0 1.0 1.0 1.0 1.0 1.0");
+    cmds.emplace_back("end_module");
+    cmds.emplace_back("push");
+    cmds.emplace_back("t 0.0 -5.0 0.0");
+    cmds.emplace_back("module block");
+    cmds.emplace_back("pop");
+    cmds.emplace_back("push");
+    cmds.emplace_back("t 0.0 -5.0 3.0");
+    cmds.emplace_back("module block");
+    cmds.emplace_back("pop");
+
+    Load load;
+    EXPECT_TRUE(load.SceneCommands(cmds, sources, scene, det_array, config));
+    scene.BuildTree(true, 8.0);
+
+    // Walk a path from hit to hit, starting exactly on the last hit, and
+    // return the x, y, or z position of each hit along with if it was a front
+    // face.
+    auto walk = [this](VectorR3 pos, const VectorR3& dir, int axis) {
+        std::vector<std::pair<double, bool>> hits;
+        VisiblePoint point;
+        HitSurface surface;
+        double dist = DBL_MAX;
+        while (scene.SeekIntersection(pos, dir, dist, point, surface) >= 0) {
+            hits.emplace_back(point.GetPosition()[axis],
+                              point.IsFrontFacing());
+            surface = point.GetSurface();
+            pos = point.GetPosition();
+            dist = DBL_MAX;
+            if (hits.size() > 20) {
+                break;
+            }
+        }
+        return (hits);
+    };
+
+    using Hits = std::vector<std::pair<double, bool>>;
+    Hits hits = walk({-5.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, 0);
+    Hits expected = {{-1.5, true}, {-0.5, false}, {-0.5, true}, {0.5, false},
+                     {0.5, true}, {1.5, false}};
+    ASSERT_EQ(hits.size(), expected.size());
+    for (size_t ii = 0; ii < hits.size(); ++ii) {
+        EXPECT_NEAR(hits[ii].first, expected[ii].first, 1e-12);
+        EXPECT_EQ(hits[ii].second, expected[ii].second);
+    }
+
+    hits = walk({0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, 1);
+    expected = {{0.5, false}, {4.0, true}, {6.0, false}};
+    ASSERT_EQ(hits.size(), expected.size());
+    for (size_t ii = 0; ii < hits.size(); ++ii) {
+        EXPECT_NEAR(hits[ii].first, expected[ii].first, 1e-12);
+        EXPECT_EQ(hits[ii].second, expected[ii].second);
+    }
+
+    // Through the touching crystals of both placements of the module, which
+    // share the same objects.
+    hits = walk({0.0, -5.0, -5.0}, {0.0, 0.0, 1.0}, 2);
+    expected = {{-1.0, true}, {0.0, false}, {0.0, true}, {1.0, false},
+                {2.0, true}, {3.0, false}, {3.0, true}, {4.0, false}};
+    ASSERT_EQ(hits.size(), expected.size());
+    for (size_t ii = 0; ii < hits.size(); ++ii) {
+        EXPECT_NEAR(hits[ii].first, expected[ii].first, 1e-12);
+        EXPECT_EQ(hits[ii].second, expected[ii].second);
+    }
+}
+
+TEST_F(SceneLoadTest, SeekIntersectionOverlap) {
+    std::vector<Command> cmds;
+    cmds.emplace_back("m sensitive");
+    // Overlapping volumes whose surfaces meet along the x axis: two boxes
+    // with the same faces, one sharing just the far face, and a sphere that
+    // touches the near faces.
+    cmds.emplace_back("k 0.0 0.0 0.0 2.0 2.0 2.0");
+    cmds.emplace_back("k 0.0 0.0 0.0 2.0 2.0 2.0");
+    cmds.emplace_back("k 0.5 0.0 0.0 1.0 2.0 2.0");
+    cmds.emplace_back("sphere 0.5 0.0 0.0 1.5");
+
+    Load load;
+    EXPECT_TRUE(load.SceneCommands(cmds, sources, scene, det_array, config));
+    scene.BuildTree(true, 8.0);
+
+    // Every surface along the path is crossed exactly once, no matter which
+    // order the surfaces at the same place are reported in, rather than the
+    // ray going back and forth between them.
+    VectorR3 pos(-5.0, 0.0, 0.0);
+    const VectorR3 dir(1.0, 0.0, 0.0);
+    std::map<long, std::vector<std::pair<double, bool>>> crossed;
+    VisiblePoint point;
+    HitSurface surface;
+    long leaf = -1;
+    double dist = DBL_MAX;
+    long object;
+    int no_hits = 0;
+    while ((object = scene.SeekIntersection(pos, dir, dist, point, leaf,
+                                            surface)) >= 0)
+    {
+        crossed[object].emplace_back(point.GetPosition().x,
+                                     point.IsFrontFacing());
+        surface = point.GetSurface();
+        pos = point.GetPosition();
+        dist = DBL_MAX;
+        ASSERT_LT(++no_hits, 20);
+    }
+    EXPECT_EQ(no_hits, 8);
+    const std::map<long, std::pair<double, double>> expected = {
+        {0, {-1.0, 1.0}}, {1, {-1.0, 1.0}}, {2, {0.0, 1.0}}, {3, {-1.0, 2.0}}};
+    ASSERT_EQ(crossed.size(), expected.size());
+    for (const auto& object_hits : crossed) {
+        const auto& hits = object_hits.second;
+        ASSERT_EQ(hits.size(), 2);
+        EXPECT_TRUE(hits[0].second);
+        EXPECT_FALSE(hits[1].second);
+        EXPECT_NEAR(hits[0].first, expected.at(object_hits.first).first,
+                    1e-12);
+        EXPECT_NEAR(hits[1].first, expected.at(object_hits.first).second,
+                    1e-12);
+    }
+}
+
+TEST_F(SceneLoadTest, SeekIntersectionOverlapModule) {
+    std::vector<Command> cmds;
+    cmds.emplace_back("m sensitive");
+    cmds.emplace_back("start_module cube");
+    cmds.emplace_back("k 0.0 0.0 0.0 2.0 2.0 2.0");
+    cmds.emplace_back("end_module");
+    // An instance of the module, and a box with the same faces, added after
+    // it, so its faces are reported second.
+    cmds.emplace_back("module cube");
+    cmds.emplace_back("k 0.0 0.0 0.0 2.0 2.0 2.0");
+
+    Load load;
+    EXPECT_TRUE(load.SceneCommands(cmds, sources, scene, det_array, config));
+    scene.BuildTree(true, 8.0);
+
+    // The ray enters both before leaving either, and leaves them in the same
+    // order it entered them, crossing each face once.
+    VectorR3 pos(-5.0, 0.0, 0.0);
+    const VectorR3 dir(1.0, 0.0, 0.0);
+    std::vector<std::pair<long, bool>> crossed;
+    VisiblePoint point;
+    HitSurface surface;
+    long leaf = -1;
+    double dist = DBL_MAX;
+    long object;
+    while ((object = scene.SeekIntersection(pos, dir, dist, point, leaf,
+                                            surface)) >= 0)
+    {
+        crossed.emplace_back(object, point.IsFrontFacing());
+        surface = point.GetSurface();
+        pos = point.GetPosition();
+        dist = DBL_MAX;
+        ASSERT_LT(crossed.size(), 10);
+    }
+    const std::vector<std::pair<long, bool>> expected = {
+        {0, true}, {1, true}, {0, false}, {1, false}};
+    EXPECT_EQ(crossed, expected);
+}
+
+TEST_F(SceneLoadTest, MaterialGrid) {
+    std::vector<Command> cmds;
+    cmds.emplace_back("m default");
+    cmds.emplace_back("k 0.0 0.0 0.0 4.0 4.0 4.0");
+    cmds.emplace_back("m world");
+    cmds.emplace_back("sphere 1.0 0.0 0.0 0.6");
+    cmds.emplace_back("cyl 0.0 0.0 0.0 0.0 0.0 1.0 0.3 0.5");
+    cmds.emplace_back("m sensitive");
+    cmds.emplace_back("array 0.0 0.0 1.2 3 3 1 0.4 0.4 0.4 0.3 0.3 0.3");
+    cmds.emplace_back("m default");
+    cmds.emplace_back("sp_src 0.0 0.0 0.0 1.4 1.0");
+
+    Load load;
+    EXPECT_TRUE(load.SceneCommands(cmds, sources, scene, det_array, config));
+    scene.BuildTree(true, 8.0);
+
+    MaterialGrid grid(scene, MaterialGrid::SourceRegion(sources), 3);
+    EXPECT_EQ(grid.NumCells(), 32 * 32 * 32);
+    EXPECT_GT(grid.NumRefinedCells(), 0);
+    // The box, the sphere and cylinder, and the crystals.  The region doesn't
+    // reach outside of the box.
+    EXPECT_EQ(grid.NumStacks(), 3);
+
+    std::mt19937 gen(2);
+    std::uniform_real_distribution<double> coord(-1.7, 1.7);
+    int found = 0;
+    const int no_points = 2000;
+    for (int ii = 0; ii < no_points; ++ii) {
+        const VectorR3 pos(coord(gen), coord(gen), coord(gen));
+        const MaterialGrid::Stack* stack = grid.Lookup(pos);
+        if (stack) {
+            EXPECT_TRUE(*stack == GammaRayTrace::BuildStack(scene, pos));
+            found++;
+        }
+    }
+    // Only the thin shells around surfaces are left to trace.
+    EXPECT_GT(found, 0.8 * no_points);
+    EXPECT_EQ(grid.Lookup({5.0, 0.0, 0.0}), nullptr);
+}
+
+TEST_F(SceneLoadTest, DetectorResponse) {
+    std::vector<Command> cmds;
+    cmds.emplace_back("m sensitive");
+    cmds.emplace_back("detector_response lso.rsp 2.0 3.0 4.0");
+    cmds.emplace_back("detector_response lso.rsp 2.0 3.0");
+    cmds.emplace_back("detector_response lso.rsp 2.0 0.0 4.0");
+    cmds.emplace_back("m default");
+    cmds.emplace_back("detector_response lso.rsp 2.0 3.0 4.0");
+    Load load;
+    EXPECT_FALSE(load.SceneCommands(cmds, sources, scene, det_array, config));
+    EXPECT_FALSE(cmds[1].IsError());
+    EXPECT_TRUE(cmds[2].IsError());
+    EXPECT_TRUE(cmds[3].IsError());
+    EXPECT_TRUE(cmds[5].IsError());
+    ASSERT_EQ(load.CrystalTypes().size(), 1);
+    EXPECT_EQ(load.CrystalTypes()[0].filename, "lso.rsp");
+    EXPECT_EQ(load.CrystalTypes()[0].material,
+              &scene.GetMaterial("sensitive"));
+    EXPECT_DOUBLE_EQ(load.CrystalTypes()[0].size.z, 4.0);
+}
+
+TEST(DetectorResponseTest, Sample) {
+    GammaMaterial lso(1, "LSO", true, true, GammaStats(
+            7.4, {0.01, 0.1, 1.0}, {0.05, 0.07, 0.05}, {90.0, 0.3, 0.02},
+            {1.0, 0.01, 0.001}, {0.0, 1.0}, {1.0, 1.0}, {1.0, 1.0}));
+    GammaMaterial other(2, "other", true, true, GammaStats());
+    lso.BuildTables();
+    DetectorArray detectors;
+    RigidMapR3 rotate = RigidMapR3::Identity();
+    rotate.SetColumn1(VectorR3(0, 1, 0));
+    rotate.SetColumn2(VectorR3(-1, 0, 0));
+    detectors.AddDetector({0, 0, 10}, {2, 3, 4}, rotate, 0, 0, 0, 0);
+    detectors.AddDetector({0, 0, 20}, {1, 1, 1}, rotate, 0, 0, 0, 1);
+
+    const std::string test_file = "tmp_detector_response_test.rsp";
+    Random::SetSeed(3);
+    DetectorResponse response(detectors);
+    bool built = false;
+    ASSERT_TRUE(response.AddCrystalType({test_file, &lso, {2, 3, 4}}, built));
+    EXPECT_TRUE(built);
+    ASSERT_TRUE(response.AddCrystalType({test_file, &lso, {2, 3, 4}}, built));
+    EXPECT_FALSE(built);
+    std::remove(test_file.c_str());
+    EXPECT_EQ(response.NumTables(), 1);
+    EXPECT_EQ(response.NumCrystals(), 1);
+
+    DetectorResponse::Hits hits;
+    const Photon photon({0.5, -0.5, 8}, {0, 0, 1}, 0.511, 0, 0,
+                        Photon::P_BLUE, 0);
+    EXPECT_EQ(response.Sample(1, &lso, photon, hits), -1);
+    EXPECT_EQ(response.Sample(0, &other, photon, hits), -1);
+    const Photon low({0.5, -0.5, 8}, {0, 0, 1}, 0.01, 0, 0, Photon::P_BLUE, 0);
+    EXPECT_EQ(response.Sample(0, &lso, low, hits), -1);
+
+    // The crystal is rotated, so it's 3 wide along x, and 2 along y.
+    const int no_samples = 20000;
+    int no_direct = 0;
+    for (int ii = 0; ii < no_samples; ++ii) {
+        const int no_hits = response.Sample(0, &lso, photon, hits);
+        ASSERT_GT(no_hits, 0);
+        double energy = photon.GetEnergy();
+        double path = 0;
+        for (int idx = 0; idx < no_hits; ++idx) {
+            const DetectorResponse::Hit& hit = hits[idx];
+            EXPECT_LE(std::abs(hit.pos.x), 1.5 + 1e-6);
+            EXPECT_LE(std::abs(hit.pos.y), 1.0 + 1e-6);
+            EXPECT_LE(std::abs(hit.pos.z - 10), 2.0 + 1e-6);
+            EXPECT_LE(hit.energy, energy + 1e-6);
+            EXPECT_GE(hit.path, path);
+            energy = hit.energy;
+            path = hit.path;
+        }
+        const DetectorResponse::Hit& last = hits[no_hits - 1];
+        if (last.type != DetectorResponse::escape) {
+            EXPECT_EQ(last.energy, 0);
+        } else if (no_hits == 1) {
+            EXPECT_NEAR(last.pos.z, 12.0, 1e-6);
+            EXPECT_NEAR(last.path, 4.0, 1e-6);
+            no_direct++;
+        }
+    }
+    EXPECT_NEAR(static_cast<double>(no_direct) / no_samples,
+                std::exp(-4.0 * lso.Attenuation(0.511)), 0.01);
+}
+
+TEST(DetectorResponseTest, SameSizeMaterials) {
+    GammaMaterial lso(1, "LSO", true, true, GammaStats(
+            7.4, {0.01, 0.1, 1.0}, {0.05, 0.07, 0.05}, {90.0, 0.3, 0.02},
+            {1.0, 0.01, 0.001}, {0.0, 1.0}, {1.0, 1.0}, {1.0, 1.0}));
+    GammaMaterial gso(2, "GSO", true, true, GammaStats(
+            6.7, {0.01, 0.1, 1.0}, {0.04, 0.05, 0.03}, {60.0, 0.2, 0.01},
+            {1.0, 0.01, 0.001}, {0.0, 1.0}, {1.0, 1.0}, {1.0, 1.0}));
+    lso.BuildTables();
+    gso.BuildTables();
+    DetectorArray detectors;
+    detectors.AddDetector({0, 0, 10}, {2, 2, 2}, RigidMapR3::Identity(),
+                          0, 0, 0, 0);
+    detectors.AddDetector({0, 0, 20}, {2, 2, 2}, RigidMapR3::Identity(),
+                          0, 0, 0, 1);
+
+    const std::string lso_file = "tmp_detector_response_lso_test.rsp";
+    const std::string gso_file = "tmp_detector_response_gso_test.rsp";
+    Random::SetSeed(4);
+    DetectorResponse response(detectors);
+    bool built = false;
+    ASSERT_TRUE(response.AddCrystalType({lso_file, &lso, {2, 2, 2}}, built));
+    ASSERT_TRUE(response.AddCrystalType({gso_file, &gso, {2, 2, 2}}, built));
+    std::remove(lso_file.c_str());
+    std::remove(gso_file.c_str());
+    EXPECT_EQ(response.NumTables(), 2);
+    EXPECT_EQ(response.NumCrystals(), 2);
+
+    // Each material is sampled from its own table, so the fraction of
+    // photons that go straight through follows its attenuation.
+    const Photon photon({0, 0, 9}, {0, 0, 1}, 0.511, 0, 0, Photon::P_BLUE, 0);
+    const int no_samples = 20000;
+    for (const GammaMaterial* material: {&lso, &gso}) {
+        DetectorResponse::Hits hits;
+        int no_direct = 0;
+        for (int ii = 0; ii < no_samples; ++ii) {
+            const int no_hits = response.Sample(0, material, photon, hits);
+            ASSERT_GT(no_hits, 0);
+            if ((no_hits == 1) &&
+                (hits[0].type == DetectorResponse::escape))
+            {
+                no_direct++;
+            }
+        }
+        EXPECT_NEAR(static_cast<double>(no_direct) / no_samples,
+                    std::exp(-2.0 * material->Attenuation(0.511)), 0.01)
+                << material->GetName();
+    }
+}
+
+TEST_F(SceneLoadTest, SceneCommandsModuleErrors) {
+    std::vector<Command> cmds;
+    cmds.emplace_back("module missing");
+    cmds.emplace_back("end_module");
+    cmds.emplace_back("start_module block");
+    cmds.emplace_back("pt_src 0.0 0.0 0.0 1.0");
+    cmds.emplace_back("end_module");
+
+    Load load;
+    EXPECT_FALSE(load.SceneCommands(cmds, sources, scene, det_array, config));
+    EXPECT_TRUE(cmds[0].IsError());
+    EXPECT_TRUE(cmds[1].IsError());
+    EXPECT_TRUE(cmds[3].IsError());
+    // No geometry was added to the module
+    EXPECT_TRUE(cmds[4].IsError());
+    EXPECT_EQ(sources.NumSources(), 0);
+}
@@ -9,7 +9,17 @@
  */
 
 #include "gtest/gtest.h"
+#include <algorithm>
+#include <cmath>
 #include <memory>
+#include <vector>
+#include "Gray/Math/Math.h"
+#include "Gray/Physics/Compton.h"
+#include "Gray/Physics/EmissionBias.h"
+#include "Gray/Physics/GammaStats.h"
+#include "Gray/Physics/KleinNishina.h"
+#include "Gray/Physics/Photon.h"
+#include "Gray/Physics/Physics.h"
 #include "Gray/Physics/Positron.h"
 #include "Gray/Sources/VectorSource.h"
 #include "Gray/Graphics/SceneDescription.h"
@@ -55,3 +65,143 @@ TEST(Positron, ExpectedPhotons) {
     pos = Positron(0.0, std::numeric_limits<double>::infinity(), 0.25, 1);
     EXPECT_EQ(pos.ExpectedNoPhotons(), 1.5);
 }
+
+TEST(GammaStats, AttenTable) {
+    GammaStats stats(2.0, {0.001, 0.01, 0.05, 0.1, 0.5, 1.0, 10.0},
+                     {0.01, 0.1, 0.18, 0.16, 0.09, 0.07, 0.02},
+                     {2000.0, 5.0, 0.05, 0.006, 1e-4, 3e-5, 1e-6},
+                     {1.0, 0.3, 0.04, 0.01, 5e-4, 1e-4, 1e-6},
+                     {0.0, 1.0}, {1.0, 1.0}, {1.0, 1.0});
+    EXPECT_FALSE(stats.TablesBuilt());
+    stats.BuildTables();
+    EXPECT_TRUE(stats.TablesBuilt());
+    for (double energy = 0.0011; energy < 9.0; energy *= 1.037) {
+        const GammaStats::AttenLengths table = stats.GetAttenLengths(energy);
+        const GammaStats::AttenLengths exact =
+                stats.GetAttenLengthsExact(energy);
+        EXPECT_NEAR(table.photoelectric, exact.photoelectric,
+                    1e-3 * exact.photoelectric);
+        EXPECT_NEAR(table.compton, exact.compton, 1e-3 * exact.compton);
+        EXPECT_NEAR(table.rayleigh, exact.rayleigh, 1e-3 * exact.rayleigh);
+    }
+
+    // Cached energies skip the table.
+    EXPECT_EQ(stats.GetAttenLengths(Physics::energy_511).total(),
+              stats.GetAttenLengthsExact(Physics::energy_511).total());
+    stats.CacheEnergy(0.2);
+    EXPECT_EQ(stats.GetAttenLengths(0.2).total(),
+              stats.GetAttenLengthsExact(0.2).total());
+    stats.DisableRayleigh();
+    EXPECT_EQ(stats.GetAttenLengths(0.2).rayleigh, 0.0);
+    EXPECT_EQ(stats.GetAttenLengths(0.3).rayleigh, 0.0);
+}
+
+TEST(Positron, EmittedEnergies) {
+    Positron pos(0.0, std::numeric_limits<double>::infinity(), 1.0, 1.157);
+    EXPECT_EQ(pos.EmittedEnergies(),
+              std::vector<double>({Physics::energy_511, 1.157}));
+}
+
+TEST(Positron, EmissionBias) {
+    // A square ring of detectors 10cm from the axis and 4cm long.
+    const std::vector<AABB> ring = {
+        AABB({10, -12, -2}, {12, 12, 2}), AABB({-12, -12, -2}, {-10, 12, 2}),
+        AABB({-10, 10, -2}, {10, 12, 2}), AABB({-10, -12, -2}, {10, -10, 2})};
+    const double max_cos = 2.0 / std::sqrt(104.0);
+    EXPECT_DOUBLE_EQ(EmissionBias(ring, 1.0).GetInnerRadius(), 10.0);
+    EXPECT_DOUBLE_EQ(EmissionBias(ring, 1.0).MaxCosine({0, 0, 0}), max_cos);
+    EXPECT_EQ(EmissionBias(ring, 1.0).MaxCosine({11, 0, 0}), 1.0);
+
+    Positron pos(0.0, std::numeric_limits<double>::infinity(), 1.0, 1.157);
+    pos.SetEmissionBias(std::make_shared<EmissionBias>(ring, 1.0));
+    for (int ii = 0; ii < 1000; ++ii) {
+        const NuclearDecay decay = pos.Decay(ii, 0, 0, {0, 0, 0});
+        EXPECT_DOUBLE_EQ(decay.GetWeight(), max_cos);
+        for (const Photon& photon: decay) {
+            EXPECT_EQ(photon.GetWeight(), decay.GetWeight());
+            if (photon.GetColor() == Photon::P_BLUE) {
+                EXPECT_LE(std::abs(photon.GetDir().z), max_cos);
+            }
+        }
+    }
+
+    // Mixed with uniform emission, the weights still add up to the uniform
+    // distribution, both inside of the band and out.
+    pos.SetEmissionBias(std::make_shared<EmissionBias>(ring, 0.8));
+    const int no_decays = 200000;
+    double total = 0;
+    double total_outside = 0;
+    for (int ii = 0; ii < no_decays; ++ii) {
+        const NuclearDecay decay = pos.Decay(ii, 0, 0, {0, 0, 0});
+        for (const Photon& photon: decay) {
+            if (photon.GetColor() == Photon::P_BLUE) {
+                total += decay.GetWeight();
+                if (std::abs(photon.GetDir().z) > 0.5) {
+                    total_outside += decay.GetWeight();
+                }
+            }
+        }
+    }
+    EXPECT_NEAR(total / no_decays, 1.0, 0.02);
+    EXPECT_NEAR(total_outside / no_decays, 0.5, 0.02);
+}
+
+TEST(Photon, Roulette) {
+    const int no_photons = 100000;
+    double total = 0;
+    for (int ii = 0; ii < no_photons; ++ii) {
+        Photon photon;
+        photon.SetWeight(2.0);
+        if (photon.Roulette(0.25)) {
+            EXPECT_DOUBLE_EQ(photon.GetWeight(), 8.0);
+            EXPECT_DOUBLE_EQ(photon.GetRouletteWeight(), 4.0);
+            total += photon.GetWeight();
+        }
+    }
+    // The survivors carry the weight of the ones that were killed.
+    EXPECT_NEAR(total / no_photons, 2.0, 0.05);
+}
+
+TEST(ScatterTable, KleinNishinaDistribution) {
+    // With a scattering function of one, Compton is just Klein-Nishina.
+    const Compton compton({0.0, 1.0}, {1.0, 1.0});
+    const std::vector<double> thetas = Math::linspace(0, M_PI, 20001);
+    for (double energy: {0.05, 0.2, 0.34, Physics::energy_511, 1.2}) {
+        std::vector<double> costhetas(thetas.size());
+        std::transform(thetas.begin(), thetas.end(), costhetas.begin(),
+                       [](double theta) { return (std::cos(theta)); });
+        const std::vector<double> cdf = Math::pdf_to_cdf(
+                thetas, KleinNishina::dsigma(costhetas, energy));
+
+        // Taking evenly spaced probabilities, the fraction of angles below
+        // theta should follow the CDF.
+        const int no_samples = 20000;
+        std::vector<double> sampled(no_samples);
+        for (int ii = 0; ii < no_samples; ++ii) {
+            sampled[ii] = std::acos(compton.scatter_angle(
+                    energy, (ii + 0.5) / no_samples));
+        }
+        std::sort(sampled.begin(), sampled.end());
+        for (double theta = 0.1; theta < M_PI; theta += 0.1) {
+            const double expected = Math::interpolate(thetas, cdf, theta);
+            const double fraction = static_cast<double>(
+                    std::upper_bound(sampled.begin(), sampled.end(), theta) -
+                    sampled.begin()) / no_samples;
+            EXPECT_NEAR(fraction, expected, 0.005)
+                    << "energy: " << energy << " theta: " << theta;
+        }
+    }
+
+    // The batch gives the same angles, one at a time.
+    const std::vector<double> energies = {0.0, 0.01, 0.08, 0.3, 0.511, 2.0};
+    const std::vector<double> rands = {0.0, 0.99, 0.5, 0.25, 0.75, 1.0};
+    std::vector<double> batch(energies.size());
+    compton.scatter_angles(energies.data(), rands.data(), batch.data(),
+                           batch.size());
+    for (size_t ii = 0; ii < batch.size(); ++ii) {
+        EXPECT_NEAR(batch[ii], compton.scatter_angle(energies[ii], rands[ii]),
+                    1e-6);
+        EXPECT_GE(batch[ii], -1.0);
+        EXPECT_LE(batch[ii], 1.0);
+    }
+}
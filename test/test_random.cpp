@@ -9,7 +9,14 @@
  */
 
 #include  "gtest/gtest.h"
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "Gray/Random/AliasTable.h"
+#include "Gray/Random/QuasiRandom.h"
 #include "Gray/Random/Random.h"
+#include "Gray/VrMath/LinearR3.h"
 
 /*!
  * We use the std::mt19937 implementation of the Mersenne Twister Engine.  Even
@@ -25,3 +32,125 @@ TEST(RandomTest, CorrectVal) {
     }
     EXPECT_EQ(val, 4123659995);
 }
+
+TEST(AliasTableTest, Distribution) {
+    const std::vector<double> weights = {1.0, 0.0, 3.0, 0.5, 5.5};
+    AliasTable table(weights);
+    ASSERT_EQ(table.Size(), weights.size());
+    EXPECT_DOUBLE_EQ(table.TotalWeight(), 10.0);
+
+    // Stepping evenly through the uniform gives each index exactly its share,
+    // up to the resolution of the steps.
+    const int no_steps = 100000;
+    std::vector<int> counts(weights.size(), 0);
+    for (int ii = 0; ii < no_steps; ++ii) {
+        counts[table.Sample((ii + 0.5) / no_steps)]++;
+    }
+    for (size_t idx = 0; idx < weights.size(); ++idx) {
+        EXPECT_NEAR(counts[idx], no_steps * weights[idx] / 10.0, 5.0);
+    }
+    EXPECT_LT(table.Sample(1.0), weights.size());
+    EXPECT_THROW(AliasTable({0.0, 0.0}), std::runtime_error);
+    EXPECT_THROW(AliasTable({1.0, -1.0}), std::runtime_error);
+}
+
+TEST(QuasiRandomTest, Stratified) {
+    ScrambledHalton sequence({2, 3});
+    ASSERT_EQ(sequence.Dimensions(), 2);
+    std::mt19937 generator(3);
+    sequence.Scramble(generator);
+
+    // Scrambling the digits keeps each block of base^k points to one point in
+    // each interval of width base^-k.
+    const int no_points = 72;
+    std::vector<double> first(no_points);
+    std::vector<int> count_2(8, 0);
+    std::vector<int> count_3(9, 0);
+    for (int ii = 0; ii < no_points; ++ii) {
+        double point[2];
+        sequence.Next(point);
+        ASSERT_GE(point[0], 0.0);
+        ASSERT_LT(point[0], 1.0);
+        ASSERT_GE(point[1], 0.0);
+        ASSERT_LT(point[1], 1.0);
+        count_2[static_cast<int>(point[0] * 8)]++;
+        count_3[static_cast<int>(point[1] * 9)]++;
+        first[ii] = point[0];
+    }
+    for (int count: count_2) {
+        EXPECT_EQ(count, no_points / 8);
+    }
+    for (int count: count_3) {
+        EXPECT_EQ(count, no_points / 9);
+    }
+
+    // Scrambling again starts over with different points.
+    sequence.Scramble(generator);
+    double point[2];
+    sequence.Next(point);
+    EXPECT_NE(point[0], first[0]);
+}
+
+TEST(QuasiRandomTest, Convergence) {
+    Random::SetQuasiRandom(true);
+    Random::SetSeed(7);
+    EXPECT_TRUE(Random::GetQuasiRandom());
+
+    // The mean of r^2 in the unit sphere is 3/5, and of z^2 on its surface is
+    // 1/3.  For this many points, pseudorandom estimates are only good to
+    // around 4e-3 and 3e-3.
+    const int no_points = 4096;
+    double r_squared = 0;
+    double z_squared = 0;
+    for (int ii = 0; ii < no_points; ++ii) {
+        const VectorR3 pos = Random::UniformSphereFilled();
+        ASSERT_LT(pos.NormSq(), 1.0);
+        r_squared += pos.NormSq();
+        const VectorR3 dir = Random::EmissionDirection();
+        EXPECT_NEAR(dir.Norm(), 1.0, 1e-12);
+        z_squared += dir.z * dir.z;
+    }
+    EXPECT_NEAR(r_squared / no_points, 3.0 / 5.0, 5e-4);
+    EXPECT_NEAR(z_squared / no_points, 1.0 / 3.0, 5e-4);
+
+    // Setting the seed starts the sequences over, scrambled from that seed.
+    Random::SetSeed(7);
+    const VectorR3 first = Random::UniformSphereFilled();
+    Random::SetSeed(7);
+    EXPECT_EQ(Random::UniformSphereFilled().x, first.x);
+    Random::SetSeed(8);
+    EXPECT_NE(Random::UniformSphereFilled().x, first.x);
+
+    Random::SetQuasiRandom(false);
+    Random::SeedDefault();
+}
+
+TEST(QuasiRandomTest, PerThread) {
+    Random::SetQuasiRandom(true);
+    const auto draw = [](unsigned long seed) {
+        Random::ScrambleSequences(seed);
+        std::vector<double> values;
+        for (int ii = 0; ii < 16; ++ii) {
+            const VectorR3 pos = Random::UniformSphereFilled();
+            values.insert(values.end(), {pos.x, pos.y, pos.z});
+        }
+        return (values);
+    };
+
+    // Each thread's sequence is scrambled from its own seed, and stepped
+    // through on its own, however the others are seeded or drawn from.
+    const std::vector<double> expected_1 = draw(1);
+    const std::vector<double> expected_2 = draw(2);
+    EXPECT_NE(expected_1, expected_2);
+    std::vector<double> values_1;
+    std::vector<double> values_2;
+    std::thread thread_1([&]() { values_1 = draw(1); });
+    std::thread thread_2([&]() { values_2 = draw(2); });
+    thread_1.join();
+    thread_2.join();
+    EXPECT_EQ(values_1, expected_1);
+    EXPECT_EQ(values_2, expected_2);
+
+    Random::SetQuasiRandom(false);
+    Random::SeedDefault();
+}
@@ -9,11 +9,22 @@
  */
 
 #include "gtest/gtest.h"
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
 #include <limits>
 #include <memory>
+#include <vector>
+#include "Gray/Gray/PhaseSpace.h"
 #include "Gray/Physics/Beam.h"
 #include "Gray/Physics/GaussianBeam.h"
 #include "Gray/Physics/Positron.h"
+#include "Gray/Physics/NuclearDecay.h"
+#include "Gray/Physics/Photon.h"
+#include "Gray/Random/Random.h"
+#include "Gray/Sources/PhaseSpaceSource.h"
+#include "Gray/Sources/PointSource.h"
+#include "Gray/Sources/SourceGrid.h"
 #include "Gray/Sources/SourceList.h"
 #include "Gray/Sources/SphereSource.h"
 #include "Gray/Sources/VectorSource.h"
@@ -50,6 +61,21 @@ TEST_F(VectorSourceTest, OutsideExtents) {
     EXPECT_FALSE(source->Inside({10, 1e-6, -1}));
 }
 
+TEST_F(VectorSourceTest, DecayGrid) {
+    EXPECT_GT(source->NumInsideCells(), 0);
+    EXPECT_GT(source->NumBoundaryCells(), 0);
+
+    // A uniform ball has an eighth of its decays within half of its radius.
+    const int no_decays = 100000;
+    int no_inner = 0;
+    for (int ii = 0; ii < no_decays; ++ii) {
+        const double radius = source->Decay().Norm();
+        ASSERT_LE(radius, 1.0 + 1e-9);
+        no_inner += (radius < 0.5);
+    }
+    EXPECT_NEAR(static_cast<double>(no_inner) / no_decays, 0.125, 0.005);
+}
+
 TEST(Source, HalfLife) {
     const double act = 1.0;
     const double act_uCi = act / Physics::decays_per_microcurie;
@@ -121,6 +147,78 @@ TEST(SourceList, SearchSplitTime) {
     EXPECT_NEAR(list.ExpectedPhotons(time, 2.0 - time), exp_phot / 2.0, 1e-5);
 }
 
+TEST(SourceList, SuperposedDecays) {
+    SourceList list;
+    list.AddIsotope("stable", std::unique_ptr<Isotope>(new Positron(
+                0.0, std::numeric_limits<double>::infinity(), 1.0, 0)));
+    list.AddIsotope("decaying", std::unique_ptr<Isotope>(new Positron(
+                0.0, 100.0, 1.0, 0)));
+    list.SetCurIsotope("stable", RigidMapR3());
+    const double act_uCi = 1000.0 / Physics::decays_per_microcurie;
+    list.AddSource(std::unique_ptr<Source>(
+                new PointSource({0, 0, 0}, act_uCi)));
+    list.AddSource(std::unique_ptr<Source>(
+                new PointSource({1, 0, 0}, 3.0 * act_uCi)));
+    list.SetSimulationTime(1.0);
+
+    SourceList superposed(list);
+    superposed.InitSources();
+    ASSERT_TRUE(superposed.SuperposedDecays());
+    const int no_decays = 40000;
+    int no_second = 0;
+    double time = 0;
+    for (int ii = 0; ii < no_decays; ++ii) {
+        NuclearDecay decay = superposed.Decay();
+        EXPECT_GE(decay.GetTime(), time);
+        time = decay.GetTime();
+        no_second += decay.GetSourceId();
+    }
+    EXPECT_NEAR(static_cast<double>(no_second) / no_decays, 0.75, 0.01);
+    // The sources decay 4000 times a second between them.
+    EXPECT_NEAR(time, no_decays / 4000.0, 0.25);
+
+    // A source with a different half-life has to be sampled on its own.
+    list.SetCurIsotope("decaying", RigidMapR3());
+    list.AddSource(std::unique_ptr<Source>(
+                new PointSource({2, 0, 0}, act_uCi)));
+    list.InitSources();
+    EXPECT_FALSE(list.SuperposedDecays());
+}
+
+TEST(SourceGrid, MatchesAllSources) {
+    std::vector<std::shared_ptr<const Source>> sources;
+    for (int ii = 0; ii < 200; ++ii) {
+        const VectorR3 center(10.0 * Random::Uniform(),
+                              10.0 * Random::Uniform(),
+                              3.0 * Random::Uniform());
+        sources.emplace_back(new SphereSource(
+                center, 0.1 + 0.5 * Random::Uniform(), -0.5));
+    }
+    SourceGrid grid(sources);
+    for (int ii = 0; ii < 20000; ++ii) {
+        const VectorR3 pos(12.0 * Random::Uniform() - 1.0,
+                           12.0 * Random::Uniform() - 1.0,
+                           5.0 * Random::Uniform() - 1.0);
+        std::vector<uint32_t> expected;
+        for (size_t idx = 0; idx < sources.size(); ++idx) {
+            if (sources[idx]->Inside(pos)) {
+                expected.push_back(idx);
+            }
+        }
+        const uint32_t* begin;
+        const uint32_t* end;
+        grid.Candidates(pos, begin, end);
+        ASSERT_TRUE(std::is_sorted(begin, end));
+        std::vector<uint32_t> found;
+        for (const uint32_t* idx = begin; idx != end; ++idx) {
+            if (sources[*idx]->Inside(pos)) {
+                found.push_back(*idx);
+            }
+        }
+        EXPECT_EQ(found, expected);
+    }
+}
+
 TEST(SourceList, IsotopeFactoryNone) {
     Json::Value iso_json;
     Json::Reader reader;
@@ -302,3 +400,101 @@ TEST(SourceList, ParseGaussianBeamIsotope) {
     GaussianBeam cmp({0.0, 0.0, 1.0}, 3.0, 0.511);
     EXPECT_EQ(cmp, *beam);
 }
+
+TEST(PhaseSpace, SurfaceExitDistance) {
+    auto box = PhaseSpace::Surface::Box({1, 0, 0}, {4, 2, 2});
+    EXPECT_TRUE(box->Inside({2, 0, 0}));
+    EXPECT_FALSE(box->Inside({4, 0, 0}));
+    EXPECT_DOUBLE_EQ(box->ExitDistance({2, 0, 0}, {1, 0, 0}), 1.0);
+    EXPECT_DOUBLE_EQ(box->ExitDistance({2, 0, 0}, {0, -1, 0}), 1.0);
+    EXPECT_LT(box->ExitDistance({4, 0, 0}, {-1, 0, 0}), 0);
+
+    // A cylinder of radius 2 and height 4 along x.
+    auto cyl = PhaseSpace::Surface::Cylinder({0, 0, 1}, {1, 0, 0}, 2, 4);
+    EXPECT_TRUE(cyl->Inside({1.5, 1, 1}));
+    EXPECT_FALSE(cyl->Inside({0, 0, 3.5}));
+    EXPECT_DOUBLE_EQ(cyl->ExitDistance({0, 0, 1}, {0, 0, 1}), 2.0);
+    EXPECT_DOUBLE_EQ(cyl->ExitDistance({0, 0, 1}, {-1, 0, 0}), 2.0);
+    EXPECT_DOUBLE_EQ(cyl->ExitDistance({0, 1, 1}, {0, 1, 0}), 1.0);
+    const AABB extents = cyl->GetExtents();
+    EXPECT_DOUBLE_EQ(extents.GetMinX(), -2.0);
+    EXPECT_DOUBLE_EQ(extents.GetMaxY(), 2.0);
+    EXPECT_DOUBLE_EQ(extents.GetMinZ(), -1.0);
+}
+
+TEST(PhaseSpaceSource, WriteAndReplay) {
+    const std::string test_file = "tmp_phase_space_test.dat";
+    {
+        PhaseSpace::Writer writer(PhaseSpace::Surface::Box({0, 0, 0},
+                                                           {2, 2, 2}));
+        ASSERT_TRUE(writer.Open(test_file, true));
+        Photon blue({1, 0, 0}, {1, 0, 0}, 0.511, 1.5, 7, Photon::P_BLUE, 2);
+        Photon red({-1, 0, 0}, {-1, 0, 0}, 0.3, 1.5, 7, Photon::P_RED, 2);
+        red.SetScatterCompton();
+        red.SetRouletteWeight(4.0);
+        blue.SetWeight(0.5);
+        red.SetWeight(0.5 * 4.0);
+        writer.Write(blue, 1.0);
+        writer.Write(red, 1.0);
+        // A different decay at the same time.
+        Photon same({0, -1, 0}, {0, -1, 0}, 0.511, 1.2, 9, Photon::P_BLUE, 2);
+        writer.Write(same, 1.0);
+        Photon other({0, 1, 0}, {0, 1, 0}, 0.511, 3.0, 8, Photon::P_BLUE, 2);
+        writer.Write(other, 3.0);
+        writer.Close();
+    }
+    PhaseSpaceSource source;
+    ASSERT_TRUE(source.Load(test_file));
+    std::remove(test_file.c_str());
+
+    EXPECT_EQ(source.NumRecords(), 4);
+    EXPECT_TRUE(source.Inside({0.5, 0.5, 0.5}));
+    // Each decay is stepped to in turn, even where they share a time.
+    long index = -1;
+    EXPECT_DOUBLE_EQ(source.NextDecayTime(0.0, index), 1.0);
+    EXPECT_EQ(index, 0);
+    long same_index = index;
+    EXPECT_DOUBLE_EQ(source.NextDecayTime(1.0, same_index), 1.0);
+    EXPECT_EQ(same_index, 2);
+    long other_index = same_index;
+    EXPECT_DOUBLE_EQ(source.NextDecayTime(1.0, other_index), 3.0);
+    EXPECT_EQ(other_index, 3);
+    long end_index = other_index;
+    EXPECT_EQ(source.NextDecayTime(3.0, end_index),
+              std::numeric_limits<double>::infinity());
+    long start_index = -1;
+    EXPECT_DOUBLE_EQ(source.NextDecayTime(1.0, start_index), 3.0);
+    EXPECT_EQ(start_index, 3);
+    EXPECT_DOUBLE_EQ(source.GetExpectedPhotons(0.0, 2.0), 3.0);
+    EXPECT_DOUBLE_EQ(source.GetExpectedPhotons(0.0, 5.0), 4.0);
+
+    NuclearDecay decay = source.Emit(11, 1.0, index, 0,
+                                     source.DecayAt(1.0, index));
+    EXPECT_DOUBLE_EQ(decay.GetWeight(), 0.5);
+    const std::vector<Photon> photons(decay.begin(), decay.end());
+    ASSERT_EQ(photons.size(), 2);
+    const Photon& replay_blue = (photons[0].GetColor() == Photon::P_BLUE) ?
+            photons[0] : photons[1];
+    const Photon& replay_red = (photons[0].GetColor() == Photon::P_RED) ?
+            photons[0] : photons[1];
+    EXPECT_EQ(replay_blue.GetColor(), Photon::P_BLUE);
+    EXPECT_EQ(replay_blue.GetId(), 11);
+    EXPECT_EQ(replay_blue.GetSrc(), 2);
+    EXPECT_DOUBLE_EQ(replay_blue.GetTime(), 1.5);
+    EXPECT_DOUBLE_EQ(replay_blue.GetWeight(), 0.5);
+    EXPECT_EQ(replay_red.GetColor(), Photon::P_RED);
+    EXPECT_FLOAT_EQ(replay_red.GetEnergy(), 0.3);
+    EXPECT_EQ(replay_red.GetScatterComptonPhantom(), 1);
+    EXPECT_DOUBLE_EQ(replay_red.GetRouletteWeight(), 4.0);
+    EXPECT_DOUBLE_EQ(replay_red.GetWeight(), 2.0);
+
+    const NuclearDecay same_decay = source.Emit(
+            12, 1.0, same_index, 0, source.DecayAt(1.0, same_index));
+    ASSERT_EQ(std::distance(same_decay.begin(), same_decay.end()), 1);
+    EXPECT_FLOAT_EQ(same_decay.begin()->GetTime(), 1.2);
+    EXPECT_EQ(same_decay.begin()->GetId(), 12);
+    EXPECT_DOUBLE_EQ(same_decay.GetPosition().y, -1.0);
+
+    const NuclearDecay empty = source.Emit(13, 2.0, end_index, 0, {0, 0, 0});
+    EXPECT_TRUE(empty.begin() == empty.end());
+}
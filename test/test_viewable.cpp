@@ -10,9 +10,23 @@
 
 #include "gtest/gtest.h"
 #include <cmath>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <tuple>
 #include <unordered_map>
 #include "Gray/VrMath/LinearR3.h"
+#include "Gray/Graphics/MeshFile.h"
+#include "Gray/Graphics/ParallelepipedBatch.h"
+#include "Gray/Graphics/ViewableMesh.h"
+#include "Gray/Graphics/ViewableParallelepiped.h"
+#include "Gray/Graphics/ViewableVoxelGrid.h"
+#include "Gray/Graphics/VisiblePoint.h"
+#include "Gray/Gray/DeltaMaterial.h"
+#include "Gray/Gray/GammaMaterial.h"
 #include "Gray/Gray/Load.h"
+#include "Gray/Physics/Photon.h"
+#include "Gray/Random/Random.h"
 
 TEST(AnnulusCylinderTest, NoTriangles) {
     auto pieces = Load::MakeAnnulusCylinder(50, 60, 20);
@@ -96,3 +110,438 @@ TEST(AnnulusCylinderTest, Radius) {
         ASSERT_EQ(no_on, 3);
     }
 }
+
+TEST(ParallelepipedBatchTest, MatchesFindIntersection) {
+    // An odd number of rotated boxes, so the group is padded.
+    std::vector<ViewableParallelepiped> boxes;
+    for (int ii = 0; ii < 7; ++ii) {
+        const VectorR3 a(ii - 3.0, 0.5 * ii, -1.0);
+        const VectorR3 b = a + VectorR3(1.0, 0.2 * ii, 0.0);
+        const VectorR3 c = a + VectorR3(-0.1 * ii, 1.0, 0.3);
+        const VectorR3 d = a + ((b - a) * (c - a)).MakeUnit() * (0.5 + ii);
+        ViewableParallelepiped box;
+        box.SetVertices(a, b, c, d);
+        boxes.push_back(box);
+    }
+    std::vector<const ViewableParallelepiped*> group;
+    for (const auto& box: boxes) {
+        group.push_back(&box);
+    }
+    ParallelepipedBatch batch;
+    ASSERT_EQ(batch.AddGroup(group), 0);
+    ASSERT_EQ(batch.Size(), 8);
+
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<double> pos_dist(-6, 6);
+    std::normal_distribution<double> dir_dist;
+    std::uniform_real_distribution<double> max_dist(0, 20);
+    const size_t width = ParallelepipedBatch::width;
+    int no_hits = 0;
+    for (int ray = 0; ray < 10000; ++ray) {
+        const VectorR3 pos(pos_dist(gen), pos_dist(gen), pos_dist(gen));
+        const VectorR3 dir = VectorR3(dir_dist(gen), dir_dist(gen),
+                                      dir_dist(gen)).MakeUnit();
+        const double max_distance = max_dist(gen);
+        for (size_t first = 0; first < batch.Size(); first += width) {
+            double front[width];
+            double back[width];
+            bool hit[width];
+            batch.Intersect(first, pos, dir, max_distance, front, back, hit);
+            for (size_t ii = 0; ii < width && first + ii < boxes.size(); ++ii) {
+                double distance;
+                VisiblePoint point;
+                bool expect_hit = boxes[first + ii].FindIntersection(
+                        pos, dir, max_distance, &distance, point);
+                bool batch_hit = hit[ii];
+                double batch_distance = -1;
+                bool batch_front = false;
+                if (batch_hit && front[ii] >= 0) {
+                    batch_distance = front[ii];
+                    batch_front = true;
+                } else if (batch_hit && back[ii] > 0 &&
+                           back[ii] < max_distance) {
+                    batch_distance = back[ii];
+                } else {
+                    batch_hit = false;
+                }
+                ASSERT_EQ(batch_hit, expect_hit);
+                if (expect_hit) {
+                    no_hits++;
+                    EXPECT_EQ(batch_distance, distance);
+                    EXPECT_EQ(batch_front, point.IsFrontFacing());
+                }
+            }
+        }
+    }
+    EXPECT_GT(no_hits, 1000);
+}
+
+namespace {
+/*!
+ * A cube from -1 to 1 on each axis, as a mesh of twelve triangles wound
+ * counter-clockwise when seen from outside.
+ */
+ViewableMesh MakeCubeMesh() {
+    std::vector<VectorR3> vertices;
+    for (int ii = 0; ii < 8; ++ii) {
+        vertices.emplace_back((ii & 1) ? 1 : -1, (ii & 2) ? 1 : -1,
+                              (ii & 4) ? 1 : -1);
+    }
+    std::vector<ViewableMesh::Triangle> triangles;
+    auto add = [&](uint32_t a, uint32_t b, uint32_t c) {
+        const VectorR3 normal = (vertices[b] - vertices[a]) *
+                                (vertices[c] - vertices[a]);
+        const VectorR3 centroid = vertices[a] + vertices[b] + vertices[c];
+        if ((normal ^ centroid) < 0) {
+            std::swap(b, c);
+        }
+        triangles.push_back({{a, b, c}});
+    };
+    for (int axis = 0; axis < 3; ++axis) {
+        const uint32_t bit = 1 << axis;
+        const uint32_t u = 1 << ((axis + 1) % 3);
+        const uint32_t v = 1 << ((axis + 2) % 3);
+        for (uint32_t side: {0u, bit}) {
+            add(side, side | u, side | u | v);
+            add(side, side | u | v, side | v);
+        }
+    }
+    return (ViewableMesh(vertices, triangles));
+}
+}
+
+TEST(ViewableMeshTest, MatchesParallelepiped) {
+    const ViewableMesh mesh = MakeCubeMesh();
+    ASSERT_EQ(mesh.NumVertices(), 8);
+    ASSERT_EQ(mesh.NumTriangles(), 12);
+    const ViewableParallelepiped box({0, 0, 0}, {2, 2, 2});
+
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<double> pos_dist(-3, 3);
+    std::normal_distribution<double> dir_dist;
+    int no_hits = 0;
+    for (int ray = 0; ray < 10000; ++ray) {
+        const VectorR3 pos(pos_dist(gen), pos_dist(gen), pos_dist(gen));
+        const VectorR3 dir = VectorR3(dir_dist(gen), dir_dist(gen),
+                                      dir_dist(gen)).MakeUnit();
+        double mesh_dist, box_dist;
+        VisiblePoint mesh_point, box_point;
+        bool mesh_hit = mesh.FindIntersection(pos, dir, DBL_MAX, &mesh_dist,
+                                              mesh_point);
+        bool box_hit = box.FindIntersection(pos, dir, DBL_MAX, &box_dist,
+                                            box_point);
+        ASSERT_EQ(mesh_hit, box_hit);
+        if (mesh_hit) {
+            no_hits++;
+            EXPECT_NEAR(mesh_dist, box_dist, 1e-12);
+            EXPECT_EQ(mesh_point.IsFrontFacing(), box_point.IsFrontFacing());
+        }
+    }
+    EXPECT_GT(no_hits, 1000);
+}
+
+TEST(ViewableMeshTest, Watertight) {
+    const ViewableMesh mesh = MakeCubeMesh();
+    // Rays along the diagonals of the faces, where the two triangles of each
+    // face meet, and through the cube's corners, must hit and then leave.
+    std::vector<std::pair<VectorR3, VectorR3>> rays;
+    for (int ii = -8; ii <= 8; ++ii) {
+        const double t = ii / 8.0;
+        rays.emplace_back(VectorR3(-5, t, t), VectorR3(1, 0, 0));
+        rays.emplace_back(VectorR3(-5, t, -t), VectorR3(1, 0, 0));
+        rays.emplace_back(VectorR3(t, 5, t), VectorR3(0, -1, 0));
+        rays.emplace_back(VectorR3(t, -t, -5), VectorR3(0, 0, 1));
+    }
+    rays.emplace_back(VectorR3(-2, -2, -2), VectorR3(1, 1, 1).MakeUnit());
+    rays.emplace_back(VectorR3(2, -2, 2), VectorR3(-1, 1, -1).MakeUnit());
+    for (const auto& ray: rays) {
+        const VectorR3& pos = ray.first;
+        const VectorR3& dir = ray.second;
+        double dist;
+        VisiblePoint point;
+        ASSERT_TRUE(mesh.FindIntersection(pos, dir, DBL_MAX, &dist, point));
+        EXPECT_TRUE(point.IsFrontFacing());
+        // Continue from the hit, which must find the way out, and nothing
+        // after that.
+        const VectorR3 inside = point.GetPosition();
+        ASSERT_TRUE(mesh.FindIntersection(inside, dir, DBL_MAX, &dist, point,
+                                          point.GetSurface()));
+        EXPECT_TRUE(point.IsBackFacing());
+        EXPECT_GT(dist, 0);
+        const VectorR3 outside = point.GetPosition();
+        EXPECT_FALSE(mesh.FindIntersection(outside, dir, DBL_MAX, &dist,
+                                           point, point.GetSurface()));
+    }
+}
+
+TEST(ViewableVoxelGridTest, Walk) {
+    Material water;
+    Material bone;
+    // Along x: empty, water, then two voxels of bone, from x = 8 to 12.
+    std::vector<const Material*> label_materials = {nullptr, &water, &bone};
+    RigidMapR3 local_to_global = RigidMapR3::Identity();
+    local_to_global.SetColumn4(VectorR3(10.0, 0.0, 0.0));
+    ViewableVoxelGrid grid({4, 1, 1}, {0, 1, 2, 2}, label_materials,
+                           {4.0, 1.0, 1.0}, local_to_global);
+
+    // Walk from hit to hit, starting each search on the last hit.
+    auto walk = [&grid](VectorR3 pos, const VectorR3& dir) {
+        std::vector<std::tuple<double, bool, const Material*>> hits;
+        VisiblePoint point;
+        HitSurface surface;
+        double dist;
+        while (grid.FindIntersection(pos, dir, DBL_MAX, &dist, point,
+                                     surface))
+        {
+            hits.emplace_back(point.GetPosition().x, point.IsFrontFacing(),
+                              point.GetMaterial());
+            surface = point.GetSurface();
+            pos = point.GetPosition();
+            if (hits.size() > 10) {
+                break;
+            }
+        }
+        return (hits);
+    };
+
+    using Hits = std::vector<std::tuple<double, bool, const Material*>>;
+    // Going straight from water into bone leaves the water, then enters the
+    // bone at the same point.
+    Hits expected = {std::make_tuple(9.0, true, &water),
+                     std::make_tuple(10.0, false, &water),
+                     std::make_tuple(10.0, true, &bone),
+                     std::make_tuple(12.0, false, &bone)};
+    Hits hits = walk({0.0, 0.2, -0.3}, {1.0, 0.0, 0.0});
+    ASSERT_EQ(hits.size(), expected.size());
+    for (size_t ii = 0; ii < hits.size(); ++ii) {
+        EXPECT_NEAR(std::get<0>(hits[ii]), std::get<0>(expected[ii]), 1e-12);
+        EXPECT_EQ(std::get<1>(hits[ii]), std::get<1>(expected[ii]));
+        EXPECT_EQ(std::get<2>(hits[ii]), std::get<2>(expected[ii]));
+    }
+
+    // Starting inside of the bone, and leaving through the empty voxel.
+    expected = {std::make_tuple(10.0, false, &bone),
+                std::make_tuple(10.0, true, &water),
+                std::make_tuple(9.0, false, &water)};
+    hits = walk({11.5, 0.0, 0.0}, {-1.0, 0.0, 0.0});
+    ASSERT_EQ(hits.size(), expected.size());
+    for (size_t ii = 0; ii < hits.size(); ++ii) {
+        EXPECT_NEAR(std::get<0>(hits[ii]), std::get<0>(expected[ii]), 1e-12);
+        EXPECT_EQ(std::get<1>(hits[ii]), std::get<1>(expected[ii]));
+        EXPECT_EQ(std::get<2>(hits[ii]), std::get<2>(expected[ii]));
+    }
+
+    VisiblePoint point;
+    double dist;
+    EXPECT_FALSE(grid.FindIntersection({0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, 5.0,
+                                       &dist, point));
+    EXPECT_FALSE(grid.FindIntersection({0.0, 2.0, 0.0}, {1.0, 0.0, 0.0},
+                                       DBL_MAX, &dist, point));
+    EXPECT_EQ(grid.GetMaterialAt({9.5, 0.0, 0.0}), &water);
+    EXPECT_EQ(grid.GetMaterialAt({8.5, 0.0, 0.0}), nullptr);
+    EXPECT_EQ(grid.GetMaterialAt({13.0, 0.0, 0.0}), nullptr);
+
+    std::vector<uint8_t> labels;
+    EXPECT_TRUE(ViewableVoxelGrid::ValuesToLabels({0.0, 3.0, 255.0}, labels));
+    EXPECT_EQ(labels, std::vector<uint8_t>({0, 3, 255}));
+    EXPECT_FALSE(ViewableVoxelGrid::ValuesToLabels({1.5}, labels));
+    EXPECT_FALSE(ViewableVoxelGrid::ValuesToLabels({256.0}, labels));
+}
+
+TEST(ViewableVoxelGridTest, DeltaTracking) {
+    // Bone attenuates more at low energies and water at high energies, so
+    // the majorant switches between them.
+    GammaMaterial water(1, "water", false, true, GammaStats(
+            1.0, {0.01, 0.1, 1.0}, {0.2, 0.15, 0.07}, {4.0, 0.003, 1e-5},
+            {0.1, 0.01, 1e-4}, {0.0, 1.0}, {1.0, 1.0}, {1.0, 1.0}));
+    GammaMaterial bone(2, "bone", false, true, GammaStats(
+            1.0, {0.02, 0.2, 1.0}, {0.15, 0.12, 0.05}, {20.0, 0.01, 1e-5},
+            {0.2, 0.02, 1e-4}, {0.0, 1.0}, {1.0, 1.0}, {1.0, 1.0}));
+    std::vector<const Material*> label_materials = {&water, &bone};
+    RigidMapR3 local_to_global = RigidMapR3::Identity();
+    local_to_global.SetColumn4(VectorR3(10.0, 0.0, 0.0));
+    ViewableVoxelGrid grid({4, 1, 1}, {0, 0, 1, 1}, label_materials,
+                           {4.0, 1.0, 1.0}, local_to_global);
+    DeltaMaterial* delta = new DeltaMaterial(grid, {&water, &bone});
+    grid.SetDeltaMaterial(std::unique_ptr<Material>(delta));
+
+    for (double energy = 0.005; energy < 2.0; energy *= 1.05) {
+        const double largest = std::max(water.Attenuation(energy),
+                                        bone.Attenuation(energy));
+        EXPECT_GE(delta->Majorant(energy), largest);
+        EXPECT_LE(delta->Majorant(energy),
+                  1.02 * DeltaMaterial::majorant_margin * largest);
+    }
+    EXPECT_EQ(&delta->MaterialAt({9.0, 0.0, 0.0}), &water);
+    EXPECT_EQ(&delta->MaterialAt({11.0, 0.0, 0.0}), &bone);
+
+    // The phantom is only a box, with no surface where the material changes.
+    VisiblePoint point;
+    double dist;
+    ASSERT_TRUE(grid.FindIntersection({0.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
+                                      DBL_MAX, &dist, point));
+    EXPECT_NEAR(dist, 8.0, 1e-12);
+    EXPECT_TRUE(point.IsFrontFacing());
+    EXPECT_EQ(point.GetMaterial(), delta);
+    ASSERT_TRUE(grid.FindIntersection(point.GetPosition(), {1.0, 0.0, 0.0},
+                                      DBL_MAX, &dist, point,
+                                      point.GetSurface()));
+    EXPECT_NEAR(dist, 4.0, 1e-12);
+    EXPECT_TRUE(point.IsBackFacing());
+    EXPECT_FALSE(grid.FindIntersection(point.GetPosition(), {1.0, 0.0, 0.0},
+                                       DBL_MAX, &dist, point,
+                                       point.GetSurface()));
+
+    // Interactions are kept in proportion to the local attenuation.
+    Random::SetSeed(7);
+    const double energy = 0.511;
+    const Photon photon({9.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, energy, 0, 0,
+                        Photon::P_BLUE, 0);
+    const int no_samples = 100000;
+    int no_real = 0;
+    for (int ii = 0; ii < no_samples; ++ii) {
+        GammaStats::AttenLengths len;
+        const GammaMaterial* interact_mat = delta->InteractionMaterial(photon,
+                                                                       len);
+        if (interact_mat) {
+            EXPECT_EQ(interact_mat, &water);
+            no_real++;
+        }
+    }
+    EXPECT_NEAR(static_cast<double>(no_real) / no_samples,
+                water.Attenuation(energy) / delta->Majorant(energy), 0.01);
+}
+
+TEST(MeshFileTest, OBJ) {
+    std::istringstream input(
+            "# a square and a triangle\n"
+            "v 0 0 0\n"
+            "v 1 0 0\n"
+            "v 1 1 0\n"
+            "vn 0 0 1\n"
+            "v 0 1 0\n"
+            "f 1 2 3 4\n"
+            "f -4/1/1 -2//1 -1\n");
+    std::vector<VectorR3> vertices;
+    std::vector<ViewableMesh::Triangle> triangles;
+    std::string error;
+    ASSERT_TRUE(MeshFile::ReadOBJ(input, vertices, triangles, error)) << error;
+    ASSERT_EQ(vertices.size(), 4);
+    ASSERT_EQ(triangles.size(), 3);
+    EXPECT_EQ(triangles[0], (ViewableMesh::Triangle{{0, 1, 2}}));
+    EXPECT_EQ(triangles[1], (ViewableMesh::Triangle{{0, 2, 3}}));
+    EXPECT_EQ(triangles[2], (ViewableMesh::Triangle{{0, 2, 3}}));
+    EXPECT_EQ(vertices[3].y, 1.0);
+
+    std::istringstream bad("v 0 0 0\nv 1 0 0\nv 1 1 0\nf 1 2 4\n");
+    EXPECT_FALSE(MeshFile::ReadOBJ(bad, vertices, triangles, error));
+}
+
+TEST(MeshFileTest, STL) {
+    // Two facets that share an edge, so the vertices are merged.
+    std::istringstream ascii(
+            "solid test\n"
+            "facet normal 0 0 1\n outer loop\n"
+            "  vertex 0 0 0\n  vertex 1 0 0\n  vertex 1 1 0\n"
+            " endloop\nendfacet\n"
+            "facet normal 0 0 1\n outer loop\n"
+            "  vertex 0 0 0\n  vertex 1 1 0\n  vertex 0 1 -0.0\n"
+            " endloop\nendfacet\n"
+            "endsolid test\n");
+    std::vector<VectorR3> vertices;
+    std::vector<ViewableMesh::Triangle> triangles;
+    std::string error;
+    ASSERT_TRUE(MeshFile::ReadSTL(ascii, vertices, triangles, error)) << error;
+    ASSERT_EQ(vertices.size(), 4);
+    ASSERT_EQ(triangles.size(), 2);
+    EXPECT_EQ(triangles[1], (ViewableMesh::Triangle{{0, 2, 3}}));
+
+    // A binary file whose header also starts with solid.
+    std::string binary = "solid but really binary";
+    binary.resize(80, ' ');
+    auto add_u32 = [&binary](uint32_t value) {
+        for (int ii = 0; ii < 4; ++ii) {
+            binary.push_back(static_cast<char>((value >> (8 * ii)) & 0xff));
+        }
+    };
+    auto add_float = [&add_u32](float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        add_u32(bits);
+    };
+    add_u32(1);
+    const float record[12] = {0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 3, 0.5};
+    for (float value: record) {
+        add_float(value);
+    }
+    binary.append(2, '\0');
+    std::istringstream binary_input(binary);
+    vertices.clear();
+    triangles.clear();
+    ASSERT_TRUE(MeshFile::ReadSTL(binary_input, vertices, triangles, error))
+            << error;
+    ASSERT_EQ(vertices.size(), 3);
+    ASSERT_EQ(triangles.size(), 1);
+    EXPECT_EQ(vertices[1].x, 2.0);
+    EXPECT_EQ(vertices[2].z, 0.5);
+}
+
+TEST(MeshFileTest, PLY) {
+    std::istringstream ascii(
+            "ply\n"
+            "format ascii 1.0\n"
+            "comment a square\n"
+            "element vertex 4\n"
+            "property float x\n"
+            "property float y\n"
+            "property float z\n"
+            "property uchar red\n"
+            "element face 1\n"
+            "property list uchar int vertex_indices\n"
+            "end_header\n"
+            "0 0 0 255\n"
+            "1 0 0 255\n"
+            "1 1 0 255\n"
+            "0 1 0.5 255\n"
+            "4 0 1 2 3\n");
+    std::vector<VectorR3> vertices;
+    std::vector<ViewableMesh::Triangle> triangles;
+    std::string error;
+    ASSERT_TRUE(MeshFile::ReadPLY(ascii, vertices, triangles, error)) << error;
+    ASSERT_EQ(vertices.size(), 4);
+    ASSERT_EQ(triangles.size(), 2);
+    EXPECT_EQ(vertices[3].z, 0.5);
+    EXPECT_EQ(triangles[1], (ViewableMesh::Triangle{{0, 2, 3}}));
+
+    std::string binary =
+            "ply\n"
+            "format binary_big_endian 1.0\n"
+            "element vertex 3\n"
+            "property double x\n"
+            "property double y\n"
+            "property double z\n"
+            "element face 1\n"
+            "property list uchar ushort vertex_indices\n"
+            "end_header\n";
+    auto add_double = [&binary](double value) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        for (int ii = 7; ii >= 0; --ii) {
+            binary.push_back(static_cast<char>((bits >> (8 * ii)) & 0xff));
+        }
+    };
+    const double coords[9] = {0, 0, 0, -1.5, 0, 0, 0, 2, 0};
+    for (double value: coords) {
+        add_double(value);
+    }
+    binary += std::string("\x03\x00\x02\x00\x01\x00\x00", 7);
+    std::istringstream binary_input(binary);
+    vertices.clear();
+    triangles.clear();
+    ASSERT_TRUE(MeshFile::ReadPLY(binary_input, vertices, triangles, error))
+            << error;
+    ASSERT_EQ(vertices.size(), 3);
+    ASSERT_EQ(triangles.size(), 1);
+    EXPECT_EQ(vertices[1].x, -1.5);
+    EXPECT_EQ(triangles[0], (ViewableMesh::Triangle{{2, 1, 0}}));
+}
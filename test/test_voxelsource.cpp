@@ -13,6 +13,7 @@
 #include <sstream>
 #include <vector>
 #include "Gray/Sources/VoxelSource.h"
+#include "Gray/VrMath/LinearR3.h"
 
 TEST(VoxelSourceTest, LoadEasy) {
     std::stringstream ss;
@@ -79,3 +80,49 @@ TEST(VoxelSourceTest, LoadBadVersion) {
     std::vector<double> vals;
     ASSERT_FALSE(VoxelSource::Load(ss, vals, dims));
 }
+
+TEST(VoxelSourceTest, DecayDistribution) {
+    std::stringstream ss;
+    int magic_number = 65531;
+    int version_number = 1;
+    std::array<int,3> dims{{2, 2, 3}};
+    // In XZY ordering, with the first slice in x mostly empty.
+    std::vector<float> write_vals({0, 0, 1, 0, 0, 0, 2, 3, 0, 1, 4, 0});
+    ss.write(reinterpret_cast<char*>(&magic_number), sizeof(magic_number));
+    ss.write(reinterpret_cast<char*>(&version_number), sizeof(version_number));
+    ss.write(reinterpret_cast<char*>(dims.data()), dims.size() * sizeof(int));
+    ss.write(reinterpret_cast<char*>(write_vals.data()),
+            write_vals.size() * sizeof(float));
+
+    const VectorR3 size(2.0, 2.0, 3.0);
+    VoxelSource source({0, 0, 0}, size, {0, 0, 1}, 1.0);
+    ASSERT_TRUE(source.Load(ss));
+
+    // In XYZ ordering
+    const std::vector<double> exp_vals = {0, 1, 0, 0, 0, 0, 2, 0, 4, 3, 1, 0};
+    const int no_decays = 110000;
+    std::vector<int> counts(exp_vals.size(), 0);
+    for (int ii = 0; ii < no_decays; ++ii) {
+        VectorR3 pos = source.Decay();
+        int x = static_cast<int>(pos.x + 1.0);
+        int y = static_cast<int>(pos.y + 1.0);
+        int z = static_cast<int>(pos.z + 1.5);
+        ASSERT_TRUE((x >= 0) && (x < 2) && (y >= 0) && (y < 2) &&
+                    (z >= 0) && (z < 3));
+        counts[(x * 2 + y) * 3 + z]++;
+    }
+    for (size_t idx = 0; idx < exp_vals.size(); ++idx) {
+        EXPECT_NEAR(counts[idx], no_decays * exp_vals[idx] / 11.0, 800);
+    }
+
+    std::stringstream empty;
+    std::vector<float> zeros(12, 0);
+    empty.write(reinterpret_cast<char*>(&magic_number), sizeof(magic_number));
+    empty.write(reinterpret_cast<char*>(&version_number),
+                sizeof(version_number));
+    empty.write(reinterpret_cast<char*>(dims.data()),
+                dims.size() * sizeof(int));
+    empty.write(reinterpret_cast<char*>(zeros.data()),
+                zeros.size() * sizeof(float));
+    EXPECT_FALSE(source.Load(empty));
+}